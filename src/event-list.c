@@ -53,7 +53,9 @@
 #include "orage-appointment-window.h"
 #include "orage-category.h"
 #include "orage-i18n.h"
+#include "orage-memory.h"
 #include "orage-time-utils.h"
+#include "orage-trace.h"
 #include "orage-week-window.h"
 #include "orage-window.h"
 #include "parameters.h"
@@ -85,6 +87,12 @@ static const GtkTargetEntry drag_targets[] =
     { "STRING", 0, DRAG_TARGET_STRING }
 };
 
+/* Rough heap bytes of one list store row without its strings. */
+#define EL_ROW_BYTES (48 + NUM_COLS * 2 * sizeof (gpointer))
+
+/* open event list windows, for memory accounting */
+static GList *el_windows = NULL;
+
 static void start_appt_win (const gboolean copy_appt_win, el_win *el
         , GtkTreeModel *model, GtkTreeIter *iter, GtkTreePath *path)
 {
@@ -156,7 +164,9 @@ static void append_time (gchar *result, GDateTime *gdt, const size_t len)
     g_free (ical_time);
 }
 
-static gchar *format_time(el_win *el, xfical_appt *appt, GDateTime *gdt_par)
+static gchar *format_time (el_win *el, const xfical_appt *appt,
+                           GDateTime *start, GDateTime *end,
+                           GDateTime *gdt_par)
 {
     gchar *result;
     const size_t result_len = 51;
@@ -169,41 +179,41 @@ static gchar *format_time(el_win *el, xfical_appt *appt, GDateTime *gdt_par)
     if (el->page == EVENT_PAGE && el->days == 0) {
         /* special formatting for 1 day VEVENTS */
         if (appt->allDay == FALSE) { /* time part available */
-            if (gdt_par && (orage_gdatetime_compare_date (appt->starttimecur, gdt_par) < 0))
+            if (gdt_par && (orage_gdatetime_compare_date (start, gdt_par) < 0))
                 g_strlcpy (result, "+00:00 ", result_len);
             else
-                append_time (&result[i], appt->starttimecur, result_len - i);
+                append_time (&result[i], start, result_len - i);
             i = g_strlcat (result, "- ", result_len);
-            if ((gdt_par == NULL) || (orage_gdatetime_compare_date (gdt_par, appt->endtimecur) < 0))
+            if ((gdt_par == NULL) || (orage_gdatetime_compare_date (gdt_par, end) < 0))
                 g_strlcat (result, "24:00+", result_len);
             else
-                append_time (&result[i], appt->endtimecur, result_len - i);
+                append_time (&result[i], end, result_len - i);
         }
         else {/* date only appointment */
             g_strlcpy (result, _("All day"), result_len);
         }
     }
     else { /* normally show date and time */
-        tmp = orage_gdatetime_to_i18_time (appt->starttimecur, TRUE);
+        tmp = orage_gdatetime_to_i18_time (start, TRUE);
         i = g_strlcpy(result, tmp, result_len);
         g_free (tmp);
         if (appt->allDay == FALSE) { /* time part available */
             result[i++] = ' ';
-            append_time (&result[i], appt->starttimecur, result_len - i);
+            append_time (&result[i], start, result_len - i);
             i = g_strlcat (result, "- ", result_len);
             if (el->page == TODO_PAGE && !appt->use_due_time) {
                 g_strlcat (result, "...", result_len);
             }
             else {
-                same_date = !orage_gdatetime_compare_date (appt->starttimecur,
-                                                           appt->endtimecur);
+                same_date = !orage_gdatetime_compare_date (start,
+                                                           end);
                 if (!same_date) {
-                    tmp = orage_gdatetime_to_i18_time (appt->endtimecur, TRUE);
+                    tmp = orage_gdatetime_to_i18_time (end, TRUE);
                     i = g_strlcat (result, tmp, result_len);
                     g_free (tmp);
                     result[i++] = ' ';
                 }
-                append_time (&result[i], appt->endtimecur, result_len - i);
+                append_time (&result[i], end, result_len - i);
             }
         }
         else {/* date only */
@@ -212,7 +222,7 @@ static gchar *format_time(el_win *el, xfical_appt *appt, GDateTime *gdt_par)
                 g_strlcat(result, "...", result_len);
             }
             else {
-                tmp = orage_gdatetime_to_i18_time (appt->endtimecur, TRUE);
+                tmp = orage_gdatetime_to_i18_time (end, TRUE);
                 g_strlcat(result, tmp, result_len);
                 g_free (tmp);
             }
@@ -386,7 +396,8 @@ static void start_time_data_func (G_GNUC_UNUSED GtkTreeViewColumn *col,
     }
 }
 
-static void add_el_row(el_win *el, xfical_appt *appt, GDateTime *gdt_par)
+static void add_el_row (el_win *el, const xfical_appt *appt,
+                        GDateTime *start, GDateTime *end, GDateTime *gdt_par)
 {
     GtkTreeIter     iter1;
     GtkListStore   *list1;
@@ -394,12 +405,12 @@ static void add_el_row(el_win *el, xfical_appt *appt, GDateTime *gdt_par)
     gchar           flags[6]; 
     gchar          *stime;
     gchar          /* *s_sort,*/ *s_sort1;
-    gchar          *tmp_note;
+    const gchar    *tmp_note;
     guint           len = 50;
     gchar *s_time;
     gchar *e_time;
 
-    stime = format_time (el, appt, gdt_par);
+    stime = format_time (el, appt, start, end, gdt_par);
     if (appt->display_alarm_orage || appt->display_alarm_notify 
     ||  appt->sound_alarm || appt->procedure_alarm)
         if (appt->alarm_persistent)
@@ -441,21 +452,21 @@ static void add_el_row(el_win *el, xfical_appt *appt, GDateTime *gdt_par)
     flags[5] = '\0';
 
     if (appt->title != NULL)
-        title = orage_process_text_commands(appt->title);
+        title = g_strdup (orage_process_text_commands_cached (appt->uid,
+                                                              appt->title));
     else if (appt->note != NULL) { 
     /* let's take len chars of the first line from the text */
-        tmp_note = orage_process_text_commands(appt->note);
+        tmp_note = orage_process_text_commands_cached (appt->uid, appt->note);
         if ((tmp = g_strstr_len(tmp_note, strlen(tmp_note), "\n")) != NULL) {
             /* there is line change. take text only up to that */
             if ((strlen(tmp_note)-strlen(tmp)) < len)
                 len = strlen(tmp_note)-strlen(tmp);
         }
         title = g_strndup(tmp_note, len);
-        g_free(tmp_note);
     }
 
-    s_time = orage_gdatetime_to_icaltime (appt->starttimecur, appt->allDay);
-    e_time = orage_gdatetime_to_icaltime (appt->endtimecur, appt->allDay);
+    s_time = orage_gdatetime_to_icaltime (start, appt->allDay);
+    e_time = orage_gdatetime_to_icaltime (end, appt->allDay);
     s_sort1 = g_strconcat (s_time, e_time, NULL);
     g_free (s_time);
     g_free (e_time);
@@ -484,7 +495,7 @@ static void searh_rows(el_win *el, gchar *search_string, gchar *file_type)
          appt;
          appt = xfical_appt_get_next_with_string(search_string, FALSE
                  , file_type)) {
-        add_el_row(el, appt, NULL);
+        add_el_row (el, appt, appt->starttimecur, appt->endtimecur, NULL);
         xfical_appt_free(appt);
     }
 }
@@ -522,22 +533,23 @@ static void search_data(el_win *el)
 static void app_rows (el_win *el, GDateTime *a_day_gdt, GDateTime *gdt_par,
                       xfical_type ical_type, gchar *file_type)
 {
-    GList *appt_list=NULL, *tmp;
+    GList *occurrence_list=NULL, *tmp;
+    xfical_occurrence *occurrence;
     xfical_appt *appt;
 
     if (ical_type == XFICAL_TYPE_EVENT && !el->only_first) {
         xfical_get_each_app_within_time (a_day_gdt, el->days+1
-                , ical_type, file_type, &appt_list);
-        for (tmp = g_list_first(appt_list);
+                , ical_type, file_type, &occurrence_list);
+        for (tmp = g_list_first(occurrence_list);
              tmp != NULL;
              tmp = g_list_next(tmp)) {
-            appt = (xfical_appt *)tmp->data;
-            if (appt->priority < g_par.priority_list_limit) {
-                add_el_row (el, appt, gdt_par);
+            occurrence = (xfical_occurrence *)tmp->data;
+            if (occurrence->appt->priority < g_par.priority_list_limit) {
+                add_el_row (el, occurrence->appt, occurrence->start,
+                            occurrence->end, gdt_par);
             }
-            xfical_appt_free(appt);
         }
-        g_list_free(appt_list);
+        xfical_occurrence_list_free (occurrence_list);
     }
     else {
         for (appt = xfical_appt_get_next_on_day (a_day_gdt, TRUE, el->days
@@ -545,7 +557,8 @@ static void app_rows (el_win *el, GDateTime *a_day_gdt, GDateTime *gdt_par,
              appt;
              appt = xfical_appt_get_next_on_day (a_day_gdt, FALSE, el->days
                     , ical_type, file_type)) {
-            add_el_row (el, appt, gdt_par);
+            add_el_row (el, appt, appt->starttimecur, appt->endtimecur,
+                        gdt_par);
             xfical_appt_free(appt);
         }
     }
@@ -665,7 +678,8 @@ static void journal_data(el_win *el)
 
 void refresh_el_win(el_win *el)
 {
-    (void)orage_category_get_list (); /* Uses side effects. */
+    ORAGE_TRACE_SCOPE("event list refresh");
+
     if (el->Window && el->ListStore && el->TreeView) {
         gtk_list_store_clear(el->ListStore);
         el->page = gtk_notebook_get_current_page(GTK_NOTEBOOK(el->Notebook));
@@ -838,6 +852,7 @@ static void close_window(el_win *el)
     }
     g_list_free(el->apptw_list);
 
+    el_windows = g_list_remove(el_windows, el);
     gtk_widget_destroy(el->Window); /* destroy the eventlist window */
     g_free(el);
     el = NULL;
@@ -1528,6 +1543,7 @@ el_win *create_el_win (GDateTime *gdt)
     el->date_now = g_date_time_new_now_local ();
     el->apptw_list = NULL;
     el->accel_group = gtk_accel_group_new();
+    el_windows = g_list_prepend(el_windows, el);
 
     el->Window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
     if (g_par.el_size_x || g_par.el_size_y)
@@ -1562,3 +1578,37 @@ el_win *create_el_win (GDateTime *gdt)
 
     return(el);
 }
+
+void el_win_memory_usage (GArray *usage)
+{
+    GList *tmp;
+    GtkTreeModel *model;
+    GtkTreeIter iter;
+    gchar *col[NUM_COLS];
+    gboolean valid;
+    guint64 bytes = 0;
+    guint rows = 0;
+    gint i;
+
+    for (tmp = el_windows; tmp != NULL; tmp = g_list_next(tmp)) {
+        model = GTK_TREE_MODEL(((el_win *)tmp->data)->ListStore);
+        for (valid = gtk_tree_model_get_iter_first(model, &iter);
+             valid;
+             valid = gtk_tree_model_iter_next(model, &iter)) {
+            gtk_tree_model_get(model, &iter
+                    , COL_TIME, &col[COL_TIME], COL_FLAGS, &col[COL_FLAGS]
+                    , COL_HEAD, &col[COL_HEAD], COL_UID, &col[COL_UID]
+                    , COL_SORT, &col[COL_SORT]
+                    , CAL_CATEGORIES, &col[CAL_CATEGORIES], -1);
+            rows++;
+            bytes += EL_ROW_BYTES;
+            for (i = 0; i < NUM_COLS; i++) {
+                bytes += orage_memory_string_size(col[i]);
+                g_free(col[i]);
+            }
+        }
+    }
+
+    orage_memory_usage_add(usage, "event list windows", rows, 0, bytes);
+}
+
@@ -106,4 +106,9 @@ el_win *create_el_win (GDateTime *gdt);
 
 void refresh_el_win (el_win *el);
 
+/** Add memory usage of rows in open event list windows.
+ *  @param usage array of OrageMemoryUsage
+ */
+void el_win_memory_usage (GArray *usage);
+
 #endif
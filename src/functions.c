@@ -41,6 +41,7 @@
 
 #include "functions.h"
 #include "orage-i18n.h"
+#include "orage-memory.h"
 #include "orage-time-utils.h"
 #include "parameters.h"
 #include "tz_zoneinfo_read.h"
@@ -477,6 +478,129 @@ gchar *orage_process_text_commands (const gchar *text)
     return(beq);
 }
 
+/* Cache for orage_process_text_commands_cached. Entries are kept until day
+ * change. When the cache grows too big, it is cleared from idle callback so
+ * that strings returned earlier stay valid for the caller.
+ */
+#define TEXT_COMMANDS_CACHE_MAX 4096
+
+typedef struct _text_commands_key
+{
+    gchar *uid;
+    gchar *text;
+    guint hash;
+} text_commands_key;
+
+static GHashTable *text_commands_cache = NULL;
+static guint text_commands_cache_clear_id = 0;
+
+static guint text_commands_key_hash (gconstpointer key)
+{
+    return ((const text_commands_key *)key)->hash;
+}
+
+static gboolean text_commands_key_equal (gconstpointer a, gconstpointer b)
+{
+    const text_commands_key *key_a = (const text_commands_key *)a;
+    const text_commands_key *key_b = (const text_commands_key *)b;
+
+    return (key_a->hash == key_b->hash)
+        && (g_strcmp0 (key_a->uid, key_b->uid) == 0)
+        && (strcmp (key_a->text, key_b->text) == 0);
+}
+
+static void text_commands_key_free (gpointer data)
+{
+    text_commands_key *key = (text_commands_key *)data;
+
+    g_free (key->uid);
+    g_free (key->text);
+    g_free (key);
+}
+
+static gboolean text_commands_cache_clear_idle (G_GNUC_UNUSED gpointer data)
+{
+    text_commands_cache_clear_id = 0;
+    orage_process_text_commands_cache_clear ();
+
+    return G_SOURCE_REMOVE;
+}
+
+const gchar *orage_process_text_commands_cached (const gchar *uid,
+                                                 const gchar *text)
+{
+    text_commands_key lookup;
+    text_commands_key *key;
+    gchar *result;
+
+    if (text == NULL)
+        return NULL;
+
+    if (text_commands_cache == NULL)
+    {
+        text_commands_cache = g_hash_table_new_full (text_commands_key_hash,
+                                                     text_commands_key_equal,
+                                                     text_commands_key_free,
+                                                     g_free);
+    }
+
+    lookup.uid = (gchar *)uid;
+    lookup.text = (gchar *)text;
+    lookup.hash = (uid ? g_str_hash (uid) * 31 : 0) + g_str_hash (text);
+
+    result = g_hash_table_lookup (text_commands_cache, &lookup);
+    if (result)
+        return result;
+
+    if (g_hash_table_size (text_commands_cache) >= TEXT_COMMANDS_CACHE_MAX &&
+        text_commands_cache_clear_id == 0)
+    {
+        text_commands_cache_clear_id =
+                g_idle_add (text_commands_cache_clear_idle, NULL);
+    }
+
+    key = g_new (text_commands_key, 1);
+    key->uid = g_strdup (uid);
+    key->text = g_strdup (text);
+    key->hash = lookup.hash;
+    result = orage_process_text_commands (text);
+    g_hash_table_insert (text_commands_cache, key, result);
+
+    return result;
+}
+
+void orage_process_text_commands_cache_clear (void)
+{
+    if (text_commands_cache)
+        g_hash_table_remove_all (text_commands_cache);
+}
+
+void orage_process_text_commands_memory_usage (GArray *usage)
+{
+    GHashTableIter iter;
+    gpointer key;
+    gpointer value;
+    text_commands_key *cache_key;
+    guint64 bytes = 0;
+    guint n = 0;
+
+    if (text_commands_cache)
+    {
+        g_hash_table_iter_init (&iter, text_commands_cache);
+        while (g_hash_table_iter_next (&iter, &key, &value))
+        {
+            cache_key = (text_commands_key *)key;
+            n++;
+            bytes += ORAGE_MEMORY_HASH_ENTRY + sizeof (text_commands_key)
+                   + orage_memory_string_size (cache_key->uid)
+                   + orage_memory_string_size (cache_key->text)
+                   + orage_memory_string_size (value);
+        }
+    }
+
+    orage_memory_usage_add (usage, "text command cache", n, 0, bytes);
+}
+
 /** Create new horizontal filler with given width.
  *  @param width filler width
  */
@@ -40,6 +40,8 @@
 #define ORAGE_CATEGORIES_DIR_FILE ORAGE_DIR ORAGE_CATEGORIES_FILE
 #define ORAGE_PERSISTENT_ALARMS_FILE "orage_persistent_alarms.txt"
 #define ORAGE_PERSISTENT_ALARMS_DIR_FILE ORAGE_DIR ORAGE_PERSISTENT_ALARMS_FILE
+#define ORAGE_PERSISTENT_ALARMS_LOG_FILE "orage_persistent_alarms.log"
+#define ORAGE_PERSISTENT_ALARMS_LOG_DIR_FILE ORAGE_DIR ORAGE_PERSISTENT_ALARMS_LOG_FILE
 #define ORAGE_DEFAULT_ALARM_FILE "orage_default_alarm.txt"
 #define ORAGE_DEFAULT_ALARM_DIR_FILE ORAGE_DIR ORAGE_DEFAULT_ALARM_FILE
 #define ORAGE_DOC_ADDRESS "https://docs.xfce.org/apps/orage/start"
@@ -89,6 +91,25 @@ char *orage_replace_text(char *text, char *old, char *new);
 char *orage_limit_text(char *text, int max_line_len, int max_lines);
 gchar *orage_process_text_commands (const gchar *text);
 
+/** Same as orage_process_text_commands, but the result is cached per
+ *  component UID and text. Commands depend only on the current date, so the
+ *  cache is cleared on day change.
+ *  @param uid component UID, or NULL
+ *  @param text text to process, or NULL
+ *  @return processed text owned by the cache, or NULL if text is NULL. Result
+ *          stays valid until control returns to the main loop.
+ */
+const gchar *orage_process_text_commands_cached (const gchar *uid,
+                                                 const gchar *text);
+
+/** Drop all cached orage_process_text_commands_cached results. */
+void orage_process_text_commands_cache_clear (void);
+
+/** Add memory usage of orage_process_text_commands_cached results.
+ *  @param usage array of OrageMemoryUsage
+ */
+void orage_process_text_commands_memory_usage (GArray *usage);
+
 GtkWidget *orage_period_hbox_new(gboolean head_space, gboolean tail_space
         , GtkWidget *spin_dd, GtkWidget *dd_label
         , GtkWidget *spin_hh, GtkWidget *hh_label
@@ -0,0 +1,902 @@
+/*
+ * Copyright (c) 2026 Erkki Moorits
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ *     Free Software Foundation
+ *     51 Franklin Street, 5th Floor
+ *     Boston, MA 02110-1301 USA
+ */
+
+/* Segmented archive.
+ *
+ * Archived components are stored in <archive file>.d/<year>.ics, where year
+ * is the year when the component, or its last occurrence, ends. A manifest
+ * in the same directory keeps date range, component count and a bloom
+ * filter of UIDs for each segment, so date queries and UID lookups parse
+ * only segments which can contain a match. Segments are parsed when first
+ * needed and stay in memory until the archive is closed.
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <libical/ical.h>
+#include <libical/icalss.h>
+
+#include "ical-code.h"
+#include "ical-internal.h"
+#include "parameters.h"
+
+#ifdef HAVE_ARCHIVE
+
+#define ARCHIVE_MANIFEST "manifest"
+
+/* Bloom filter has at least this many bits and grows in powers of two to
+ * keep ARCHIVE_BLOOM_BITS_PER_UID bits per UID, which gives about 1 %
+ * false positives with ARCHIVE_BLOOM_HASHES hash functions.
+ */
+#define ARCHIVE_BLOOM_MIN_BITS 1024
+#define ARCHIVE_BLOOM_BITS_PER_UID 10
+#define ARCHIVE_BLOOM_HASHES 4
+
+/* Last day of series which do not end. */
+#define ARCHIVE_LAST_DAY 99991231
+
+typedef struct _archive_segment
+{
+    gint year;
+    gint first_day;     /* YYYYMMDD of the earliest start */
+    gint last_day;      /* YYYYMMDD of the latest end */
+    guint count;
+    guint8 *bloom;      /* NULL when not known, matches every UID */
+    gsize bloom_len;
+    icalcomponent *ical; /* NULL until the segment is parsed */
+    gboolean changed;
+} archive_segment;
+
+/* Segments sorted by year, NULL when the archive is not open. */
+static GPtrArray *segments = NULL;
+
+static gboolean manifest_changed = FALSE;
+
+static gchar *archive_dir (void)
+{
+    return g_strconcat (g_par.archive_file, ".d", NULL);
+}
+
+static gchar *archive_dir_file (const gchar *name)
+{
+    gchar *dir;
+    gchar *path;
+
+    dir = archive_dir ();
+    path = g_build_filename (dir, name, NULL);
+    g_free (dir);
+
+    return path;
+}
+
+static gchar *archive_segment_path (const gint year)
+{
+    gchar name[16];
+
+    g_snprintf (name, sizeof (name), "%04d.ics", year);
+
+    return archive_dir_file (name);
+}
+
+/* Date range of the component. Returns year of the segment. */
+static gint archive_component_range (icalcomponent *c, gint *first_day,
+                                     gint *last_day)
+{
+    xfical_period per;
+    struct icaltimetype end;
+
+    per = ic_get_period (c, TRUE);
+    *first_day = IC_ARCHIVE_DAY (per.stime);
+    if (!ic_get_event_end (c, &end))
+    {
+        *last_day = ARCHIVE_LAST_DAY;
+        return per.etime.year;
+    }
+
+    *last_day = IC_ARCHIVE_DAY (end);
+
+    return end.year;
+}
+
+/* FNV-1a, the second hash for double hashing. Odd, so that it never
+ * repeats the same bit.
+ */
+static guint32 archive_uid_hash (const gchar *uid)
+{
+    guint32 h = 2166136261u;
+
+    for (; *uid != '\0'; uid++)
+    {
+        h ^= (guchar)*uid;
+        h *= 16777619u;
+    }
+
+    return h | 1;
+}
+
+static void archive_bloom_reset (archive_segment *segment, const guint n_uids)
+{
+    gsize bits = ARCHIVE_BLOOM_MIN_BITS;
+
+    while (bits < (gsize)n_uids * ARCHIVE_BLOOM_BITS_PER_UID)
+        bits *= 2;
+
+    g_free (segment->bloom);
+    segment->bloom_len = bits / 8;
+    segment->bloom = g_malloc0 (segment->bloom_len);
+}
+
+static void archive_bloom_add (archive_segment *segment, const gchar *uid)
+{
+    guint32 h1;
+    guint32 h2;
+    gsize bit;
+    guint i;
+
+    if (segment->bloom == NULL)
+        return;
+
+    h1 = g_str_hash (uid);
+    h2 = archive_uid_hash (uid);
+    for (i = 0; i < ARCHIVE_BLOOM_HASHES; i++)
+    {
+        bit = (h1 + i * h2) % (segment->bloom_len * 8);
+        segment->bloom[bit / 8] |= 1 << (bit % 8);
+    }
+}
+
+static gboolean archive_bloom_contains (const archive_segment *segment,
+                                        const gchar *uid)
+{
+    guint32 h1;
+    guint32 h2;
+    gsize bit;
+    guint i;
+
+    if (segment->bloom == NULL)
+        return TRUE;
+
+    h1 = g_str_hash (uid);
+    h2 = archive_uid_hash (uid);
+    for (i = 0; i < ARCHIVE_BLOOM_HASHES; i++)
+    {
+        bit = (h1 + i * h2) % (segment->bloom_len * 8);
+        if ((segment->bloom[bit / 8] & (1 << (bit % 8))) == 0)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void archive_segment_account (archive_segment *segment,
+                                     icalcomponent *c)
+{
+    const gchar *uid;
+    gint first_day;
+    gint last_day;
+
+    (void)archive_component_range (c, &first_day, &last_day);
+    if (segment->count == 0 || first_day < segment->first_day)
+        segment->first_day = first_day;
+    if (segment->count == 0 || last_day > segment->last_day)
+        segment->last_day = last_day;
+    segment->count++;
+
+    if ((uid = icalcomponent_get_uid (c)) != NULL)
+        archive_bloom_add (segment, uid);
+}
+
+/* Count manifest data again from a parsed segment. */
+static void archive_segment_rebuild (archive_segment *segment)
+{
+    icalcomponent *c;
+
+    segment->count = 0;
+    archive_bloom_reset (segment,
+                         icalcomponent_count_components (segment->ical,
+                                                         ICAL_ANY_COMPONENT));
+    for (c = icalcomponent_get_first_component (segment->ical,
+                                                ICAL_ANY_COMPONENT);
+         c != NULL;
+         c = icalcomponent_get_next_component (segment->ical,
+                                               ICAL_ANY_COMPONENT))
+    {
+        archive_segment_account (segment, c);
+    }
+
+    manifest_changed = TRUE;
+}
+
+static void archive_segment_free (gpointer data)
+{
+    archive_segment *segment = data;
+
+    /* segments are written only by archive_segments_commit */
+    if (segment->ical)
+        icalcomponent_free (segment->ical);
+    g_free (segment->bloom);
+    g_free (segment);
+}
+
+static icalcomponent *archive_segment_load (archive_segment *segment)
+{
+    GError *error = NULL;
+    gchar *path;
+    gchar *dir;
+    gchar *text;
+    gsize len;
+
+    if (segment->ical)
+        return segment->ical;
+
+    dir = archive_dir ();
+    if (g_mkdir_with_parents (dir, 0700) != 0)
+    {
+        g_warning ("failed to create archive directory '%s'", dir);
+        g_free (dir);
+        return NULL;
+    }
+
+    g_free (dir);
+
+    path = archive_segment_path (segment->year);
+    if (g_file_get_contents (path, &text, &len, &error))
+    {
+        if (len)
+            segment->ical = icalparser_parse_string (text);
+        g_free (text);
+        if (len && (segment->ical == NULL
+                 || icalcomponent_isa (segment->ical)
+                        != ICAL_VCALENDAR_COMPONENT))
+        {
+            g_warning ("failed to parse archive segment '%s'", path);
+            g_clear_pointer (&segment->ical, icalcomponent_free);
+            g_free (path);
+            return NULL;
+        }
+    }
+    else if (g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+        g_clear_error (&error);
+    else
+    {
+        g_warning ("failed to open archive segment '%s': %s", path,
+                   error->message);
+        g_error_free (error);
+        g_free (path);
+        return NULL;
+    }
+
+    if (segment->ical == NULL)
+    {
+        segment->ical = icalcomponent_vanew (ICAL_VCALENDAR_COMPONENT
+                , icalproperty_new_version ("2.0")
+                , icalproperty_new_prodid ("-//Xfce//Orage//EN")
+                , NULL);
+    }
+
+    g_debug ("loaded archive segment '%s'", path);
+    g_free (path);
+
+    return segment->ical;
+}
+
+static gint archive_segment_compare (gconstpointer a, gconstpointer b)
+{
+    const archive_segment *s1 = *(archive_segment * const *)a;
+    const archive_segment *s2 = *(archive_segment * const *)b;
+
+    return s1->year - s2->year;
+}
+
+static archive_segment *archive_segment_get (const gint year,
+                                             const gboolean create)
+{
+    archive_segment *segment;
+    guint i;
+
+    for (i = 0; i < segments->len; i++)
+    {
+        segment = g_ptr_array_index (segments, i);
+        if (segment->year == year)
+            return segment;
+    }
+
+    if (!create)
+        return NULL;
+
+    segment = g_new0 (archive_segment, 1);
+    segment->year = year;
+    archive_bloom_reset (segment, 0);
+    g_ptr_array_add (segments, segment);
+    g_ptr_array_sort (segments, archive_segment_compare);
+    manifest_changed = TRUE;
+
+    return segment;
+}
+
+static void archive_manifest_read (void)
+{
+    GKeyFile *manifest;
+    archive_segment *segment;
+    gchar **groups;
+    gchar *path;
+    gchar *bloom;
+    gchar *end;
+    gint year;
+    guint i;
+
+    path = archive_dir_file (ARCHIVE_MANIFEST);
+    manifest = g_key_file_new ();
+    if (!g_key_file_load_from_file (manifest, path, G_KEY_FILE_NONE, NULL))
+    {
+        g_key_file_free (manifest);
+        g_free (path);
+        return;
+    }
+
+    groups = g_key_file_get_groups (manifest, NULL);
+    for (i = 0; groups[i] != NULL; i++)
+    {
+        year = (gint)g_ascii_strtoll (groups[i], &end, 10);
+        if (*end != '\0' || archive_segment_get (year, FALSE) != NULL)
+            continue;
+
+        segment = g_new0 (archive_segment, 1);
+        segment->year = year;
+        segment->first_day = g_key_file_get_integer (manifest, groups[i],
+                                                     "First", NULL);
+        segment->last_day = g_key_file_get_integer (manifest, groups[i],
+                                                    "Last", NULL);
+        segment->count = g_key_file_get_integer (manifest, groups[i],
+                                                 "Count", NULL);
+        bloom = g_key_file_get_string (manifest, groups[i], "Bloom", NULL);
+        if (bloom)
+        {
+            segment->bloom = g_base64_decode (bloom, &segment->bloom_len);
+            if (segment->bloom_len == 0)
+                g_clear_pointer (&segment->bloom, g_free);
+            g_free (bloom);
+        }
+
+        g_ptr_array_add (segments, segment);
+    }
+
+    g_ptr_array_sort (segments, archive_segment_compare);
+    g_strfreev (groups);
+    g_key_file_free (manifest);
+    g_free (path);
+}
+
+static gboolean archive_manifest_write (void)
+{
+    GKeyFile *manifest;
+    archive_segment *segment;
+    GError *error = NULL;
+    gchar group[16];
+    gchar *bloom;
+    gchar *path;
+    gboolean ok;
+    guint i;
+
+    manifest = g_key_file_new ();
+    for (i = 0; i < segments->len; i++)
+    {
+        segment = g_ptr_array_index (segments, i);
+        g_snprintf (group, sizeof (group), "%04d", segment->year);
+        g_key_file_set_integer (manifest, group, "First", segment->first_day);
+        g_key_file_set_integer (manifest, group, "Last", segment->last_day);
+        g_key_file_set_integer (manifest, group, "Count", segment->count);
+        if (segment->bloom)
+        {
+            bloom = g_base64_encode (segment->bloom, segment->bloom_len);
+            g_key_file_set_string (manifest, group, "Bloom", bloom);
+            g_free (bloom);
+        }
+    }
+
+    path = archive_dir_file (ARCHIVE_MANIFEST);
+    ok = g_key_file_save_to_file (manifest, path, &error);
+    if (ok)
+        manifest_changed = FALSE;
+    else
+    {
+        g_warning ("failed to write archive manifest '%s': %s", path,
+                   error->message);
+        g_error_free (error);
+    }
+
+    g_free (path);
+    g_key_file_free (manifest);
+
+    return ok;
+}
+
+/* Read the manifest and check it against segment files. Segments written
+ * after the manifest, for example when Orage was stopped in between, are
+ * parsed and counted again.
+ */
+static void archive_manifest_load (void)
+{
+    archive_segment *segment;
+    GStatBuf s;
+    GDir *dir;
+    const gchar *name;
+    gchar *dir_name;
+    gchar *path;
+    gchar *end;
+    time_t manifest_time = 0;
+    gint year;
+    guint i;
+
+    segments = g_ptr_array_new_with_free_func (archive_segment_free);
+    manifest_changed = FALSE;
+    archive_manifest_read ();
+
+    path = archive_dir_file (ARCHIVE_MANIFEST);
+    if (g_stat (path, &s) == 0)
+        manifest_time = s.st_mtime;
+    g_free (path);
+
+    /* segments which have disappeared */
+    for (i = 0; i < segments->len;)
+    {
+        segment = g_ptr_array_index (segments, i);
+        path = archive_segment_path (segment->year);
+        if (g_file_test (path, G_FILE_TEST_EXISTS))
+            i++;
+        else
+        {
+            g_ptr_array_remove_index (segments, i);
+            manifest_changed = TRUE;
+        }
+        g_free (path);
+    }
+
+    dir_name = archive_dir ();
+    if ((dir = g_dir_open (dir_name, 0, NULL)) != NULL)
+    {
+        while ((name = g_dir_read_name (dir)) != NULL)
+        {
+            year = (gint)g_ascii_strtoll (name, &end, 10);
+            if (end != name + 4 || strcmp (end, ".ics") != 0)
+                continue;
+
+            path = g_build_filename (dir_name, name, NULL);
+            segment = archive_segment_get (year, FALSE);
+            if (segment == NULL || g_stat (path, &s) != 0
+             || s.st_mtime > manifest_time)
+            {
+                segment = archive_segment_get (year, TRUE);
+                if (archive_segment_load (segment))
+                    archive_segment_rebuild (segment);
+            }
+            g_free (path);
+        }
+
+        g_dir_close (dir);
+    }
+
+    g_free (dir_name);
+}
+
+static gchar *archive_segment_new_path (const gint year)
+{
+    gchar name[16];
+
+    g_snprintf (name, sizeof (name), "%04d.ics.new", year);
+
+    return archive_dir_file (name);
+}
+
+/* Changed segments are first written next to the old ones and renamed only
+ * when all of them have been written, so a failed commit leaves the
+ * archive on disk as it was.
+ */
+static gboolean archive_segments_commit (void)
+{
+    archive_segment *segment;
+    GPtrArray *written;
+    GError *error = NULL;
+    const gchar *text;
+    gchar *path;
+    gchar *new_path;
+    gboolean ok = TRUE;
+    guint i;
+
+    written = g_ptr_array_new_with_free_func (g_free);
+    for (i = 0; ok && i < segments->len; i++)
+    {
+        segment = g_ptr_array_index (segments, i);
+        if (!segment->changed || segment->ical == NULL)
+            continue;
+
+        archive_segment_rebuild (segment);
+        if (segment->count == 0)
+            continue;
+
+        new_path = archive_segment_new_path (segment->year);
+        text = icalcomponent_as_ical_string (segment->ical);
+        if (g_file_set_contents (new_path, text, -1, &error))
+            g_ptr_array_add (written, new_path);
+        else
+        {
+            g_warning ("failed to write archive segment '%s': %s", new_path,
+                       error->message);
+            g_clear_error (&error);
+            g_free (new_path);
+            ok = FALSE;
+        }
+    }
+
+    if (!ok)
+    {
+        for (i = 0; i < written->len; i++)
+            (void)g_remove (g_ptr_array_index (written, i));
+        g_ptr_array_free (written, TRUE);
+
+        return FALSE;
+    }
+
+    g_ptr_array_free (written, TRUE);
+
+    for (i = 0; i < segments->len;)
+    {
+        segment = g_ptr_array_index (segments, i);
+        if (segment->changed && segment->ical)
+        {
+            path = archive_segment_path (segment->year);
+            if (segment->count == 0)
+            {
+                if (g_remove (path) != 0 && errno != ENOENT)
+                    g_warning ("failed to remove archive segment '%s'", path);
+                g_free (path);
+                g_ptr_array_remove_index (segments, i);
+                continue;
+            }
+
+            new_path = archive_segment_new_path (segment->year);
+            if (g_rename (new_path, path) != 0)
+            {
+                g_warning ("failed to replace archive segment '%s'", path);
+                ok = FALSE;
+            }
+            else
+                segment->changed = FALSE;
+            g_free (new_path);
+            g_free (path);
+        }
+        i++;
+    }
+
+    if (manifest_changed && !archive_manifest_write ())
+        ok = FALSE;
+
+    return ok;
+}
+
+/* Archives of older versions are one file. Split it into segments. */
+static gboolean archive_migrate (void)
+{
+    icalset *fical;
+    icalcomponent *ical;
+    icalcomponent *c;
+    gboolean ok = TRUE;
+    gint moved = 0;
+
+    if (!g_file_test (g_par.archive_file, G_FILE_TEST_IS_REGULAR))
+        return TRUE;
+
+    fical = icalset_new_file_reader (g_par.archive_file);
+    if (fical == NULL)
+    {
+        g_warning ("failed to open archive file '%s'", g_par.archive_file);
+        return FALSE;
+    }
+
+    for (ical = icalset_get_first_component (fical);
+         ical != NULL;
+         ical = icalset_get_next_component (fical))
+    {
+        while ((c = icalcomponent_get_first_component (ical,
+                                                       ICAL_ANY_COMPONENT)))
+        {
+            icalcomponent_remove_component (ical, c);
+            if (ic_archive_add (c))
+                moved++;
+            else
+            {
+                icalcomponent_free (c);
+                ok = FALSE;
+            }
+        }
+    }
+
+    icalset_free (fical);
+
+    if (!ok || !archive_segments_commit ())
+    {
+        /* archive file stays and splitting is tried again on next open */
+        g_warning ("archive segments could not be written; keeping archive "
+                   "file '%s'", g_par.archive_file);
+        ic_archive_discard ();
+        return FALSE;
+    }
+
+    if (g_remove (g_par.archive_file) != 0)
+    {
+        g_warning ("failed to remove archive file '%s'", g_par.archive_file);
+    }
+
+    g_message ("split archive file into %u segments (%d components)",
+               segments->len, moved);
+
+    return TRUE;
+}
+
+gboolean ic_archive_open (void)
+{
+    if (segments)
+        return TRUE;
+
+    archive_manifest_load ();
+
+    return archive_migrate ();
+}
+
+gboolean ic_archive_commit (void)
+{
+    if (segments == NULL)
+        return TRUE;
+
+    return archive_segments_commit ();
+}
+
+void ic_archive_close (void)
+{
+    if (segments == NULL)
+        return;
+
+    (void)archive_segments_commit ();
+    g_clear_pointer (&segments, g_ptr_array_unref);
+}
+
+void ic_archive_discard (void)
+{
+    g_clear_pointer (&segments, g_ptr_array_unref);
+}
+
+gboolean ic_archive_add (icalcomponent *c)
+{
+    archive_segment *segment;
+    gint first_day;
+    gint last_day;
+    gint year;
+
+    year = archive_component_range (c, &first_day, &last_day);
+    segment = archive_segment_get (year, TRUE);
+    if (archive_segment_load (segment) == NULL)
+        return FALSE;
+
+    icalcomponent_add_component (segment->ical, c);
+    archive_segment_account (segment, c);
+    segment->changed = TRUE;
+    manifest_changed = TRUE;
+
+    return TRUE;
+}
+
+void ic_archive_remove (icalcomponent *base, icalcomponent *c)
+{
+    archive_segment *segment;
+    guint i;
+
+    icalcomponent_remove_component (base, c);
+
+    /* count, range and bloom filter are updated when the segment is
+     * written, until then they only cover too much */
+    for (i = 0; i < segments->len; i++)
+    {
+        segment = g_ptr_array_index (segments, i);
+        if (segment->ical == base)
+        {
+            segment->changed = TRUE;
+            return;
+        }
+    }
+}
+
+icalcomponent *ic_archive_next_in_range (guint *n, const gint first_day,
+                                         const gint last_day)
+{
+    archive_segment *segment;
+    icalcomponent *base;
+
+    if (segments == NULL)
+        return NULL;
+
+    for (; *n < segments->len; (*n)++)
+    {
+        segment = g_ptr_array_index (segments, *n);
+        if (segment->first_day > last_day || segment->last_day < first_day)
+            continue;
+
+        if ((base = archive_segment_load (segment)) != NULL)
+            return base;
+    }
+
+    return NULL;
+}
+
+void ic_archive_foreach (const gint first_day, const gint last_day,
+                         ic_calendar_func func, gpointer user_data)
+{
+    icalcomponent *base;
+    guint n;
+
+    for (n = 0;
+         (base = ic_archive_next_in_range (&n, first_day, last_day)) != NULL;
+         n++)
+    {
+        func (base, user_data);
+    }
+}
+
+void ic_archive_foreach_loaded (ic_calendar_func func, gpointer user_data)
+{
+    archive_segment *segment;
+    guint i;
+
+    if (segments == NULL)
+        return;
+
+    for (i = 0; i < segments->len; i++)
+    {
+        segment = g_ptr_array_index (segments, i);
+        if (segment->ical)
+            func (segment->ical, user_data);
+    }
+}
+
+icalcomponent *ic_archive_find_uid (const gchar *uid, icalcomponent **base)
+{
+    archive_segment *segment;
+    icalcomponent *c;
+    const gchar *c_uid;
+    guint i;
+
+    if (segments == NULL)
+        return NULL;
+
+    for (i = segments->len; i-- > 0;)
+    {
+        segment = g_ptr_array_index (segments, i);
+        if (!archive_bloom_contains (segment, uid)
+         || archive_segment_load (segment) == NULL)
+        {
+            continue;
+        }
+
+        for (c = icalcomponent_get_first_component (segment->ical,
+                                                    ICAL_ANY_COMPONENT);
+             c != NULL;
+             c = icalcomponent_get_next_component (segment->ical,
+                                                   ICAL_ANY_COMPONENT))
+        {
+            c_uid = icalcomponent_get_uid (c);
+            if (c_uid && strcmp (c_uid, uid) == 0)
+            {
+                *base = segment->ical;
+                return c;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+gchar *ic_archive_get_path (const guint n)
+{
+    if (segments == NULL || n >= segments->len)
+        return NULL;
+
+    return archive_segment_path (
+            ((archive_segment *)g_ptr_array_index (segments, n))->year);
+}
+
+icalcomponent *ic_archive_load_file (const gchar *path)
+{
+    archive_segment *segment;
+    gchar *segment_path;
+    gboolean found;
+    guint i;
+
+    if (segments == NULL)
+        return NULL;
+
+    for (i = 0; i < segments->len; i++)
+    {
+        segment = g_ptr_array_index (segments, i);
+        segment_path = archive_segment_path (segment->year);
+        found = (strcmp (segment_path, path) == 0);
+        g_free (segment_path);
+        if (found)
+            return archive_segment_load (segment);
+    }
+
+    return NULL;
+}
+
+gboolean ic_archive_take_all (icalcomponent *target)
+{
+    archive_segment *segment;
+    icalcomponent *c;
+    guint i;
+
+    /* parse everything first, nothing is moved if some segment fails */
+    for (i = 0; i < segments->len; i++)
+    {
+        if (archive_segment_load (g_ptr_array_index (segments, i)) == NULL)
+            return FALSE;
+    }
+
+    for (i = 0; i < segments->len; i++)
+    {
+        segment = g_ptr_array_index (segments, i);
+        while ((c = icalcomponent_get_first_component (segment->ical,
+                                                       ICAL_ANY_COMPONENT)))
+        {
+            icalcomponent_remove_component (segment->ical, c);
+            icalcomponent_add_component (target, c);
+        }
+    }
+
+    return TRUE;
+}
+
+void ic_archive_remove_all (void)
+{
+    archive_segment *segment;
+    gchar *path;
+    guint i;
+
+    for (i = 0; i < segments->len; i++)
+    {
+        segment = g_ptr_array_index (segments, i);
+        path = archive_segment_path (segment->year);
+        if (g_remove (path) != 0)
+            g_warning ("failed to remove archive segment '%s'", path);
+        g_free (path);
+    }
+
+    g_ptr_array_set_size (segments, 0);
+    manifest_changed = FALSE;
+
+    path = archive_dir_file (ARCHIVE_MANIFEST);
+    (void)g_remove (path);
+    g_free (path);
+    path = archive_dir ();
+    (void)g_rmdir (path);
+    g_free (path);
+}
+#endif
@@ -76,8 +76,8 @@ gboolean xfical_archive_open(void)
     if (!ORAGE_STR_EXISTS(g_par.archive_file))
         return(FALSE);
 
-    return(ic_internal_file_open(&ic_aical, &ic_afical, g_par.archive_file
-            , FALSE, FALSE));
+    /* only the manifest is read, segments are parsed when needed */
+    return(ic_archive_open());
 }
 
 void xfical_archive_close(void)
@@ -85,14 +85,87 @@ void xfical_archive_close(void)
     if (!ORAGE_STR_EXISTS(g_par.archive_file))
         return;
 
-    if (ic_afical == NULL)
-    {
-        g_warning ("ic_afical is NULL");
+    ic_archive_close();
+}
+
+static gboolean archive_copy_dir (const gchar *from, const gchar *to)
+{
+    GDir *dir;
+    const gchar *name;
+    gchar *source;
+    gchar *target;
+    gboolean ok = TRUE;
+
+    if ((dir = g_dir_open(from, 0, NULL)) == NULL)
+        return(TRUE); /* no segments */
+
+    if (g_mkdir_with_parents(to, 0700) != 0) {
+        g_warning ("failed to create archive directory '%s'", to);
+        g_dir_close(dir);
+        return(FALSE);
+    }
+    while (ok && (name = g_dir_read_name(dir)) != NULL) {
+        source = g_build_filename(from, name, NULL);
+        target = g_build_filename(to, name, NULL);
+        ok = orage_copy_file(source, target);
+        g_free(source);
+        g_free(target);
+    }
+    g_dir_close(dir);
+
+    return(ok);
+}
+
+static void archive_remove_dir (const gchar *path)
+{
+    GDir *dir;
+    const gchar *name;
+    gchar *file;
+
+    if ((dir = g_dir_open(path, 0, NULL)) == NULL)
         return;
+
+    while ((name = g_dir_read_name(dir)) != NULL) {
+        file = g_build_filename(path, name, NULL);
+        if (g_remove(file))
+            g_warning ("failed to remove file '%s'", file);
+        g_free(file);
+    }
+    g_dir_close(dir);
+    (void)g_rmdir(path);
+}
+
+gboolean xfical_archive_copy (const gchar *file, const gboolean move)
+{
+    gchar *from;
+    gchar *to;
+    gboolean ok = TRUE;
+
+    xfical_archive_close();
+
+    /* archive file of older versions, which has not been split yet */
+    if (g_file_test(g_par.archive_file, G_FILE_TEST_IS_REGULAR)) {
+        if (!move || g_rename(g_par.archive_file, file)) {
+            ok = orage_copy_file(g_par.archive_file, file);
+            if (ok && move && g_remove(g_par.archive_file))
+                g_warning ("failed to remove original file '%s'",
+                           g_par.archive_file);
+        }
     }
 
-    icalset_free(ic_afical);
-    ic_afical = NULL;
+    from = g_strconcat(g_par.archive_file, ".d", NULL);
+    to = g_strconcat(file, ".d", NULL);
+    if (ok && g_file_test(from, G_FILE_TEST_IS_DIR)) {
+        if (!move || g_rename(from, to)) {
+            ok = archive_copy_dir(from, to);
+            if (ok && move)
+                archive_remove_dir(from);
+        }
+    }
+    g_free(from);
+    g_free(to);
+
+    return(ok);
 }
 #endif
 
@@ -123,12 +196,18 @@ static void xfical_icalcomponent_archive_normal(icalcomponent *e)
 {
     icalcomponent *d;
 
-    /* Add to the archive file */
+    /* Add to the archive segment */
     d = icalcomponent_new_clone(e);
-    icalcomponent_add_component(ic_aical, d);
+    if (!ic_archive_add(d)) {
+        g_warning ("archive segment could not be opened; '%s' not archived"
+                , icalcomponent_get_uid(e));
+        icalcomponent_free(d);
+        return;
+    }
 
     /* Remove from the main file */
     icalcomponent_remove_component(ic_ical, e);
+    icalcomponent_free(e);
 }
 
 static void xfical_icalcomponent_archive_recurrent (icalcomponent *e,
@@ -350,8 +429,15 @@ gboolean xfical_archive(void)
 
     g_date_time_unref (threshold);
     ic_file_modified = TRUE;
-    icalset_mark(ic_afical);
-    icalset_commit(ic_afical);
+    xfical_cache_invalidate ();
+    if (!ic_archive_commit()) {
+        /* main file is not written, so it is read again on next open and
+         * nothing is lost */
+        g_critical ("archive could not be written; calendar file not changed");
+        ic_archive_discard();
+        xfical_file_close(FALSE);
+        return(FALSE);
+    }
     xfical_archive_close();
     icalset_mark(ic_fical);
     icalset_commit(ic_fical);
@@ -362,7 +448,7 @@ gboolean xfical_archive(void)
 
 gboolean xfical_unarchive(void)
 {
-    icalcomponent *c, *d;
+    icalcomponent *c;
     icalproperty *p;
     const char *text;
 
@@ -388,8 +474,8 @@ gboolean xfical_unarchive(void)
                 p = icalcomponent_get_next_property(c, ICAL_X_PROPERTY);
         }
     }
-    /* PHASE 2: go through archive file and add everything back to base orage.
-     * After that delete the whole arch file */
+    /* PHASE 2: go through archive segments and add everything back to base
+     * orage. After that delete the segments */
     g_message ("phase 2: return archived appointments");
     if (!xfical_archive_open()) {
         /* we have risk to delete the data permanently, let's stop here */
@@ -401,20 +487,20 @@ gboolean xfical_unarchive(void)
         xfical_file_close(FALSE);
         return(FALSE);
     }
-    for (c = icalcomponent_get_first_component(ic_aical, ICAL_ANY_COMPONENT);
-         c != 0;
-         c = icalcomponent_get_next_component(ic_aical, ICAL_ANY_COMPONENT)) {
-    /* Add to the base file */
-        d = icalcomponent_new_clone(c);
-        icalcomponent_add_component(ic_ical, d);
-    }
-    xfical_archive_close();
-    if (g_remove(g_par.archive_file) == -1) {
-        g_warning ("failed to remove archive file '%s'", g_par.archive_file);
+    if (!ic_archive_take_all(ic_ical)) {
+        g_critical ("failed to read archive segments");
+        xfical_archive_close();
+        xfical_file_close(FALSE);
+        return(FALSE);
     }
     ic_file_modified = TRUE;
+    xfical_cache_invalidate ();
     icalset_mark(ic_fical);
-    icalset_commit(ic_fical);
+    if (icalset_commit(ic_fical) == ICAL_NO_ERROR)
+        ic_archive_remove_all();
+    else
+        g_critical ("calendar file could not be written; archive is kept");
+    xfical_archive_close();
     xfical_file_close(FALSE);
     g_message ("archive removal done");
     return(TRUE);
@@ -422,9 +508,7 @@ gboolean xfical_unarchive(void)
 
 gboolean xfical_unarchive_uid (const gchar *uid)
 {
-    icalcomponent *c, *d;
-    gboolean key_found = FALSE;
-    const char *text;
+    icalcomponent *c, *base;
     const gchar *ical_uid;
 
     ical_uid = uid+4; /* skip file id (which is A00. now)*/
@@ -432,25 +516,27 @@ gboolean xfical_unarchive_uid (const gchar *uid)
         g_critical ("calendar or archive file open failed");
         return(FALSE);
     } 
-    for (c = icalcomponent_get_first_component(ic_aical, ICAL_ANY_COMPONENT);
-         c != 0 && !key_found;
-         c = icalcomponent_get_next_component(ic_aical, ICAL_ANY_COMPONENT)) {
-        text = icalcomponent_get_uid(c);
-        if (strcmp(text, ical_uid) == 0) { /* we found our uid (=event) */
-            /* Add to the base file */
-            d = icalcomponent_new_clone(c);
-            icalcomponent_add_component(ic_ical, d);
-            /* Remove from the archive file */
-            icalcomponent_remove_component(ic_aical, c);
-            key_found = TRUE;
-            ic_file_modified = TRUE;
+    /* only segments whose UID filter matches are parsed */
+    if ((c = ic_archive_find_uid(ical_uid, &base)) != NULL) {
+        ic_archive_remove(base, c);
+        icalcomponent_add_component(ic_ical, c);
+        ic_file_modified = TRUE;
+        xfical_cache_invalidate ();
+        /* main file first, a failure there must not lose the event */
+        icalset_mark(ic_fical);
+        if (icalset_commit(ic_fical) != ICAL_NO_ERROR) {
+            g_critical ("calendar file could not be written; '%s' is kept in "
+                        "archive", ical_uid);
+            icalcomponent_remove_component(ic_ical, c);
+            icalcomponent_add_component(base, c);
+            xfical_archive_close();
+            xfical_file_close(FALSE);
+            return(FALSE);
         }
     }
-    icalset_mark(ic_afical);
-    icalset_commit(ic_afical);
+    else
+        g_warning ("UID '%s' not found in archive", ical_uid);
     xfical_archive_close();
-    icalset_mark(ic_fical);
-    icalset_commit(ic_fical);
     xfical_file_close(FALSE);
 
     return(TRUE);
@@ -63,8 +63,11 @@
 #include "orage-alarm-structure.h"
 #include "orage-appointment-window.h"
 #include "orage-event.h"
+#include "orage-free-busy.h"
 #include "orage-i18n.h"
+#include "orage-memory.h"
 #include "orage-time-utils.h"
+#include "orage-trace.h"
 #include "orage-window.h"
 #include "parameters.h"
 #include "reminder.h"
@@ -96,15 +99,9 @@ G_DEFINE_TYPE (OrageCalendarComponent, orage_calendar_component, G_TYPE_OBJECT)
 
 icalset *ic_fical = NULL;
 icalcomponent *ic_ical = NULL;
-#ifdef HAVE_ARCHIVE
-icalset *ic_afical = NULL;
-icalcomponent *ic_aical = NULL;
-#endif
 gboolean ic_file_modified = FALSE; /* has any ical file been changed */
 ic_foreign_ical_files ic_f_ical[10];
 
-static void xfical_alarm_build_list_internal(gboolean first_list_today);
-
 typedef struct _app_data
 {
     GList **list;
@@ -115,10 +112,53 @@ typedef struct _app_data
     GDateTime *asdate;
     GDateTime *aedate;
     gint orig_start_hour, orig_end_hour;
+    /* appointment of the current component, shared by its occurrences */
+    xfical_appt *appt;
+    gboolean appt_used;
 } app_data;
 
 static guint    file_close_timer = 0;  /* delayed file close timer */
 
+/* Marked days of calendar months. Value has bit (day - 1) set for days with
+ * appointments and MONTH_MARK_VALID set, so that empty months are cached
+ * too. Calendar is 0 for the main file and foreign file number + 1 for
+ * foreign files. */
+static GHashTable *month_marks = NULL;
+static guint month_marks_prefetch_id = 0;
+static guint month_marks_prefetch_month = 0; /* year * 12 + month - 1 */
+
+#define MONTH_MARK_VALID (1U << 31)
+#define MONTH_MARK_KEY(cal, year, month) \
+        GUINT_TO_POINTER((((guint)(year) * 12 + (month) - 1) << 4) | (cal))
+#define MONTH_MARK_CALENDAR(key) (GPOINTER_TO_UINT(key) & 0xF)
+
+/* Alarms are materialized only for the next XFICAL_ALARM_HORIZON_HOURS and
+ * refilled when they fire or the day changes. Key is file type + uid of the
+ * component, with RECURRENCE-ID for overrides, and value is its
+ * alarm_source. The whole table is rebuilt
+ * whenever a calendar changes, so refill never needs the component. */
+#define XFICAL_ALARM_HORIZON_HOURS 48
+#define XFICAL_ALARM_HORIZON_MAX 64 /* alarms of one component per fill */
+static GHashTable *alarm_sources = NULL;
+
+typedef struct _alarm_source
+{
+    /* alarm data of the component, title and description are raw text */
+    alarm_struct *alarm;
+    /* time of the last alarm in the alarm list */
+    GDateTime *last;
+    /* RRULE expansion continues from ri; next_start is the latest start time
+     * it returned. ri is NULL when the component does not repeat. */
+    icalrecur_iterator *ri;
+    struct icaltimetype next_start;
+    GList *excluded_list;
+    /* sorted RDATE alarm times (struct icaltimetype *) */
+    GList *rdate_l;
+    struct icaldurationtype alarm_start_diff;
+    struct icaldurationtype duration;
+    gboolean is_date;
+} alarm_source;
+
 typedef struct _excluded_time
 {
     struct icaltimetype e_time;
@@ -126,9 +166,10 @@ typedef struct _excluded_time
 
 typedef struct _mark_calendar_data
 {
-    GtkCalendar *cal;
+    guint32 *mask; /* n_months masks starting from year+month */
     guint year;
     guint month;
+    guint n_months;
     gint orig_start_hour, orig_end_hour;
     xfical_appt appt;
 } mark_calendar_data;
@@ -137,9 +178,6 @@ typedef struct _mark_calendar_data2
 {
     xfical_event_callback cb;
     void *cb_param;
-    GDateTime *gdt_first;
-    GDateTime *gdt_last;
-    gint orig_start_hour, orig_end_hour;
     xfical_appt appt;
 } mark_calendar_data2;
 
@@ -176,6 +214,8 @@ gboolean xfical_set_local_timezone(gboolean testing)
 {
     local_icaltimezone = NULL;
     g_par.local_timezone_utc = FALSE;
+    /* cached marks and free/busy slots are in local time */
+    xfical_cache_invalidate ();
     if (!utc_icaltimezone)
             utc_icaltimezone = icaltimezone_get_utc_timezone();
 
@@ -297,6 +337,7 @@ gboolean xfical_file_open(gboolean foreign)
     gboolean ok;
     gint i;
     struct stat s;
+    ORAGE_TRACE_SCOPE("file open");
 
     /* make sure there are no external updates or they will be overwritten */
     if (g_par.latest_file_change)
@@ -314,6 +355,8 @@ gboolean xfical_file_open(gboolean foreign)
         else {
             g_par.latest_file_change = s.st_mtime;
         }
+
+        ic_shards_check();
     }
 
     if (ok && foreign) /* let's open foreign files */
@@ -354,6 +397,7 @@ static gboolean delayed_file_close (G_GNUC_UNUSED gpointer user_data)
 {
     if (ic_fical == NULL)
         return(FALSE); /* closed already, nothing to do */
+    ic_shards_close();
     icalset_free(ic_fical);
     ic_fical = NULL;
     g_debug ("closing iCal file");
@@ -378,6 +422,7 @@ void xfical_file_close(gboolean foreign)
             file_close_timer = 0;
             g_debug ("canceling delayed file close");
         }
+        ic_shards_commit();
         if (ic_file_modified || g_par.file_close_delay == 0) { /* close it now */
             g_debug ("closing iCal file immediately");
             delayed_file_close(NULL);
@@ -421,6 +466,8 @@ void xfical_file_close(gboolean foreign)
 
 void xfical_file_close_force(void)
 {
+    /* files are re-read, they may have been changed externally */
+    xfical_cache_invalidate ();
     ic_file_modified = TRUE;
     xfical_file_close(TRUE);
 }
@@ -435,7 +482,7 @@ char *ic_get_char_timezone(icalproperty *p)
     return(tz_loc);
 }
 
-static icaltimezone *get_builtin_timezone(gchar *tz_loc)
+static icaltimezone *get_builtin_timezone(const gchar *tz_loc)
 {
      /* This probably is evolution format, 
       * which has /xxx/xxx/timezone and we should remove the 
@@ -668,7 +715,8 @@ static int local_compare_date_only(struct icaltimetype a
     return retval;
 }
 
-static struct icaltimetype convert_to_zone(struct icaltimetype t, gchar *tz)
+static struct icaltimetype convert_to_zone(struct icaltimetype t
+        , const gchar *tz)
 {
     struct icaltimetype wtime = t;
     icaltimezone *l_icaltimezone = NULL;
@@ -699,10 +747,47 @@ static struct icaltimetype convert_to_zone(struct icaltimetype t, gchar *tz)
     return(wtime);
 }
 
+/* Convert occurrence span from icalcomponent_foreach_recurrence into start
+ * and end times in the appointment timezones. Note that libical does not
+ * understand timezones here, but gives always raw time, which we need to
+ * convert to correct timezone. */
+static void span_to_icaltime (const xfical_appt *appt, gint orig_start_hour
+        , time_t span_start, time_t span_end
+        , struct icaltimetype *sdate, struct icaltimetype *edate)
+{
+    *sdate = orage_time_t_to_icaltimetype (span_start);
+    *edate = orage_time_t_to_icaltimetype (span_end);
+
+    /* BUG 7886. we are called with wrong span->end when we have full day
+       event. This is libical bug and needs to be fixed properly later, but
+       now I just work around it.
+    FIXME: code whole loop correctly = function icalcomponent_foreach_recurrence
+    */
+    if (appt->allDay && !appt->use_duration) {
+        icaltime_adjust(edate, -1, 0, 0, 0);
+        /* now end is correct, but we still have been called wrongly on
+           the last day */
+    }
+
+    /* BUG 7929. If calendar file contains same timezone definition than what
+       the time is in, libical returns wrong time in span. But as the hour
+       only changes with HOURLY repeating appointments, we can replace received
+       hour with the hour from start time */
+    if (appt->freq != XFICAL_FREQ_HOURLY && sdate->hour != orig_start_hour) {
+        /* WHEN we arrive here, libical has done an extra UTC conversion,
+           which we need to undo */
+        *sdate = convert_to_zone(*sdate, "UTC");
+        *edate = convert_to_zone(*edate, "UTC");
+    }
+    else {
+        *sdate = convert_to_zone(*sdate, appt->start_tz_loc);
+        *edate = convert_to_zone(*edate, appt->end_tz_loc);
+    }
+}
+
 gint xfical_compare_times (xfical_appt *appt)
 {
     struct icaltimetype stime, etime;
-    const char *text;
     struct icaldurationtype duration;
 
     if (appt->starttime == NULL)
@@ -716,11 +801,9 @@ gint xfical_compare_times (xfical_appt *appt)
         stime = orage_gdatetime_to_icaltimetype (appt->starttime, appt->allDay);
         duration = icaldurationtype_from_int(appt->duration);
         etime = icaltime_add(stime, duration);
-        text  = icaltime_as_ical_string(etime);
         orage_gdatetime_unref (appt->endtime);
-        appt->endtime = orage_icaltime_to_gdatetime (text);
-        g_free(appt->end_tz_loc);
-        appt->end_tz_loc = g_strdup(appt->start_tz_loc);
+        appt->endtime = orage_icaltimetype_to_gdatetime2 (etime);
+        appt->end_tz_loc = appt->start_tz_loc;
         return(0); /* ok */
 
     }
@@ -1362,6 +1445,243 @@ static void appt_add_completedtime_internal (const xfical_appt *appt,
     }
 }
 
+/* Calendar index used in month mark keys: 0 for the main file and foreign
+ * file number + 1 for foreign files. -1 if unknown. */
+static gint calendar_index_of_uid (const gchar *ical_uid)
+{
+    gint i;
+
+    if (ical_uid == NULL)
+        return -1;
+    if (ical_uid[0] == 'O')
+        return 0;
+    if (ical_uid[0] == 'F' && sscanf(ical_uid, "F%02d", &i) == 1)
+        return i + 1;
+
+    return -1;
+}
+
+static gboolean month_mark_of_calendar (gpointer key
+        , G_GNUC_UNUSED gpointer value, gpointer user_data)
+{
+    return (MONTH_MARK_CALENDAR(key) == GPOINTER_TO_UINT(user_data));
+}
+
+static void month_marks_invalidate_calendar (gint cal)
+{
+    if (month_marks == NULL)
+        return;
+
+    if (cal < 0)
+        g_hash_table_remove_all (month_marks);
+    else
+        g_hash_table_foreach_remove (month_marks, month_mark_of_calendar
+                , GUINT_TO_POINTER(cal));
+}
+
+static void month_marks_invalidate_range (gint cal
+        , struct icaltimetype s, struct icaltimetype e)
+{
+    gint m;
+
+    if (month_marks == NULL)
+        return;
+
+    if (cal < 0) {
+        g_hash_table_remove_all (month_marks);
+        return;
+    }
+
+    for (m = s.year*12 + s.month - 1; m <= e.year*12 + e.month - 1; m++)
+        g_hash_table_remove (month_marks
+                , MONTH_MARK_KEY(cal, m / 12, m % 12 + 1));
+}
+
+void xfical_cache_invalidate (void)
+{
+    if (month_marks)
+        g_hash_table_remove_all (month_marks);
+
+    orage_free_busy_invalidate_all ();
+}
+
+/* Rough heap bytes of libical objects on 64 bit systems. Text values are
+ * counted by their length, since they usually are the largest part. */
+#define IC_COMPONENT_BYTES 96
+#define IC_PROPERTY_BYTES 80
+#define IC_VALUE_BYTES 96
+#define IC_PARAMETER_BYTES 64
+
+typedef struct _tree_usage
+{
+    guint64 components;
+    guint64 properties;
+    guint64 bytes;
+} tree_usage;
+
+/* External iterator is used for components, so that iteration of the caller
+ * is not disturbed. */
+static void tree_usage_add (icalcomponent *c, gpointer user_data)
+{
+    tree_usage *usage = user_data;
+    icalcompiter ci;
+    icalproperty *p;
+    icalvalue *v;
+    const gchar *text;
+
+    usage->components++;
+    usage->bytes += IC_COMPONENT_BYTES;
+
+    for (p = icalcomponent_get_first_property (c, ICAL_ANY_PROPERTY);
+         p != NULL;
+         p = icalcomponent_get_next_property (c, ICAL_ANY_PROPERTY)) {
+        usage->properties++;
+        usage->bytes += IC_PROPERTY_BYTES + IC_VALUE_BYTES
+                + icalproperty_count_parameters (p) * IC_PARAMETER_BYTES;
+
+        v = icalproperty_get_value (p);
+        if (v && icalvalue_isa (v) == ICAL_TEXT_VALUE
+        && (text = icalvalue_get_text (v)) != NULL)
+            usage->bytes += strlen (text) + 1;
+    }
+
+    for (ci = icalcomponent_begin_component (c, ICAL_ANY_COMPONENT);
+         icalcompiter_deref (&ci) != NULL;
+         icalcompiter_next (&ci))
+        tree_usage_add (icalcompiter_deref (&ci), usage);
+}
+
+static void tree_usage_report (GArray *usage, const gchar *name
+        , const tree_usage *tree)
+{
+    orage_memory_usage_add (usage, name, tree->components, tree->properties
+            , tree->bytes);
+}
+
+void xfical_memory_usage (GArray *usage)
+{
+    tree_usage tree;
+    GHashTableIter iter;
+    gpointer key, value;
+    alarm_source *src;
+    guint64 bytes;
+    gchar *name;
+    gint i;
+
+    /* calendar files are in memory only while open or waiting for the
+     * delayed close, closed ones are reported as empty */
+    memset (&tree, 0, sizeof (tree));
+    if (ic_fical)
+        tree_usage_add (ic_ical, &tree);
+    tree_usage_report (usage, "calendar", &tree);
+
+    memset (&tree, 0, sizeof (tree));
+    if (ic_fical)
+        ic_shards_foreach_loaded (tree_usage_add, &tree);
+    tree_usage_report (usage, "calendar year shards", &tree);
+
+    for (i = 0; i < g_par.foreign_count; i++) {
+        memset (&tree, 0, sizeof (tree));
+        if (ic_f_ical[i].fical)
+            tree_usage_add (ic_f_ical[i].ical, &tree);
+        name = g_strdup_printf ("foreign calendar '%s'"
+                , g_par.foreign_data[i].name);
+        tree_usage_report (usage, name, &tree);
+        g_free (name);
+    }
+
+#ifdef HAVE_ARCHIVE
+    memset (&tree, 0, sizeof (tree));
+    ic_archive_foreach_loaded (tree_usage_add, &tree);
+    tree_usage_report (usage, "archive segments", &tree);
+#endif
+
+    i = month_marks ? g_hash_table_size (month_marks) : 0;
+    orage_memory_usage_add (usage, "month marks", i, 0
+            , i * ORAGE_MEMORY_HASH_ENTRY);
+
+    bytes = 0;
+    i = 0;
+    if (alarm_sources) {
+        g_hash_table_iter_init (&iter, alarm_sources);
+        while (g_hash_table_iter_next (&iter, &key, &value)) {
+            src = (alarm_source *)value;
+            i++;
+            bytes += ORAGE_MEMORY_HASH_ENTRY + sizeof (alarm_source)
+                    + ORAGE_MEMORY_DATE_TIME + sizeof (alarm_struct)
+                    + orage_memory_string_size (key)
+                    + orage_memory_string_size (src->alarm->recurrence_id)
+                    + orage_memory_string_size (src->alarm->title)
+                    + orage_memory_string_size (src->alarm->description)
+                    + (g_list_length (src->excluded_list)
+                            * (ORAGE_MEMORY_LIST_NODE + sizeof (excluded_time)))
+                    + (g_list_length (src->rdate_l)
+                            * (ORAGE_MEMORY_LIST_NODE
+                                + sizeof (struct icaltimetype)));
+        }
+    }
+    orage_memory_usage_add (usage, "alarm sources", i, 0, bytes);
+}
+
+void xfical_memory_trim (void)
+{
+    /* main calendar stays open for a while after use, close it now */
+    if (file_close_timer) {
+        g_source_remove (file_close_timer);
+        (void)delayed_file_close (NULL);
+    }
+
+    xfical_cache_invalidate ();
+}
+
+/* Drop cached month marks and free/busy bitmaps touched by the component.
+ * Recurring components and TODOs may touch any day, so everything of their
+ * calendar is dropped for them. */
+static void forget_cached_component (icalcomponent *c, const gchar *ical_uid)
+{
+    xfical_period per;
+    icalcomponent_kind kind;
+    GDateTime *gdt_start;
+    GDateTime *gdt_end;
+    gint cal;
+
+    kind = icalcomponent_isa(c);
+    if (kind != ICAL_VEVENT_COMPONENT && kind != ICAL_VTODO_COMPONENT)
+        return;
+
+    cal = calendar_index_of_uid(ical_uid);
+    if (kind == ICAL_VTODO_COMPONENT) {
+        month_marks_invalidate_calendar(cal);
+        return;
+    }
+
+    if (icalcomponent_get_first_property(c, ICAL_RRULE_PROPERTY)
+     || icalcomponent_get_first_property(c, ICAL_RDATE_PROPERTY)) {
+        month_marks_invalidate_calendar(cal);
+        orage_free_busy_invalidate_all ();
+        return;
+    }
+
+    per = ic_get_period(c, TRUE);
+    if (icaltime_is_null_time(per.stime))
+        return;
+
+    /* one extra day on both sides, like in xfical_get_each_app_within_time,
+     * covers rounding of all-day events and timezones */
+    icaltime_adjust(&per.stime, -1, 0, 0, 0);
+    icaltime_adjust(&per.etime, 1, 0, 0, 0);
+    month_marks_invalidate_range(cal, per.stime, per.etime);
+    gdt_start = orage_icaltimetype_to_gdatetime2 (per.stime);
+    gdt_end = orage_icaltimetype_to_gdatetime2 (per.etime);
+    if (gdt_start && gdt_end)
+        orage_free_busy_invalidate_range (gdt_start, gdt_end);
+    else
+        orage_free_busy_invalidate_all ();
+
+    orage_gdatetime_unref (gdt_start);
+    orage_gdatetime_unref (gdt_end);
+}
+
 static gchar *appt_add_internal (xfical_appt *appt, gboolean add, gchar *uid,
                                  struct icaltimetype cre_time)
 {
@@ -1477,6 +1797,7 @@ static gchar *appt_add_internal (xfical_appt *appt, gboolean add, gchar *uid,
                     ext_uid[0], ext_uid);
         return(NULL);
     }
+    forget_cached_component(icmp, ext_uid);
     xfical_alarm_build_list_internal(FALSE);
     ic_file_modified = TRUE;
     return(ext_uid);
@@ -1672,18 +1993,19 @@ static void process_start_date(xfical_appt *appt, icalproperty *p
     *stime = ic_convert_to_timezone(*itime, p);
     *sltime = convert_to_local_timezone(*itime, p);
     orage_gdatetime_unref (appt->starttime);
-    appt->starttime = orage_icaltime_to_gdatetime (text);
+    appt->starttime = orage_icaltimetype_to_gdatetime2 (*itime);
     if (icaltime_is_date(*itime)) {
         appt->allDay = TRUE;
-        appt->start_tz_loc = "floating";
+        appt->start_tz_loc = g_intern_static_string ("floating");
     }
     else if (icaltime_is_utc(*itime)) {
-        appt->start_tz_loc = "UTC";
+        appt->start_tz_loc = g_intern_static_string ("UTC");
     }
     else { /* let's check timezone */
         char *t;
 
-        appt->start_tz_loc = ((t = ic_get_char_timezone(p)) ? t : "floating");
+        appt->start_tz_loc = ((t = ic_get_char_timezone(p))
+                ? g_intern_string (t) : g_intern_static_string ("floating"));
     }
 
     if (appt->endtime == NULL) {
@@ -1701,18 +2023,19 @@ static void process_end_date(xfical_appt *appt, icalproperty *p
     *itime = icaltime_from_string(text);
     *eltime = convert_to_local_timezone (*itime, p);
     orage_gdatetime_unref (appt->endtime);
-    appt->endtime = orage_icaltime_to_gdatetime (text);
+    appt->endtime = orage_icaltimetype_to_gdatetime2 (*itime);
     if (icaltime_is_date(*itime)) {
         appt->allDay = TRUE;
-        appt->end_tz_loc = "floating";
+        appt->end_tz_loc = g_intern_static_string ("floating");
     }
     else if (icaltime_is_utc(*itime)) {
-        appt->end_tz_loc = "UTC";
+        appt->end_tz_loc = g_intern_static_string ("UTC");
     }
     else { /* let's check timezone */
         char *t;
 
-        appt->end_tz_loc = ((t = ic_get_char_timezone(p)) ? t : "floating");
+        appt->end_tz_loc = ((t = ic_get_char_timezone(p))
+                ? g_intern_string (t) : g_intern_static_string ("floating"));
     }
     appt->use_due_time = TRUE;
 }
@@ -1726,10 +2049,9 @@ static void process_completed_date(xfical_appt *appt, icalproperty *p)
     text = icalproperty_get_value_as_string(p);
     itime = icaltime_from_string(text);
     eltime = convert_to_local_timezone(itime, p);
-    text  = icaltime_as_ical_string(eltime);
     orage_gdatetime_unref (appt->completedtime);
-    appt->completedtime = orage_icaltime_to_gdatetime (text);
-    appt->completed_tz_loc = g_par.local_timezone;
+    appt->completedtime = orage_icaltimetype_to_gdatetime2 (eltime);
+    appt->completed_tz_loc = g_intern_string (g_par.local_timezone);
     appt->completed = TRUE;
 }
 
@@ -1846,10 +2168,7 @@ static void ical_appt_get_rrule_internal (G_GNUC_UNUSED icalcomponent *c,
     if ((appt->recur_count = rrule.count))
         appt->recur_limit = XFICAL_RECUR_COUNT;
     else if(! icaltime_is_null_time(rrule.until)) {
-        const char *text;
-
-        text = icaltime_as_ical_string (rrule.until);
-        gdt = orage_icaltime_to_gdatetime (text);
+        gdt = orage_icaltimetype_to_gdatetime2 (rrule.until);
         if (gdt)
         {
             orage_gdatetime_unref (appt->recur_until);
@@ -1971,6 +2290,7 @@ static void appt_init(xfical_appt *appt)
 static gboolean get_appt_from_icalcomponent(icalcomponent *c, xfical_appt *appt)
 {
     const char *text;
+    gchar *categories;
     icalproperty *p = NULL;
     struct icaltimetype itime, stime, etime, sltime, eltime, wtime;
     icaltimezone *l_icaltimezone = NULL;
@@ -2085,11 +2405,11 @@ static gboolean get_appt_from_icalcomponent(icalcomponent *c, xfical_appt *appt)
                 if (appt->categories == NULL)
                     appt->categories = g_strdup(icalproperty_get_categories(p));
                 else {
-                    text = appt->categories;
+                    categories = appt->categories;
                     appt->categories = g_strjoin(","
                             , appt->categories
                             , icalproperty_get_categories(p), NULL);
-                    g_free((char *)text);
+                    g_free(categories);
                 }
                 break;
             case ICAL_EXDATE_PROPERTY:
@@ -2145,9 +2465,8 @@ static gboolean get_appt_from_icalcomponent(icalcomponent *c, xfical_appt *appt)
     /* need to set missing endtime or duration */
     if (appt->use_duration) {
         etime = icaltime_add(stime, duration);
-        text  = icaltime_as_ical_string(etime);
         orage_gdatetime_unref (appt->endtime);
-        appt->endtime = orage_icaltime_to_gdatetime (text);
+        appt->endtime = orage_icaltimetype_to_gdatetime2 (etime);
         appt->end_tz_loc = appt->start_tz_loc;
     }
     else {
@@ -2160,9 +2479,8 @@ static gboolean get_appt_from_icalcomponent(icalcomponent *c, xfical_appt *appt)
             appt->duration -= icaldurationtype_as_int(duration_tmp);
             duration = icaldurationtype_from_int(appt->duration);
             etime = icaltime_add(stime, duration);
-            text  = icaltime_as_ical_string(etime);
             orage_gdatetime_unref (appt->endtime);
-            appt->endtime = orage_icaltime_to_gdatetime (text);
+            appt->endtime = orage_icaltimetype_to_gdatetime2 (etime);
         }
     }
     if (appt->recur_limit == XFICAL_RECUR_UNTIL) { /* BUG 2937: convert back from UTC */
@@ -2177,9 +2495,8 @@ static gboolean get_appt_from_icalcomponent(icalcomponent *c, xfical_appt *appt)
                     appt->start_tz_loc);
             wtime = icaltime_convert_to_zone(wtime, l_icaltimezone);
         }
-        text  = icaltime_as_ical_string(wtime);
         orage_gdatetime_unref (appt->recur_until);
-        appt->recur_until = orage_icaltime_to_gdatetime (text);
+        appt->recur_until = orage_icaltimetype_to_gdatetime2 (wtime);
     }
     return(TRUE);
 }
@@ -2228,18 +2545,13 @@ static void xfical_appt_get_fill_internal (xfical_appt *appt,
         appt->uid = g_strconcat(file_type, appt->uid, NULL);
         appt->title = g_strdup(appt->title);
         appt->location = g_strdup(appt->location);
-        if (appt->start_tz_loc)
-            appt->start_tz_loc = g_strdup(appt->start_tz_loc);
-        else
-            appt->start_tz_loc = g_strdup("floating");
-        if (appt->end_tz_loc)
-            appt->end_tz_loc = g_strdup(appt->end_tz_loc);
-        else
-            appt->end_tz_loc = g_strdup("floating");
-        if (appt->completed_tz_loc)
-            appt->completed_tz_loc = g_strdup(appt->completed_tz_loc);
-        else
-            appt->completed_tz_loc = g_strdup("floating");
+        /* timezone names are interned, so they are not copied */
+        if (appt->start_tz_loc == NULL)
+            appt->start_tz_loc = g_intern_static_string ("floating");
+        if (appt->end_tz_loc == NULL)
+            appt->end_tz_loc = g_intern_static_string ("floating");
+        if (appt->completed_tz_loc == NULL)
+            appt->completed_tz_loc = g_intern_static_string ("floating");
         appt->note = g_strdup(appt->note);
         appt->sound = g_strdup(appt->sound);
         appt->procedure_cmd = g_strdup(appt->procedure_cmd);
@@ -2261,6 +2573,7 @@ static xfical_appt *appt_get_any(const char *ical_uid, icalcomponent *base
 xfical_appt *xfical_appt_get(const gchar *uid)
 {
     xfical_appt *appt;
+    icalcomponent *base;
     const char *ical_uid;
     char file_type[8];
     gint i;
@@ -2270,10 +2583,15 @@ xfical_appt *xfical_appt_get(const gchar *uid)
     ical_uid = uid+4; /* skip file id */
     if (uid[0] == 'O') {
         appt = appt_get_any(ical_uid, ic_ical, file_type);
+        if (appt == NULL && ic_shards_find_uid(ical_uid, &base))
+            appt = appt_get_any(ical_uid, base, file_type);
     }
 #ifdef HAVE_ARCHIVE
     else if (uid[0] == 'A') {
-        appt = appt_get_any(ical_uid, ic_aical, file_type);
+        if (ic_archive_find_uid(ical_uid, &base))
+            appt = appt_get_any(ical_uid, base, file_type);
+        else
+            appt = NULL;
     }
 #endif
     else if (uid[0] == 'F') {
@@ -2304,9 +2622,6 @@ void xfical_appt_free(xfical_appt *appt)
     g_free(appt->uid);
     g_free(appt->title);
     g_free(appt->location);
-    g_free(appt->start_tz_loc);
-    g_free(appt->end_tz_loc);
-    g_free(appt->completed_tz_loc);
     g_free(appt->note);
     g_free(appt->sound);
     g_free(appt->procedure_cmd);
@@ -2370,10 +2685,22 @@ gboolean xfical_appt_mod (gchar *ical_uid, xfical_appt *appt)
             if ((p = icalcomponent_get_first_property(c,
                             ICAL_CREATED_PROPERTY)))
                 create_time = icalproperty_get_created(p);
+            forget_cached_component(c, ical_uid);
             icalcomponent_remove_component(base, c);
             key_found = TRUE;
         }
     } 
+    if (!key_found && ical_uid[0] == 'O'
+    && (c = ic_shards_find_uid(int_uid, &base))) {
+        /* modified event goes back to the main file */
+        if ((p = icalcomponent_get_first_property(c, ICAL_CREATED_PROPERTY)))
+            create_time = icalproperty_get_created(p);
+        forget_cached_component(c, ical_uid);
+        icalcomponent_remove_component(base, c);
+        icalcomponent_free(c);
+        ic_shards_mark(base);
+        key_found = TRUE;
+    }
     if (!key_found) {
         g_warning ("UID '%s' not found; nothing done", ical_uid);
         return(FALSE);
@@ -2432,6 +2759,7 @@ gboolean xfical_appt_del (gchar *ical_uid)
          c = icalcomponent_get_next_component(base, ICAL_ANY_COMPONENT)) {
         uid = (char *)icalcomponent_get_uid(c);
         if (ORAGE_STR_EXISTS(uid) && strcmp(uid, int_uid) == 0) {
+            forget_cached_component(c, ical_uid);
             icalcomponent_remove_component(base, c);
             icalset_mark(fbase);
             xfical_alarm_build_list_internal(FALSE);
@@ -2440,6 +2768,16 @@ gboolean xfical_appt_del (gchar *ical_uid)
         }
     }
 
+    if (ical_uid[0] == 'O' && (c = ic_shards_find_uid(int_uid, &base))) {
+        forget_cached_component(c, ical_uid);
+        icalcomponent_remove_component(base, c);
+        icalcomponent_free(c);
+        ic_shards_mark(base);
+        xfical_alarm_build_list_internal(FALSE);
+        ic_file_modified = TRUE;
+        return(TRUE);
+    }
+
     g_warning ("appointment with UID '%s' not found", ical_uid);
     return(FALSE);
 }
@@ -2609,13 +2947,68 @@ static gboolean time_is_excluded(GList *exclude_l, struct icaltimetype *time)
     return(0); /* end of list reached */
 }
 
+static gint alarm_time_order(gconstpointer a, gconstpointer b)
+{
+    return(icaltime_compare(*(struct icaltimetype *)a
+                          , *(struct icaltimetype *)b));
+}
+
+/* Set alarm_time and action_time of new_alarm. next_alarm_time is UTC time
+ * or, for dates, already local time due to the hack in
+ * count_first_alarm_time. */
+static void alarm_set_times(alarm_struct *new_alarm
+        , struct icaltimetype next_alarm_time, gboolean is_date
+        , struct icaldurationtype alarm_start_diff
+        , struct icaldurationtype duration)
+{
+    struct icaltimetype next_start_time, next_end_time;
+    gchar *tmp1, *tmp2;
+
+    /* If we had a date, we now have the time already in local time and
+       no conversion is needed. This is due to the hack in date time
+       calculation in count_first_alarm_time. We just need to set it to
+       local timezone.
+       If it is normal time we need to convert it to local.
+     */
+    if (is_date) {
+        if (local_icaltimezone != utc_icaltimezone) {
+            next_alarm_time.is_daylight   = 0;
+            next_alarm_time.zone          = local_icaltimezone;
+        }
+    }
+    else
+        next_alarm_time = icaltime_convert_to_zone(next_alarm_time, local_icaltimezone);
+
+    new_alarm->alarm_time = orage_icaltimetype_to_gdatetime2 (next_alarm_time);
+    /* alarm_start_diff goes from start to alarm, so we need to revert it
+     * here since now we need to get the start time from alarm.
+     */
+    if (alarm_start_diff.is_neg)
+        alarm_start_diff.is_neg = 0;
+    else 
+        alarm_start_diff.is_neg = 1;
+
+    next_start_time = icaltime_add(next_alarm_time, alarm_start_diff);
+    next_end_time = icaltime_add(next_start_time, duration);
+    tmp1 = orage_icaltime_to_i18_time (
+        icaltime_as_ical_string (next_start_time));
+    tmp2 = orage_icaltime_to_i18_time (
+        icaltime_as_ical_string (next_end_time));
+    new_alarm->action_time = g_strconcat(tmp1, " - ", tmp2, NULL);
+    g_free(tmp1);
+    g_free(tmp2);
+}
+
 /* let's find the trigger and check that it is active.
  * return new alarm struct if alarm is active and NULL if it is not
+ * If src is given, recurrence state is saved there so that later alarms
+ * can be expanded forward from this one (see alarm_source_next).
  * FIXME: We assume all alarms have similar trigger, which 
  * may not be true for other than Orage appointments
  */
 static alarm_struct *process_alarm_trigger(icalcomponent *c
-        , icalcomponent *ca, struct icaltimetype cur_time, int *cnt_repeat)
+        , icalcomponent *ca, struct icaltimetype cur_time, int *cnt_repeat
+        , alarm_source *src)
 { /* c == main component; ca == alarm component */
     icalproperty *p, *rdate;
     struct icaltriggertype trg;
@@ -2628,13 +3021,11 @@ static alarm_struct *process_alarm_trigger(icalcomponent *c
 #endif
     icalrecur_iterator* ri;
     xfical_period per;
-    struct icaltimetype next_alarm_time, next_start_time, next_end_time, 
-                        rdate_alarm_time;
+    struct icaltimetype next_alarm_time, next_start_time, rdate_alarm_time;
     gboolean trg_active = FALSE;
     alarm_struct *new_alarm;
     struct icaldurationtype alarm_start_diff;
     struct icaldatetimeperiodtype rdate_period;
-    gchar *tmp1, *tmp2;
     GList *excluded_list = NULL;
     icaltimezone *dtstart_zone;
     /* pvl_elem property_iterator;   */ /* for saving the iterator */
@@ -2718,7 +3109,6 @@ struct icaltimetype exdatetime;
              */
             (*cnt_repeat)++;
         }
-        icalrecur_iterator_free(ri);
         /* Due to the hack in date time calculation in count_first_alarm_time,
            we need to set next_alarm_time to local timezone so that 
            icaltime_compare works. Fix for Bug 8525
@@ -2732,7 +3122,26 @@ struct icaltimetype exdatetime;
         if (icaltime_compare(cur_time, next_alarm_time) <= 0) {
             trg_active = TRUE;
         }
-        free_excluded_list(excluded_list);
+        if (src && per.ikind != ICAL_VTODO_COMPONENT) {
+            /* later alarms continue from next_start_time */
+            src->ri = ri;
+            src->next_start = next_start_time;
+            src->excluded_list = excluded_list;
+        }
+        else {
+            icalrecur_iterator_free(ri);
+            free_excluded_list(excluded_list);
+        }
+    }
+    else if (src && per.ikind != ICAL_VTODO_COMPONENT
+    && (p = icalcomponent_get_first_property(c, ICAL_RRULE_PROPERTY)) != 0) {
+        /* first alarm comes from DTSTART, later ones from RRULE */
+        dtstart_zone = build_excluded_list_dtstart(c);
+        build_excluded_list(&src->excluded_list, c, dtstart_zone);
+        src->excluded_list = g_list_sort(src->excluded_list, exclude_order);
+        rrule = icalproperty_get_rrule(p);
+        src->ri = icalrecur_iterator_new(rrule, per.stime);
+        src->next_start = icalrecur_iterator_next(src->ri);
     }
 
     if (!trg_active)
@@ -2775,6 +3184,11 @@ struct icaltimetype exdatetime;
         /* we still need to convert it from start time to alarm time */
         rdate_alarm_time = icaltime_add(rdate_period.time, alarm_start_diff);
         if (icaltime_compare(cur_time, rdate_alarm_time) <= 0) {
+            if (src && per.ikind != ICAL_VTODO_COMPONENT)
+                src->rdate_l = g_list_insert_sorted(src->rdate_l
+                        , g_memdup2(&rdate_alarm_time
+                                , sizeof (rdate_alarm_time))
+                        , alarm_time_order);
             /* this alarm is still active */
             /* save the iterator since excluded check changes it */
             /* FIXME: how to store the iterator??
@@ -2796,42 +3210,17 @@ struct icaltimetype exdatetime;
         }
     }
 
+    if (src) {
+        src->alarm_start_diff = alarm_start_diff;
+        src->duration = per.duration;
+        src->is_date = icaltime_is_date(per.stime);
+    }
+
     if (trg_active) {
         new_alarm = orage_alarm_new ();
-        /* If we had a date, we now have the time already in local time and
-           no conversion is needed. This is due to the hack in date time
-           calculation in count_first_alarm_time. We just need to set it to
-           local timezone.
-           If it is normal time we need to convert it to local.
-         */
-        if (icaltime_is_date(per.stime)) {
-            if (local_icaltimezone != utc_icaltimezone) {
-                next_alarm_time.is_daylight   = 0;
-                next_alarm_time.zone          = local_icaltimezone;
-            }
-        }
-        else
-            next_alarm_time = icaltime_convert_to_zone(next_alarm_time, local_icaltimezone);
-
-        new_alarm->alarm_time = orage_icaltimetype_to_gdatetime2 (next_alarm_time);
-        /* alarm_start_diff goes from start to alarm, so we need to revert it
-         * here since now we need to get the start time from alarm.
-         */
-        if (alarm_start_diff.is_neg)
-            alarm_start_diff.is_neg = 0;
-        else 
-            alarm_start_diff.is_neg = 1;
-
-        next_start_time = icaltime_add(next_alarm_time, alarm_start_diff);
-        next_end_time = icaltime_add(next_start_time, per.duration);
-        tmp1 = orage_icaltime_to_i18_time (
-            icaltime_as_ical_string (next_start_time));
-        tmp2 = orage_icaltime_to_i18_time (
-            icaltime_as_ical_string (next_end_time));
-        new_alarm->action_time = g_strconcat(tmp1, " - ", tmp2, NULL);
-        g_free(tmp1);
-        g_free(tmp2);
-
+        alarm_set_times(new_alarm, next_alarm_time
+                , icaltime_is_date(per.stime), alarm_start_diff
+                , per.duration);
         return(new_alarm);
     }
     else {
@@ -2963,17 +3352,189 @@ static void process_alarm_data(icalcomponent *ca, alarm_struct *new_alarm)
 #endif
 }
 
+static GDateTime *alarm_horizon_end (void)
+{
+    GDateTime *now;
+    GDateTime *horizon_end;
+
+    now = g_date_time_new_now_utc();
+    horizon_end = g_date_time_add_hours(now, XFICAL_ALARM_HORIZON_HOURS);
+    g_date_time_unref(now);
+
+    return(horizon_end);
+}
+
+/* Key of alarm_sources. Overrides of single occurrences share the UID
+ * with their series, so RECURRENCE-ID is part of the key. */
+static gchar *alarm_source_key (const gchar *uid, const gchar *recurrence_id)
+{
+    if (recurrence_id == NULL)
+        return(g_strdup(uid));
+
+    return(g_strconcat(uid, "\n", recurrence_id, NULL));
+}
+
+static void alarm_source_free (gpointer data)
+{
+    alarm_source *src = (alarm_source *)data;
+
+    if (src->alarm)
+        orage_alarm_unref(src->alarm);
+    orage_gdatetime_unref(src->last);
+    if (src->ri)
+        icalrecur_iterator_free(src->ri);
+    free_excluded_list(src->excluded_list);
+    g_list_free_full(src->rdate_l, g_free);
+    g_free(src);
+}
+
+/* Next alarm time of src after its last alarm or null time if there are no
+ * more alarms. RRULE expansion continues where the previous call stopped,
+ * so every occurrence is expanded only once. */
+static struct icaltimetype alarm_source_next (alarm_source *src)
+{
+    struct icaltimetype last, rrule_alarm_time, *rdate_alarm_time;
+
+    last = icaltime_from_timet_with_zone(g_date_time_to_unix(src->last), 0
+            , utc_icaltimezone);
+    rrule_alarm_time = icaltime_null_time();
+    while (src->ri) {
+        if (icaltime_is_null_time(src->next_start)) { /* all done */
+            icalrecur_iterator_free(src->ri);
+            src->ri = NULL;
+            break;
+        }
+        rrule_alarm_time = count_next_alarm_time(src->next_start
+                , src->alarm_start_diff);
+        if (src->is_date && local_icaltimezone != utc_icaltimezone) {
+            rrule_alarm_time.is_daylight = 0;
+            rrule_alarm_time.zone        = local_icaltimezone;
+        }
+        if (icaltime_compare(rrule_alarm_time, last) > 0
+        && !time_is_excluded(src->excluded_list, &src->next_start))
+            break;
+        rrule_alarm_time = icaltime_null_time();
+        src->next_start = icalrecur_iterator_next(src->ri);
+    }
+
+    while (src->rdate_l) {
+        rdate_alarm_time = (struct icaltimetype *)src->rdate_l->data;
+        if (icaltime_compare(*rdate_alarm_time, last) > 0) {
+            if (icaltime_is_null_time(rrule_alarm_time)
+            || icaltime_compare(*rdate_alarm_time, rrule_alarm_time) < 0)
+                return(*rdate_alarm_time);
+            break;
+        }
+        g_free(rdate_alarm_time);
+        src->rdate_l = g_list_delete_link(src->rdate_l, src->rdate_l);
+    }
+
+    return(rrule_alarm_time);
+}
+
+/* Add alarms of src until the first alarm after horizon_end, so every
+ * component always has its next alarm in the list.
+ * Returns number of added alarms. */
+static gint alarm_source_fill (alarm_source *src, GDateTime *horizon_end)
+{
+    struct icaltimetype next_alarm_time;
+    alarm_struct *new_alarm;
+    gint cnt = 0;
+
+    while (cnt < XFICAL_ALARM_HORIZON_MAX
+    && g_date_time_compare(src->last, horizon_end) <= 0) {
+        next_alarm_time = alarm_source_next(src);
+        if (icaltime_is_null_time(next_alarm_time))
+            break;
+        new_alarm = orage_alarm_copy(src->alarm);
+        alarm_set_times(new_alarm, next_alarm_time, src->is_date
+                , src->alarm_start_diff, src->duration);
+        if (new_alarm->alarm_time == NULL
+        || g_date_time_compare(new_alarm->alarm_time, src->last) <= 0) {
+            /* did not move forward, stop here to avoid looping forever */
+            orage_alarm_unref(new_alarm);
+            break;
+        }
+        alarm_add(new_alarm);
+        cnt++;
+
+        orage_gdatetime_unref(src->last);
+        src->last = g_date_time_ref(new_alarm->alarm_time);
+    }
+
+    return(cnt);
+}
+
+/* Add alarms of component c. The first alarm is searched from cur_time and
+ * the rest are expanded forward from it. Recurrence state is kept in
+ * alarm_sources, so later fills continue from there without the component.
+ * Returns number of added alarms. */
+static gint alarm_horizon_fill (icalcomponent *c, const gchar *file_type
+        , struct icaltimetype cur_time, GDateTime *horizon_end
+        , gint *cnt_repeat)
+{
+    icalcomponent *ca;
+    icalcompiter ci;
+    alarm_struct *new_alarm, *first_alarm;
+    alarm_source *src;
+    struct icaltimetype rid;
+    gchar *tmp;
+
+    ca = icalcomponent_get_first_component(c, ICAL_VALARM_COMPONENT);
+    if (ca == NULL)
+        return(0);
+
+    src = g_new0(alarm_source, 1);
+    new_alarm = process_alarm_trigger(c, ca, cur_time, cnt_repeat, src);
+    if (new_alarm == NULL || new_alarm->alarm_time == NULL) {
+        if (new_alarm)
+            orage_alarm_unref(new_alarm);
+        alarm_source_free(src);
+        return(0);
+    }
+
+    src->alarm = orage_alarm_new();
+    tmp = g_strconcat(file_type, icalcomponent_get_uid(c), NULL);
+    src->alarm->uid = g_intern_string(tmp);
+    g_free(tmp);
+    rid = icalcomponent_get_recurrenceid(c);
+    if (!icaltime_is_null_time(rid))
+        src->alarm->recurrence_id = g_strdup(icaltime_as_ical_string(rid));
+    src->alarm->title = g_strdup (
+            orage_process_text_commands_cached (src->alarm->uid,
+                icalcomponent_get_summary (c)));
+    src->alarm->description = g_strdup (
+            orage_process_text_commands_cached (src->alarm->uid,
+                icalcomponent_get_description (c)));
+    for (ci = icalcomponent_begin_component(c, ICAL_VALARM_COMPONENT);
+            icalcompiter_deref(&ci) != 0;
+            icalcompiter_next(&ci)) {
+        process_alarm_data(icalcompiter_deref(&ci), src->alarm);
+    }
+
+    first_alarm = orage_alarm_copy(src->alarm);
+    first_alarm->alarm_time = g_date_time_ref(new_alarm->alarm_time);
+    first_alarm->action_time = g_strdup(new_alarm->action_time);
+    orage_alarm_unref(new_alarm);
+    src->last = g_date_time_ref(first_alarm->alarm_time);
+    alarm_add(first_alarm);
+
+    g_hash_table_replace(alarm_sources
+            , alarm_source_key(src->alarm->uid, src->alarm->recurrence_id)
+            , src);
+
+    return(1 + alarm_source_fill(src, horizon_end));
+}
+
 static void xfical_alarm_build_list_internal_real(gboolean first_list_today
-        , icalcomponent *base, char *file_type, char *file_name)
+        , icalcomponent *base, char *file_type, char *file_name
+        , GDateTime *horizon_end)
 {
-    icalcomponent *c, *ca;
+    icalcomponent *c;
     struct icaltimetype cur_time;
-    char *suid;
-    gboolean trg_processed = FALSE, trg_active = FALSE;
     gint cnt_alarm=0, cnt_repeat=0, cnt_event=0, cnt_act_alarm=0
-        , cnt_alarm_add=0;
+        , cnt_alarm_add=0, cnt_comp_alarm, cnt_added;
     icalcompiter ci;
-    alarm_struct *new_alarm = NULL;
 
     cur_time = icaltime_current_time_with_zone(utc_icaltimezone);
 
@@ -2981,35 +3542,21 @@ static void xfical_alarm_build_list_internal_real(gboolean first_list_today
             c != 0;
             c = icalcomponent_get_next_component(base, ICAL_ANY_COMPONENT)) {
         cnt_event++;
-        trg_processed = FALSE;
-        trg_active = FALSE;
+        cnt_comp_alarm = 0;
         for (ci = icalcomponent_begin_component(c, ICAL_VALARM_COMPONENT);
                 icalcompiter_deref(&ci) != 0;
                 icalcompiter_next(&ci)) {
-            ca = icalcompiter_deref(&ci);
-            cnt_alarm++;
-            if (!trg_processed) {
-                trg_processed = TRUE;
-                new_alarm = process_alarm_trigger(c, ca, cur_time, &cnt_repeat);
-                if (new_alarm) {
-                    trg_active = TRUE;
-                    suid = (char *)icalcomponent_get_uid(c);
-                    new_alarm->uid = g_strconcat(file_type, suid, NULL);
-                    new_alarm->title = orage_process_text_commands(
-                            (char *)icalcomponent_get_summary(c));
-                    new_alarm->description = orage_process_text_commands(
-                            (char *)icalcomponent_get_description(c));
-                }
-            }
-            if (trg_active) {
-                cnt_act_alarm++;
-                process_alarm_data(ca, new_alarm);
-            }
+            cnt_comp_alarm++;
+        }
+        if (cnt_comp_alarm == 0)
+            continue;
 
-        }  /* ALARM */
-        if (trg_active) {
-            alarm_add(new_alarm);
-            cnt_alarm_add++;
+        cnt_alarm += cnt_comp_alarm;
+        cnt_added = alarm_horizon_fill(c, file_type, cur_time, horizon_end
+                , &cnt_repeat);
+        if (cnt_added) {
+            cnt_act_alarm += cnt_comp_alarm;
+            cnt_alarm_add += cnt_added;
         }
     }  /* COMPONENT */
     if (first_list_today) {
@@ -3028,25 +3575,36 @@ static void xfical_alarm_build_list_internal_real(gboolean first_list_today
     }
 }
 
-static void xfical_alarm_build_list_internal(gboolean first_list_today)
+void xfical_alarm_build_list_internal(gboolean first_list_today)
 {
     OrageApplication *app;
+    GDateTime *horizon_end;
     gchar file_type[8];
     gint i;
+    ORAGE_TRACE_SCOPE("alarm build");
 
     /* first remove all old alarms by cleaning the whole structure */
     alarm_list_free();
+    if (alarm_sources == NULL)
+        alarm_sources = g_hash_table_new_full(g_str_hash, g_str_equal
+                , g_free, alarm_source_free);
+    else
+        g_hash_table_remove_all(alarm_sources);
+
+    horizon_end = alarm_horizon_end();
 
     /* first search base orage file */
     g_strlcpy (file_type, "O00.", sizeof (file_type));
     xfical_alarm_build_list_internal_real(first_list_today, ic_ical, file_type
-            , NULL);
+            , NULL, horizon_end);
     /* then process all foreign files */
     for (i = 0; i < g_par.foreign_count; i++) {
         g_snprintf(file_type, sizeof (file_type), "F%02d.", i);
         xfical_alarm_build_list_internal_real(first_list_today
-                , ic_f_ical[i].ical, file_type, g_par.foreign_data[i].name);
+                , ic_f_ical[i].ical, file_type, g_par.foreign_data[i].name
+                , horizon_end);
     }
+    g_date_time_unref(horizon_end);
     setup_orage_alarm_clock(); /* keep reminders upto date */
 
     /* Refresh main calendar window lists. */
@@ -3063,9 +3621,66 @@ void xfical_alarm_build_list(gboolean first_list_today)
     }
 }
 
+void xfical_alarm_horizon_slide(void)
+{
+    GHashTableIter iter;
+    gpointer value;
+    alarm_source *src;
+    GDateTime *horizon_end;
+
+    if (alarm_sources == NULL) {
+        xfical_alarm_build_list(FALSE);
+        return;
+    }
+
+    horizon_end = alarm_horizon_end();
+    g_hash_table_iter_init(&iter, alarm_sources);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        src = (alarm_source *)value;
+        if (alarm_source_fill(src, horizon_end) == 0
+        && src->ri == NULL && src->rdate_l == NULL
+        && g_date_time_compare(src->last, horizon_end) <= 0)
+            g_hash_table_iter_remove(&iter); /* no more alarms */
+    }
+    g_date_time_unref(horizon_end);
+
+    setup_orage_alarm_clock();
+}
+
+void xfical_alarm_fired(GList *fired)
+{
+    GDateTime *horizon_end;
+    alarm_source *src;
+    alarm_struct *l_alarm;
+    GList *alarm_l;
+    gchar *key;
+
+    if (alarm_sources == NULL) {
+        xfical_alarm_build_list(FALSE);
+        return;
+    }
+
+    /* Next alarms of the components are normally in the list already.
+     * Only components, which fired their last known alarm, need more. */
+    horizon_end = alarm_horizon_end();
+    for (alarm_l = fired; alarm_l != NULL; alarm_l = g_list_next(alarm_l)) {
+        l_alarm = (alarm_struct *)alarm_l->data;
+        if (l_alarm->temporary || l_alarm->uid == NULL)
+            continue;
+        key = alarm_source_key(l_alarm->uid, l_alarm->recurrence_id);
+        src = g_hash_table_lookup(alarm_sources, key);
+        g_free(key);
+        if (src && g_date_time_compare(src->last, l_alarm->alarm_time) <= 0)
+            (void)alarm_source_fill(src, horizon_end);
+    }
+    g_date_time_unref(horizon_end);
+
+    setup_orage_alarm_clock();
+}
+
  /* Read next EVENT/TODO/JOURNAL component on the specified date from 
   * ical datafile.
-  * a_day:  start date of ical component which is to be read
+  * asdate: start date of ical component which is to be read
   * first:  get first appointment if TRUE, if not get next.
   * days:   how many more days to check forward. 0 = only one day
   * type:   EVENT/TODO/JOURNAL to be read
@@ -3074,11 +3689,12 @@ void xfical_alarm_build_list(gboolean first_list_today)
   *          You need to deallocate it after used.
   * Note:   starttimecur and endtimecur are converted to local timezone
   */
-static xfical_appt *xfical_appt_get_next_on_day_internal (const gchar *a_day
+static xfical_appt *xfical_appt_get_next_on_day_internal (
+        struct icaltimetype asdate
         , gboolean first, gint days, xfical_type type, icalcomponent *base
         , gchar *file_type)
 {
-    struct icaltimetype asdate, aedate    /* period to check */
+    struct icaltimetype aedate    /* period to check */
             , nsdate, nedate;   /* repeating event occurrency start and end */
     xfical_period per; /* event start and end times with duration */
     icalcomponent *c=NULL;
@@ -3095,11 +3711,8 @@ static xfical_appt *xfical_appt_get_next_on_day_internal (const gchar *a_day
 #endif
     icalrecur_iterator* ri;
     icalcomponent_kind ikind = ICAL_VEVENT_COMPONENT;
-    const gchar *start_str;
-    const gchar *end_str;
 
     /* setup period to test */
-    asdate = icaltime_from_string(a_day);
     aedate = asdate;
     if (days)
         icaltime_adjust(&aedate, days, 0, 0, 0);
@@ -3181,19 +3794,15 @@ static xfical_appt *xfical_appt_get_next_on_day_internal (const gchar *a_day
             return(0);
         }
         appt = appt_get_any(uid, base, file_type);
-        if (recurrent_date_found) {
-            start_str = icaltime_as_ical_string (nsdate);
-            end_str = icaltime_as_ical_string(nedate);
-        }
-        else {
-            start_str = icaltime_as_ical_string (per.stime);
-            end_str = icaltime_as_ical_string (per.etime);
+        if (!recurrent_date_found) {
+            nsdate = per.stime;
+            nedate = per.etime;
         }
 
         orage_gdatetime_unref (appt->starttimecur);
-        appt->starttimecur = orage_icaltime_to_gdatetime (start_str);
+        appt->starttimecur = orage_icaltimetype_to_gdatetime2 (nsdate);
         orage_gdatetime_unref (appt->endtimecur);
-        appt->endtimecur = orage_icaltime_to_gdatetime (end_str);
+        appt->endtimecur = orage_icaltimetype_to_gdatetime2 (nedate);
 
         return(appt);
     }
@@ -3201,25 +3810,95 @@ static xfical_appt *xfical_appt_get_next_on_day_internal (const gchar *a_day
         return(0);
 }
 
-xfical_appt *xfical_appt_get_next_on_day (GDateTime *gdt, gboolean first,
+static void shard_base_collect (icalcomponent *base, gpointer user_data)
+{
+    g_ptr_array_add((GPtrArray *)user_data, base);
+}
+
+/* Main calendar and then its year shards. Events, which ended before the
+ * year of the day, are in older shards and can not be on the day. */
+static xfical_appt *main_get_next_on_day (struct icaltimetype a_day
+        , gboolean first, gint days, xfical_type type, gchar *file_type)
+{
+    static GPtrArray *bases = NULL;
+    static guint base_n;
+    xfical_appt *appt;
+
+    if (first) {
+        if (bases == NULL)
+            bases = g_ptr_array_new();
+        else
+            g_ptr_array_set_size(bases, 0);
+        g_ptr_array_add(bases, ic_ical);
+        /* shards contain only events */
+        if (type == XFICAL_TYPE_EVENT)
+            ic_shards_foreach(a_day.year, shard_base_collect, bases);
+        base_n = 0;
+    }
+    while (bases && base_n < bases->len) {
+        appt = xfical_appt_get_next_on_day_internal (a_day, first, days, type,
+                g_ptr_array_index(bases, base_n), file_type);
+        if (appt)
+            return(appt);
+        base_n++;
+        first = TRUE;
+    }
+
+    return(NULL);
+}
+
+#ifdef HAVE_ARCHIVE
+/* Archive segments are gone through one after another, skipping those
+ * which have nothing in the period. */
+static xfical_appt *archive_get_next_on_day (struct icaltimetype a_day
+        , gboolean first, gint days, xfical_type type, gchar *file_type)
+{
+    static guint segment_n;
+    static icalcomponent *base;
+    struct icaltimetype first_day, last_day;
+    xfical_appt *appt;
+
+    first_day = a_day;
+    icaltime_adjust(&first_day, -1, 0, 0, 0);
+    last_day = a_day;
+    icaltime_adjust(&last_day, days + 1, 0, 0, 0);
+    if (first) {
+        segment_n = 0;
+        base = ic_archive_next_in_range(&segment_n
+                , IC_ARCHIVE_DAY(first_day), IC_ARCHIVE_DAY(last_day));
+    }
+    while (base) {
+        appt = xfical_appt_get_next_on_day_internal (a_day, first, days, type,
+                                                     base, file_type);
+        if (appt)
+            return(appt);
+        segment_n++;
+        base = ic_archive_next_in_range(&segment_n
+                , IC_ARCHIVE_DAY(first_day), IC_ARCHIVE_DAY(last_day));
+        first = TRUE;
+    }
+
+    return(NULL);
+}
+#endif
+
+xfical_appt *xfical_appt_get_next_on_day (GDateTime *gdt, gboolean first,
                                           gint days, xfical_type type,
                                           gchar *file_type)
 {
     gint i;
-    gchar *a_day;
+    struct icaltimetype a_day;
     xfical_appt *appt;
 
-    a_day = orage_gdatetime_to_icaltime (gdt, TRUE);
+    a_day = orage_gdatetime_to_icaltimetype (gdt, TRUE);
 
     /* FIXME: old code called, replace with xfical_get_each_app_within_time. */
     if (file_type[0] == 'O') {
-        appt = xfical_appt_get_next_on_day_internal (a_day, first, days, type,
-                                                     ic_ical, file_type);
+        appt = main_get_next_on_day (a_day, first, days, type, file_type);
     }
 #ifdef HAVE_ARCHIVE
     else if (file_type[0] == 'A') {
-        appt = xfical_appt_get_next_on_day_internal (a_day, first, days, type,
-                                                     ic_aical, file_type);
+        appt = archive_get_next_on_day (a_day, first, days, type, file_type);
     }
 #endif
     else if (file_type[0] == 'F') {
@@ -3240,12 +3919,10 @@ xfical_appt *xfical_appt_get_next_on_day (GDateTime *gdt, gboolean first,
         appt = NULL;
     }
 
-    g_free (a_day);
-
     return appt;
 }
 
-static gboolean xfical_mark_calendar_days(GtkCalendar *gtkcal
+static gboolean xfical_mark_calendar_days(guint32 *mask
         , int cur_year, int cur_month
         , int s_year, int s_month, int s_day
         , int e_year, int e_month, int e_day)
@@ -3273,13 +3950,23 @@ static gboolean xfical_mark_calendar_days(GtkCalendar *gtkcal
             end_day = monthdays[cur_month-1]; /* monthdays is 0...11 */
         }
         for (day_cnt = start_day; day_cnt <= end_day; day_cnt++) {
-            gtk_calendar_mark_day(gtkcal, day_cnt);
+            *mask |= 1U << (day_cnt - 1);
             marked = TRUE;
         }
     }
     return(marked);
 }
 
+static void month_marks_apply (GtkCalendar *gtkcal, guint32 mask)
+{
+    guint day;
+
+    for (day = 1; mask != 0; day++, mask >>= 1) {
+        if (mask & 1)
+            gtk_calendar_mark_day(gtkcal, day);
+    }
+}
+
 /* note that this not understand timezones, but gets always raw time,
  * which we need to convert to correct timezone */
 static void mark_calendar (G_GNUC_UNUSED icalcomponent *c,
@@ -3292,39 +3979,12 @@ static void mark_calendar (G_GNUC_UNUSED icalcomponent *c,
 {
     struct icaltimetype sdate, edate;
     mark_calendar_data *cal_data;
-    GDateTime *gdt_start;
-    GDateTime *gdt_end;
-    GDateTime *gdt_tmp;
+    guint i, year, month;
 
-    /*FIXME: find times from the span */
     cal_data = (mark_calendar_data *)data;
 
-    gdt_start = g_date_time_new_from_unix_utc (span->start);
-    gdt_end = g_date_time_new_from_unix_utc (span->end);
-
-    /* check bug 7886 explanation in function add_appt_to_list */
-    if (cal_data->appt.allDay && !cal_data->appt.use_duration) {
-        gdt_tmp = gdt_end;
-        gdt_end = g_date_time_add_days (gdt_tmp, -1);
-        g_date_time_unref (gdt_tmp);
-    }
-
-    sdate = orage_gdatetime_to_icaltimetype (gdt_start, FALSE);
-    edate = orage_gdatetime_to_icaltimetype (gdt_end, FALSE);
-
-    if (cal_data->appt.freq != XFICAL_FREQ_HOURLY
-    &&  g_date_time_get_hour (gdt_start) != cal_data->orig_start_hour) {
-        /* WHEN we arrive here, libical has done an extra UTC conversion,
-          which we need to undo */
-        sdate = convert_to_zone(sdate, "UTC");
-        edate = convert_to_zone(edate, "UTC");
-    }
-    else {
-        sdate = convert_to_zone(sdate, cal_data->appt.start_tz_loc);
-        edate = convert_to_zone(edate, cal_data->appt.end_tz_loc);
-    }
-    g_date_time_unref (gdt_start);
-    g_date_time_unref (gdt_end);
+    span_to_icaltime (&cal_data->appt, cal_data->orig_start_hour
+            , span->start, span->end, &sdate, &edate);
     sdate = icaltime_convert_to_zone(sdate, local_icaltimezone);
     edate = icaltime_convert_to_zone(edate, local_icaltimezone);
 
@@ -3332,10 +3992,13 @@ static void mark_calendar (G_GNUC_UNUSED icalcomponent *c,
        Only has effect when end date is midnight */
     icaltime_adjust(&edate, 0, 0, 0, -1);
 
-    (void)xfical_mark_calendar_days (cal_data->cal, cal_data->year,
-                                     cal_data->month, sdate.year, sdate.month,
-                                     sdate.day, edate.year, edate.month,
-                                     edate.day);
+    for (i = 0, year = cal_data->year, month = cal_data->month;
+         i < cal_data->n_months;
+         i++, month = (month % 12) + 1, year += (month == 1)) {
+        (void)xfical_mark_calendar_days (&cal_data->mask[i], year, month,
+                                         sdate.year, sdate.month, sdate.day,
+                                         edate.year, edate.month, edate.day);
+    }
 }
 
 /* Note that this not understand timezones, but gets always raw time, which we
@@ -3348,70 +4011,12 @@ static void mark_calendar2 (icalcomponent *c, icaltime_span *span, void *data)
 #endif
 {
     OrageEvent *event;
-    struct icaltimetype sdate, edate;
     mark_calendar_data2 *cal_data;
     GDateTime *gdt_start;
     GDateTime *gdt_end;
-    GDateTime *gdt_tmp;
 
     cal_data = (mark_calendar_data2 *)data;
 
-    gdt_start = g_date_time_new_from_unix_utc (span->start);
-    gdt_end = g_date_time_new_from_unix_utc (span->end);
-
-    /* check bug 7886 explanation in function add_appt_to_list */
-    if (cal_data->appt.allDay && cal_data->appt.use_duration == FALSE)
-    {
-        gdt_tmp = gdt_end;
-        gdt_end = g_date_time_add_days (gdt_tmp, -1);
-        g_date_time_unref (gdt_tmp);
-    }
-
-    sdate = orage_gdatetime_to_icaltimetype (gdt_start, FALSE);
-    edate = orage_gdatetime_to_icaltimetype (gdt_end, FALSE);
-
-    if ((cal_data->appt.freq != XFICAL_FREQ_HOURLY) &&
-        (g_date_time_get_hour (gdt_start) != cal_data->orig_start_hour))
-    {
-        /* WHEN we arrive here, libical has done an extra UTC conversion, which
-         * we need to undo.
-         */
-        sdate = convert_to_zone (sdate, "UTC");
-        edate = convert_to_zone (edate, "UTC");
-    }
-    else
-    {
-        sdate = convert_to_zone (sdate, cal_data->appt.start_tz_loc);
-        edate = convert_to_zone (edate, cal_data->appt.end_tz_loc);
-    }
-
-    g_date_time_unref (gdt_start);
-    g_date_time_unref (gdt_end);
-    sdate = icaltime_convert_to_zone (sdate, local_icaltimezone);
-    edate = icaltime_convert_to_zone (edate, local_icaltimezone);
-
-    /* fix for bug 8508 prevent showing extra day in calendar. Only has effect
-     * when end date is midnight.
-     */
-    icaltime_adjust (&edate, 0, 0, 0, -1);
-
-    gdt_start = g_date_time_new_local (sdate.year, sdate.month, sdate.day, 0, 0, 0);
-    gdt_end = g_date_time_new_local (edate.year, edate.month, edate.day, 0, 0, 0);
-
-    if (g_date_time_compare (cal_data->gdt_first, gdt_start) > 0)
-    {
-        g_date_time_unref (gdt_start);
-        gdt_start = g_date_time_ref (cal_data->gdt_first);
-    }
-
-    if (g_date_time_compare (gdt_end, cal_data->gdt_last) > 0)
-    {
-        g_date_time_unref (gdt_end);
-        gdt_end = g_date_time_ref (cal_data->gdt_last);
-    }
-
-    g_date_time_unref (gdt_start);
-    g_date_time_unref (gdt_end);
     gdt_start = orage_time_t_to_gdatetime (span->start, cal_data->appt.start_tz_loc);
     gdt_end = orage_time_t_to_gdatetime (span->end, cal_data->appt.end_tz_loc);
 
@@ -3431,7 +4036,7 @@ static void mark_calendar2 (icalcomponent *c, icaltime_span *span, void *data)
   * year: Year to be searched
   * month: Month to be searched
   */
-static void xfical_mark_calendar_from_component (GtkCalendar *gtkcal,
+static void xfical_mark_calendar_from_component (guint32 *mask,
                                                  icalcomponent *c,
                                                  guint year,
                                                  guint month)
@@ -3471,9 +4076,10 @@ static void xfical_mark_calendar_from_component (GtkCalendar *gtkcal,
         p = icalcomponent_get_first_property(c, ICAL_DTSTART_PROPERTY);
         start = icalproperty_get_dtstart(p);
         if (start.year >= 1970) {
-            cal_data.cal = gtkcal;
+            cal_data.mask = mask;
             cal_data.year = year;
             cal_data.month = month;
+            cal_data.n_months = 1;
             (void)get_appt_from_icalcomponent(c, &cal_data.appt);
         /* BUG 7929. If calendar file contains same timezone definition than
            what the time is in, libical returns wrong time in span.
@@ -3493,7 +4099,7 @@ static void xfical_mark_calendar_from_component (GtkCalendar *gtkcal,
         }
         else {
             per = ic_get_period(c, TRUE);
-            (void)xfical_mark_calendar_days (gtkcal, year, month,
+            (void)xfical_mark_calendar_days (mask, year, month,
                                              per.stime.year, per.stime.month,
                                              per.stime.day, per.etime.year,
                                              per.etime.month, per.etime.day);
@@ -3510,7 +4116,7 @@ static void xfical_mark_calendar_from_component (GtkCalendar *gtkcal,
                         nedate = icaltime_add(nsdate, per.duration)) {
                     if (!icalproperty_recurrence_is_excluded(c, &per.stime
                                 , &nsdate))
-                        (void)xfical_mark_calendar_days (gtkcal, year, month,
+                        (void)xfical_mark_calendar_days (mask, year, month,
                                                          nsdate.year,
                                                          nsdate.month,
                                                          nsdate.day,
@@ -3529,7 +4135,7 @@ static void xfical_mark_calendar_from_component (GtkCalendar *gtkcal,
         || (local_compare(per.ctime, per.stime) < 0)) {
             /* VTODO needs to be checked either if it never completed 
              * or it has completed before start */
-            marked = xfical_mark_calendar_days(gtkcal, year, month
+            marked = xfical_mark_calendar_days(mask, year, month
                     , per.etime.year, per.etime.month, per.etime.day
                     , per.etime.year, per.etime.month, per.etime.day);
         }
@@ -3553,7 +4159,7 @@ static void xfical_mark_calendar_from_component (GtkCalendar *gtkcal,
             icalrecur_iterator_free(ri);
             if (!icaltime_is_null_time(nsdate)) {
                 nedate = icaltime_add(nsdate, per.duration);
-                (void)xfical_mark_calendar_days (gtkcal, year, month,
+                (void)xfical_mark_calendar_days (mask, year, month,
                                                  nedate.year, nedate.month,
                                                  nedate.day, nedate.year,
                                                  nedate.month, nedate.day);
@@ -3601,7 +4207,6 @@ static void xfical_get_event_from_component (icalcomponent *c,
     icalrecur_iterator *ri;
     icalproperty *p;
     icalcomponent_kind kind;
-    struct icaltimetype start;
     mark_calendar_data2 cal_data;
 
     /* Note that all VEVENTS are marked, but only the first VTODO end date is
@@ -3610,21 +4215,9 @@ static void xfical_get_event_from_component (icalcomponent *c,
     kind = icalcomponent_isa (c);
     if (kind == ICAL_VEVENT_COMPONENT)
     {
-        p = icalcomponent_get_first_property (c, ICAL_DTSTART_PROPERTY);
-        start = icalproperty_get_dtstart (p);
         cal_data.cb = cb;
         cal_data.cb_param = param;
-        cal_data.gdt_first = g_date_time_ref (gdt_span_start);
-        cal_data.gdt_last = g_date_time_ref (gdt_span_end);
         (void)get_appt_from_icalcomponent (c, &cal_data.appt);
-        /* BUG 7929. If calendar file contains same timezone definition than
-         * what the time is in, libical returns wrong time in span. But as
-         * the hour only changes with HOURLY repeating appointments, we can
-         * replace received hour with the hour from start time.
-         */
-        p = icalcomponent_get_first_property (c, ICAL_DTSTART_PROPERTY);
-        start = icalproperty_get_dtstart (p);
-        cal_data.orig_start_hour = start.hour;
         nsdate = orage_gdatetime_to_icaltimetype (gdt_span_start, FALSE);
         nedate = orage_gdatetime_to_icaltimetype (gdt_span_end, FALSE);
         icalcomponent_foreach_recurrence (c, nsdate, nedate, mark_calendar2,
@@ -3634,10 +4227,6 @@ static void xfical_get_event_from_component (icalcomponent *c,
         cal_data.appt.starttime = NULL;
         orage_gdatetime_unref (cal_data.appt.endtime);
         cal_data.appt.endtime = NULL;
-        orage_gdatetime_unref (cal_data.gdt_first);
-        cal_data.gdt_first = NULL;
-        orage_gdatetime_unref (cal_data.gdt_last);
-        cal_data.gdt_last = NULL;
     }
     else if (kind == ICAL_VTODO_COMPONENT)
     {
@@ -3695,14 +4284,64 @@ static void xfical_get_event_from_component (icalcomponent *c,
     }
 }
 
-void xfical_mark_calendar_recur(GtkCalendar *gtkcal, const xfical_appt *appt)
+/* Mark n_months consecutive months with one recurrence expansion. Only
+ * VEVENTs starting after 1970 can be expanded this way, others are marked
+ * month by month.
+ */
+static void xfical_mark_months_from_component (guint32 *masks,
+                                               icalcomponent *c,
+                                               guint year, guint month,
+                                               guint n_months)
+{
+    mark_calendar_data cal_data;
+    struct icaltimetype nsdate, nedate, start;
+    icalproperty *p;
+    guint i;
+
+    p = icalcomponent_get_first_property (c, ICAL_DTSTART_PROPERTY);
+    start = p ? icalproperty_get_dtstart (p) : icaltime_null_time ();
+
+    if (icalcomponent_isa (c) != ICAL_VEVENT_COMPONENT || start.year < 1970)
+    {
+        for (i = 0; i < n_months; i++, month = (month % 12) + 1,
+                                       year += (month == 1))
+        {
+            xfical_mark_calendar_from_component (&masks[i], c, year, month);
+        }
+
+        return;
+    }
+
+    nsdate = icaltime_null_time ();
+    nsdate.year = year;
+    nsdate.month = month;
+    nsdate.day = 1;
+    nedate = nsdate;
+    nedate.month += n_months;
+    nedate = icaltime_normalize (nedate);
+
+    cal_data.mask = masks;
+    cal_data.year = year;
+    cal_data.month = month;
+    cal_data.n_months = n_months;
+    cal_data.orig_start_hour = start.hour;
+    (void)get_appt_from_icalcomponent (c, &cal_data.appt);
+    icalcomponent_foreach_recurrence (c, nsdate, nedate, mark_calendar,
+                                      &cal_data);
+    g_free (cal_data.appt.categories);
+    orage_gdatetime_unref (cal_data.appt.starttime);
+    cal_data.appt.starttime = NULL;
+    orage_gdatetime_unref (cal_data.appt.endtime);
+    cal_data.appt.endtime = NULL;
+}
+
+void xfical_mark_recur_months (const xfical_appt *appt, guint year,
+                               guint month, guint n_months, guint32 *masks)
 {
-    guint year, month;
     icalcomponent_kind ikind = ICAL_VEVENT_COMPONENT;
     icalcomponent *icmp;
 
-    gtk_calendar_get_date(gtkcal, &year, &month, NULL);
-    gtk_calendar_clear_marks(gtkcal);
+    memset (masks, 0, n_months * sizeof (guint32));
     if (appt->type == XFICAL_TYPE_EVENT)
         ikind = ICAL_VEVENT_COMPONENT;
     else if (appt->type == XFICAL_TYPE_TODO)
@@ -3720,13 +4359,29 @@ void xfical_mark_calendar_recur(GtkCalendar *gtkcal, const xfical_appt *appt)
     appt_add_completedtime_internal(appt, icmp);
     appt_add_recur_internal(appt, icmp);
     appt_add_exception_internal(appt, icmp);
-    xfical_mark_calendar_from_component(gtkcal, icmp, year, month+1);
+    xfical_mark_months_from_component (masks, icmp, year, month, n_months);
     icalcomponent_free(icmp);
 }
 
+void xfical_mark_calendar_with_mask (GtkCalendar *gtkcal, const guint32 mask)
+{
+    gtk_calendar_clear_marks (gtkcal);
+    month_marks_apply (gtkcal, mask);
+}
+
+void xfical_mark_calendar_recur(GtkCalendar *gtkcal, const xfical_appt *appt)
+{
+    guint year, month;
+    guint32 mask;
+
+    gtk_calendar_get_date(gtkcal, &year, &month, NULL);
+    xfical_mark_recur_months (appt, year, month + 1, 1, &mask);
+    xfical_mark_calendar_with_mask (gtkcal, mask);
+}
+
  /* Get all appointments from the file and mark calendar for EVENTs and TODOs
   */
-static void xfical_mark_calendar_file (GtkCalendar *gtkcal, icalcomponent *base,
+static void xfical_mark_calendar_file (guint32 *mask, icalcomponent *base,
                                        guint year, guint month)
 {
     icalcomponent *c;
@@ -3734,10 +4389,128 @@ static void xfical_mark_calendar_file (GtkCalendar *gtkcal, icalcomponent *base,
     for (c = icalcomponent_get_first_component(base, ICAL_ANY_COMPONENT);
          c != 0;
          c = icalcomponent_get_next_component(base, ICAL_ANY_COMPONENT)) {
-        xfical_mark_calendar_from_component(gtkcal, c, year, month);
+        xfical_mark_calendar_from_component(mask, c, year, month);
     } 
 }
 
+/* Get marked days of calendar month from cache. Returns FALSE if the month
+ * of the calendar has not been marked yet. */
+static gboolean month_marks_lookup (guint cal, guint year, guint month
+        , guint32 *mask)
+{
+    gpointer value;
+
+    if (month_marks == NULL)
+        return FALSE;
+
+    value = g_hash_table_lookup(month_marks, MONTH_MARK_KEY(cal, year, month));
+    if (value == NULL)
+        return FALSE;
+
+    *mask |= GPOINTER_TO_UINT(value) & ~MONTH_MARK_VALID;
+    return TRUE;
+}
+
+/* Get marked days of all calendars, if they all are in the cache. */
+static gboolean month_marks_lookup_all (guint year, guint month
+        , guint32 *mask)
+{
+    gint i;
+
+    if (!month_marks_lookup(0, year, month, mask))
+        return FALSE;
+    for (i = 0; i < g_par.foreign_count; i++) {
+        if (!month_marks_lookup(i + 1, year, month, mask))
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+typedef struct _shard_mark_data
+{
+    guint32 *mask;
+    guint year;
+    guint month;
+} shard_mark_data;
+
+static void month_marks_from_shard (icalcomponent *base, gpointer user_data)
+{
+    shard_mark_data *data = user_data;
+
+    xfical_mark_calendar_file(data->mask, base, data->year, data->month);
+}
+
+/* Add marked days of calendar month to mask, marking the calendar file if
+ * it is not in the cache. Calendar files must be open. */
+static void month_marks_get (guint cal, icalcomponent *base
+        , guint year, guint month, guint32 *mask)
+{
+    guint32 cal_mask = 0;
+    shard_mark_data shard_data;
+
+    if (month_marks_lookup(cal, year, month, mask) || base == NULL)
+        return;
+
+    if (month_marks == NULL)
+        month_marks = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+    xfical_mark_calendar_file(&cal_mask, base, year, month);
+    if (cal == 0) {
+        /* events which ended before this month cannot be in it */
+        shard_data.mask = &cal_mask;
+        shard_data.year = year;
+        shard_data.month = month;
+        ic_shards_foreach(year, month_marks_from_shard, &shard_data);
+    }
+    g_hash_table_insert(month_marks, MONTH_MARK_KEY(cal, year, month)
+            , GUINT_TO_POINTER(cal_mask | MONTH_MARK_VALID));
+    *mask |= cal_mask;
+}
+
+/* Mark months before and after the shown month, so that they are ready
+ * when user flips the calendar. */
+static gboolean month_marks_prefetch (G_GNUC_UNUSED gpointer user_data)
+{
+    guint year, month, m;
+    guint32 mask;
+    gint i;
+
+    month_marks_prefetch_id = 0;
+    if (!xfical_file_open(TRUE))
+        return(FALSE);
+
+    for (m = month_marks_prefetch_month - 1;
+         m <= month_marks_prefetch_month + 1;
+         m += 2) {
+        year = m / 12;
+        month = m % 12 + 1;
+        mask = 0;
+        month_marks_get(0, ic_ical, year, month, &mask);
+        for (i = 0; i < g_par.foreign_count; i++) {
+            month_marks_get(i + 1, ic_f_ical[i].ical, year, month, &mask);
+        }
+    }
+    xfical_file_close(TRUE);
+
+    return(FALSE);
+}
+
+static void month_marks_prefetch_schedule (guint year, guint month)
+{
+    guint32 mask = 0;
+    guint m = year*12 + month - 1;
+
+    if (month_marks_lookup_all((m - 1) / 12, (m - 1) % 12 + 1, &mask)
+     && month_marks_lookup_all((m + 1) / 12, (m + 1) % 12 + 1, &mask))
+        return; /* both are ready */
+
+    month_marks_prefetch_month = m;
+    if (month_marks_prefetch_id == 0)
+        month_marks_prefetch_id = g_idle_add_full(G_PRIORITY_LOW
+                , month_marks_prefetch, NULL, NULL);
+}
+
 static void xfical_list_events_from_component (icalcomponent *base,
                                                GDateTime *gdt_start,
                                                GDateTime *gdt_end,
@@ -3758,22 +4531,65 @@ void xfical_mark_calendar(GtkCalendar *gtkcal)
 {
     gint i;
     guint year, month, day;
+    guint32 mask = 0;
 
     gtk_calendar_get_date(gtkcal, &year, &month, &day);
-    gtk_calendar_clear_marks(gtkcal);
-    xfical_mark_calendar_file(gtkcal, ic_ical, year, month+1);
+    month_marks_get(0, ic_ical, year, month+1, &mask);
     for (i = 0; i < g_par.foreign_count; i++) {
-        xfical_mark_calendar_file(gtkcal, ic_f_ical[i].ical, year, month+1);
+        month_marks_get(i + 1, ic_f_ical[i].ical, year, month+1, &mask);
     }
+    gtk_calendar_clear_marks(gtkcal);
+    month_marks_apply(gtkcal, mask);
+    month_marks_prefetch_schedule(year, month+1);
+}
+
+gboolean xfical_mark_calendar_from_cache(GtkCalendar *gtkcal)
+{
+    guint year, month, day;
+    guint32 mask = 0;
+
+    gtk_calendar_get_date(gtkcal, &year, &month, &day);
+    if (!month_marks_lookup_all(year, month+1, &mask))
+        return(FALSE);
+    gtk_calendar_clear_marks(gtkcal);
+    month_marks_apply(gtkcal, mask);
+    month_marks_prefetch_schedule(year, month+1);
+
+    return(TRUE);
+}
+
+typedef struct _shard_list_data
+{
+    GDateTime *gdt_start;
+    GDateTime *gdt_end;
+    xfical_event_callback cb;
+    void *param;
+} shard_list_data;
+
+static void xfical_list_events_from_shard (icalcomponent *base,
+                                           gpointer user_data)
+{
+    shard_list_data *data = user_data;
+
+    xfical_list_events_from_component (base, data->gdt_start, data->gdt_end,
+                                       data->cb, data->param);
 }
 
 void xfical_list_events_in_range (GDateTime *gdt_start, GDateTime *gdt_end,
                                   xfical_event_callback cb, void *param)
 {
+    shard_list_data shard_data;
     gint i;
 
     xfical_list_events_from_component (ic_ical, gdt_start, gdt_end, cb, param);
 
+    shard_data.gdt_start = gdt_start;
+    shard_data.gdt_end = gdt_end;
+    shard_data.cb = cb;
+    shard_data.param = param;
+    ic_shards_foreach (g_date_time_get_year (gdt_start),
+                       xfical_list_events_from_shard, &shard_data);
+
     for (i = 0; i < g_par.foreign_count; i++)
     {
         xfical_list_events_from_component (ic_f_ical[i].ical,
@@ -3791,91 +4607,67 @@ static void add_appt_to_list(icalcomponent *c, icaltime_span *span , void *data)
 #endif
 {
     xfical_appt *appt;
+    xfical_occurrence *occurrence;
     struct icaltimetype sdate, edate;
-    struct tm end_tm;
     GDateTime *gdt_start;
     GDateTime *gdt_end;
-    GDateTime *gdt_tmp;
-    const gchar *i18_time;
     app_data *data1;
-        /* Need to check that returned value is withing limits.
-           Check more from BUG 5764 and 7886. */
 
     data1 = (app_data *)data;
-    appt = g_new0(xfical_appt, 1);
-    /* FIXME: we could check if UID is the same and only get all data
-     * when UID changes. This seems to be fast enough as it is though */
-    (void)get_appt_from_icalcomponent(c, appt);
-    xfical_appt_get_fill_internal(appt, data1->file_type);
-    gmtime_r(&span->end, &end_tm);
-    gdt_start = g_date_time_new_from_unix_utc (span->start);
-    gdt_end = g_date_time_new_from_unix_utc (span->end);
-
-    /* BUG 7886. we are called with wrong span->end when we have full day
-       event. This is libical bug and needs to be fixed properly later, but
-       now I just work around it.
-    FIXME: code whole loop correctly = function icalcomponent_foreach_recurrence
-    */
-    if (appt->allDay && !appt->use_duration) {
-        gdt_tmp = gdt_end;
-        gdt_end = g_date_time_add_days (gdt_tmp, -1);
-        g_date_time_unref (gdt_tmp);
-        /* now end is correct, but we still have been called wrongly on
-           the last day */
+    if (data1->appt == NULL) {
+        /* component is read only once, all its occurrences share it */
+        appt = g_new0(xfical_appt, 1);
+        (void)get_appt_from_icalcomponent(c, appt);
+        xfical_appt_get_fill_internal(appt, data1->file_type);
+        data1->appt = appt;
+        data1->appt_used = FALSE;
     }
-
-    /* end of bug workaround */
-    /* FIXME: should we use interval instead ? */
-    sdate = orage_gdatetime_to_icaltimetype (gdt_start, FALSE);
-    edate = orage_gdatetime_to_icaltimetype (gdt_end, FALSE);
-
-    /* BUG 7929. If calendar file contains same timezone definition than what
-       the time is in, libical returns wrong time in span. But as the hour
-       only changes with HOURLY repeating appointments, we can replace received
-       hour with the hour from start time */
-    if (appt->freq != XFICAL_FREQ_HOURLY
-    &&  g_date_time_get_hour (gdt_start) != data1->orig_start_hour) {
-        /* WHEN we arrive here, libical has done an extra UTC conversion,
-           which we need to undo */
-        sdate = convert_to_zone(sdate, "UTC");
-        edate = convert_to_zone(edate, "UTC");
-    }
-    else {
-        sdate = convert_to_zone(sdate, appt->start_tz_loc);
-        edate = convert_to_zone(edate, appt->end_tz_loc);
-    }
-
-    g_date_time_unref (gdt_start);
-    g_date_time_unref (gdt_end);
-
-    sdate = icaltime_convert_to_zone(sdate, local_icaltimezone);
-    edate = icaltime_convert_to_zone(edate, local_icaltimezone);
-
-    i18_time = icaltime_as_ical_string (sdate);
-    orage_gdatetime_unref (appt->starttimecur);
-    appt->starttimecur = orage_icaltime_to_gdatetime (i18_time);
-
-    i18_time = icaltime_as_ical_string (edate);
-    g_date_time_unref (appt->endtimecur);
-    appt->endtimecur = orage_icaltime_to_gdatetime (i18_time);
+    else
+        appt = data1->appt;
+
+    span_to_icaltime (appt, data1->orig_start_hour, span->start, span->end
+            , &sdate, &edate);
+    gdt_start = orage_icaltimetype_to_gdatetime_in_zone (sdate
+            , local_icaltimezone);
+    gdt_end = orage_icaltimetype_to_gdatetime_in_zone (edate
+            , local_icaltimezone);
         /* Need to check that returned value is withing limits.
            Check more from BUG 5764 and 7886. */
-    /* starttimecur and endtimecur are in local timezone. Compare that to
-       limits, which are also localtimezone DATEs */
-    if (g_date_time_compare (appt->endtimecur, data1->asdate) <= 0
-     || g_date_time_compare (appt->starttimecur, data1->aedate) >= 0) {
-        /* we do not need this. Free the memory */
-        xfical_appt_free(appt);
+    /* start and end are in local timezone. Compare that to limits, which are
+       also localtimezone DATEs */
+    if (g_date_time_compare (gdt_end, data1->asdate) <= 0
+     || g_date_time_compare (gdt_start, data1->aedate) >= 0) {
+        /* we do not need this occurrence */
+        g_date_time_unref (gdt_start);
+        g_date_time_unref (gdt_end);
     }
     else {/* add to list like with internal libical */
-        *data1->list = g_list_prepend(*data1->list, appt);
+        occurrence = g_new (xfical_occurrence, 1);
+        occurrence->start = gdt_start;
+        occurrence->end = gdt_end;
+        occurrence->appt = appt;
+        occurrence->flags = data1->appt_used ? XFICAL_OCCURRENCE_NONE
+                                             : XFICAL_OCCURRENCE_OWNS_APPT;
+        data1->appt_used = TRUE;
+        *data1->list = g_list_prepend(*data1->list, occurrence);
     }
 }
 
+/* Release appointment of the previous component unless some occurrence
+ * took the ownership of it */
+static void app_data_reset_appt (app_data *data1)
+{
+    if (data1->appt && !data1->appt_used)
+        xfical_appt_free (data1->appt);
+
+    data1->appt = NULL;
+    data1->appt_used = FALSE;
+}
+
 /* Fetch each appointment within the specified time period and add those
- * to the data GList. Note that each repeating appointment is real full 
- * appt */
-static void xfical_get_each_app_within_time_internal (const gchar *a_day,
+ * to the data GList as xfical_occurrence. Each calendar component is read
+ * only once and the result is shared between all of its occurrences. */
+static void xfical_get_each_app_within_time_internal (GDateTime *a_day,
                                                       gint days,
                                                       xfical_type type,
                                                       icalcomponent *base,
@@ -3891,7 +4683,7 @@ static void xfical_get_each_app_within_time_internal (const gchar *a_day,
     app_data data1;
 
     /* setup period to test */
-    asdate = icaltime_from_string(a_day);
+    asdate = orage_gdatetime_to_icaltimetype (a_day, TRUE);
     aedate = asdate;
     icaltime_adjust(&aedate, days, 0, 0, 0);
 
@@ -3906,9 +4698,11 @@ static void xfical_get_each_app_within_time_internal (const gchar *a_day,
 
     data1.list = data;
     data1.file_type = file_type;
+    data1.appt = NULL;
+    data1.appt_used = FALSE;
         /* Need to check that returned value is withing limits.
            Check more from BUG 5764 and 7886. */
-    data1.asdate = orage_icaltime_to_gdatetime (a_day);
+    data1.asdate = orage_icaltimetype_to_gdatetime2 (asdate);
     data1.aedate = orage_icaltimetype_to_gdatetime2 (aedate);
     /* Hack for bug 8382: Take one more day earlier and later than needed
        due to UTC conversion. (And drop those days later then.) */
@@ -3941,25 +4735,51 @@ static void xfical_get_each_app_within_time_internal (const gchar *a_day,
             icalproperty_set_dtstart(p, start);
             icalcomponent_foreach_recurrence(c2, asdate, aedate
                     , add_appt_to_list, (void *)&data1);
+            icalcomponent_free(c2);
         }
         /* FIXME: end of hack */
         else {
             icalcomponent_foreach_recurrence(c, asdate, aedate
                     , add_appt_to_list, (void *)&data1);
         }
+        app_data_reset_appt (&data1);
     }
 
     g_date_time_unref (data1.asdate);
     g_date_time_unref (data1.aedate);
 }
 
+typedef struct _base_app_data
+{
+    GDateTime *a_day;
+    gint days;
+    xfical_type type;
+    const gchar *file_type;
+    GList **data;
+} base_app_data;
+
+static void xfical_get_each_app_from_base (icalcomponent *base,
+                                           gpointer user_data)
+{
+    base_app_data *base_data = user_data;
+
+    xfical_get_each_app_within_time_internal (base_data->a_day,
+                                              base_data->days,
+                                              base_data->type, base,
+                                              base_data->file_type,
+                                              base_data->data);
+}
+
 /* This will (probably) replace xfical_appt_get_next_on_day */
 void xfical_get_each_app_within_time (GDateTime *a_day, const gint days,
                                       xfical_type type, const gchar *file_type,
                                       GList **data)
 {
+    base_app_data base_data;
     gint i;
-    gchar *str;
+#ifdef HAVE_ARCHIVE
+    struct icaltimetype first_day, last_day;
+#endif
 
     if (file_type == NULL)
     {
@@ -3967,23 +4787,40 @@ void xfical_get_each_app_within_time (GDateTime *a_day, const gint days,
         return;
     }
 
-    str = orage_gdatetime_to_icaltime (a_day, TRUE);
-
     if (file_type[0] == 'O') {
-        xfical_get_each_app_within_time_internal(str
+        xfical_get_each_app_within_time_internal(a_day
                 , days, type, ic_ical, file_type, data);
+        if (type == XFICAL_TYPE_EVENT) {
+            base_data.a_day = a_day;
+            base_data.days = days;
+            base_data.type = type;
+            base_data.file_type = file_type;
+            base_data.data = data;
+            ic_shards_foreach(g_date_time_get_year(a_day)
+                    , xfical_get_each_app_from_base, &base_data);
+        }
     }
 #ifdef HAVE_ARCHIVE
     else if (file_type[0] == 'A') {
-        xfical_get_each_app_within_time_internal(str
-                , days, type, ic_aical, file_type, data);
+        base_data.a_day = a_day;
+        base_data.days = days;
+        base_data.type = type;
+        base_data.file_type = file_type;
+        base_data.data = data;
+        /* one day more on both sides like in the internal search */
+        first_day = orage_gdatetime_to_icaltimetype (a_day, TRUE);
+        icaltime_adjust(&first_day, -1, 0, 0, 0);
+        last_day = first_day;
+        icaltime_adjust(&last_day, days + 2, 0, 0, 0);
+        ic_archive_foreach(IC_ARCHIVE_DAY(first_day), IC_ARCHIVE_DAY(last_day)
+                , xfical_get_each_app_from_base, &base_data);
     }
 #endif
     else if (file_type[0] == 'F') {
         sscanf(file_type, "F%02d", &i);
         if (i < g_par.foreign_count && ic_f_ical[i].ical != NULL)
         {
-            xfical_get_each_app_within_time_internal (str, days, type,
+            xfical_get_each_app_within_time_internal (a_day, days, type,
                                                       ic_f_ical[i].ical,
                                                       file_type, data);
         }
@@ -3992,8 +4829,24 @@ void xfical_get_each_app_within_time (GDateTime *a_day, const gint days,
     }
     else
         g_warning ("unknown calendar file type '%s'", file_type);
+}
 
-    g_free (str);
+void xfical_occurrence_list_free (GList *list)
+{
+    GList *tmp;
+    xfical_occurrence *occurrence;
+
+    for (tmp = list; tmp != NULL; tmp = g_list_next (tmp))
+    {
+        occurrence = (xfical_occurrence *)tmp->data;
+        g_date_time_unref (occurrence->start);
+        g_date_time_unref (occurrence->end);
+        if (occurrence->flags & XFICAL_OCCURRENCE_OWNS_APPT)
+            xfical_appt_free ((xfical_appt *)occurrence->appt);
+        g_free (occurrence);
+    }
+
+    g_list_free (list);
 }
 
 /* let's find next VEVENT or VTODO or VJOURNAL BEGIN or END
@@ -4076,7 +4929,6 @@ static xfical_appt *xfical_appt_get_next_with_string_internal (
     xfical_appt *appt;
     gboolean found_valid, search_done = FALSE;
     struct icaltimetype it;
-    const char *stime;
 
     if (!ORAGE_STR_EXISTS(str))
         return(NULL);
@@ -4183,7 +5035,13 @@ static xfical_appt *xfical_appt_get_next_with_string_internal (
                         g_critical ("too long UID '%s'", ical_uid);
                         return(NULL);
                     }
-                    appt = appt_get_any(ical_uid, base, file_type);
+#ifdef HAVE_ARCHIVE
+                    /* archive segment is parsed only when it has a match */
+                    if (base == NULL)
+                        base = ic_archive_load_file(search_file);
+#endif
+                    appt = base ? appt_get_any(ical_uid, base, file_type)
+                                : NULL;
                     if (!appt) {
                         g_warning ("UID not found in iCal file '%s'", ical_uid);
                         search_done = TRUE;
@@ -4199,19 +5057,17 @@ static xfical_appt *xfical_appt_get_next_with_string_internal (
                             it = orage_gdatetime_to_icaltimetype (appt->starttime,
                                                                   appt->allDay);
                             it = convert_to_zone(it, appt->start_tz_loc);
-                            it = icaltime_convert_to_zone(it
-                                    , local_icaltimezone);
-                            stime = icaltime_as_ical_string(it);
                             orage_gdatetime_unref (appt->starttimecur);
-                            appt->starttimecur = orage_icaltime_to_gdatetime (stime);
+                            appt->starttimecur =
+                                    orage_icaltimetype_to_gdatetime_in_zone (it
+                                            , local_icaltimezone);
                             it = orage_gdatetime_to_icaltimetype (appt->endtime,
                                                                   appt->allDay);
                             it = convert_to_zone(it, appt->end_tz_loc);
-                            it = icaltime_convert_to_zone(it
-                                    , local_icaltimezone);
-                            stime = icaltime_as_ical_string(it);
                             orage_gdatetime_unref (appt->endtimecur);
-                            appt->endtimecur = orage_icaltime_to_gdatetime (stime);
+                            appt->endtimecur =
+                                    orage_icaltimetype_to_gdatetime_in_zone (it
+                                            , local_icaltimezone);
                         }
                         beg = find_next(uid, end, "\nEND:");
                         if (!beg) {
@@ -4236,20 +5092,74 @@ static xfical_appt *xfical_appt_get_next_with_string_internal (
     return(NULL);
 }
 
+#ifdef HAVE_ARCHIVE
+/* Text of each segment is searched, but only segments with a match are
+ * parsed. */
+static xfical_appt *archive_get_next_with_string (const gchar *str
+        , gboolean first, const gchar *file_type)
+{
+    static guint segment_n;
+    static gchar *path = NULL;
+    xfical_appt *appt;
+
+    if (first) {
+        segment_n = 0;
+        g_clear_pointer(&path, g_free);
+        path = ic_archive_get_path(segment_n);
+    }
+    while (path) {
+        appt = xfical_appt_get_next_with_string_internal(str, first
+                , path, NULL, file_type);
+        if (appt)
+            return(appt);
+        g_free(path);
+        path = ic_archive_get_path(++segment_n);
+        first = TRUE;
+    }
+
+    return(NULL);
+}
+#endif
+
 xfical_appt *xfical_appt_get_next_with_string (const gchar *str,
                                                const gboolean first,
                                                const gchar *file_type)
 {
+    static guint shard_n;
+    static gboolean in_shards = FALSE;
+    xfical_appt *appt;
+    icalcomponent *base;
+    gchar *path;
+    gboolean restart = first;
     gint i;
 
     if (file_type[0] == 'O') {
-        return(xfical_appt_get_next_with_string_internal(str, first
-                , g_par.orage_file , ic_ical, file_type));
+        if (first)
+            in_shards = FALSE;
+        if (!in_shards) {
+            appt = xfical_appt_get_next_with_string_internal(str, first
+                    , g_par.orage_file, ic_ical, file_type);
+            if (appt)
+                return(appt);
+            /* main file done, continue with year shards */
+            in_shards = TRUE;
+            shard_n = 0;
+            restart = TRUE;
+        }
+        while (ic_shards_get(shard_n, &path, &base)) {
+            appt = xfical_appt_get_next_with_string_internal(str, restart
+                    , path, base, file_type);
+            g_free(path);
+            if (appt)
+                return(appt);
+            shard_n++;
+            restart = TRUE;
+        }
+        return(NULL);
     }
 #ifdef HAVE_ARCHIVE
     else if (file_type[0] == 'A') {
-        return(xfical_appt_get_next_with_string_internal(str, first
-                , g_par.archive_file, ic_aical, file_type));
+        return(archive_get_next_with_string(str, first, file_type));
     }
 #endif
     else if (file_type[0] == 'F') {
@@ -4594,7 +5504,7 @@ GList *o_cal_component_list_from_file (GFile *file)
         {
             comp = o_cal_component_new_from_icalcomponent (subcomp);
             if (comp)
-                list = g_list_append (list, comp);
+                list = g_list_prepend (list, comp);
         }
         else if (kind != I_CAL_VTIMEZONE_COMPONENT)
         {
@@ -4612,7 +5522,7 @@ GList *o_cal_component_list_from_file (GFile *file)
         return NULL;
     }
 
-    return list;
+    return g_list_reverse (list);
 }
 
 static const gchar *o_cal_component_get_string_value (
@@ -121,12 +121,15 @@ typedef struct _xfical_appt
     gboolean allDay;
     gboolean readonly;
 
+    /* Timezone names are interned with g_intern_string, so they are shared
+     * between appointments and must not be freed.
+     */
     GDateTime *starttime;
-    gchar *start_tz_loc;
+    const gchar *start_tz_loc;
     gboolean use_due_time;  /* VTODO has due date or not */
 
     GDateTime *endtime;
-    gchar *end_tz_loc;
+    const gchar *end_tz_loc;
     gboolean use_duration;
 
     /* Event duration in seconds. */
@@ -134,7 +137,7 @@ typedef struct _xfical_appt
     gboolean completed;
 
     GDateTime *completedtime;
-    gchar *completed_tz_loc;
+    const gchar *completed_tz_loc;
 
     gint availability;
     gint priority;
@@ -189,6 +192,26 @@ typedef struct _xfical_appt
     GList  *recur_exceptions; /* EXDATE and RDATE list xfical_exception */
 } xfical_appt;
 
+typedef enum
+{
+    XFICAL_OCCURRENCE_NONE = 0,
+    /* this occurrence frees the shared appt in xfical_occurrence_list_free */
+    XFICAL_OCCURRENCE_OWNS_APPT = 1 << 0
+} xfical_occurrence_flags;
+
+/* One occurrence of an appointment inside a requested period. All occurrences
+ * of the same calendar component share one read-only appt, which is read from
+ * the component only once. Use start and end instead of appt->starttimecur
+ * and appt->endtimecur.
+ */
+typedef struct _xfical_occurrence
+{
+    GDateTime *start; /* in local timezone */
+    GDateTime *end;   /* in local timezone */
+    xfical_occurrence_flags flags;
+    const xfical_appt *appt;
+} xfical_occurrence;
+
 #define ORAGE_CALENDAR_COMPONENT_TYPE (orage_calendar_component_get_type ())
 G_DECLARE_FINAL_TYPE (OrageCalendarComponent, orage_calendar_component, ORAGE, CALENDAR_COMPONENT, GObject)
 
@@ -329,17 +352,70 @@ xfical_appt *xfical_appt_get_next_on_day (GDateTime *gdt, gboolean first,
 xfical_appt *xfical_appt_get_next_with_string (const gchar *str, gboolean first,
                                                const gchar *file_type);
 
+/** Fetch each occurrence of appointments within the specified time period.
+ *  @param a_day first day of the period
+ *  @param days length of the period in days
+ *  @param type EVENT/TODO/JOURNAL to be read
+ *  @param file_type calendar file id, for example "O00."
+ *  @param data list where xfical_occurrence items are prepended. Free it
+ *         with xfical_occurrence_list_free
+ */
 void xfical_get_each_app_within_time (GDateTime *a_day, gint days
         , xfical_type type, const gchar *file_type , GList **data);
 
+/** Free list returned by xfical_get_each_app_within_time together with the
+ *  appointments shared by its occurrences.
+ *  @param list list of xfical_occurrence
+ */
+void xfical_occurrence_list_free (GList *list);
+
+/** Mark days with appointments in the shown month of the calendar. Marks
+ *  are cached per calendar file and month, and months next to the shown one
+ *  are marked in background. Calendar files must be open.
+ *  @param gtkcal calendar to mark
+ */
 void xfical_mark_calendar(GtkCalendar *gtkcal);
+
+/** Mark calendar from cached marks only, files are not read.
+ *  @param gtkcal calendar to mark
+ *  @return TRUE if all marks of the shown month were cached, FALSE if the
+ *          calendar was not changed and xfical_mark_calendar is needed
+ */
+gboolean xfical_mark_calendar_from_cache(GtkCalendar *gtkcal);
 void xfical_mark_calendar_recur(GtkCalendar *gtkcal, const xfical_appt *appt);
 
+/** Get marked days of consecutive months from one recurrence expansion of
+ *  the appointment.
+ *  @param appt appointment to expand
+ *  @param year year of the first month
+ *  @param month first month, 1..12
+ *  @param n_months number of months
+ *  @param masks (out) n_months day masks, bit 0 is the first day of month
+ */
+void xfical_mark_recur_months (const xfical_appt *appt, guint year,
+                               guint month, guint n_months, guint32 *masks);
+
+/** Replace marks of the calendar with days of the mask.
+ *  @param gtkcal calendar to mark
+ *  @param mask day mask, bit 0 is the first day of month
+ */
+void xfical_mark_calendar_with_mask (GtkCalendar *gtkcal, guint32 mask);
+
 void xfical_list_events_in_range (GDateTime *gdt_start, GDateTime *gdt_end,
                                   xfical_event_callback cb, void *param);
 
 void xfical_alarm_build_list(gboolean first_list_today);
 
+/** Continue alarm lists of components whose last listed alarm fired.
+ *  @param fired alarms which were raised, the list is not modified
+ */
+void xfical_alarm_fired(GList *fired);
+
+/** Move alarm horizon forward, only components with no alarm beyond the new
+ *  horizon are expanded again.
+ */
+void xfical_alarm_horizon_slide(void);
+
 gint xfical_compare_times (xfical_appt *appt);
 #ifdef HAVE_ARCHIVE
 gboolean xfical_archive_open(void);
@@ -347,8 +423,31 @@ void xfical_archive_close(void);
 gboolean xfical_archive(void);
 gboolean xfical_unarchive(void);
 gboolean xfical_unarchive_uid (const gchar *uid);
+
+/** Copy or move archive, including its segments, to a new file name.
+ *  @param file new archive file name
+ *  @param move remove the original archive after copying
+ *  @return FALSE if copying failed
+ */
+gboolean xfical_archive_copy (const gchar *file, gboolean move);
 #endif
 
 gboolean xfical_file_check (const gchar *file_name);
 
+/** Drop cached month marks and free/busy bitmaps. Needed when calendar
+ *  files are changed as a whole, for example by import or archiving.
+ */
+void xfical_cache_invalidate (void);
+
+/** Add memory usage of calendar trees, month marks and alarm sources.
+ *  @param usage array of OrageMemoryUsage
+ */
+void xfical_memory_usage (GArray *usage);
+
+/** Close the main calendar if it is only waiting for the delayed close and
+ *  drop cached month marks and free/busy bitmaps. They are read again on
+ *  next use.
+ */
+void xfical_memory_trim (void);
+
 #endif /* !__ICAL_CODE_H__ */
@@ -58,538 +58,744 @@
 #include "ical-internal.h"
 #include "interface.h"
 #include "orage-i18n.h"
+#include "orage-trace.h"
 #include "parameters.h"
 #include "reminder.h"
 
-static gboolean export_selected (const gchar *file_name, const gchar *uids);
+static gboolean export_selected (GFile *file, const gchar *uids);
 static gboolean export_all (const gchar *file_name);
+static gboolean export_all_with_shards (GFile *file);
 
-static gchar *find_calendar_id (const gchar *calendar_name,
-                                gboolean *ical_opened)
+typedef struct _import_context
+{
+    /** Parser of the component that is currently being read. */
+    icalparser *parser;
+
+    /** Calendar where imported components are added. */
+    icalcomponent *target;
+    icalset *target_set;
+
+    /** Components of the target calendar by UID and RECURRENCE-ID. Keys are
+     *  owned by the table, values belong to the target calendar.
+     */
+    GHashTable *existing;
+
+    /** Year shard of indexed components, which are not in the target but in
+     *  a year shard of the main calendar.
+     */
+    GHashTable *shard_bases;
+
+    /** Components added to and replaced in the target calendar. Nothing is
+     *  written before the whole file is read, and on failure these are used
+     *  to restore the calendar as it was.
+     */
+    GHashTable *added;
+    GList *replaced;
+
+    /** Current unfolded content line. */
+    GString *line;
+
+    /** BEGIN/END nesting level, 1 means directly inside VCALENDAR. */
+    gint depth;
+
+    /** Replace existing components without comparing their versions. */
+    gboolean replace;
+
+    gint vcalendar_cnt;
+    gint component_cnt;
+    gint inserted_cnt;
+    gint updated_cnt;
+    gint unchanged_cnt;
+    gint dcreated_cnt;
+    gint tzid_cnt;
+} import_context;
+
+/* File type is optional, when given it gets the UID prefix of the
+ * calendar.
+ */
+static gboolean find_calendar (const gchar *calendar_name,
+                               icalcomponent **ical,
+                               icalset **fical,
+                               gchar file_type[8])
 {
-    gchar *calendar_id;
-    gboolean found;
     gint i;
 
     if (xfce_str_is_empty (calendar_name))
-        calendar_id = g_strdup ("O00.");
-    else
     {
-        calendar_id = NULL;
-        if (xfical_file_open (TRUE))
-        {
-            *ical_opened = TRUE;
-            found = FALSE;
-            for (i = 0; (i < g_par.foreign_count) && (found == FALSE); i++)
-            {
-                if (strcmp (g_par.foreign_data[i].file, calendar_name) == 0 ||
-                    strcmp (g_par.foreign_data[i].name, calendar_name) == 0)
-                {
-                    found = TRUE;
-                }
-            }
+        *ical = ic_ical;
+        *fical = ic_fical;
+        if (file_type)
+            g_strlcpy (file_type, "O00.", 8);
+        return TRUE;
+    }
 
-            if (found)
-                calendar_id = g_strdup_printf ("F%02d.", i - 1);
-            else
-                g_warning ("foreign calendar '%s' not found", calendar_name);
+    for (i = 0; i < g_par.foreign_count; i++)
+    {
+        if (strcmp (g_par.foreign_data[i].file, calendar_name) == 0 ||
+            strcmp (g_par.foreign_data[i].name, calendar_name) == 0)
+        {
+            break;
         }
-        else
-            g_warning ("failed to open calendar file");
     }
 
-    return calendar_id;
-}
+    if (i == g_par.foreign_count)
+    {
+        g_warning ("foreign calendar '%s' not found", calendar_name);
+        return FALSE;
+    }
 
-#if ICAL_CHECK_VERSION(4, 0, 0)
-#define icalcomponent_new_clone(_c) icalcomponent_clone (_c)
-#endif
+    if (g_par.foreign_data[i].read_only || ic_f_ical[i].ical == NULL)
+    {
+        g_warning ("foreign calendar '%s' is not writable", calendar_name);
+        return FALSE;
+    }
+
+    *ical = ic_f_ical[i].ical;
+    *fical = ic_f_ical[i].fical;
+    if (file_type)
+        g_snprintf (file_type, 8, "F%02d.", i);
 
-static void add_event (icalcomponent *c, gboolean *ical_opened)
+    return TRUE;
+}
+
+/* Rule out some features, which Orage does not support, so that we can do
+ * better conversion. Works on one unfolded content line.
+ */
+static void import_fix_line (import_context *ctx)
 {
-    icalcomponent *ca;
-    char *uid;
+    GString *line = ctx->line;
+    const gsize dcreated_len = strlen ("DCREATED:yyyymmddThhmmss");
+    gchar *tzid;
+    gchar *tz_end;
+    gchar *tz_real;
+    gsize tz_pos = 0;
 
-    ca = icalcomponent_new_clone(c);
-    if (icalcomponent_get_uid(ca) == NULL) {
-        uid = ic_generate_uid();
-        icalcomponent_add_property(ca,  icalproperty_new_uid(uid));
-        g_debug ("generated uid '%s'", uid);
-        g_free(uid);
+    /***** 1: change DCREATED to CREATED *****/
+    if (g_ascii_strncasecmp (line->str, "DCREATED:", 9) == 0)
+    {
+        if (line->len >= dcreated_len && line->str[dcreated_len] != 'Z')
+        {
+            /* needs to be converted to UTC also */
+            g_string_truncate (line, dcreated_len);
+            g_string_append_c (line, 'Z');
+        }
+
+        g_string_erase (line, 0, 1);
+        ctx->dcreated_cnt++;
     }
 
-    if (*ical_opened == FALSE)
+    /***** 2: change absolute timezones into libical format *****/
+    /* At least evolution uses absolute timezones.
+     * We assume format has /xxx/xxx/timezone and we should remove the
+     * extra /xxx/xxx/ from it */
+    for (tzid = strstr (line->str, ";TZID=/");
+         tzid != NULL;
+         tzid = strstr (line->str + tz_pos, ";TZID=/"))
     {
-        if (xfical_file_open (FALSE) == FALSE)
+        tzid += 6; /* 6 = skip ";TZID=" */
+        tz_pos = tzid - line->str;
+        tz_end = tzid + strcspn (tzid, ";:");
+        tz_real = memchr (tzid + 1, '/', tz_end - tzid - 1);
+        if (tz_real != NULL)
+            tz_real = memchr (tz_real + 1, '/', tz_end - tz_real - 1);
+
+        if (tz_real == NULL)
         {
-            g_critical ("iCal file open failed");
-            return;
+            g_warning ("timezone patch failed: unexpected TZID format '%.*s'",
+                       (gint)(tz_end - tzid), tzid);
+            continue;
         }
 
-        *ical_opened = TRUE;
+        g_string_erase (line, tz_pos, tz_real + 1 - tzid);
+        ctx->tzid_cnt++;
     }
-
-    icalcomponent_add_component(ic_ical, ca);
-    ic_file_modified = TRUE;
-    icalset_mark(ic_fical);
-    icalset_commit(ic_fical);
 }
 
-static void add_event_with_id (icalcomponent *c, gboolean *ical_opened,
-                               const gchar *id)
+/* Recurrence overrides share UID with the main component, so RECURRENCE-ID
+ * is part of the key.
+ */
+static gchar *import_component_key (icalcomponent *c)
 {
-    icalcomponent *ca;
-    gchar *tmp;
-    gchar *uid;
-    gint i;
+    struct icaltimetype rid;
 
-    ca = icalcomponent_new_clone (c);
-    if (icalcomponent_get_uid (ca) == NULL)
-    {
-        tmp = ic_generate_uid ();
-        uid = g_strconcat (id, tmp, NULL);
-        g_free (tmp);
-        icalcomponent_add_property (ca, icalproperty_new_uid (uid));
-        g_debug ("generated uid '%s'", uid);
-        g_free (uid);
-    }
+    rid = icalcomponent_get_recurrenceid (c);
+    if (icaltime_is_null_time (rid))
+        return g_strdup (icalcomponent_get_uid (c));
 
-    if (*ical_opened == FALSE)
+    return g_strconcat (icalcomponent_get_uid (c), "\n",
+                        icaltime_as_ical_string (rid), NULL);
+}
+
+static void import_index_base (icalcomponent *base, gpointer user_data)
+{
+    import_context *ctx = (import_context *)user_data;
+    icalcomponent *c;
+    icalcomponent_kind kind;
+
+    for (c = icalcomponent_get_first_component (base, ICAL_ANY_COMPONENT);
+         c != NULL;
+         c = icalcomponent_get_next_component (base, ICAL_ANY_COMPONENT))
     {
-        if (xfical_file_open (FALSE) == FALSE)
+        kind = icalcomponent_isa (c);
+        if ((kind == ICAL_VEVENT_COMPONENT || kind == ICAL_VTODO_COMPONENT
+          || kind == ICAL_VJOURNAL_COMPONENT)
+         && icalcomponent_get_uid (c) != NULL)
         {
-            g_critical ("iCal file open failed");
-            return;
+            g_hash_table_replace (ctx->existing, import_component_key (c), c);
+            if (base != ctx->target)
+                g_hash_table_insert (ctx->shard_bases, c, base);
         }
-
-        *ical_opened = TRUE;
     }
+}
 
-    if (id[0] == 'O')
+static void import_index_target (import_context *ctx)
+{
+    ctx->existing = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                           g_free, NULL);
+    ctx->shard_bases = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+    /* Ended events of the main calendar may have moved to year shards.
+     * Shards are indexed first, so the main file wins on duplicates.
+     */
+    if (ctx->target == ic_ical)
+        ic_shards_foreach (G_MININT, import_index_base, ctx);
+
+    import_index_base (ctx->target, ctx);
+}
+
+/* Calendar where indexed component c is stored. */
+static icalcomponent *import_component_base (import_context *ctx,
+                                             icalcomponent *c)
+{
+    icalcomponent *base;
+
+    base = g_hash_table_lookup (ctx->shard_bases, c);
+
+    return base ? base : ctx->target;
+}
+
+static void import_index_free (import_context *ctx)
+{
+    g_hash_table_destroy (ctx->existing);
+    g_hash_table_destroy (ctx->shard_bases);
+}
+
+static struct icaltimetype import_last_modified (icalcomponent *c)
+{
+    icalproperty *p;
+
+    p = icalcomponent_get_first_property (c, ICAL_LASTMODIFIED_PROPERTY);
+
+    return p ? icalproperty_get_lastmodified (p) : icaltime_null_time ();
+}
+
+/* Return TRUE when incoming component is newer than the stored one. Higher
+ * SEQUENCE wins, with equal SEQUENCE later LAST-MODIFIED wins.
+ */
+static gboolean import_is_newer (icalcomponent *incoming, icalcomponent *old)
+{
+    struct icaltimetype new_modified;
+    struct icaltimetype old_modified;
+    const gint new_sequence = icalcomponent_get_sequence (incoming);
+    const gint old_sequence = icalcomponent_get_sequence (old);
+
+    if (new_sequence != old_sequence)
+        return (new_sequence > old_sequence);
+
+    new_modified = import_last_modified (incoming);
+    old_modified = import_last_modified (old);
+    if (icaltime_is_null_time (new_modified))
+        return FALSE;
+
+    if (icaltime_is_null_time (old_modified))
+        return TRUE;
+
+    return (icaltime_compare (new_modified, old_modified) > 0);
+}
+
+/* Insert new component, replace older version of it or drop it when
+ * calendar already has the same or newer version.
+ */
+static void import_merge_component (import_context *ctx, icalcomponent *c)
+{
+    icalcomponent *old;
+    icalcomponent *base;
+    gchar *key;
+
+    key = import_component_key (c);
+    old = g_hash_table_lookup (ctx->existing, key);
+
+    if (old == NULL)
     {
-        icalcomponent_add_component (ic_ical, ca);
-        icalset_mark (ic_fical);
+        icalcomponent_add_component (ctx->target, c);
+        g_hash_table_add (ctx->added, c);
+        g_hash_table_insert (ctx->existing, key, c);
+        ctx->inserted_cnt++;
     }
-    else if (id[0] == 'F')
+    else if (ctx->replace || import_is_newer (c, old))
     {
-        sscanf (id, "F%02d", &i);
-        if (i < g_par.foreign_count && ic_f_ical[i].ical != NULL)
-        {
-            icalcomponent_add_component (ic_f_ical[i].ical, ca);
-            icalset_mark (ic_f_ical[i].fical);
-        }
+        /* New version always goes to the main file, shards get it back
+         * when it has ended.
+         */
+        base = import_component_base (ctx, old);
+        icalcomponent_remove_component (base, old);
+        if (base != ctx->target)
+            ic_shards_mark (base);
+
+        icalcomponent_add_component (ctx->target, c);
+        g_hash_table_add (ctx->added, c);
+        g_hash_table_replace (ctx->existing, key, c);
+        ctx->updated_cnt++;
+
+        /* A component replaced earlier in the same import is not needed for
+         * rollback, only the version that was in the calendar.
+         */
+        if (g_hash_table_remove (ctx->added, old))
+            icalcomponent_free (old);
         else
-        {
-            g_critical ("unknown foreign file number '%s'", id);
-            return;
-        }
+            ctx->replaced = g_list_prepend (ctx->replaced, old);
     }
     else
     {
-        /* Note: we never update/add Archive file */
-        g_critical ("unknown file type '%s'", id);
-        return;
+        icalcomponent_free (c);
+        g_free (key);
+        ctx->unchanged_cnt++;
+    }
+}
+
+static void import_rollback (import_context *ctx)
+{
+    GHashTableIter iter;
+    GList *tmp;
+    gpointer c;
+
+    g_hash_table_iter_init (&iter, ctx->added);
+    while (g_hash_table_iter_next (&iter, &c, NULL))
+    {
+        icalcomponent_remove_component (ctx->target, c);
+        icalcomponent_free (c);
     }
 
-    ic_file_modified = TRUE;
-    icalset_commit (ic_fical);
+    for (tmp = ctx->replaced; tmp != NULL; tmp = g_list_next (tmp))
+    {
+        icalcomponent_add_component (import_component_base (ctx, tmp->data),
+                                     tmp->data);
+    }
+
+    g_list_free (ctx->replaced);
+    ctx->replaced = NULL;
 }
 
-/* pre process the file to rule out some features, which orage does not
- * support so that we can do better conversion 
- */
-static gboolean pre_format(const gchar *file_name_in,
-                           const gchar *file_name_out)
+static void import_commit (import_context *ctx)
 {
-    gchar *text, *tmp, *tmp2, *tmp3;
-    gsize text_len;
-    GError *error = NULL;
+    g_list_free_full (ctx->replaced, (GDestroyNotify)icalcomponent_free);
+    ctx->replaced = NULL;
+}
 
-    g_debug ("starting import file preprocessing");
+static void import_ensure_uid (icalcomponent *c)
+{
+    gchar *uid;
 
-    if (g_file_get_contents (file_name_in, &text, &text_len, &error) == FALSE)
+    if (icalcomponent_get_uid (c) == NULL)
     {
-        g_critical ("could not open ical file '%s': %s", file_name_in,
-                    error->message);
-        g_error_free (error);
-        return FALSE;
+        uid = ic_generate_uid ();
+        icalcomponent_add_property (c, icalproperty_new_uid (uid));
+        g_debug ("generated uid '%s'", uid);
+        g_free (uid);
     }
+}
 
-    /***** Check utf8 conformability *****/
-    if (!g_utf8_validate(text, -1, NULL)) {
-        g_critical ("file '%s' is not in UTF-8 format; convert it to UTF-8 "
-                    "and import again", file_name_in);
-        return FALSE;
+static void import_add_component (import_context *ctx, icalcomponent *c)
+{
+    switch (icalcomponent_isa (c))
+    {
+        case ICAL_VEVENT_COMPONENT:
+        case ICAL_VTODO_COMPONENT:
+        case ICAL_VJOURNAL_COMPONENT:
+            import_ensure_uid (c);
+            import_merge_component (ctx, c);
+            ctx->component_cnt++;
+            break;
+
+        case ICAL_VTIMEZONE_COMPONENT:
+            /* We ignore TIMEZONE component; Orage only uses internal
+             * timezones from libical.
+             */
+            icalcomponent_free (c);
+            break;
+
+        default:
+            g_warning ("unknown component '%s'",
+                       icalcomponent_kind_to_string (icalcomponent_isa (c)));
+            icalcomponent_free (c);
+            break;
     }
+}
 
-    /***** 1: change DCREATED to CREATED *****/
-    for (tmp = g_strstr_len(text, text_len, "DCREATED:"); 
-         tmp != NULL;
-         tmp = g_strstr_len(tmp, strlen(tmp), "DCREATED:")) {
-        tmp2 = tmp+strlen("DCREATED:yyyymmddThhmmss");
-        if (*tmp2 == 'Z') {
-            /* it is already in UTC, so just fix the parameter name */
-            *tmp = ' ';
-        }
-        else {
-            /* needs to be converted to UTC also */
-            for (tmp3 = tmp; tmp3 < tmp2; tmp3++) {
-                *tmp3 = *(tmp3+1); 
-            }
-            *(tmp3-1) = 'Z'; /* this is 'bad'...but who cares...it is fast */
+/* Only components inside VCALENDAR are handed to the parser, one at a time,
+ * so the parser never holds more than a single component in memory.
+ */
+static void import_process_line (import_context *ctx)
+{
+    icalcomponent *c;
+    gchar *line;
+    gboolean begin;
+    gboolean end;
+
+    import_fix_line (ctx);
+    line = ctx->line->str;
+    begin = (g_ascii_strncasecmp (line, "BEGIN:", 6) == 0);
+    end = (g_ascii_strncasecmp (line, "END:", 4) == 0);
+
+    if (ctx->depth == 0)
+    {
+        if (begin && g_ascii_strcasecmp (line + 6, "VCALENDAR") == 0)
+        {
+            ctx->vcalendar_cnt++;
+            ctx->depth = 1;
         }
-        g_message ("patched DCREATED property to CREATED");
+        else
+            g_warning ("skipping line outside of VCALENDAR: '%s'", line);
+
+        return;
     }
 
-    /***** 2: change absolute timezones into libical format *****/
-    /* At least evolution uses absolute timezones.
-     * We assume format has /xxx/xxx/timezone and we should remove the
-     * extra /xxx/xxx/ from it */
-    for (tmp = g_strstr_len(text, text_len, ";TZID=/"); 
-         tmp != NULL;
-         tmp = g_strstr_len(tmp, strlen(tmp), ";TZID=/")) {
-        /* tmp = original TZID start
-         * tmp2 = end of line 
-         * tmp3 = current search and eventually the real tzid */
-        tmp = tmp+6; /* 6 = skip ";TZID=" */
-        if (!(tmp2 = g_strstr_len(tmp, 100, "\n"))) { /* no end of line */
-            g_warning ("timezone patch failed: no end-of-line found in TZID "
-                       "field");
-            continue;
-        }
-        tmp3 = tmp;
+    if (ctx->depth == 1 && begin == FALSE)
+    {
+        /* VCALENDAR level properties are not imported */
+        if (end)
+            ctx->depth = 0;
 
-        tmp3++; /* skip '/' */
-        if (!(tmp3 = g_strstr_len(tmp3, tmp2-tmp3, "/"))) { /* no more '/' */
-            g_warning ("timezone patch failed: unexpected TZID format '%s'",
-                       tmp);
-            continue;
+        return;
+    }
+
+    if (begin)
+        ctx->depth++;
+    else if (end)
+        ctx->depth--;
+
+    c = icalparser_add_line (ctx->parser, line);
+    if (c != NULL)
+        import_add_component (ctx, c);
+}
+
+static gboolean import_stream (import_context *ctx, GInputStream *stream,
+                               GError **error)
+{
+    GDataInputStream *data;
+    gchar *raw;
+    gsize len;
+    GError *read_error = NULL;
+
+    data = g_data_input_stream_new (stream);
+    g_data_input_stream_set_newline_type (data,
+                                          G_DATA_STREAM_NEWLINE_TYPE_ANY);
+
+    while ((raw = g_data_input_stream_read_line_utf8 (data, &len, NULL,
+                                                      &read_error)) != NULL)
+    {
+        if (raw[0] == ' ' || raw[0] == '\t')
+        {
+            /* folded line, continues the previous one */
+            g_string_append_len (ctx->line, raw + 1, len - 1);
         }
-        tmp3++; /* skip '/' */
-        if (!(tmp3 = g_strstr_len(tmp3, tmp2-tmp3, "/"))) { /* no more '/' */
-            g_warning ("timezone patch failed: unexpected TZID format '%s'",
-                       tmp);
-            continue;
+        else
+        {
+            if (ctx->line->len != 0)
+                import_process_line (ctx);
+
+            g_string_assign (ctx->line, raw);
         }
 
-        /* we found the real tzid since we came here */
-        tmp3++; /* skip '/' */
-        /* move the real tzid (=tmp3) to the beginning (=tmp) */
-        for (; tmp3 < tmp2; tmp3++, tmp++)
-            *tmp = *tmp3;
-        /* fill the end of the line with spaces */
-        for (; tmp < tmp2; tmp++)
-            *tmp = ' ';
-        g_message ("patched timezone to Orage format");
+        g_free (raw);
     }
 
-    /***** All done: write file *****/
-    if (!g_file_set_contents(file_name_out, text, -1, NULL)) {
-        g_critical ("could not write iCal file '%s'", file_name_out);
-        return(FALSE);
+    if (read_error == NULL && ctx->line->len != 0)
+        import_process_line (ctx);
+
+    g_object_unref (data);
+
+    if (read_error != NULL)
+    {
+        g_propagate_error (error, read_error);
+        return FALSE;
     }
-    g_free(text);
-    g_message ("import file preprocessing done");
-    return(TRUE);
+
+    return TRUE;
 }
 
-/* pre process the file to rule out some features, which orage does not
- * support so that we can do better conversion
- */
-static gboolean pre_format_gfile_to_string (GFile *file_in,
-                                            GString **out,
-                                            GError **error)
+static gboolean import_file (GFile *file, const gchar *calendar_name)
 {
-    gchar *text, *tmp, *tmp2, *tmp3;
-    gsize text_len;
-
-    g_debug ("starting import file preprocessing");
+    import_context ctx = {0};
+    GFileInputStream *stream;
+    gchar *file_name;
+    gboolean result;
+    GError *error = NULL;
 
-    if (g_file_load_contents (file_in, NULL, &text, &text_len, NULL, error) == FALSE)
+    file_name = g_file_get_path (file);
+    stream = g_file_read (file, NULL, &error);
+    if (stream == NULL)
+    {
+        g_warning ("could not open iCal file '%s': %s", file_name,
+                   error->message);
+        g_error_free (error);
+        g_free (file_name);
         return FALSE;
+    }
 
-    if (g_utf8_validate (text, -1, NULL) == FALSE)
+    if (xfical_file_open (TRUE) == FALSE)
     {
-        g_set_error (error, G_CONVERT_ERROR, G_CONVERT_ERROR_ILLEGAL_SEQUENCE,
-                     "input file is not valid UTF-8");
-        g_free (text);
+        g_critical ("iCal file open failed");
+        g_object_unref (stream);
+        g_free (file_name);
         return FALSE;
     }
 
-    /***** 1: change DCREATED to CREATED *****/
-    for (tmp = g_strstr_len (text, text_len, "DCREATED:");
-         tmp != NULL;
-         tmp = g_strstr_len (tmp, strlen (tmp), "DCREATED:"))
+    result = find_calendar (calendar_name, &ctx.target, &ctx.target_set,
+                            NULL);
+    if (result)
     {
-        tmp2 = tmp + strlen ("DCREATED:yyyymmddThhmmss");
-        if (*tmp2 == 'Z')
+        g_debug ("starting streaming import of '%s'", file_name);
+
+        ctx.parser = icalparser_new ();
+        ctx.line = g_string_sized_new (256);
+        ctx.added = g_hash_table_new (g_direct_hash, g_direct_equal);
+        import_index_target (&ctx);
+
+        result = import_stream (&ctx, G_INPUT_STREAM (stream), &error);
+        if (result == FALSE)
         {
-            /* it is already in UTC, so just fix the parameter name */
-            *tmp = ' ';
+            g_warning ("could not read iCal file '%s': %s", file_name,
+                       error->message);
+            g_error_free (error);
         }
-        else
+        else if (ctx.depth != 0)
         {
-            /* needs to be converted to UTC also */
-            for (tmp3 = tmp; tmp3 < tmp2; tmp3++)
-                *tmp3 = *(tmp3 + 1);
+            g_warning ("iCal file '%s' ends inside of a component",
+                       file_name);
+            result = FALSE;
+        }
+        else if (ctx.vcalendar_cnt == 0)
+        {
+            g_warning ("no VCALENDAR components found in '%s'", file_name);
+            result = FALSE;
+        }
 
-            *(tmp3 - 1) = 'Z'; /* this is 'bad'...but who cares...it is fast */
+        /* Partially read file is not imported at all. */
+        if (result)
+            import_commit (&ctx);
+        else if (ctx.component_cnt > 0)
+        {
+            g_warning ("import of '%s' rolled back, %d components dropped",
+                       file_name, ctx.component_cnt);
+            import_rollback (&ctx);
         }
 
-        g_message ("patched DCREATED property to CREATED");
+        g_hash_table_destroy (ctx.added);
+        import_index_free (&ctx);
+        g_string_free (ctx.line, TRUE);
+        icalparser_free (ctx.parser);
     }
 
-    /***** 2: change absolute timezones into libical format *****/
-    /* At least evolution uses absolute timezones.
-     * We assume format has /xxx/xxx/timezone and we should remove the
-     * extra /xxx/xxx/ from it */
-    for (tmp = g_strstr_len (text, text_len, ";TZID=/");
-         tmp != NULL;
-         tmp = g_strstr_len (tmp, strlen (tmp), ";TZID=/"))
-    {
-        /* tmp = original TZID start
-         * tmp2 = end of line
-         * tmp3 = current search and eventually the real tzid */
-        tmp = tmp + 6; /* 6 = skip ";TZID=" */
-        if (!(tmp2 = g_strstr_len (tmp, 100, "\n")))
-        { /* no end of line */
-            g_warning ("timezone patch failed: no end-of-line found in TZID "
-                       "field");
-            continue;
-        }
-        tmp3 = tmp;
+    if (ctx.dcreated_cnt)
+        g_message ("patched %d DCREATED properties to CREATED",
+                   ctx.dcreated_cnt);
 
-        tmp3++; /* skip '/' */
-        if (!(tmp3 = g_strstr_len (tmp3, tmp2 - tmp3, "/")))
-        {
-            g_warning ("timezone patch failed: unexpected TZID format '%s'",
-                       tmp);
-            continue;
-        }
-        tmp3++; /* skip '/' */
-        if (!(tmp3 = g_strstr_len (tmp3, tmp2 - tmp3, "/")))
+    if (ctx.tzid_cnt)
+        g_message ("patched %d timezones to Orage format", ctx.tzid_cnt);
+
+    if (result && ctx.component_cnt > 0)
+    {
+        if (ctx.inserted_cnt + ctx.updated_cnt > 0)
         {
-            g_warning ("timezone patch failed: unexpected TZID format '%s'",
-                       tmp);
-            continue;
+            /* Everything is added in memory, so the calendar file is written
+             * and alarms are rebuilt only once per import.
+             */
+            icalset_mark (ctx.target_set);
+            icalset_commit (ctx.target_set);
+            ic_file_modified = TRUE;
+            xfical_cache_invalidate ();
+            xfical_alarm_build_list_internal (FALSE);
         }
 
-        tmp3++;
-        for (; tmp3 < tmp2; tmp3++, tmp++)
-            *tmp = *tmp3;
+        g_message ("imported %d components from '%s': %d inserted, "
+                   "%d updated, %d unchanged", ctx.component_cnt, file_name,
+                   ctx.inserted_cnt, ctx.updated_cnt, ctx.unchanged_cnt);
+    }
+    else if (result)
+    {
+        g_warning ("no importable iCal components found in '%s'", file_name);
+        result = FALSE;
+    }
+
+    xfical_file_close (TRUE);
+    g_object_unref (stream);
+    g_free (file_name);
 
-        for (; tmp < tmp2; tmp++)
-            *tmp = ' ';
+    return result;
+}
 
-        g_message ("patched timezone to Orage format");
-    }
+gboolean xfical_import_by_path (const gchar *file_name)
+{
+    GFile *file = g_file_new_for_path (file_name);
+    const gboolean result = import_file (file, NULL);
 
-    /***** All done: write file *****/
-    *out = g_string_new (text);
-    g_free (text);
-    g_message ("import file preprocessing done");
+    g_object_unref (file);
 
-    return TRUE;
+    return result;
 }
 
-static gboolean xfical_import_component (icalcomponent *root,
-                                         gboolean *ical_opened,
-                                         const gchar *id)
+gboolean orage_calendar_import_file (GFile *file, const gchar *dest)
 {
-    icalcomponent *comp;
+    ORAGE_TRACE_SCOPE ("import");
 
-    for (comp = icalcomponent_get_first_component (root, ICAL_ANY_COMPONENT);
-         comp != NULL;
-         comp = icalcomponent_get_next_component (root, ICAL_ANY_COMPONENT))
-    {
-        switch (icalcomponent_isa (comp))
-        {
-            case ICAL_VEVENT_COMPONENT:
-            case ICAL_VTODO_COMPONENT:
-            case ICAL_VJOURNAL_COMPONENT:
-                g_debug ("importing component '%s'",
-                         icalcomponent_kind_to_string(icalcomponent_isa(comp)));
-                add_event_with_id (comp, ical_opened, id);
-                return TRUE;
-
-            case ICAL_VTIMEZONE_COMPONENT:
-                /* We ignore TIMEZONE component; Orage only uses internal
-                 * timezones from libical.
-                 */
-                return FALSE;
+    return import_file (file, dest);
+}
 
-            default:
-                g_warning ("unknown component '%s'",
-                           icalcomponent_kind_to_string (icalcomponent_isa (comp)));
-                return FALSE;
-        }
+/* Add one component of a batch and collect its UID with the file type
+ * prefix of the target calendar.
+ */
+static gboolean store_add_component (import_context *ctx, icalcomponent *c,
+                                     const gchar *file_type, GPtrArray *uids,
+                                     const guint n, GError **error)
+{
+    const icalcomponent_kind kind = icalcomponent_isa (c);
+
+    if (kind != ICAL_VEVENT_COMPONENT && kind != ICAL_VTODO_COMPONENT
+     && kind != ICAL_VJOURNAL_COMPONENT)
+    {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                     "component %u is %s, only VEVENT, VTODO and VJOURNAL "
+                     "can be stored", n, icalcomponent_kind_to_string (kind));
+        icalcomponent_free (c);
+        return FALSE;
     }
 
-    return FALSE;
+    import_ensure_uid (c);
+    g_ptr_array_add (uids, g_strconcat (file_type, icalcomponent_get_uid (c),
+                                        NULL));
+    import_merge_component (ctx, c);
+    ctx->component_cnt++;
+
+    return TRUE;
 }
 
-gboolean xfical_import_by_path (const gchar *file_name)
+/* One batch entry is either a bare component or a VCALENDAR, whose
+ * VTIMEZONE components are ignored like in file import.
+ */
+static gboolean store_add_text (import_context *ctx, const gchar *text,
+                                const gchar *file_type, GPtrArray *uids,
+                                const guint n, GError **error)
 {
-    icalset *file_ical;
-    gchar *ical_file_name;
-    icalcomponent *c1, *c2;
-    gint cnt1 = 0, cnt2 = 0;
-    gboolean ical_opened = FALSE;
+    icalcomponent *c;
+    icalcomponent *sub;
+    icalcomponent *next;
+    gboolean result = TRUE;
 
-    ical_file_name = g_strdup_printf("%s.orage", file_name);
-    if (!pre_format(file_name, ical_file_name)) {
-        g_free(ical_file_name);
-        return(FALSE);
-    }
-    if ((file_ical = icalset_new_file(ical_file_name)) == NULL) {
-        g_critical ("could not open iCal file '%s': %s",
-                    ical_file_name, icalerror_strerror(icalerrno));
-        g_free(ical_file_name);
-        return(FALSE);
-    }
-    for (c1 = icalset_get_first_component(file_ical);
-         c1 != 0;
-         c1 = icalset_get_next_component(file_ical)) {
-        if (icalcomponent_isa(c1) == ICAL_VCALENDAR_COMPONENT) {
-            cnt1++;
-            for (c2=icalcomponent_get_first_component(c1, ICAL_ANY_COMPONENT);
-                 c2 != 0;
-                 c2=icalcomponent_get_next_component(c1, ICAL_ANY_COMPONENT)){
-                if ((icalcomponent_isa(c2) == ICAL_VEVENT_COMPONENT)
-                ||  (icalcomponent_isa(c2) == ICAL_VTODO_COMPONENT)
-                ||  (icalcomponent_isa(c2) == ICAL_VJOURNAL_COMPONENT)) {
-                    cnt2++;
-                    add_event (c2, &ical_opened);
-                }
-                /* we ignore TIMEZONE component; Orage only uses internal
-                 * timezones from libical */
-                else if (icalcomponent_isa(c2) != ICAL_VTIMEZONE_COMPONENT)
-                {
-                    g_warning ("unknown component '%s' in '%s'",
-                               icalcomponent_kind_to_string (
-                                    icalcomponent_isa(c2)), ical_file_name);
-                }
-            }
-        }
-        else
-        {
-            g_warning ("unknown icalset component '%s' in '%s'",
-                       icalcomponent_kind_to_string(icalcomponent_isa(c1)),
-                       ical_file_name);
-        }
+    c = icalparser_parse_string (text);
+    if (c == NULL)
+    {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                     "component %u is not valid iCalendar data", n);
+        return FALSE;
     }
 
-    if (ical_opened)
-        xfical_file_close (FALSE);
+    if (icalcomponent_isa (c) != ICAL_VCALENDAR_COMPONENT)
+        return store_add_component (ctx, c, file_type, uids, n, error);
 
-    if (cnt1 == 0) {
-        g_warning ("no valid icalset components found in '%s'", ical_file_name);
-        g_free(ical_file_name);
-        return(FALSE);
-    }
-    if (cnt2 == 0) {
-        g_warning ("no valid icalset components found in '%s'", ical_file_name);
-        g_free(ical_file_name);
-        return(FALSE);
+    for (sub = icalcomponent_get_first_component (c, ICAL_ANY_COMPONENT);
+         result && sub != NULL;
+         sub = next)
+    {
+        next = icalcomponent_get_next_component (c, ICAL_ANY_COMPONENT);
+        if (icalcomponent_isa (sub) == ICAL_VTIMEZONE_COMPONENT)
+            continue;
+
+        icalcomponent_remove_component (c, sub);
+        result = store_add_component (ctx, sub, file_type, uids, n, error);
     }
 
-    g_free(ical_file_name);
-    return(TRUE);
+    icalcomponent_free (c);
+
+    return result;
 }
 
-gboolean orage_calendar_import_file (GFile *file, const gchar *dest)
+gchar **orage_calendar_store_components (const gchar * const *components,
+                                         const gchar *dest, GError **error)
 {
-    gchar *calendar_id = NULL;
-    icalcomponent *vcal;
-    icalcomponent *root;
-    gchar *file_name;
-    gboolean vcalendar_found;
-    gboolean imported;
-    gboolean result = TRUE;
-    gboolean ical_opened = FALSE;
-    GString *ical_text = NULL;
-    GError *error = NULL;
+    import_context ctx = {0};
+    GPtrArray *uids;
+    gchar file_type[8];
+    gboolean result;
+    guint i;
+    ORAGE_TRACE_SCOPE ("store components");
 
-    if (pre_format_gfile_to_string (file, &ical_text, &error) == FALSE)
+    if (components == NULL || components[0] == NULL)
     {
-        file_name = g_file_get_path (file);
-        g_warning ("could not open iCal file '%s': %s",
-                   file_name, error ? error->message : "unknown error");
-        g_free (file_name);
-        g_error_free (error);
-        result = FALSE;
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                     "no components to store");
+        return NULL;
     }
 
-    if (result)
+    if (xfical_file_open (TRUE) == FALSE)
     {
-        root = icalparser_parse_string (ical_text->str);
-        g_string_free (ical_text, TRUE);
-        if (root == NULL)
-        {
-            g_warning ("failed to parse iCal data: %s",
-                       icalerror_strerror (icalerrno));
-            result = FALSE;
-        }
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                     "could not open calendar files");
+        return NULL;
     }
 
-    if (result)
+    if (!find_calendar (dest, &ctx.target, &ctx.target_set, file_type))
     {
-        calendar_id = find_calendar_id (dest, &ical_opened);
-        if (calendar_id == NULL)
-        {
-            g_warning ("calendar '%s' not found", dest);
-            result = FALSE;
-        }
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                     "calendar '%s' not found or not writable", dest);
+        xfical_file_close (TRUE);
+        return NULL;
     }
 
-    if (result)
+    /* the caller owns the data, so stored components always win */
+    ctx.replace = TRUE;
+    ctx.added = g_hash_table_new (g_direct_hash, g_direct_equal);
+    import_index_target (&ctx);
+    uids = g_ptr_array_new_with_free_func (g_free);
+
+    result = TRUE;
+    for (i = 0; result && components[i] != NULL; i++)
     {
-        vcalendar_found = FALSE;
-        imported = FALSE;
+        result = store_add_text (&ctx, components[i], file_type, uids, i,
+                                 error);
+    }
 
-        if (icalcomponent_isa (root) == ICAL_VCALENDAR_COMPONENT)
-        {
-            vcalendar_found = TRUE;
-            imported = xfical_import_component (root, &ical_opened, calendar_id);
-        }
-        else
-        {
-            g_message ("multiple VCALENDAR components found, importing all");
+    /* all or nothing, like file import */
+    if (result)
+        import_commit (&ctx);
+    else if (ctx.component_cnt > 0)
+        import_rollback (&ctx);
 
-            for (vcal = icalcomponent_get_first_component (root, ICAL_VCALENDAR_COMPONENT);
-                 vcal != NULL;
-                 vcal = icalcomponent_get_next_component (root, ICAL_VCALENDAR_COMPONENT))
-            {
-                vcalendar_found = TRUE;
-                imported |= xfical_import_component (root, &ical_opened, calendar_id);
-            }
-        }
+    g_hash_table_destroy (ctx.added);
+    import_index_free (&ctx);
 
-        icalcomponent_free (root);
+    if (result && ctx.inserted_cnt + ctx.updated_cnt > 0)
+    {
+        icalset_mark (ctx.target_set);
+        icalset_commit (ctx.target_set);
+        ic_file_modified = TRUE;
+        xfical_cache_invalidate ();
+        xfical_alarm_build_list_internal (FALSE);
+    }
 
-        if (vcalendar_found == FALSE)
-        {
-            g_warning ("no VCALENDAR components found");
-            result = FALSE;
-        }
+    xfical_file_close (TRUE);
 
-        if (result)
-        {
-            if (imported == FALSE)
-            {
-                g_warning ("no importable iCal components found");
-                result = FALSE;
-            }
-        }
+    if (!result)
+    {
+        g_ptr_array_free (uids, TRUE);
+        return NULL;
     }
 
-    if (calendar_id)
-        g_free (calendar_id);
+    g_message ("stored %d components: %d inserted, %d updated",
+               ctx.component_cnt, ctx.inserted_cnt, ctx.updated_cnt);
+    g_ptr_array_add (uids, NULL);
 
-    if (ical_opened)
-        xfical_file_close (TRUE);
-
-    return result;
+    return (gchar **)g_ptr_array_free (uids, FALSE);
 }
 
 gboolean xfical_export_file (GFile *file, const gchar *uids)
@@ -602,7 +808,7 @@ gboolean xfical_export_file (GFile *file, const gchar *uids)
     if (uids)
     {
         /* Copy only selected appointments. */
-        result = export_selected (name, uids);
+        result = export_selected (file, uids);
     }
     else
     {
@@ -638,124 +844,359 @@ static gboolean export_prepare_write_file(const gchar *file_name)
     return(TRUE);
 }
 
+/* Whole calendar is copied as a file. GIO uses reflink or in-kernel copy
+ * when the file system supports it and a fixed size buffer otherwise.
+ */
 static gboolean export_all (const gchar *file_name)
 {
-    gchar *text;
-    gsize text_len;
+    GFile *source;
+    GFile *destination;
+    gboolean result;
+    GError *error = NULL;
 
     if (!export_prepare_write_file(file_name))
         return(FALSE);
-    /* read Orage's ical file */
-    if (!g_file_get_contents(g_par.orage_file, &text, &text_len, NULL)) {
-        g_critical ("could not read orage iCal file '%s'", g_par.orage_file);
-        return(FALSE);
+
+    /* main file alone does not have the ended events */
+    if (g_par.main_shards)
+    {
+        destination = g_file_new_for_path (file_name);
+        result = export_all_with_shards (destination);
+        g_object_unref (destination);
+
+        return result;
     }
-    if (!g_file_set_contents(file_name, text, -1, NULL)) {
-        g_warning ("could not write export file '%s'", file_name);
-        g_free(text);
-        return(FALSE);
+
+    /* edits are committed when they are done, but make sure that an open
+     * calendar has nothing unwritten before copying the file */
+    if (ic_fical != NULL)
+        icalset_commit (ic_fical);
+
+    source = g_file_new_for_path (g_par.orage_file);
+    destination = g_file_new_for_path (file_name);
+    result = g_file_copy (source, destination,
+                          G_FILE_COPY_OVERWRITE
+                        | G_FILE_COPY_TARGET_DEFAULT_PERMS,
+                          NULL, NULL, NULL, &error);
+    if (result == FALSE)
+    {
+        g_warning ("could not copy orage iCal file '%s' to '%s': %s",
+                   g_par.orage_file, file_name, error->message);
+        g_error_free (error);
     }
-    g_free(text);
-    return(TRUE);
+
+    g_object_unref (destination);
+    g_object_unref (source);
+
+    return result;
 }
 
-static gboolean export_selected_uid (icalcomponent *base, const gchar *uid,
-                                     icalcomponent *x_ical)
+static gboolean export_write (GOutputStream *stream, const gchar *text,
+                              GError **error)
 {
-    icalcomponent *c, *d;
-    gboolean key_found = FALSE;
+    return g_output_stream_write_all (stream, text, strlen (text), NULL, NULL,
+                                      error);
+}
+
+/* Makes one pass over the calendar and writes every component whose UID is
+ * in the set. Written UIDs are removed from the set.
+ */
+static gboolean export_selected_from (GOutputStream *stream,
+                                      icalcomponent *base,
+                                      GHashTable *uid_set,
+                                      GError **error)
+{
+    icalcomponent *c;
     const gchar *uid_ical;
 
     for (c = icalcomponent_get_first_component (base, ICAL_ANY_COMPONENT);
-         c != 0 && !key_found;
+         c != NULL && g_hash_table_size (uid_set) != 0;
          c = icalcomponent_get_next_component (base, ICAL_ANY_COMPONENT))
     {
         uid_ical = icalcomponent_get_uid (c);
         if (uid_ical == NULL)
             g_warning ("component missing uid, skipping");
-        else if (strcmp (uid, uid_ical) == 0)
+        else if (g_hash_table_remove (uid_set, uid_ical))
         {
-            d = icalcomponent_new_clone (c);
-            icalcomponent_add_component (x_ical, d);
-            key_found = TRUE;
+            if (export_write (stream, icalcomponent_as_ical_string (c),
+                              error) == FALSE)
+            {
+                return FALSE;
+            }
         }
     }
 
-    if (key_found == FALSE)
-        g_warning ("uid '%s' not found in Orage data", uid);
+    return TRUE;
+}
+
+static gboolean export_all_from (GOutputStream *stream, icalcomponent *base,
+                                 GError **error)
+{
+    icalcomponent *c;
+
+    for (c = icalcomponent_get_first_component (base, ICAL_ANY_COMPONENT);
+         c != NULL;
+         c = icalcomponent_get_next_component (base, ICAL_ANY_COMPONENT))
+    {
+        if (export_write (stream, icalcomponent_as_ical_string (c),
+                          error) == FALSE)
+        {
+            return FALSE;
+        }
+    }
 
-    return key_found;
+    return TRUE;
 }
 
-static gboolean export_selected (const gchar *file_name, const gchar *uids)
+typedef struct _export_shard_data
 {
-    icalcomponent *x_ical = NULL;
-    icalset *x_fical = NULL;
-    gchar *uid_end;
-    const gchar *uid;
-    gboolean more_uids;
-    gboolean result;
-    gint i;
+    GOutputStream *stream;
+    GHashTable *uid_set; /* NULL exports everything */
+    GError **error;
+} export_shard_data;
 
-    if (export_prepare_write_file (file_name) == FALSE)
-        return FALSE;
+static void export_from_shard (icalcomponent *base, gpointer user_data)
+{
+    export_shard_data *data = user_data;
+
+    if (*data->error != NULL)
+        return;
 
-    if (xfce_str_is_empty (uids))
+    if (data->uid_set == NULL)
+        (void)export_all_from (data->stream, base, data->error);
+    else if (g_hash_table_size (data->uid_set) != 0)
     {
-        g_warning ("uid list is empty");
+        (void)export_selected_from (data->stream, base, data->uid_set,
+                                    data->error);
+    }
+}
+
+/* Main calendar and its year shards written as one calendar. */
+static gboolean export_all_with_shards (GFile *file)
+{
+    GFileOutputStream *stream;
+    export_shard_data shard_data;
+    GCancellable *cancellable;
+    GError *error = NULL;
+    gchar *file_name;
+
+    if (xfical_file_open (TRUE) == FALSE)
         return FALSE;
+
+    stream = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_NONE, NULL,
+                             &error);
+    if (stream != NULL)
+    {
+        if (export_write (G_OUTPUT_STREAM (stream),
+                          "BEGIN:VCALENDAR\r\n"
+                          "VERSION:2.0\r\n"
+                          "PRODID:-//Xfce//Orage//EN\r\n", &error)
+         && export_all_from (G_OUTPUT_STREAM (stream), ic_ical, &error))
+        {
+            shard_data.stream = G_OUTPUT_STREAM (stream);
+            shard_data.uid_set = NULL;
+            shard_data.error = &error;
+            ic_shards_foreach (G_MININT, export_from_shard, &shard_data);
+        }
+
+        if (error == NULL)
+        {
+            (void)export_write (G_OUTPUT_STREAM (stream), "END:VCALENDAR\r\n",
+                                &error);
+        }
+
+        if (error == NULL)
+        {
+            (void)g_output_stream_close (G_OUTPUT_STREAM (stream), NULL,
+                                         &error);
+        }
+        else
+        {
+            /* Closing with cancelled cancellable leaves the old file intact. */
+            cancellable = g_cancellable_new ();
+            g_cancellable_cancel (cancellable);
+            (void)g_output_stream_close (G_OUTPUT_STREAM (stream), cancellable,
+                                         NULL);
+            g_object_unref (cancellable);
+        }
+
+        g_object_unref (stream);
     }
 
-    if (ic_internal_file_open (&x_ical, &x_fical, file_name, FALSE, FALSE) == FALSE)
+    xfical_file_close (TRUE);
+
+    if (error != NULL)
     {
-        g_warning ("failed to create export file '%s'", file_name);
+        file_name = g_file_get_path (file);
+        g_warning ("could not write export file '%s': %s", file_name,
+                   error->message);
+        g_free (file_name);
+        g_error_free (error);
         return FALSE;
     }
 
-    if (xfical_file_open (TRUE) == FALSE)
+    return TRUE;
+}
+
+static GHashTable *export_get_uid_set (GHashTable **uid_sets,
+                                       const gchar *uid)
+{
+    gint i;
+
+    if (uid[0] == 'O')
+        i = 0;
+    else if (uid[0] == 'F' && sscanf (uid, "F%02d", &i) == 1 &&
+             i >= 0 && i < g_par.foreign_count && ic_f_ical[i].ical != NULL)
+    {
+        i++;
+    }
+    else
+        return NULL;
+
+    if (uid_sets[i] == NULL)
+        uid_sets[i] = g_hash_table_new (g_str_hash, g_str_equal);
+
+    return uid_sets[i];
+}
+
+static gboolean export_selected (GFile *file, const gchar *uids)
+{
+    GHashTable *uid_sets[G_N_ELEMENTS (ic_f_ical) + 1] = {NULL};
+    GHashTable *uid_set;
+    GHashTableIter iter;
+    export_shard_data shard_data;
+    GFileOutputStream *stream;
+    GCancellable *cancellable;
+    GError *error = NULL;
+    gchar *file_name;
+    gchar **uid_list;
+    gpointer uid;
+    gboolean result;
+    guint i;
+
+    file_name = g_file_get_path (file);
+    result = export_prepare_write_file (file_name);
+
+    if (result && xfce_str_is_empty (uids))
+    {
+        g_warning ("uid list is empty");
+        result = FALSE;
+    }
+
+    if (result == FALSE || xfical_file_open (TRUE) == FALSE)
+    {
+        g_free (file_name);
         return FALSE;
+    }
 
-    /* checks done, let's start the real work */
-    more_uids = TRUE;
-    result = TRUE;
-    for (uid = uids; more_uids;)
+    /* Sort requested UIDs by calendar; keys point to the UID part after the
+     * file type prefix.
+     */
+    uid_list = g_strsplit (uids, ",", 0);
+    for (i = 0; uid_list[i] != NULL; i++)
     {
-        if (strlen (uid) < 5)
+        if (strlen (uid_list[i]) < 5)
         {
-            g_warning ("invalid uid '%s'", uid);
-            return FALSE;
+            g_warning ("invalid uid '%s'", uid_list[i]);
+            result = FALSE;
         }
+        else if ((uid_set = export_get_uid_set (uid_sets, uid_list[i])) != NULL)
+            g_hash_table_add (uid_set, uid_list[i] + 4);
+        else
+        {
+            g_warning ("unknown uid type '%s'", uid_list[i]);
+            result = FALSE;
+        }
+    }
 
-        uid_end = g_strstr_len (uid, strlen (uid), ",");
-        if (uid_end != NULL)
-            *uid_end = 0; /* uid ends here */
-        /* FIXME: proper messages to screen */
-        if (uid[0] == 'O')
-            result &= export_selected_uid (ic_ical, uid, x_ical);
-        else if (uid[0] == 'F')
+    stream = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_NONE, NULL,
+                             &error);
+    if (stream != NULL)
+    {
+        if (export_write (G_OUTPUT_STREAM (stream),
+                          "BEGIN:VCALENDAR\r\n"
+                          "VERSION:2.0\r\n"
+                          "PRODID:-//Xfce//Orage//EN\r\n", &error) == FALSE)
         {
-            sscanf (uid, "F%02d", &i);
-            if (i < g_par.foreign_count && ic_f_ical[i].ical != NULL)
-                result &= export_selected_uid (ic_f_ical[i].ical, uid, x_ical);
-            else
+            result = FALSE;
+        }
+
+        for (i = 0; i < G_N_ELEMENTS (uid_sets) && error == NULL; i++)
+        {
+            if (uid_sets[i] == NULL)
+                continue;
+
+            if (export_selected_from (G_OUTPUT_STREAM (stream),
+                                      i == 0 ? ic_ical : ic_f_ical[i - 1].ical,
+                                      uid_sets[i], &error) == FALSE)
             {
-                g_warning ("unknown foreign file number %d for uid '%s'", i, uid);
-                return FALSE;
+                result = FALSE;
+                break;
+            }
+
+            if (i == 0 && g_hash_table_size (uid_sets[i]) != 0)
+            {
+                shard_data.stream = G_OUTPUT_STREAM (stream);
+                shard_data.uid_set = uid_sets[i];
+                shard_data.error = &error;
+                ic_shards_foreach (G_MININT, export_from_shard, &shard_data);
+                if (error != NULL)
+                {
+                    result = FALSE;
+                    break;
+                }
+            }
+
+            g_hash_table_iter_init (&iter, uid_sets[i]);
+            while (g_hash_table_iter_next (&iter, &uid, NULL))
+            {
+                g_warning ("uid '%s' not found in Orage data", (gchar *)uid);
+                result = FALSE;
             }
         }
-        else
-            g_warning ("unknown uid type '%s'", uid);
 
-        if (uid_end != NULL) /* we have more uids */
-            uid = uid_end + 1; /* next uid starts here */
+        if (error == NULL)
+        {
+            (void)export_write (G_OUTPUT_STREAM (stream), "END:VCALENDAR\r\n",
+                                &error);
+        }
+
+        if (error == NULL)
+        {
+            (void)g_output_stream_close (G_OUTPUT_STREAM (stream), NULL,
+                                         &error);
+        }
         else
-            more_uids = FALSE;
+        {
+            /* Closing with cancelled cancellable leaves the old file intact. */
+            cancellable = g_cancellable_new ();
+            g_cancellable_cancel (cancellable);
+            (void)g_output_stream_close (G_OUTPUT_STREAM (stream), cancellable,
+                                         NULL);
+            g_object_unref (cancellable);
+        }
+
+        g_object_unref (stream);
+    }
+
+    if (error != NULL)
+    {
+        g_warning ("could not write export file '%s': %s", file_name,
+                   error->message);
+        g_error_free (error);
+        result = FALSE;
     }
 
+    for (i = 0; i < G_N_ELEMENTS (uid_sets); i++)
+    {
+        if (uid_sets[i])
+            g_hash_table_destroy (uid_sets[i]);
+    }
+
+    g_strfreev (uid_list);
+    g_free (file_name);
     xfical_file_close (TRUE);
-    icalset_mark (x_fical);
-    icalset_commit (x_fical);
-    icalset_free (x_fical);
+
     return result;
 }
 
@@ -763,11 +1204,18 @@ gboolean xfical_export_by_path (const gchar *file_name,
                                 const gint type,
                                 const gchar *uids)
 {
+    GFile *file;
+    gboolean result;
+    ORAGE_TRACE_SCOPE ("export");
+
     if (type == 0) { /* copy the whole file */
         return(export_all(file_name));
     }
     else if (type == 1) { /* copy only selected appointments */
-        return(export_selected(file_name, uids));
+        file = g_file_new_for_path (file_name);
+        result = export_selected (file, uids);
+        g_object_unref (file);
+        return result;
     }
     else {
         g_critical ("unknown export type %d", type);
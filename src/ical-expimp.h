@@ -26,6 +26,20 @@
 #include <glib.h>
 
 gboolean orage_calendar_import_file (GFile *file, const gchar *id);
+
+/** Add or replace appointments in one transaction. Calendar file is written
+ *  and alarms are rebuilt once for the whole batch, and nothing is stored if
+ *  some component is not valid.
+ *  @param components NULL terminated array of serialized VEVENT, VTODO or
+ *         VJOURNAL components, each optionally wrapped in VCALENDAR
+ *  @param dest foreign calendar file or name, NULL or empty for the main
+ *         calendar
+ *  @param error location for error, or NULL
+ *  @return NULL terminated array of UIDs with file type prefix in input
+ *          order, free with g_strfreev. NULL on failure.
+ */
+gchar **orage_calendar_store_components (const gchar * const *components,
+                                         const gchar *dest, GError **error);
 gboolean xfical_export_file (GFile *file, const gchar *uids);
 
 gboolean xfical_import_by_path (const gchar *file_name);
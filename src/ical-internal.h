@@ -47,10 +47,6 @@ typedef struct _foreign_ical_files
 
 extern icalset *ic_fical;
 extern icalcomponent *ic_ical;
-#ifdef HAVE_ARCHIVE
-extern icalset *ic_afical;
-extern icalcomponent *ic_aical;
-#endif
 extern gboolean ic_file_modified; /* has any ical file been changed */
 extern ic_foreign_ical_files ic_f_ical[10];
 
@@ -63,6 +59,138 @@ char *ic_generate_uid(void);
 struct icaltimetype ic_convert_to_timezone(struct icaltimetype t
         , icalproperty *p);
 
+/** Rebuild alarm list from already opened calendar files. */
+void xfical_alarm_build_list_internal(gboolean first_list_today);
+
+/** Find time when the last occurrence of the component ends.
+ *  @param c calendar component
+ *  @param end (out) end time of the last occurrence in local time
+ *  @return FALSE for series which do not end
+ */
+gboolean ic_get_event_end (icalcomponent *c, struct icaltimetype *end);
+
+/** Called for each loaded year shard or archive segment.
+ *  @param base VCALENDAR component of the shard or segment
+ *  @param user_data user data given to the foreach function
+ */
+typedef void (*ic_calendar_func) (icalcomponent *base, gpointer user_data);
+
+/** Move ended events of the main calendar to year shards once a year, or
+ *  move everything back when shards are not in use anymore. Main calendar
+ *  must be open.
+ */
+void ic_shards_check (void);
+
+/** Call func for shards of first_year and later years, loading them when
+ *  needed. Does nothing when shards are not in use.
+ */
+void ic_shards_foreach (gint first_year, ic_calendar_func func,
+                        gpointer user_data);
+
+/** Call func for shards which are in memory, without loading others. */
+void ic_shards_foreach_loaded (ic_calendar_func func, gpointer user_data);
+
+/** Find component from year shards.
+ *  @param uid UID without file type prefix
+ *  @param base (out) VCALENDAR component of the shard where it was found
+ *  @return component or NULL when not found
+ */
+icalcomponent *ic_shards_find_uid (const gchar *uid, icalcomponent **base);
+
+/** Get shard by its position among shard files, oldest first.
+ *  @param n position of the shard
+ *  @param path (out) file name of the shard, free with g_free
+ *  @param base (out) VCALENDAR component of the shard
+ *  @return FALSE when there is no such shard
+ */
+gboolean ic_shards_get (guint n, gchar **path, icalcomponent **base);
+
+/** Mark shard as changed, so that it is written on next commit. */
+void ic_shards_mark (icalcomponent *base);
+
+/** Write changed shards. */
+void ic_shards_commit (void);
+
+/** Write changed shards and drop all of them from memory. */
+void ic_shards_close (void);
+
+#ifdef HAVE_ARCHIVE
+/** Date of icaltimetype as YYYYMMDD number, used for archive date ranges. */
+#define IC_ARCHIVE_DAY(t) ((t).year * 10000 + (t).month * 100 + (t).day)
+
+/** Read the archive manifest, splitting an archive file of older versions
+ *  into segments when needed.
+ *  @return FALSE if the archive could not be read
+ */
+gboolean ic_archive_open (void);
+
+/** Write changed segments and the manifest.
+ *  @return FALSE if some of them could not be written
+ */
+gboolean ic_archive_commit (void);
+
+/** Write changed segments and drop all of them from memory. */
+void ic_archive_close (void);
+
+/** Drop all segments from memory without writing them, after a failed
+ *  commit.
+ */
+void ic_archive_discard (void);
+
+/** Add component to the segment of the year when it ends.
+ *  @param c component without parent, owned by the archive after the call
+ *  @return FALSE if the segment could not be opened
+ */
+gboolean ic_archive_add (icalcomponent *c);
+
+/** Remove component from the segment. Caller owns the component after
+ *  the call.
+ */
+void ic_archive_remove (icalcomponent *base, icalcomponent *c);
+
+/** Find next segment which may have components between first_day and
+ *  last_day, both in YYYYMMDD format, and parse it when needed.
+ *  @param n (in/out) position of the segment to start from
+ *  @return VCALENDAR component of the segment or NULL after the last one
+ */
+icalcomponent *ic_archive_next_in_range (guint *n, gint first_day,
+                                         gint last_day);
+
+/** Call func for segments which may have components between first_day and
+ *  last_day, both in YYYYMMDD format.
+ */
+void ic_archive_foreach (gint first_day, gint last_day,
+                         ic_calendar_func func, gpointer user_data);
+
+/** Call func for segments which are parsed, without loading others. */
+void ic_archive_foreach_loaded (ic_calendar_func func, gpointer user_data);
+
+/** Find component from segments whose UID filter matches.
+ *  @param uid UID without file type prefix
+ *  @param base (out) VCALENDAR component of the segment where it was found
+ *  @return component or NULL when not found
+ */
+icalcomponent *ic_archive_find_uid (const gchar *uid, icalcomponent **base);
+
+/** Get file name of nth segment without parsing it.
+ *  @return file name, free with g_free, or NULL after the last segment
+ */
+gchar *ic_archive_get_path (guint n);
+
+/** Parse segment by its file name.
+ *  @return VCALENDAR component of the segment or NULL
+ */
+icalcomponent *ic_archive_load_file (const gchar *path);
+
+/** Move all archived components to target. Nothing is moved if some
+ *  segment cannot be parsed.
+ */
+gboolean ic_archive_take_all (icalcomponent *target);
+
+/** Remove all segment files and the manifest. */
+void ic_archive_remove_all (void);
+#endif
+
 /**
  * is_todo_completed:
  * @per: pointer to an #xfical_period structure
@@ -0,0 +1,576 @@
+/*
+ * Copyright (c) 2026 Erkki Moorits
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ *     Free Software Foundation
+ *     51 Franklin Street, 5th Floor
+ *     Boston, MA 02110-1301 USA
+ */
+
+/* Year shards of the main calendar.
+ *
+ * When enabled, events which have ended before the current year are moved
+ * from the main calendar file to <main file>.d/<year>.ics, where year is the
+ * year of their last occurrence. The main file keeps current and future
+ * events, open ended series, todos and journals, so day to day edits
+ * rewrite only that. Shards are read when a query reaches their year and
+ * stay in memory as long as the main file is open.
+ */
+
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <libical/ical.h>
+#include <libical/icalss.h>
+
+#include "ical-code.h"
+#include "ical-internal.h"
+#include "parameters.h"
+
+#if ICAL_CHECK_VERSION(4, 0, 0)
+#define icaltime_add icalduration_extend
+#endif
+
+/* Series with more occurrences than this are treated as open ended. */
+#define SHARD_RECUR_MAX 100000
+
+typedef struct _ical_shard
+{
+    icalset *fical;
+    icalcomponent *ical;
+} ical_shard;
+
+/* Year -> ical_shard of loaded shards. */
+static GHashTable *shards = NULL;
+
+/* Sorted years of shard files on disk, NULL when not scanned yet. */
+static GArray *shard_years = NULL;
+
+/* Year for which the main file was last checked for ended events. */
+static gint shards_checked_year = 0;
+
+static gchar *shard_dir (void)
+{
+    return g_strconcat (g_par.orage_file, ".d", NULL);
+}
+
+static gchar *shard_path (const gint year)
+{
+    gchar *dir;
+    gchar *path;
+
+    dir = shard_dir ();
+    path = g_strdup_printf ("%s%c%04d.ics", dir, G_DIR_SEPARATOR, year);
+    g_free (dir);
+
+    return path;
+}
+
+static gint compare_years (gconstpointer a, gconstpointer b)
+{
+    return *(const gint *)a - *(const gint *)b;
+}
+
+static GArray *shards_scan (void)
+{
+    GDir *dir;
+    const gchar *name;
+    gchar *dir_name;
+    gchar *end;
+    gint year;
+
+    if (shard_years)
+        return shard_years;
+
+    shard_years = g_array_new (FALSE, FALSE, sizeof (gint));
+    dir_name = shard_dir ();
+    dir = g_dir_open (dir_name, 0, NULL);
+    if (dir)
+    {
+        while ((name = g_dir_read_name (dir)) != NULL)
+        {
+            year = (gint)g_ascii_strtoll (name, &end, 10);
+            if (end == name + 4 && strcmp (end, ".ics") == 0)
+                g_array_append_val (shard_years, year);
+        }
+
+        g_dir_close (dir);
+        g_array_sort (shard_years, compare_years);
+    }
+
+    g_free (dir_name);
+
+    return shard_years;
+}
+
+static void shard_free (gpointer data)
+{
+    ical_shard *shard = data;
+
+    /* writes the shard if it was changed */
+    icalset_free (shard->fical);
+    g_free (shard);
+}
+
+static ical_shard *shard_open (const gint year, const gboolean create)
+{
+    ical_shard *shard;
+    gchar *path;
+    gchar *dir;
+
+    if (shards == NULL)
+    {
+        shards = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+                                        shard_free);
+    }
+    else if ((shard = g_hash_table_lookup (shards, GINT_TO_POINTER (year))))
+        return shard;
+
+    path = shard_path (year);
+    if (!g_file_test (path, G_FILE_TEST_EXISTS))
+    {
+        if (!create)
+        {
+            g_free (path);
+            return NULL;
+        }
+
+        dir = shard_dir ();
+        if (g_mkdir_with_parents (dir, 0700) != 0)
+        {
+            g_warning ("failed to create calendar shard directory '%s'", dir);
+            g_free (dir);
+            g_free (path);
+            return NULL;
+        }
+
+        g_free (dir);
+
+        /* new shard file, list of years must be read again */
+        if (shard_years)
+        {
+            g_array_free (shard_years, TRUE);
+            shard_years = NULL;
+        }
+    }
+
+    shard = g_new0 (ical_shard, 1);
+    shard->fical = icalset_new_file (path);
+    if (shard->fical == NULL)
+    {
+        g_warning ("failed to open calendar shard '%s'", path);
+        g_free (shard);
+        g_free (path);
+        return NULL;
+    }
+
+    shard->ical = icalset_get_first_component (shard->fical);
+    if (shard->ical == NULL)
+    {
+        shard->ical = icalcomponent_vanew (ICAL_VCALENDAR_COMPONENT
+                , icalproperty_new_version ("2.0")
+                , icalproperty_new_prodid ("-//Xfce//Orage//EN")
+                , NULL);
+        icalset_add_component (shard->fical, shard->ical);
+    }
+
+    g_hash_table_insert (shards, GINT_TO_POINTER (year), shard);
+    g_debug ("loaded calendar shard '%s'", path);
+    g_free (path);
+
+    return shard;
+}
+
+gboolean ic_get_event_end (icalcomponent *c, struct icaltimetype *end)
+{
+    xfical_period per;
+    icalproperty *p;
+    icalrecur_iterator *ri;
+    struct icaltimetype next;
+    struct icaltimetype last;
+    gint cnt;
+#if ICAL_CHECK_VERSION(4, 0, 0)
+    struct icalrecurrencetype *rrule;
+#else
+    struct icalrecurrencetype rrule;
+#endif
+
+    per = ic_get_period (c, TRUE);
+    p = icalcomponent_get_first_property (c, ICAL_RRULE_PROPERTY);
+    if (p == NULL)
+    {
+        *end = per.etime;
+        return TRUE;
+    }
+
+    rrule = icalproperty_get_rrule (p);
+#if ICAL_CHECK_VERSION(4, 0, 0)
+    if (rrule == NULL)
+        return FALSE;
+    if (rrule->count == 0 && icaltime_is_null_time (rrule->until))
+        return FALSE;
+#else
+    if (rrule.count == 0 && icaltime_is_null_time (rrule.until))
+        return FALSE;
+#endif
+
+    last = icaltime_null_time ();
+    ri = icalrecur_iterator_new (rrule, per.stime);
+    for (cnt = 0, next = icalrecur_iterator_next (ri);
+         !icaltime_is_null_time (next) && cnt < SHARD_RECUR_MAX;
+         cnt++, next = icalrecur_iterator_next (ri))
+    {
+        last = next;
+    }
+
+    icalrecur_iterator_free (ri);
+
+    if (cnt == SHARD_RECUR_MAX)
+        return FALSE;
+
+    *end = icaltime_is_null_time (last) ? per.etime
+                                        : icaltime_add (last, per.duration);
+
+    return TRUE;
+}
+
+/* Occurrences overriding single instances of a series share UID with the
+ * series and must stay in the same file, so such UIDs are never moved.
+ */
+static GHashTable *shards_overridden_uids (icalcomponent *base)
+{
+    GHashTable *uids;
+    icalcomponent *c;
+    const gchar *uid;
+
+    uids = g_hash_table_new (g_str_hash, g_str_equal);
+    for (c = icalcomponent_get_first_component (base, ICAL_VEVENT_COMPONENT);
+         c != NULL;
+         c = icalcomponent_get_next_component (base, ICAL_VEVENT_COMPONENT))
+    {
+        uid = icalcomponent_get_uid (c);
+        if (uid && icalcomponent_get_first_property (c,
+                                                ICAL_RECURRENCEID_PROPERTY))
+        {
+            g_hash_table_add (uids, (gpointer)uid);
+        }
+    }
+
+    return uids;
+}
+
+/* Move ended events from the main file to shards. */
+static void shards_rollover (const gint year_now)
+{
+    GHashTable *overridden;
+    icalcomponent *c;
+    icalcomponent *next;
+    struct icaltimetype end;
+    ical_shard *shard;
+    const gchar *uid;
+    gint moved = 0;
+
+    overridden = shards_overridden_uids (ic_ical);
+
+    for (c = icalcomponent_get_first_component (ic_ical,
+                                                ICAL_VEVENT_COMPONENT);
+         c != NULL;
+         c = next)
+    {
+        /* removing moves the iterator, so take the next one first */
+        next = icalcomponent_get_next_component (ic_ical,
+                                                 ICAL_VEVENT_COMPONENT);
+
+        uid = icalcomponent_get_uid (c);
+        if (uid == NULL || g_hash_table_contains (overridden, uid)
+         || icalcomponent_get_first_property (c, ICAL_RDATE_PROPERTY))
+        {
+            continue;
+        }
+
+        if (!ic_get_event_end (c, &end) || end.year >= year_now)
+            continue;
+
+        if ((shard = shard_open (end.year, TRUE)) == NULL)
+            continue;
+
+        icalcomponent_remove_component (ic_ical, c);
+        icalcomponent_add_component (shard->ical, c);
+        icalset_mark (shard->fical);
+        moved++;
+    }
+
+    g_hash_table_destroy (overridden);
+
+    if (moved == 0)
+        return;
+
+    /* shards first: if writing the main file fails, events are in both
+     * files instead of neither */
+    ic_shards_commit ();
+    icalset_mark (ic_fical);
+    icalset_commit (ic_fical);
+    ic_file_modified = TRUE;
+    xfical_cache_invalidate ();
+    g_message ("moved %d ended events to yearly calendar shards", moved);
+}
+
+/* Sharding was turned off, move everything back to the main file. */
+static void shards_merge_back (void)
+{
+    GArray *years;
+    ical_shard *shard;
+    icalcomponent *c;
+    gchar *path;
+    gchar *dir;
+    GPtrArray *moved;
+    GPtrArray *moved_from;
+    guint i;
+    gint year;
+
+    years = shards_scan ();
+    if (years->len == 0)
+        return;
+
+    moved = g_ptr_array_new ();
+    moved_from = g_ptr_array_new ();
+    for (i = 0; i < years->len; i++)
+    {
+        year = g_array_index (years, gint, i);
+        if ((shard = shard_open (year, FALSE)) == NULL)
+            continue;
+
+        while ((c = icalcomponent_get_first_component (shard->ical,
+                                                  ICAL_ANY_COMPONENT)))
+        {
+            icalcomponent_remove_component (shard->ical, c);
+            icalcomponent_add_component (ic_ical, c);
+            g_ptr_array_add (moved, c);
+            g_ptr_array_add (moved_from, shard->ical);
+        }
+    }
+
+    icalset_mark (ic_fical);
+    if (icalset_commit (ic_fical) != ICAL_NO_ERROR)
+    {
+        g_warning ("failed to write calendar file, shards are kept");
+
+        /* main calendar in memory must match the file again */
+        for (i = 0; i < moved->len; i++)
+        {
+            c = g_ptr_array_index (moved, i);
+            icalcomponent_remove_component (ic_ical, c);
+            icalcomponent_add_component (g_ptr_array_index (moved_from, i),
+                                         c);
+        }
+
+        g_ptr_array_free (moved, TRUE);
+        g_ptr_array_free (moved_from, TRUE);
+        ic_shards_close ();
+        shards_checked_year = 0; /* try again on next check */
+        return;
+    }
+
+    /* shards were not marked changed, so closing does not write them */
+    years = g_array_copy (years);
+    ic_shards_close ();
+
+    for (i = 0; i < years->len; i++)
+    {
+        path = shard_path (g_array_index (years, gint, i));
+        if (g_remove (path) != 0)
+            g_warning ("failed to remove calendar shard '%s'", path);
+        g_free (path);
+    }
+
+    g_array_free (years, TRUE);
+    dir = shard_dir ();
+    (void)g_rmdir (dir);
+    g_free (dir);
+
+    ic_file_modified = TRUE;
+    xfical_cache_invalidate ();
+    g_message ("moved %u events from yearly calendar shards back to the main "
+               "calendar", moved->len);
+    g_ptr_array_free (moved, TRUE);
+    g_ptr_array_free (moved_from, TRUE);
+}
+
+void ic_shards_check (void)
+{
+    GDateTime *gdt;
+    gint year_now;
+
+    gdt = g_date_time_new_now_local ();
+    year_now = g_date_time_get_year (gdt);
+    g_date_time_unref (gdt);
+
+    if (shards_checked_year == year_now)
+        return;
+
+    shards_checked_year = year_now;
+
+    if (g_par.main_shards)
+        shards_rollover (year_now);
+    else
+        shards_merge_back ();
+}
+
+void ic_shards_foreach (const gint first_year, ic_calendar_func func,
+                        gpointer user_data)
+{
+    GArray *years;
+    ical_shard *shard;
+    guint i;
+    gint year;
+
+    if (!g_par.main_shards)
+        return;
+
+    years = shards_scan ();
+    for (i = 0; i < years->len; i++)
+    {
+        year = g_array_index (years, gint, i);
+        if (year < first_year)
+            continue;
+
+        if ((shard = shard_open (year, FALSE)) != NULL)
+            func (shard->ical, user_data);
+    }
+}
+
+void ic_shards_foreach_loaded (ic_calendar_func func, gpointer user_data)
+{
+    GHashTableIter iter;
+    gpointer value;
+
+    if (shards == NULL)
+        return;
+
+    g_hash_table_iter_init (&iter, shards);
+    while (g_hash_table_iter_next (&iter, NULL, &value))
+        func (((ical_shard *)value)->ical, user_data);
+}
+
+icalcomponent *ic_shards_find_uid (const gchar *uid, icalcomponent **base)
+{
+    GArray *years;
+    ical_shard *shard;
+    icalcomponent *c;
+    const gchar *c_uid;
+    guint i;
+
+    if (!g_par.main_shards)
+        return NULL;
+
+    /* edited events are usually recent, so start from the newest */
+    years = shards_scan ();
+    for (i = years->len; i-- > 0;)
+    {
+        shard = shard_open (g_array_index (years, gint, i), FALSE);
+        if (shard == NULL)
+            continue;
+
+        for (c = icalcomponent_get_first_component (shard->ical,
+                                                    ICAL_ANY_COMPONENT);
+             c != NULL;
+             c = icalcomponent_get_next_component (shard->ical,
+                                                   ICAL_ANY_COMPONENT))
+        {
+            c_uid = icalcomponent_get_uid (c);
+            if (c_uid && strcmp (c_uid, uid) == 0)
+            {
+                *base = shard->ical;
+                return c;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+gboolean ic_shards_get (const guint n, gchar **path, icalcomponent **base)
+{
+    GArray *years;
+    ical_shard *shard;
+    gint year;
+
+    if (!g_par.main_shards)
+        return FALSE;
+
+    years = shards_scan ();
+    if (n >= years->len)
+        return FALSE;
+
+    year = g_array_index (years, gint, n);
+    *path = shard_path (year);
+    if ((shard = shard_open (year, FALSE)) == NULL)
+    {
+        g_clear_pointer (path, g_free);
+        return FALSE;
+    }
+
+    /* file content must match the loaded shard */
+    icalset_commit (shard->fical);
+    *base = shard->ical;
+
+    return TRUE;
+}
+
+void ic_shards_mark (icalcomponent *base)
+{
+    GHashTableIter iter;
+    gpointer value;
+    ical_shard *shard;
+
+    if (shards == NULL)
+        return;
+
+    g_hash_table_iter_init (&iter, shards);
+    while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+        shard = value;
+        if (shard->ical == base)
+        {
+            icalset_mark (shard->fical);
+            return;
+        }
+    }
+}
+
+void ic_shards_commit (void)
+{
+    GHashTableIter iter;
+    gpointer value;
+
+    if (shards == NULL)
+        return;
+
+    g_hash_table_iter_init (&iter, shards);
+    while (g_hash_table_iter_next (&iter, NULL, &value))
+        icalset_commit (((ical_shard *)value)->fical);
+}
+
+void ic_shards_close (void)
+{
+    g_clear_pointer (&shards, g_hash_table_destroy);
+
+    if (shard_years)
+    {
+        g_array_free (shard_years, TRUE);
+        shard_years = NULL;
+    }
+}
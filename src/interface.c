@@ -64,10 +64,21 @@ static gboolean interface_lock = FALSE;
 
 static void refresh_foreign_files(intf_win *intf_w, const gboolean first);
 
+static void external_update_refresh (void)
+{
+    OrageApplication *app;
+
+    g_message ("refreshing alarms and calendar due to external update");
+    xfical_file_close_force();
+    xfical_alarm_build_list(FALSE);
+    app = ORAGE_APPLICATION (g_application_get_default ());
+    orage_window_update_appointments (
+        ORAGE_WINDOW (orage_application_get_window (app)));
+}
+
 gboolean orage_external_update_check (G_GNUC_UNUSED gpointer user_data)
 {
     struct stat s;
-    OrageApplication *app;
     gint i;
     gboolean external_changes_present = FALSE;
 
@@ -101,18 +112,42 @@ gboolean orage_external_update_check (G_GNUC_UNUSED gpointer user_data)
         }
     }
 
-    if (external_changes_present) {
-        g_message ("refreshing alarms and calendar due to external update");
-        xfical_file_close_force();
-        xfical_alarm_build_list(FALSE);
-        app = ORAGE_APPLICATION (g_application_get_default ());
-        orage_window_update_appointments (
-            ORAGE_WINDOW (orage_application_get_window (app)));
-    }
+    if (external_changes_present)
+        external_update_refresh();
 
     return(TRUE); /* keep running */
 }
 
+gboolean orage_external_update_file (const gchar *filename)
+{
+    struct stat s;
+    time_t *latest_file_change = NULL;
+    gint i;
+
+    g_return_val_if_fail (filename != NULL, FALSE);
+
+    if (strcmp(g_par.orage_file, filename) == 0)
+        latest_file_change = &g_par.latest_file_change;
+    for (i = 0; i < g_par.foreign_count && !latest_file_change; i++) {
+        if (strcmp(g_par.foreign_data[i].file, filename) == 0)
+            latest_file_change = &g_par.foreign_data[i].latest_file_change;
+    }
+
+    if (latest_file_change == NULL) {
+        g_warning ("file '%s' is not an Orage calendar file", filename);
+        return(FALSE);
+    }
+
+    /* remember the time so that the periodic check does not reload again */
+    if (g_stat(filename, &s) == 0)
+        *latest_file_change = s.st_mtime;
+
+    g_message ("reloading calendar file '%s'", filename);
+    external_update_refresh();
+
+    return(TRUE);
+}
+
 static void orage_file_entry_changed (G_GNUC_UNUSED GtkWidget *dialog,
                                       gpointer user_data)
 {
@@ -205,17 +240,21 @@ static void archive_file_save_button_clicked (G_GNUC_UNUSED GtkButton *button
         , gpointer user_data)
 {
     intf_win *intf_w = (intf_win *)user_data;
-    gchar *s;
-    gboolean ok = TRUE;
+    gchar *s, *segments;
+    gboolean ok = TRUE, segmented;
 
     s = g_strdup(gtk_entry_get_text(GTK_ENTRY(intf_w->archive_file_entry)));
     if (gtk_toggle_button_get_active(
             GTK_TOGGLE_BUTTON(intf_w->archive_file_rename_rb))) {
-        if (!g_file_test(s, G_FILE_TEST_EXISTS)) {
+        /* archive may consist of segments only */
+        segments = g_strconcat(s, ".d", NULL);
+        segmented = g_file_test(segments, G_FILE_TEST_IS_DIR);
+        g_free(segments);
+        if (!segmented && !g_file_test(s, G_FILE_TEST_EXISTS)) {
             g_warning ("file '%s' does not exist; rename not performed", s);
             ok = FALSE;
         }
-        if (!xfical_file_check(s)) {
+        else if (!segmented && !xfical_file_check(s)) {
             g_warning ("file '%s' is not a valid iCal calendar file; rename "
                        "not performed", s);
             ok = FALSE;
@@ -223,21 +262,11 @@ static void archive_file_save_button_clicked (G_GNUC_UNUSED GtkButton *button
     }
     else if (gtk_toggle_button_get_active(
             GTK_TOGGLE_BUTTON(intf_w->archive_file_copy_rb))) {
-        ok = orage_copy_file(g_par.archive_file, s);
+        ok = xfical_archive_copy(s, FALSE);
     }
     else if (gtk_toggle_button_get_active(
             GTK_TOGGLE_BUTTON(intf_w->archive_file_move_rb))) {
-        if (g_rename(g_par.archive_file, s)) { /* failed */
-            g_warning ("rename failed; attempting manual copy");
-            ok = orage_copy_file(g_par.archive_file, s);
-            if (ok) { /* this is move. so let's remove the orig */
-                if (g_remove(g_par.archive_file))
-                {
-                    g_warning ("failed to remove original file '%s'",
-                               g_par.archive_file);
-                }
-            }
-        }
+        ok = xfical_archive_copy(s, TRUE);
     }
     else {
         g_warning ("illegal file save toggle button status");
@@ -450,7 +479,6 @@ gboolean orage_import_file (const gchar *entry_filename)
         app = ORAGE_APPLICATION (g_application_get_default ());
         orage_window_update_appointments (ORAGE_WINDOW (
             orage_application_get_window (app)));
-        xfical_alarm_build_list(FALSE);
         return(TRUE);
     }
     else
@@ -581,6 +609,7 @@ static void orage_foreign_file_remove_line(gint del_line)
     g_par.foreign_data[i].name = NULL;
 
     write_parameters();
+    xfical_cache_invalidate ();
     app = ORAGE_APPLICATION (g_application_get_default ());
     orage_window_update_appointments (ORAGE_WINDOW (
         orage_application_get_window (app)));
@@ -786,6 +815,7 @@ static gboolean orage_foreign_file_add_internal (const gchar *filename,
     g_par.foreign_count++;
 
     write_parameters();
+    xfical_cache_invalidate ();
     app = ORAGE_APPLICATION (g_application_get_default ());
     orage_window_update_appointments (ORAGE_WINDOW (
         orage_application_get_window (app)));
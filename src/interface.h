@@ -100,6 +100,12 @@ typedef struct _intf_win
 void orage_external_interface (void);
 
 gboolean orage_external_update_check(gpointer user_data);
+
+/** Reload calendar file now, for example after it was synchronized.
+ *  @param filename file name of the main or a foreign calendar file
+ *  @return FALSE if file is not an Orage calendar file
+ */
+gboolean orage_external_update_file (const gchar *filename);
 gboolean orage_foreign_file_add (const gchar *filename, gboolean read_only,
                                  const gchar *name);
 
@@ -23,6 +23,7 @@
 #include "orage-application.h"
 #include "orage-dbus.h"
 #include "orage-i18n.h"
+#include "orage-trace.h"
 
 #include <glib.h>
 #include <gio/gio.h>
@@ -44,6 +45,7 @@ static gboolean quit_handler (gpointer orage_app)
 int main (int argc, char **argv)
 {
     GError *error = NULL;
+    gint status;
 
     g_autoptr (OrageApplication) orage_app = NULL;
 
@@ -63,5 +65,10 @@ int main (int argc, char **argv)
         g_clear_error (&error);
     }
 
-    return g_application_run (G_APPLICATION (orage_app), argc, argv);;
+    status = g_application_run (G_APPLICATION (orage_app), argc, argv);
+
+    /* spans of the whole run, including shutdown */
+    orage_trace_stop ();
+
+    return status;
 }
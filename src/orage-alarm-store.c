@@ -0,0 +1,532 @@
+/*
+ * Copyright (c) 2026 Erkki Moorits
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ *     Free Software Foundation
+ *     51 Franklin Street, 5th Floor
+ *     Boston, MA 02110-1301 USA
+ */
+
+#include "orage-alarm-store.h"
+
+#include "functions.h"
+#include "orage-alarm-structure.h"
+#include "orage-rc-file.h"
+#include "orage-time-utils.h"
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#define RC_ALARM_TIME "ALARM_TIME"
+#define RC_ACTION_TIME "ACTION_TIME"
+#define RC_TITLE "TITLE"
+#define RC_DESCRIPTION "DESCRIPTION"
+#define RC_DISPLAY_ORAGE "DISPLAY_ORAGE"
+#define RC_TEMPORARY "TEMPORARY"
+#define RC_DISPLAY_NOTIFY "DISPLAY_NOTIFY"
+#define RC_NOTIFY_TIMEOUT "NOTIFY_TIMEOUT"
+#define RC_AUDIO "AUDIO"
+#define RC_SOUND "SOUND"
+#define RC_REPEAT_CNT "REPEAT_CNT"
+#define RC_REPEAT_DELAY "REPEAT_DELAY"
+#define RC_PROCEDURE "PROCEDURE"
+#define RC_CMD "CMD"
+
+/* One record per line: UID and alarm data, or UID and nothing when the alarm
+ * is deleted.
+ */
+#define RECORD_TYPE "(sma{sv})"
+
+/* Log is compacted when stale records exceed both this limit and the number
+ * of live records.
+ */
+#define COMPACT_MIN_STALE 64
+
+typedef struct _alarm_store
+{
+    /** Serialized record of each stored alarm, keyed by UID. */
+    GHashTable *records;
+
+    /** Records in the log file, which are replaced or deleted by later
+     *  records.
+     */
+    guint stale_cnt;
+} alarm_store;
+
+static alarm_store *store = NULL;
+
+static void dict_add_str (GVariantBuilder *builder, const gchar *key,
+                          const gchar *val)
+{
+    if (val != NULL)
+        g_variant_builder_add (builder, "{sv}", key, g_variant_new_string (val));
+}
+
+static void dict_add_int (GVariantBuilder *builder, const gchar *key,
+                          const gint val)
+{
+    g_variant_builder_add (builder, "{sv}", key, g_variant_new_int32 (val));
+}
+
+static void dict_add_bool (GVariantBuilder *builder, const gchar *key,
+                           const gboolean val)
+{
+    g_variant_builder_add (builder, "{sv}", key, g_variant_new_boolean (val));
+}
+
+static gchar *record_print (const gchar *uid, GVariant *dict)
+{
+    GVariant *record;
+    gchar *text;
+
+    record = g_variant_ref_sink (g_variant_new ("(sm@a{sv})", uid, dict));
+    text = g_variant_print (record, TRUE);
+    g_variant_unref (record);
+
+    return text;
+}
+
+static gchar *alarm_to_record (const alarm_struct *l_alarm)
+{
+    GVariantBuilder builder;
+    gchar *icaltime;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+
+    icaltime = orage_gdatetime_to_icaltime (l_alarm->alarm_time, FALSE);
+    dict_add_str (&builder, RC_ALARM_TIME, icaltime);
+    g_free (icaltime);
+
+    dict_add_str (&builder, RC_ACTION_TIME, l_alarm->action_time);
+    dict_add_str (&builder, RC_TITLE, l_alarm->title);
+    dict_add_str (&builder, RC_DESCRIPTION, l_alarm->description);
+    dict_add_bool (&builder, RC_DISPLAY_ORAGE, l_alarm->display_orage);
+    dict_add_bool (&builder, RC_TEMPORARY, l_alarm->temporary);
+
+#ifdef HAVE_NOTIFY
+    dict_add_bool (&builder, RC_DISPLAY_NOTIFY, l_alarm->display_notify);
+    dict_add_int (&builder, RC_NOTIFY_TIMEOUT, l_alarm->notify_timeout);
+#endif
+
+    dict_add_bool (&builder, RC_AUDIO, l_alarm->audio);
+    dict_add_str (&builder, RC_SOUND, l_alarm->sound);
+    dict_add_int (&builder, RC_REPEAT_CNT, l_alarm->repeat_cnt);
+    dict_add_int (&builder, RC_REPEAT_DELAY, l_alarm->repeat_delay);
+    dict_add_bool (&builder, RC_PROCEDURE, l_alarm->procedure);
+    dict_add_str (&builder, RC_CMD, l_alarm->cmd);
+
+    return record_print (l_alarm->uid, g_variant_builder_end (&builder));
+}
+
+static alarm_struct *alarm_from_dict (const gchar *uid, GVariant *dict)
+{
+    alarm_struct *new_alarm;
+    const gchar *icaltime;
+
+    if (g_variant_lookup (dict, RC_ALARM_TIME, "&s", &icaltime) == FALSE)
+        return NULL;
+
+    new_alarm = orage_alarm_new ();
+    new_alarm->uid = g_intern_string (uid);
+    new_alarm->alarm_time = orage_icaltime_to_gdatetime (icaltime);
+    if (new_alarm->alarm_time == NULL)
+    {
+        g_warning ("skipping persistent alarm '%s' with invalid time '%s'",
+                   uid, icaltime);
+        orage_alarm_unref (new_alarm);
+        return NULL;
+    }
+
+    if (g_variant_lookup (dict, RC_ACTION_TIME, "s",
+                          &new_alarm->action_time) == FALSE)
+    {
+        new_alarm->action_time = g_strdup ("0000");
+    }
+
+    (void)g_variant_lookup (dict, RC_TITLE, "s", &new_alarm->title);
+    (void)g_variant_lookup (dict, RC_DESCRIPTION, "s",
+                            &new_alarm->description);
+    new_alarm->persistent = TRUE; /* this must be */
+    (void)g_variant_lookup (dict, RC_TEMPORARY, "b", &new_alarm->temporary);
+    (void)g_variant_lookup (dict, RC_DISPLAY_ORAGE, "b",
+                            &new_alarm->display_orage);
+
+#ifdef HAVE_NOTIFY
+    (void)g_variant_lookup (dict, RC_DISPLAY_NOTIFY, "b",
+                            &new_alarm->display_notify);
+    (void)g_variant_lookup (dict, RC_NOTIFY_TIMEOUT, "i",
+                            &new_alarm->notify_timeout);
+#endif
+
+    (void)g_variant_lookup (dict, RC_AUDIO, "b", &new_alarm->audio);
+    (void)g_variant_lookup (dict, RC_SOUND, "s", &new_alarm->sound);
+    (void)g_variant_lookup (dict, RC_REPEAT_CNT, "i", &new_alarm->repeat_cnt);
+
+    new_alarm->repeat_delay = 2;
+    (void)g_variant_lookup (dict, RC_REPEAT_DELAY, "i",
+                            &new_alarm->repeat_delay);
+    (void)g_variant_lookup (dict, RC_PROCEDURE, "b", &new_alarm->procedure);
+    (void)g_variant_lookup (dict, RC_CMD, "s", &new_alarm->cmd);
+
+    return new_alarm;
+}
+
+static gchar *alarm_store_get_path (void)
+{
+    return orage_data_file_location (ORAGE_PERSISTENT_ALARMS_LOG_DIR_FILE);
+}
+
+static void alarm_store_load_record (alarm_store *st, const gchar *text)
+{
+    GVariant *record;
+    GVariant *dict;
+    const gchar *uid;
+    GError *error = NULL;
+
+    record = g_variant_parse (G_VARIANT_TYPE (RECORD_TYPE), text, NULL, NULL,
+                              &error);
+    if (record == NULL)
+    {
+        g_warning ("skipping invalid persistent alarm record: %s",
+                   error->message);
+        g_error_free (error);
+        st->stale_cnt++;
+        return;
+    }
+
+    g_variant_get (record, "(&sm@a{sv})", &uid, &dict);
+    if (dict)
+    {
+        if (g_hash_table_replace (st->records, g_strdup (uid),
+                                  g_strdup (text)) == FALSE)
+        {
+            st->stale_cnt++;
+        }
+
+        g_variant_unref (dict);
+    }
+    else
+        st->stale_cnt += g_hash_table_remove (st->records, uid) ? 2 : 1;
+
+    g_variant_unref (record);
+}
+
+static alarm_store *alarm_store_get (void)
+{
+    gchar *path;
+    gchar *text;
+    gchar **lines;
+    GError *error = NULL;
+    guint i;
+
+    if (store)
+        return store;
+
+    store = g_new0 (alarm_store, 1);
+    store->records = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                            g_free, g_free);
+
+    path = alarm_store_get_path ();
+    if (g_file_get_contents (path, &text, NULL, &error))
+    {
+        lines = g_strsplit (text, "\n", -1);
+        for (i = 0; lines[i] != NULL; i++)
+        {
+            if (lines[i][0] != '\0')
+                alarm_store_load_record (store, lines[i]);
+        }
+
+        g_strfreev (lines);
+        g_free (text);
+        g_debug ("loaded %u persistent alarms, %u stale records",
+                 g_hash_table_size (store->records), store->stale_cnt);
+    }
+    else
+    {
+        if (g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT) == FALSE)
+        {
+            g_warning ("could not read persistent alarms file '%s': %s", path,
+                       error->message);
+        }
+
+        g_error_free (error);
+    }
+
+    g_free (path);
+
+    return store;
+}
+
+static void alarm_store_compact (alarm_store *st)
+{
+    GHashTableIter iter;
+    GString *text;
+    gchar *path;
+    gpointer record;
+    GError *error = NULL;
+
+    text = g_string_new (NULL);
+    g_hash_table_iter_init (&iter, st->records);
+    while (g_hash_table_iter_next (&iter, NULL, &record))
+    {
+        g_string_append (text, record);
+        g_string_append_c (text, '\n');
+    }
+
+    path = alarm_store_get_path ();
+    if (g_file_set_contents (path, text->str, text->len, &error))
+    {
+        g_debug ("compacted persistent alarms file, dropped %u stale records",
+                 st->stale_cnt);
+        st->stale_cnt = 0;
+    }
+    else
+    {
+        g_warning ("could not write persistent alarms file '%s': %s", path,
+                   error->message);
+        g_error_free (error);
+    }
+
+    g_free (path);
+    g_string_free (text, TRUE);
+}
+
+static void alarm_store_append (const GString *records)
+{
+    GFile *file;
+    GFileOutputStream *stream;
+    gchar *path;
+    GError *error = NULL;
+
+    path = alarm_store_get_path ();
+    file = g_file_new_for_path (path);
+    stream = g_file_append_to (file, G_FILE_CREATE_PRIVATE, NULL, &error);
+    if (stream)
+    {
+        if (g_output_stream_write_all (G_OUTPUT_STREAM (stream), records->str,
+                                       records->len, NULL, NULL, &error))
+        {
+            (void)g_output_stream_close (G_OUTPUT_STREAM (stream), NULL,
+                                         &error);
+        }
+
+        g_object_unref (stream);
+    }
+
+    if (error)
+    {
+        g_warning ("could not append to persistent alarms file '%s': %s",
+                   path, error->message);
+        g_error_free (error);
+    }
+
+    g_object_unref (file);
+    g_free (path);
+}
+
+static GList *alarm_store_read_legacy (const gchar *fpath)
+{
+    alarm_struct *new_alarm;
+    OrageRc *orc;
+    gchar **alarm_groups;
+    GList *alarms = NULL;
+    gint i;
+
+    if ((orc = orage_rc_file_open (fpath, TRUE)) == NULL)
+    {
+        g_warning ("could not open persistent alarms file '%s'", fpath);
+        return NULL;
+    }
+
+    alarm_groups = orage_rc_get_groups (orc);
+    for (i = 0; alarm_groups[i] != NULL; i++)
+    {
+        orage_rc_set_group (orc, alarm_groups[i]);
+
+        new_alarm = orage_alarm_new ();
+        new_alarm->uid = g_intern_string (alarm_groups[i]);
+        new_alarm->alarm_time = orage_rc_get_gdatetime (orc, RC_ALARM_TIME,
+                                                        NULL);
+        new_alarm->action_time = orage_rc_get_str (orc, RC_ACTION_TIME, "0000");
+        new_alarm->title = orage_rc_get_str (orc, RC_TITLE, NULL);
+        new_alarm->description = orage_rc_get_str (orc, RC_DESCRIPTION, NULL);
+        new_alarm->persistent = TRUE; /* this must be */
+        new_alarm->temporary = orage_rc_get_bool (orc, RC_TEMPORARY, FALSE);
+        new_alarm->display_orage = orage_rc_get_bool (orc, RC_DISPLAY_ORAGE,
+                                                      FALSE);
+#ifdef HAVE_NOTIFY
+        new_alarm->display_notify = orage_rc_get_bool (orc, RC_DISPLAY_NOTIFY,
+                                                       FALSE);
+        new_alarm->notify_timeout = orage_rc_get_int (orc, RC_NOTIFY_TIMEOUT,
+                                                      FALSE);
+#endif
+        new_alarm->audio = orage_rc_get_bool (orc, RC_AUDIO, FALSE);
+        new_alarm->sound = orage_rc_get_str (orc, RC_SOUND, NULL);
+        new_alarm->repeat_cnt = orage_rc_get_int (orc, RC_REPEAT_CNT, 0);
+        new_alarm->repeat_delay = orage_rc_get_int (orc, RC_REPEAT_DELAY, 2);
+        new_alarm->procedure = orage_rc_get_bool (orc, RC_PROCEDURE, FALSE);
+        new_alarm->cmd = orage_rc_get_str (orc, RC_CMD, NULL);
+
+        if (new_alarm->alarm_time == NULL)
+            orage_alarm_unref (new_alarm);
+        else
+            alarms = g_list_prepend (alarms, new_alarm);
+    }
+
+    g_strfreev (alarm_groups);
+    orage_rc_file_close (orc);
+
+    return g_list_reverse (alarms);
+}
+
+/* Moves alarms from the old key file into the record log. */
+static GList *alarm_store_migrate (alarm_store *st)
+{
+    GList *alarms;
+    GList *alarm_l;
+    alarm_struct *l_alarm;
+    gchar *fpath;
+
+    fpath = orage_data_file_location (ORAGE_PERSISTENT_ALARMS_DIR_FILE);
+    if (g_file_test (fpath, G_FILE_TEST_IS_REGULAR) == FALSE)
+    {
+        g_free (fpath);
+        return NULL;
+    }
+
+    alarms = alarm_store_read_legacy (fpath);
+    for (alarm_l = alarms; alarm_l != NULL; alarm_l = g_list_next (alarm_l))
+    {
+        l_alarm = (alarm_struct *)alarm_l->data;
+        g_hash_table_replace (st->records, g_strdup (l_alarm->uid),
+                              alarm_to_record (l_alarm));
+    }
+
+    alarm_store_compact (st);
+    if (g_remove (fpath) != 0)
+        g_warning ("could not remove old persistent alarms file '%s'", fpath);
+    else
+        g_message ("migrated %u persistent alarms", g_list_length (alarms));
+
+    g_free (fpath);
+
+    return alarms;
+}
+
+GList *orage_alarm_store_read (void)
+{
+    alarm_store *st = alarm_store_get ();
+    GHashTableIter iter;
+    GVariant *record;
+    GVariant *dict;
+    GList *alarms = NULL;
+    alarm_struct *new_alarm;
+    gpointer uid;
+    gpointer text;
+
+    if (g_hash_table_size (st->records) == 0)
+        return alarm_store_migrate (st);
+
+    g_hash_table_iter_init (&iter, st->records);
+    while (g_hash_table_iter_next (&iter, &uid, &text))
+    {
+        record = g_variant_parse (G_VARIANT_TYPE (RECORD_TYPE), text, NULL,
+                                  NULL, NULL);
+        g_variant_get (record, "(&sm@a{sv})", NULL, &dict);
+        if ((new_alarm = alarm_from_dict (uid, dict)) != NULL)
+            alarms = g_list_prepend (alarms, new_alarm);
+
+        g_variant_unref (dict);
+        g_variant_unref (record);
+    }
+
+    return alarms;
+}
+
+void orage_alarm_store_update (GList *alarm_list)
+{
+    alarm_store *st = alarm_store_get ();
+    const alarm_struct *l_alarm;
+    GHashTable *current;
+    GHashTableIter iter;
+    GString *pending;
+    GList *alarm_l;
+    gchar *text;
+    const gchar *old_text;
+    gpointer uid;
+
+    current = g_hash_table_new (g_str_hash, g_str_equal);
+    pending = g_string_new (NULL);
+
+    /* Walk backwards, so that when UID is listed twice the last alarm is
+     * kept, like the old key file did.
+     */
+    for (alarm_l = g_list_last (alarm_list);
+         alarm_l != NULL;
+         alarm_l = g_list_previous (alarm_l))
+    {
+        l_alarm = (const alarm_struct *)alarm_l->data;
+
+        /* only store persistent alarms */
+        if (l_alarm->persistent == FALSE || l_alarm->uid == NULL ||
+            l_alarm->alarm_time == NULL ||
+            g_hash_table_add (current, (gpointer)l_alarm->uid) == FALSE)
+        {
+            continue;
+        }
+
+        text = alarm_to_record (l_alarm);
+        old_text = g_hash_table_lookup (st->records, l_alarm->uid);
+        if (g_strcmp0 (old_text, text) == 0)
+        {
+            g_free (text);
+            continue;
+        }
+
+        if (old_text)
+            st->stale_cnt++;
+
+        g_string_append (pending, text);
+        g_string_append_c (pending, '\n');
+        g_hash_table_replace (st->records, g_strdup (l_alarm->uid), text);
+    }
+
+    g_hash_table_iter_init (&iter, st->records);
+    while (g_hash_table_iter_next (&iter, &uid, NULL))
+    {
+        if (g_hash_table_contains (current, uid))
+            continue;
+
+        text = record_print (uid, NULL);
+        g_string_append (pending, text);
+        g_string_append_c (pending, '\n');
+        g_free (text);
+        g_hash_table_iter_remove (&iter);
+        st->stale_cnt += 2;
+    }
+
+    if (pending->len != 0)
+    {
+        if (st->stale_cnt > MAX (COMPACT_MIN_STALE,
+                                 g_hash_table_size (st->records)))
+        {
+            alarm_store_compact (st);
+        }
+        else
+            alarm_store_append (pending);
+    }
+
+    g_string_free (pending, TRUE);
+    g_hash_table_destroy (current);
+}
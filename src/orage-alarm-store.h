@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2026 Erkki Moorits
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ *     Free Software Foundation
+ *     51 Franklin Street, 5th Floor
+ *     Boston, MA 02110-1301 USA
+ */
+
+#ifndef ORAGE_ALARM_STORE_H
+#define ORAGE_ALARM_STORE_H 1
+
+/* Persistent alarm store. Alarms are kept in a record log where every
+ * record replaces or deletes one alarm by UID. Only changed alarms are
+ * appended and the log is compacted when it holds too many stale records.
+ */
+
+#include "orage-alarm-structure.h"
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * orage_alarm_store_read:
+ *
+ * Reads all alarms from the persistent alarm store. Alarms from the old key
+ * file based store are migrated on first read.
+ *
+ * Returns: (transfer full) (element-type alarm_struct): list of stored alarms.
+ *          Free with g_list_free_full() and orage_alarm_unref().
+ */
+GList *orage_alarm_store_read (void);
+
+/**
+ * orage_alarm_store_update:
+ * @alarm_list: (element-type alarm_struct): current alarm list
+ *
+ * Synchronizes the store with persistent alarms in @alarm_list. Records are
+ * written only for added, changed or removed alarms.
+ */
+void orage_alarm_store_update (GList *alarm_list);
+
+G_END_DECLS
+
+#endif
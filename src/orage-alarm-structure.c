@@ -28,7 +28,7 @@ static void orage_alarm_free (alarm_struct *alarm)
 {
     orage_gdatetime_unref (alarm->alarm_time);
     g_free (alarm->action_time);
-    g_free (alarm->uid);
+    g_free (alarm->recurrence_id);
     g_free (alarm->title);
     g_free (alarm->description);
     g_free (alarm->sound);
@@ -98,16 +98,21 @@ alarm_struct *orage_alarm_copy (const alarm_struct *l_alarm)
     if (l_alarm->action_time != NULL)
         n_alarm->action_time = g_strdup (l_alarm->action_time);
 
-    if (l_alarm->uid != NULL)
-        n_alarm->uid = g_strdup (l_alarm->uid);
+    n_alarm->uid = l_alarm->uid;
+
+    if (l_alarm->recurrence_id != NULL)
+        n_alarm->recurrence_id = g_strdup (l_alarm->recurrence_id);
 
     if (l_alarm->title != NULL)
-        n_alarm->title = orage_process_text_commands (l_alarm->title);
+    {
+        n_alarm->title = g_strdup (orage_process_text_commands_cached (
+            l_alarm->uid, l_alarm->title));
+    }
 
     if (l_alarm->description != NULL)
     {
-        n_alarm->description =
-                orage_process_text_commands (l_alarm->description);
+        n_alarm->description = g_strdup (orage_process_text_commands_cached (
+            l_alarm->uid, l_alarm->description));
     }
 
     n_alarm->persistent = l_alarm->persistent;
@@ -52,7 +52,14 @@ typedef struct _alarm_struct
 
     /** Alarm is based on this time. */
     gchar   *action_time;
-    gchar   *uid;
+    /** File type prefixed uid of the component. Interned, so all alarms of a
+     *  component share it. */
+    const gchar *uid;
+
+    /** RECURRENCE-ID of a component, which overrides one occurrence of a
+     *  series with the same uid. NULL for other components. */
+    gchar   *recurrence_id;
+
     gchar   *title;
     gchar   *description;
     gboolean persistent;
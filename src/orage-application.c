@@ -33,7 +33,9 @@
 #include "orage-i18n.h"
 #include "orage-import.h"
 #include "orage-log.h"
+#include "orage-memory.h"
 #include "orage-sleep-monitor.h"
+#include "orage-trace.h"
 #include "orage-window.h"
 #include "parameters.h"
 #include "reminder.h"
@@ -135,8 +137,7 @@ static gboolean resuming_after_delay (G_GNUC_UNUSED gpointer user_data)
 {
     g_message ("resuming after sleep");
 
-    alarm_read ();
-    orage_day_change (&g_par);
+    orage_alarm_resume ();
 
     return FALSE;
 }
@@ -201,6 +202,18 @@ static void print_version (void)
 }
 
 #ifdef ENABLE_SYNC
+static void sync_finished_cb (G_GNUC_UNUSED OrageTaskRunner *sync,
+                              gpointer conf_p,
+                              gboolean success,
+                              G_GNUC_UNUSED gpointer user_data)
+{
+    const orage_task_runner_conf *conf = (const orage_task_runner_conf *)conf_p;
+
+    /* Refresh calendar now instead of waiting for the periodic check. */
+    if (success && conf->reload_file && conf->reload_file[0] != '\0')
+        (void)orage_external_update_file (conf->reload_file);
+}
+
 static void load_sync_conf (OrageTaskRunner *sync)
 {
     guint i;
@@ -290,6 +303,7 @@ static void orage_application_startup (GApplication *app)
 #ifdef ENABLE_SYNC
     OrageApplication *self = ORAGE_APPLICATION (app);
 #endif
+    ORAGE_TRACE_SCOPE ("startup");
 
     G_APPLICATION_CLASS (orage_application_parent_class)->startup (app);
 
@@ -297,6 +311,8 @@ static void orage_application_startup (GApplication *app)
     read_parameters ();
 #ifdef ENABLE_SYNC
     self->sync = g_object_new (ORAGE_TASK_RUNNER_TYPE, NULL);
+    g_signal_connect (self->sync, "finished",
+                      G_CALLBACK (sync_finished_cb), NULL);
     load_sync_conf (self->sync);
 #endif
 }
@@ -442,6 +458,7 @@ static void orage_application_activate (GApplication *app)
     OrageApplication *self;
     GtkWidget *window;
     gboolean hide_main_window;
+    ORAGE_TRACE_SCOPE ("activate");
 
     self = ORAGE_APPLICATION (app);
     hide_main_window = self->preferences_option
@@ -533,6 +550,8 @@ static void orage_application_shutdown (GApplication *app)
     OrageApplication *self = ORAGE_APPLICATION (app);
 
 #ifdef ENABLE_SYNC
+    /* running syncs keep reference to task runner */
+    orage_task_runne_interrupt (self->sync);
     g_object_unref (self->sync);
 #endif
 
@@ -546,11 +565,18 @@ static void orage_application_shutdown (GApplication *app)
 #ifdef HAVE_ARCHIVE
     /* move old appointment to other file to keep the active
        calendar file smaller and faster */
-    xfical_archive ();
+    {
+        ORAGE_TRACE_SCOPE ("archive");
+
+        xfical_archive ();
+    }
 #endif
 
     write_parameters ();
 
+    /* write out queued log lines */
+    orage_log_set_async (FALSE);
+
     G_APPLICATION_CLASS (orage_application_parent_class)->shutdown (app);
 }
 
@@ -559,6 +585,11 @@ static gint orage_application_handle_local_options (
     GVariantDict *options)
 {
     const gchar *logger_name = NULL;
+    const gchar *trace_file = NULL;
+
+    /* as early as possible, so that startup is in the trace */
+    if (g_variant_dict_lookup (options, "trace", "^&ay", &trace_file))
+        orage_trace_start (trace_file);
 
     g_variant_dict_lookup (options, "logger", "&s", &logger_name);
 
@@ -579,10 +610,12 @@ static gint orage_application_command_line (GApplication *app,
 {
     GFile **files;
     GFile *file;
+    GArray *usage;
     const gchar **filenames = NULL;
     const gchar *file_name;
     gchar **str_array;
     gchar *hint;
+    gchar *report;
     gchar key[2] = {'\0'};
     GVariantDict *options;
     gint n_files;
@@ -591,6 +624,27 @@ static gint orage_application_command_line (GApplication *app,
 
     options = g_application_command_line_get_options_dict (cmdline);
 
+    /* report to the calling terminal without showing windows */
+    if (g_variant_dict_contains (options, "memory") ||
+        g_variant_dict_contains (options, "trim"))
+    {
+        if (g_variant_dict_contains (options, "trim"))
+        {
+            g_application_command_line_print (cmdline,
+                                              "released about %" G_GUINT64_FORMAT
+                                              " bytes\n",
+                                              orage_memory_trim ());
+        }
+
+        usage = orage_memory_get_usage ();
+        report = orage_memory_format (usage);
+        g_application_command_line_print (cmdline, "%s", report);
+        g_free (report);
+        g_array_unref (usage);
+
+        return EXIT_SUCCESS;
+    }
+
     if (g_variant_dict_contains (options, "today"))
         self->today_option = TRUE;
 
@@ -852,6 +906,35 @@ static void orage_application_init (OrageApplication *self)
             .description = N_("Select logging backend (glib|orage)"),
             .arg_description = "backend",
         },
+        {
+            .long_name = "trace",
+            .short_name = 0,
+            .flags = G_OPTION_FLAG_NONE,
+            .arg = G_OPTION_ARG_FILENAME,
+            .arg_data = NULL,
+            .description = N_("Write timing trace in Chrome trace event format "
+                              "to file on exit"),
+            .arg_description = "<file>",
+        },
+        {
+            .long_name = "memory",
+            .short_name = 0,
+            .flags = G_OPTION_FLAG_NONE,
+            .arg = G_OPTION_ARG_NONE,
+            .arg_data = NULL,
+            .description = N_("Show approximate memory usage of running Orage"),
+            .arg_description = NULL,
+        },
+        {
+            .long_name = "trim",
+            .short_name = 0,
+            .flags = G_OPTION_FLAG_NONE,
+            .arg = G_OPTION_ARG_NONE,
+            .arg_data = NULL,
+            .description = N_("Release idle calendars and caches of running "
+                              "Orage"),
+            .arg_description = NULL,
+        },
         {
             .long_name = "version",
             .short_name = 'v',
@@ -943,6 +1026,20 @@ gboolean orage_application_load_path (OrageApplication *self,
     return result;
 }
 
+gchar **orage_application_store_components (OrageApplication *self,
+                                            const gchar * const *components,
+                                            const gchar *destination,
+                                            GError **error)
+{
+    gchar **uids;
+
+    uids = orage_calendar_store_components (components, destination, error);
+    if (uids)
+        orage_window_update_appointments (ORAGE_WINDOW (self->window));
+
+    return uids;
+}
+
 gboolean orage_application_open_path (OrageApplication *self,
                                       const gchar *filename)
 {
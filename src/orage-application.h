@@ -39,6 +39,26 @@ gboolean orage_application_load_path (OrageApplication *self,
                                       const gchar *filename,
                                       const gchar *destination);
 
+/**
+ * orage_application_store_components:
+ * @self: an #OrageApplication instance.
+ * @components: %NULL terminated array of serialized VEVENT, VTODO or VJOURNAL
+ *              components.
+ * @destination: (nullable): foreign calendar file or name, or %NULL/empty for
+ *               the main calendar.
+ * @error: return location for a #GError, or %NULL.
+ *
+ * Adds new appointments and replaces existing ones with the same UID as one
+ * transaction, then refreshes the main window once.
+ *
+ * Returns: (transfer full): UIDs of the stored appointments with file type
+ *          prefix, or %NULL if nothing was stored.
+ */
+gchar **orage_application_store_components (OrageApplication *self,
+                                            const gchar * const *components,
+                                            const gchar *destination,
+                                            GError **error);
+
 /**
  * orage_application_open_path:
  * @self: an #OrageApplication instance.
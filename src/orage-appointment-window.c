@@ -78,6 +78,12 @@
 #define RECUR_FREQ_ARRAY_ELEMENTS 6
 #define NR_OF_RECUR_CALENDARS 3
 
+/* Recurrence preview is refreshed this many milliseconds after last change
+ * of the rule. Longer spans of shown months are expanded month by month.
+ */
+#define RECUR_REFRESH_DELAY 250
+#define RECUR_MAX_SPAN 12
+
 typedef enum
 {
     NEW_APPT_WIN,
@@ -245,6 +251,11 @@ struct _OrageAppointmentWindow
     GtkWidget *Recur_calendar_hbox;
     GtkWidget *Recur_calendar[NR_OF_RECUR_CALENDARS];
 
+    /* Day masks of recurrence preview by year * 12 + month, valid until
+     * the rule changes. */
+    GHashTable *recur_marks;
+    guint recur_refresh_id;
+
     GtkStack  *recurrence_frequency_box;
     GtkWidget *recurrence_limit_box;
 
@@ -727,21 +738,108 @@ static void app_time_checkbutton_clicked_cb (G_GNUC_UNUSED GtkCheckButton *cb
     mark_appointment_changed (apptw);
 }
 
-static void refresh_recur_calendars (OrageAppointmentWindow *apptw)
+static guint recur_calendar_month (GtkWidget *calendar)
+{
+    guint year;
+    guint month;
+
+    gtk_calendar_get_date (GTK_CALENDAR (calendar), &year, &month, NULL);
+
+    return year * 12 + month;
+}
+
+static void recur_marks_store (OrageAppointmentWindow *apptw,
+                               const guint first, const guint n_months)
 {
+    const xfical_appt *appt = (xfical_appt *)apptw->xf_appt;
+    guint32 masks[RECUR_MAX_SPAN];
     guint i;
-    GtkCalendar *cal;
-    xfical_appt *appt;
 
-    appt = (xfical_appt *)apptw->xf_appt;
+    xfical_mark_recur_months (appt, first / 12, first % 12 + 1, n_months,
+                              masks);
+
+    for (i = 0; i < n_months; i++)
+    {
+        g_hash_table_insert (apptw->recur_marks, GUINT_TO_POINTER (first + i),
+                             GUINT_TO_POINTER (masks[i]));
+    }
+}
+
+static void recur_marks_apply (OrageAppointmentWindow *apptw,
+                               GtkWidget *calendar)
+{
+    gpointer mask;
+
+    mask = g_hash_table_lookup (apptw->recur_marks,
+                                GUINT_TO_POINTER (
+                                    recur_calendar_month (calendar)));
+    xfical_mark_calendar_with_mask (GTK_CALENDAR (calendar),
+                                    GPOINTER_TO_UINT (mask));
+}
+
+/* Expand the rule once for all shown months and mark preview calendars. */
+static void refresh_recur_calendars_now (OrageAppointmentWindow *apptw)
+{
+    guint i;
+    guint first = G_MAXUINT;
+    guint last = 0;
+    guint month;
+
+    if (apptw->recur_refresh_id)
+    {
+        g_source_remove (apptw->recur_refresh_id);
+        apptw->recur_refresh_id = 0;
+    }
+
     if (apptw->appointment_changed)
-        fill_appt_from_apptw (appt, apptw);
+        fill_appt_from_apptw ((xfical_appt *)apptw->xf_appt, apptw);
+
+    g_hash_table_remove_all (apptw->recur_marks);
 
     for (i = 0; i < NR_OF_RECUR_CALENDARS; i++)
     {
-        cal = GTK_CALENDAR (apptw->Recur_calendar[i]);
-        xfical_mark_calendar_recur (cal, appt);
+        month = recur_calendar_month (apptw->Recur_calendar[i]);
+        first = MIN (first, month);
+        last = MAX (last, month);
+    }
+
+    if (last - first < RECUR_MAX_SPAN)
+        recur_marks_store (apptw, first, last - first + 1);
+    else
+    {
+        for (i = 0; i < NR_OF_RECUR_CALENDARS; i++)
+        {
+            month = recur_calendar_month (apptw->Recur_calendar[i]);
+            if (!g_hash_table_contains (apptw->recur_marks,
+                                        GUINT_TO_POINTER (month)))
+            {
+                recur_marks_store (apptw, month, 1);
+            }
+        }
     }
+
+    for (i = 0; i < NR_OF_RECUR_CALENDARS; i++)
+        recur_marks_apply (apptw, apptw->Recur_calendar[i]);
+}
+
+static gboolean recur_refresh_timeout (gpointer user_data)
+{
+    OrageAppointmentWindow *apptw = ORAGE_APPOINTMENT_WINDOW (user_data);
+
+    apptw->recur_refresh_id = 0;
+    refresh_recur_calendars_now (apptw);
+
+    return G_SOURCE_REMOVE;
+}
+
+/* Rule was changed, refresh preview when the changes stop. */
+static void refresh_recur_calendars (OrageAppointmentWindow *apptw)
+{
+    if (apptw->recur_refresh_id)
+        g_source_remove (apptw->recur_refresh_id);
+
+    apptw->recur_refresh_id = g_timeout_add (RECUR_REFRESH_DELAY,
+                                             recur_refresh_timeout, apptw);
 }
 
 static void on_notebook_page_switch (G_GNUC_UNUSED GtkNotebook *notebook,
@@ -749,7 +847,7 @@ static void on_notebook_page_switch (G_GNUC_UNUSED GtkNotebook *notebook,
                                      guint page_num, gpointer user_data)
 {
     if (page_num == 2)
-        refresh_recur_calendars (ORAGE_APPOINTMENT_WINDOW (user_data));
+        refresh_recur_calendars_now (ORAGE_APPOINTMENT_WINDOW (user_data));
 }
 
 static void app_recur_checkbutton_clicked_cb (
@@ -1427,8 +1525,8 @@ static gboolean fill_appt_from_apptw (xfical_appt *appt,
         g_free(tmp2);
         tmp2 = NULL;
     }
+    g_free(appt->categories);
     if (ORAGE_STR_EXISTS(tmp)) {
-        g_free(appt->categories);
         appt->categories = g_strjoin(",", tmp, tmp2, NULL);
         g_free(tmp2);
     }
@@ -1766,6 +1864,28 @@ static void on_recur_Date_button_clicked_cb (GtkWidget *button
     refresh_recur_calendars (apptw);
 }
 
+/** Timezone names of appointment are interned strings, but timezone button
+ *  works with allocated string. Make a temporary copy for the button and
+ *  intern the selected value.
+ */
+static gboolean appt_timezone_button_clicked (GtkButton *button,
+                                              OrageAppointmentWindow *apptw,
+                                              const gchar **tz_loc)
+{
+    gchar *tz;
+    gboolean changed;
+
+    tz = g_strdup (*tz_loc);
+    changed = orage_timezone_button_clicked (button, GTK_WINDOW (apptw), &tz,
+                                             TRUE, g_par.local_timezone);
+    if (changed)
+        *tz_loc = g_intern_string (tz);
+
+    g_free (tz);
+
+    return changed;
+}
+
 static void on_appStartTimezone_clicked_cb (GtkButton *button
         , gpointer *user_data)
 {
@@ -1773,8 +1893,7 @@ static void on_appStartTimezone_clicked_cb (GtkButton *button
     xfical_appt *appt;
 
     appt = (xfical_appt *)apptw->xf_appt;
-    if (orage_timezone_button_clicked(button, GTK_WINDOW (apptw)
-            , &appt->start_tz_loc, TRUE, g_par.local_timezone))
+    if (appt_timezone_button_clicked (button, apptw, &appt->start_tz_loc))
         mark_appointment_changed (apptw);
 }
 
@@ -1785,8 +1904,7 @@ static void on_appEndTimezone_clicked_cb (GtkButton *button
     xfical_appt *appt;
 
     appt = (xfical_appt *)apptw->xf_appt;
-    if (orage_timezone_button_clicked(button, GTK_WINDOW(apptw)
-            , &appt->end_tz_loc, TRUE, g_par.local_timezone))
+    if (appt_timezone_button_clicked (button, apptw, &appt->end_tz_loc))
         mark_appointment_changed (apptw);
 }
 
@@ -1797,8 +1915,7 @@ static void on_appCompletedTimezone_clicked_cb (GtkButton *button
     xfical_appt *appt;
 
     appt = (xfical_appt *)apptw->xf_appt;
-    if (orage_timezone_button_clicked(button, GTK_WINDOW(apptw)
-            , &appt->completed_tz_loc, TRUE, g_par.local_timezone))
+    if (appt_timezone_button_clicked (button, apptw, &appt->completed_tz_loc))
         mark_appointment_changed (apptw);
 }
 
@@ -1919,12 +2036,17 @@ static gboolean add_recur_exception_row (xfical_exception *except,
 static void recur_month_changed_cb (GtkCalendar *calendar, gpointer user_data)
 {
     OrageAppointmentWindow *apptw = ORAGE_APPOINTMENT_WINDOW (user_data);
-    xfical_appt *appt = (xfical_appt *)apptw->xf_appt;
+    const guint month = recur_calendar_month (GTK_WIDGET (calendar));
 
-    /* actually we do not have to do fill_appt_from_apptw always,
-     * but as we are not keeping track of changes, we just do it always */
-    fill_appt_from_apptw (appt, apptw);
-    xfical_mark_calendar_recur (calendar, appt);
+    if (!g_hash_table_contains (apptw->recur_marks, GUINT_TO_POINTER (month)))
+    {
+        /* refresh of a changed rule may still be pending, so take the
+         * current rule before expanding a new month */
+        fill_appt_from_apptw ((xfical_appt *)apptw->xf_appt, apptw);
+        recur_marks_store (apptw, month, 1);
+    }
+
+    recur_marks_apply (apptw, GTK_WIDGET (calendar));
 }
 
 static void recur_day_selected_double_click_cb (GtkCalendar *calendar
@@ -2102,13 +2224,13 @@ static xfical_appt *fill_appt_window_get_new_appt (GDateTime *gdt)
     appt->endtime = g_date_time_add_minutes (gdt, 30);
 
     if (g_par.local_timezone_utc)
-        appt->start_tz_loc = g_strdup ("UTC");
+        appt->start_tz_loc = g_intern_static_string ("UTC");
     else if (g_par.local_timezone)
-        appt->start_tz_loc = g_strdup (g_par.local_timezone);
+        appt->start_tz_loc = g_intern_string (g_par.local_timezone);
     else
-        appt->start_tz_loc = g_strdup ("floating");
+        appt->start_tz_loc = g_intern_static_string ("floating");
 
-    appt->end_tz_loc = g_strdup (appt->start_tz_loc);
+    appt->end_tz_loc = appt->start_tz_loc;
     appt->duration = 30 * 60;
     /* use NOT completed by default for new TODO */
     appt->completed = FALSE;
@@ -2116,7 +2238,7 @@ static xfical_appt *fill_appt_window_get_new_appt (GDateTime *gdt)
     appt->use_duration = TRUE;
     orage_gdatetime_unref (appt->completedtime);
     appt->completedtime = g_date_time_new_now_local ();
-    appt->completed_tz_loc = g_strdup (appt->start_tz_loc);
+    appt->completed_tz_loc = appt->start_tz_loc;
 
     read_default_alarm (appt);
 
@@ -2181,7 +2303,7 @@ static xfical_appt *fill_appt_window_get_appt (OrageAppointmentWindow *apptw,
 /* categories start.                                        */
 /************************************************************/
 
-static gboolean category_fill_cb(GtkComboBoxText *cb, char *selection)
+static gboolean category_fill_cb(GtkComboBoxText *cb, const char *selection)
 {
     OrageRc *orc;
     gchar **cat_gourps;
@@ -2228,7 +2350,8 @@ static void orage_category_refill_cb (OrageAppointmentWindow *apptw)
 static void fill_category_data (OrageAppointmentWindow *apptw,
                                   xfical_appt *appt)
 {
-    gchar *tmp = NULL;
+    const gchar *tmp = NULL;
+    gchar *entry_text;
 
     /* first search the last entry. which is the special color value */
     if (appt->categories) {
@@ -2239,14 +2362,17 @@ static void fill_category_data (OrageAppointmentWindow *apptw,
             tmp++;
     }
     if (category_fill_cb(GTK_COMBO_BOX_TEXT(apptw->Categories_cb), tmp) && tmp != NULL) {
-        /* we found match. Let's try to hide that from the entry text */
+        /* we found match. Let's try to hide that from the entry text.
+           appt->categories is not modified. */
         while (tmp != appt->categories
                 && (*(tmp-1) == ' ' || *(tmp-1) == ','))
             tmp--;
-        *tmp = '\0'; /* note that this goes to appt->categories */
+        entry_text = g_strndup(appt->categories, tmp - appt->categories);
     }
-    gtk_entry_set_text(GTK_ENTRY(apptw->Categories_entry)
-            , (appt->categories ? appt->categories : ""));
+    else
+        entry_text = g_strdup(appt->categories ? appt->categories : "");
+    gtk_entry_set_text(GTK_ENTRY(apptw->Categories_entry), entry_text);
+    g_free(entry_text);
 }
 
 static void close_cat_window(gpointer user_data)
@@ -2837,8 +2963,7 @@ static void fill_appt_window (OrageAppointmentWindow *apptw,
     if (!appt->completed) { /* some nice default */
         orage_gdatetime_unref (appt->completedtime);
         appt->completedtime = g_date_time_new_now_local (); /* probably completed today? */
-        g_free(appt->completed_tz_loc);
-        appt->completed_tz_loc = g_strdup(appt->start_tz_loc);
+        appt->completed_tz_loc = appt->start_tz_loc;
     }
     /* we only want to enable duplication if we are working with an old
      * existing app (=not adding new) */
@@ -3058,7 +3183,7 @@ static void on_test_button_clicked_cb (G_GNUC_UNUSED GtkButton *button
 
     /* no need for alarm time as we are doing this now */
     cur_alarm->alarm_time = NULL;
-    cur_alarm->uid = (appt->uid) ? g_strdup (appt->uid) : NULL;
+    cur_alarm->uid = g_intern_string (appt->uid);
     cur_alarm->action_time = create_action_time (appt);
 
     cur_alarm->title = g_strdup (appt->title);
@@ -4484,6 +4609,10 @@ static void orage_appointment_window_finalize (GObject *object)
         orage_week_window_remove_appointment_window (self->dw, self);
     }
 
+    if (self->recur_refresh_id)
+        g_source_remove (self->recur_refresh_id);
+
+    g_hash_table_destroy (self->recur_marks);
     g_free (self->xf_uid);
     xfical_appt_free ((xfical_appt *)self->xf_appt);
 
@@ -4603,6 +4732,7 @@ static void orage_appointment_window_init (OrageAppointmentWindow *self)
     self->el = NULL;
     self->dw = NULL;
     self->appointment_changed = FALSE;
+    self->recur_marks = g_hash_table_new (g_direct_hash, g_direct_equal);
     self->accel_group = gtk_accel_group_new ();
 
     gtk_window_add_accel_group (GTK_WINDOW (self), self->accel_group);
@@ -23,14 +23,24 @@
 #include "orage-category.h"
 
 #include "functions.h"
+#include "orage-memory.h"
 #include "orage-rc-file.h"
 
 #include <gdk/gdk.h>
+#include <gio/gio.h>
 #include <glib.h>
+#include <string.h>
 
 #define ORAGE_RC_COLOUR "Color"
 
+/* Categories are loaded once and kept both in a list (for the category
+ * editor) and in a hash table keyed by category name (for colour lookups).
+ * File monitor marks them dirty when the categories file changes.
+ */
 static GList *orage_category_list = NULL;
+static GHashTable *orage_category_table = NULL;
+static GFileMonitor *orage_category_monitor = NULL;
+static gboolean orage_category_dirty = TRUE;
 
 static void orage_category_free (gpointer gcat, G_GNUC_UNUSED gpointer dummy)
 {
@@ -42,11 +52,50 @@ static void orage_category_free (gpointer gcat, G_GNUC_UNUSED gpointer dummy)
 
 static void orage_category_free_list (void)
 {
+    if (orage_category_table)
+        g_hash_table_remove_all (orage_category_table);
+
     g_list_foreach (orage_category_list, orage_category_free, NULL);
     g_list_free (orage_category_list);
     orage_category_list = NULL;
 }
 
+static void orage_category_file_changed (G_GNUC_UNUSED GFileMonitor *monitor,
+                                         G_GNUC_UNUSED GFile *file,
+                                         G_GNUC_UNUSED GFile *other_file,
+                                         const GFileMonitorEvent event_type,
+                                         G_GNUC_UNUSED gpointer user_data)
+{
+    if (event_type != G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED)
+    {
+        g_debug ("category file changed, reloading categories on next use");
+        orage_category_dirty = TRUE;
+    }
+}
+
+static void orage_category_monitor_start (const gchar *fpath)
+{
+    GFile *file;
+    GError *error = NULL;
+
+    file = g_file_new_for_path (fpath);
+    orage_category_monitor = g_file_monitor_file (file, G_FILE_MONITOR_NONE,
+                                                  NULL, &error);
+    if (orage_category_monitor)
+    {
+        g_signal_connect (orage_category_monitor, "changed",
+                          G_CALLBACK (orage_category_file_changed), NULL);
+    }
+    else
+    {
+        g_warning ("failed to monitor category file '%s': %s", fpath,
+                   error->message);
+        g_error_free (error);
+    }
+
+    g_object_unref (file);
+}
+
 OrageRc *orage_category_file_open (const gboolean read_only)
 {
     gchar *fpath;
@@ -57,12 +106,15 @@ OrageRc *orage_category_file_open (const gboolean read_only)
     if (orc == NULL)
         g_warning ("failed to open category configuration file");
 
+    if (orage_category_monitor == NULL)
+        orage_category_monitor_start (fpath);
+
     g_free (fpath);
 
     return orc;
 }
 
-GList *orage_category_get_list (void)
+static void orage_category_load (void)
 {
     GdkRGBA rgba;
     OrageRc *orc;
@@ -70,10 +122,16 @@ GList *orage_category_get_list (void)
     gint i;
     orage_category_struct *cat;
 
-    if (orage_category_list != NULL)
-        orage_category_free_list ();
+    if (orage_category_table == NULL)
+        orage_category_table = g_hash_table_new (g_str_hash, g_str_equal);
+
+    orage_category_free_list ();
+    orage_category_dirty = FALSE;
 
     orc = orage_category_file_open (TRUE);
+    if (orc == NULL)
+        return;
+
     cat_groups = orage_rc_get_groups (orc);
     for (i = 0; cat_groups[i] != NULL; i++)
     {
@@ -84,29 +142,83 @@ GList *orage_category_get_list (void)
             cat->category = g_strdup (cat_groups[i]);
             cat->color = rgba;
             orage_category_list = g_list_prepend (orage_category_list, cat);
+            g_hash_table_insert (orage_category_table, cat->category, cat);
         }
     }
     g_strfreev (cat_groups);
     orage_rc_file_close (orc);
+}
+
+GList *orage_category_get_list (void)
+{
+    if (orage_category_dirty)
+        orage_category_load ();
 
     return orage_category_list;
 }
 
+static orage_category_struct *orage_category_lookup_len (const gchar *name,
+                                                         gsize len)
+{
+    gchar buf[128];
+    gchar *key;
+    orage_category_struct *cat;
+
+    /* skip blanks around the name */
+    while (len > 0 && g_ascii_isspace (*name))
+    {
+        name++;
+        len--;
+    }
+
+    while (len > 0 && g_ascii_isspace (name[len - 1]))
+        len--;
+
+    if (len == 0)
+        return NULL;
+
+    key = (len < sizeof (buf)) ? buf : g_malloc (len + 1);
+    memcpy (key, name, len);
+    key[len] = '\0';
+    cat = g_hash_table_lookup (orage_category_table, key);
+    if (key != buf)
+        g_free (key);
+
+    return cat;
+}
+
 GdkRGBA *orage_category_list_contains (const gchar *categories)
 {
-    GList *cat_l;
+    const gchar *start;
+    const gchar *end;
     orage_category_struct *cat;
 
     if (categories == NULL)
         return NULL;
 
-    for (cat_l = g_list_first (orage_category_list);
-         cat_l != NULL;
-         cat_l = g_list_next(cat_l))
+    if (orage_category_dirty)
+        orage_category_load ();
+
+    if (g_hash_table_size (orage_category_table) == 0)
+        return NULL;
+
+    /* Categories are comma separated and the colour category is stored as
+     * the last one, so check the values from the end.
+     */
+    end = categories + strlen (categories);
+    for (;;)
     {
-        cat = (orage_category_struct *)cat_l->data;
-        if (g_str_has_suffix (categories, cat->category))
+        for (start = end; start > categories && start[-1] != ','; start--)
+            ;
+
+        cat = orage_category_lookup_len (start, end - start);
+        if (cat)
             return &cat->color;
+
+        if (start == categories)
+            break;
+
+        end = start - 1;
     }
 
     /* Not found. */
@@ -131,6 +243,7 @@ void orage_category_write_entry (const gchar *category, const GdkRGBA *color)
         orage_rc_set_group (orc, category);
         orage_rc_put_str (orc, ORAGE_RC_COLOUR, color_str);
         orage_rc_file_close (orc);
+        orage_category_dirty = TRUE;
     }
     else
     {
@@ -156,6 +269,7 @@ void orage_category_remove_entry (const gchar *category)
     {
         orage_rc_del_group (orc, category);
         orage_rc_file_close (orc);
+        orage_category_dirty = TRUE;
     }
     else
     {
@@ -163,3 +277,22 @@ void orage_category_remove_entry (const gchar *category)
                    "could not be opened", category);
     }
 }
+
+void orage_category_memory_usage (GArray *usage)
+{
+    GList *tmp;
+    orage_category_struct *cat;
+    guint64 bytes = 0;
+    guint n = 0;
+
+    for (tmp = orage_category_list; tmp != NULL; tmp = g_list_next (tmp))
+    {
+        cat = (orage_category_struct *)tmp->data;
+        n++;
+        bytes += ORAGE_MEMORY_LIST_NODE + ORAGE_MEMORY_HASH_ENTRY
+               + sizeof (orage_category_struct)
+               + orage_memory_string_size (cat->category);
+    }
+
+    orage_memory_usage_add (usage, "categories", n, 0, bytes);
+}
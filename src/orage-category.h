@@ -36,15 +36,26 @@ typedef struct _orage_category
 G_BEGIN_DECLS
 
 OrageRc *orage_category_file_open (const gboolean read_only);
+/** Find colour for comma separated list of categories. The last category
+ *  with defined colour wins.
+ *  @param categories comma separated categories, or NULL
+ *  @return pointer to static colour, or NULL if no category has colour
+ */
 GdkRGBA *orage_category_list_contains (const gchar *categories);
 
-/** Load category list to static variable and return pointer of this variable.
+/** Return category list. Categories are loaded on first use and reloaded
+ *  only after the categories file has changed.
  *  @return pointer to static category list
  */
 GList *orage_category_get_list (void);
 void orage_category_write_entry (const gchar *category, const GdkRGBA *color);
 void orage_category_remove_entry (const gchar *category);
 
+/** Add memory usage of loaded categories.
+ *  @param usage array of OrageMemoryUsage
+ */
+void orage_category_memory_usage (GArray *usage);
+
 G_END_DECLS
 
 #endif
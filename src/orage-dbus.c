@@ -22,6 +22,8 @@
 
 #include "functions.h"
 #include "orage-application.h"
+#include "orage-free-busy.h"
+#include "orage-memory.h"
 #include "orage-time-utils.h"
 
 #include <gio/gio.h>
@@ -37,6 +39,11 @@
 #define ORAGE_DBUS_METHOD_ADD_FOREIGN_FILE "AddForeign"
 #define ORAGE_DBUS_METHOD_REMOVE_FOREIGN_FILE "RemoveForeign"
 #define ORAGE_DBUS_METHOD_OPEN_DAY "OpenDay"
+#define ORAGE_DBUS_METHOD_GET_FREE_BUSY "GetFreeBusy"
+#define ORAGE_DBUS_METHOD_FIND_FREE_SLOT "FindFreeSlot"
+#define ORAGE_DBUS_METHOD_GET_MEMORY_USAGE "GetMemoryUsage"
+#define ORAGE_DBUS_METHOD_TRIM "Trim"
+#define ORAGE_DBUS_METHOD_STORE_APPOINTMENTS "StoreAppointments"
 
 static const gchar introspection_xml[] =
     "<node>"
@@ -66,6 +73,30 @@ static const gchar introspection_xml[] =
     "    <method name='" ORAGE_DBUS_METHOD_OPEN_DAY "'>"
     "      <arg type='s' name='date' direction='in'/>"
     "    </method>"
+    "    <method name='" ORAGE_DBUS_METHOD_GET_FREE_BUSY "'>"
+    "      <arg type='s' name='start' direction='in'/>"
+    "      <arg type='s' name='end' direction='in'/>"
+    "      <arg type='u' name='resolution' direction='in'/>"
+    "      <arg type='s' name='first_slot' direction='out'/>"
+    "      <arg type='u' name='slots' direction='out'/>"
+    "      <arg type='ay' name='busy' direction='out'/>"
+    "    </method>"
+    "    <method name='" ORAGE_DBUS_METHOD_FIND_FREE_SLOT "'>"
+    "      <arg type='u' name='duration' direction='in'/>"
+    "      <arg type='u' name='within' direction='in'/>"
+    "      <arg type='s' name='start' direction='out'/>"
+    "    </method>"
+    "    <method name='" ORAGE_DBUS_METHOD_GET_MEMORY_USAGE "'>"
+    "      <arg type='a(sttt)' name='usage' direction='out'/>"
+    "    </method>"
+    "    <method name='" ORAGE_DBUS_METHOD_TRIM "'>"
+    "      <arg type='t' name='released' direction='out'/>"
+    "    </method>"
+    "    <method name='" ORAGE_DBUS_METHOD_STORE_APPOINTMENTS "'>"
+    "      <arg type='as' name='components' direction='in'/>"
+    "      <arg type='s' name='calendar_name' direction='in'/>"
+    "      <arg type='as' name='uids' direction='out'/>"
+    "    </method>"
     "  </interface>"
     "</node>";
 
@@ -116,6 +147,178 @@ static GDateTime *date_time_from_string (const gchar *text)
     return NULL;
 }
 
+/* GetFreeBusy: busy bitmap of the period, one bit per resolution minutes,
+ * starting from the lowest bit of the first byte. */
+static void handle_get_free_busy (GVariant *parameters,
+                                  GDBusMethodInvocation *invocation)
+{
+    GDateTime *gdt_start;
+    GDateTime *gdt_end;
+    GDateTime *first_slot = NULL;
+    GVariant *busy;
+    gchar *first_slot_str;
+    const gchar *start;
+    const gchar *end;
+    guint8 *bitmap;
+    guint resolution;
+    guint n_slots = 0;
+
+    g_variant_get (parameters, "(&s&su)", &start, &end, &resolution);
+    gdt_start = date_time_from_string (start);
+    gdt_end = date_time_from_string (end);
+
+    if (gdt_start == NULL || gdt_end == NULL)
+        bitmap = NULL;
+    else
+    {
+        bitmap = orage_free_busy_get (gdt_start, gdt_end, resolution,
+                                      &first_slot, &n_slots);
+    }
+
+    orage_gdatetime_unref (gdt_start);
+    orage_gdatetime_unref (gdt_end);
+
+    if (bitmap == NULL)
+    {
+        g_dbus_method_invocation_return_error (invocation,
+                                               G_DBUS_ERROR,
+                                               G_DBUS_ERROR_INVALID_ARGS,
+                                               "Invalid free/busy period "
+                                               "'%s' - '%s' or resolution %u",
+                                               start, end, resolution);
+        return;
+    }
+
+    busy = g_variant_new_fixed_array (G_VARIANT_TYPE_BYTE, bitmap,
+                                      (n_slots + 7) / 8, sizeof (guint8));
+    first_slot_str = g_date_time_format_iso8601 (first_slot);
+    g_dbus_method_invocation_return_value (invocation,
+                                           g_variant_new ("(su@ay)",
+                                                          first_slot_str,
+                                                          n_slots, busy));
+    g_free (first_slot_str);
+    g_date_time_unref (first_slot);
+    g_free (bitmap);
+}
+
+/* FindFreeSlot: first free period of duration minutes starting from now and
+ * ending within given number of days. */
+static void handle_find_free_slot (GVariant *parameters,
+                                   GDBusMethodInvocation *invocation)
+{
+    GDateTime *gdt_now;
+    GDateTime *gdt_until;
+    GDateTime *gdt_slot;
+    gchar *slot_str;
+    guint duration;
+    guint within;
+
+    g_variant_get (parameters, "(uu)", &duration, &within);
+
+    /* search from now touches within + 1 days */
+    if (duration == 0 || within == 0 || within >= ORAGE_FREE_BUSY_MAX_DAYS)
+    {
+        g_dbus_method_invocation_return_error (invocation,
+                                               G_DBUS_ERROR,
+                                               G_DBUS_ERROR_INVALID_ARGS,
+                                               "Invalid duration %u or "
+                                               "search period %u days",
+                                               duration, within);
+        return;
+    }
+
+    gdt_now = g_date_time_new_now_local ();
+    gdt_until = g_date_time_add_days (gdt_now, within);
+    gdt_slot = orage_free_busy_find_free_slot (gdt_now, gdt_until, duration);
+    g_date_time_unref (gdt_now);
+    g_date_time_unref (gdt_until);
+
+    if (gdt_slot == NULL)
+    {
+        g_dbus_method_invocation_return_error (invocation,
+                                               G_DBUS_ERROR,
+                                               G_DBUS_ERROR_FAILED,
+                                               "No free slot of %u minutes "
+                                               "within %u days",
+                                               duration, within);
+        return;
+    }
+
+    slot_str = g_date_time_format_iso8601 (gdt_slot);
+    g_dbus_method_invocation_return_value (invocation,
+                                           g_variant_new ("(s)", slot_str));
+    g_free (slot_str);
+    g_date_time_unref (gdt_slot);
+}
+
+/* GetMemoryUsage: name, item count, property count and approximate bytes
+ * of each accounted part. */
+static void handle_get_memory_usage (GDBusMethodInvocation *invocation)
+{
+    GVariantBuilder builder;
+    GArray *usage;
+    OrageMemoryUsage *entry;
+    guint i;
+
+    usage = orage_memory_get_usage ();
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(sttt)"));
+    for (i = 0; i < usage->len; i++)
+    {
+        entry = &g_array_index (usage, OrageMemoryUsage, i);
+        g_variant_builder_add (&builder, "(sttt)", entry->name, entry->items,
+                               entry->properties, entry->bytes);
+    }
+
+    g_dbus_method_invocation_return_value (invocation,
+                                           g_variant_new ("(a(sttt))",
+                                                          &builder));
+    g_array_unref (usage);
+}
+
+/* StoreAppointments: add or replace serialized components in one
+ * transaction and return their UIDs in input order. */
+static void handle_store_appointments (OrageApplication *app,
+                                       GVariant *parameters,
+                                       GDBusMethodInvocation *invocation)
+{
+    const gchar **components;
+    const gchar *destination;
+    gchar **uids;
+    GError *error = NULL;
+    GDBusError code;
+
+    g_variant_get (parameters, "(^a&s&s)", &components, &destination);
+    uids = orage_application_store_components (app, components, destination,
+                                               &error);
+    g_free (components);
+
+    if (uids == NULL)
+    {
+        /* tell bad input apart from problems on Orage side */
+        if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA)
+         || g_error_matches (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT))
+        {
+            code = G_DBUS_ERROR_INVALID_ARGS;
+        }
+        else if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+            code = G_DBUS_ERROR_FILE_NOT_FOUND;
+        else
+            code = G_DBUS_ERROR_FAILED;
+
+        g_dbus_method_invocation_return_error (invocation,
+                                               G_DBUS_ERROR,
+                                               code,
+                                               "Could not store appointments: "
+                                               "%s", error->message);
+        g_error_free (error);
+        return;
+    }
+
+    g_dbus_method_invocation_return_value (invocation,
+                                           g_variant_new ("(^as)", uids));
+    g_strfreev (uids);
+}
+
 static void on_method_call (G_GNUC_UNUSED GDBusConnection *connection,
                             G_GNUC_UNUSED const gchar *sender,
                             G_GNUC_UNUSED const gchar *object_path,
@@ -251,6 +454,23 @@ static void on_method_call (G_GNUC_UNUSED GDBusConnection *connection,
             g_dbus_method_invocation_return_value (invocation, NULL);
         }
     }
+    else if (g_strcmp0 (method_name, ORAGE_DBUS_METHOD_GET_FREE_BUSY) == 0)
+        handle_get_free_busy (parameters, invocation);
+    else if (g_strcmp0 (method_name, ORAGE_DBUS_METHOD_FIND_FREE_SLOT) == 0)
+        handle_find_free_slot (parameters, invocation);
+    else if (g_strcmp0 (method_name, ORAGE_DBUS_METHOD_GET_MEMORY_USAGE) == 0)
+        handle_get_memory_usage (invocation);
+    else if (g_strcmp0 (method_name, ORAGE_DBUS_METHOD_TRIM) == 0)
+    {
+        g_dbus_method_invocation_return_value (invocation,
+                                               g_variant_new ("(t)",
+                                                   orage_memory_trim ()));
+    }
+    else if (g_strcmp0 (method_name,
+                        ORAGE_DBUS_METHOD_STORE_APPOINTMENTS) == 0)
+    {
+        handle_store_appointments (app, parameters, invocation);
+    }
     else
         g_warning ("unknown DBUS method name '%s'", method_name);
 }
@@ -0,0 +1,439 @@
+/*
+ * Copyright (c) 2026 Erkki Moorits
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ *     Free Software Foundation
+ *     51 Franklin Street, 5th Floor
+ *     Boston, MA 02110-1301 USA
+ */
+
+#include "orage-free-busy.h"
+
+#include "ical-code.h"
+#include "orage-memory.h"
+#include "parameters.h"
+
+#include <glib.h>
+
+#define FREE_BUSY_MINUTES_PER_DAY (24 * 60)
+#define FREE_BUSY_SLOTS_PER_DAY \
+    (FREE_BUSY_MINUTES_PER_DAY / ORAGE_FREE_BUSY_RESOLUTION)
+#define FREE_BUSY_WORDS ((FREE_BUSY_SLOTS_PER_DAY + 63) / 64)
+
+/* When more days than this are built, days outside of the current query are
+ * dropped before building new ones.
+ */
+#define FREE_BUSY_CACHE_DAYS (2 * ORAGE_FREE_BUSY_MAX_DAYS)
+
+/* Busy slots of one day in local wall clock time. On days when daylight
+ * saving time ends the repeated hour shares the same slots.
+ */
+typedef struct _FreeBusyDay
+{
+    guint64 bits[FREE_BUSY_WORDS];
+} FreeBusyDay;
+
+/* Julian day number -> FreeBusyDay. Missing day means not built yet. */
+static GHashTable *free_busy_days = NULL;
+
+static guint32 free_busy_day_key (GDateTime *gdt)
+{
+    GDate date;
+    gint year;
+    gint month;
+    gint day;
+
+    g_date_time_get_ymd (gdt, &year, &month, &day);
+    g_date_clear (&date, 1);
+    g_date_set_dmy (&date, day, month, year);
+
+    return g_date_get_julian (&date);
+}
+
+/* Local time of the slot in finest resolution. */
+static GDateTime *free_busy_slot_time (const guint32 key, const guint slot)
+{
+    GDate date;
+    guint minute;
+
+    g_date_clear (&date, 1);
+    g_date_set_julian (&date, key);
+    minute = slot * ORAGE_FREE_BUSY_RESOLUTION;
+
+    return g_date_time_new_local (g_date_get_year (&date),
+                                  g_date_get_month (&date),
+                                  g_date_get_day (&date),
+                                  minute / 60, minute % 60, 0);
+}
+
+/* Find day and slot of the time. When round_up is set, time inside of a
+ * slot belongs to the next slot, which may be FREE_BUSY_MINUTES_PER_DAY /
+ * resolution for the end of the day.
+ */
+static void free_busy_slot_of (GDateTime *gdt, const guint resolution,
+                               const gboolean round_up,
+                               guint32 *key, guint *slot)
+{
+    GDateTime *local;
+    guint minute;
+
+    local = g_date_time_to_local (gdt);
+    minute = g_date_time_get_hour (local) * 60
+           + g_date_time_get_minute (local);
+
+    if (round_up)
+    {
+        if (g_date_time_get_second (local) != 0
+         || g_date_time_get_microsecond (local) != 0)
+        {
+            minute++;
+        }
+
+        *slot = (minute + resolution - 1) / resolution;
+    }
+    else
+        *slot = minute / resolution;
+
+    *key = free_busy_day_key (local);
+    g_date_time_unref (local);
+}
+
+static inline gboolean free_busy_day_is_busy (const FreeBusyDay *day,
+                                              const guint slot)
+{
+    return (day->bits[slot / 64] >> (slot % 64)) & 1;
+}
+
+static void free_busy_day_mark (FreeBusyDay *day, guint from, const guint to)
+{
+    for (; from < to; from++)
+        day->bits[from / 64] |= G_GUINT64_CONSTANT (1) << (from % 64);
+}
+
+static void free_busy_mark_occurrence (const xfical_occurrence *occurrence,
+                                       const guint32 first, const guint32 last)
+{
+    FreeBusyDay *day;
+    GDateTime *end;
+    guint32 key;
+    guint32 start_key;
+    guint32 end_key;
+    guint start_slot;
+    guint end_slot;
+
+    /* transparent events do not block time */
+    if (occurrence->appt->availability == 0)
+        return;
+
+    /* End of all day events without duration is the start of their last
+     * day (BUG 7886 workaround in ical-code.c), so the last day is added.
+     */
+    if (occurrence->appt->allDay && !occurrence->appt->use_duration)
+        end = g_date_time_add_days (occurrence->end, 1);
+    else
+        end = g_date_time_ref (occurrence->end);
+
+    if (g_date_time_compare (occurrence->start, end) >= 0)
+    {
+        g_date_time_unref (end);
+        return;
+    }
+
+    free_busy_slot_of (occurrence->start, ORAGE_FREE_BUSY_RESOLUTION, FALSE,
+                       &start_key, &start_slot);
+    free_busy_slot_of (end, ORAGE_FREE_BUSY_RESOLUTION, TRUE,
+                       &end_key, &end_slot);
+    g_date_time_unref (end);
+
+    for (key = MAX (start_key, first); key <= MIN (end_key, last); key++)
+    {
+        day = g_hash_table_lookup (free_busy_days, GUINT_TO_POINTER (key));
+        free_busy_day_mark (day,
+                            key == start_key ? start_slot : 0,
+                            key == end_key ? end_slot
+                                           : FREE_BUSY_SLOTS_PER_DAY);
+    }
+}
+
+static gboolean free_busy_key_in_range (gpointer key,
+                                        G_GNUC_UNUSED gpointer value,
+                                        gpointer user_data)
+{
+    const guint32 *range = user_data;
+    const guint32 day = GPOINTER_TO_UINT (key);
+
+    return (range[0] <= day && day <= range[1]);
+}
+
+static gboolean free_busy_key_outside_range (gpointer key, gpointer value,
+                                            gpointer user_data)
+{
+    return !free_busy_key_in_range (key, value, user_data);
+}
+
+/* Make sure that bitmaps of days from first to last exist. Calendars are
+ * read only once for the continuous period of missing days.
+ */
+static gboolean free_busy_load (const guint32 first, const guint32 last)
+{
+    GList *list = NULL;
+    GList *tmp;
+    GDateTime *a_day;
+    gchar file_type[8];
+    guint32 key;
+    guint32 load_first = 0;
+    guint32 load_last = 0;
+    guint32 range[2];
+    gboolean missing = FALSE;
+    gint i;
+
+    if (free_busy_days == NULL)
+    {
+        free_busy_days = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                                NULL, g_free);
+    }
+
+    for (key = first; key <= last; key++)
+    {
+        if (!g_hash_table_contains (free_busy_days, GUINT_TO_POINTER (key)))
+        {
+            if (!missing)
+                load_first = key;
+            load_last = key;
+            missing = TRUE;
+        }
+    }
+
+    if (!missing)
+        return TRUE;
+
+    if (g_hash_table_size (free_busy_days) + load_last - load_first + 1
+        > FREE_BUSY_CACHE_DAYS)
+    {
+        range[0] = first;
+        range[1] = last;
+        g_hash_table_foreach_remove (free_busy_days,
+                                     free_busy_key_outside_range, range);
+    }
+
+    if (!xfical_file_open (TRUE))
+        return FALSE;
+
+    a_day = free_busy_slot_time (load_first, 0);
+    xfical_get_each_app_within_time (a_day, load_last - load_first + 1,
+                                     XFICAL_TYPE_EVENT, "O00.", &list);
+    for (i = 0; i < g_par.foreign_count; i++)
+    {
+        g_snprintf (file_type, sizeof (file_type), "F%02d.", i);
+        xfical_get_each_app_within_time (a_day, load_last - load_first + 1,
+                                         XFICAL_TYPE_EVENT, file_type, &list);
+    }
+    xfical_file_close (TRUE);
+    g_date_time_unref (a_day);
+
+    for (key = load_first; key <= load_last; key++)
+    {
+        g_hash_table_replace (free_busy_days, GUINT_TO_POINTER (key),
+                              g_new0 (FreeBusyDay, 1));
+    }
+
+    for (tmp = list; tmp != NULL; tmp = g_list_next (tmp))
+        free_busy_mark_occurrence (tmp->data, load_first, load_last);
+
+    xfical_occurrence_list_free (list);
+
+    g_debug ("free/busy bitmaps built for %u days",
+             load_last - load_first + 1);
+
+    return TRUE;
+}
+
+void orage_free_busy_invalidate_all (void)
+{
+    if (free_busy_days)
+        g_hash_table_remove_all (free_busy_days);
+}
+
+void orage_free_busy_memory_usage (GArray *usage)
+{
+    guint n;
+
+    n = free_busy_days ? g_hash_table_size (free_busy_days) : 0;
+    orage_memory_usage_add (usage, "free/busy days", n, 0,
+                            n * (ORAGE_MEMORY_HASH_ENTRY
+                               + sizeof (FreeBusyDay)));
+}
+
+void orage_free_busy_invalidate_range (GDateTime *start, GDateTime *end)
+{
+    guint32 range[2];
+    guint slot;
+
+    if (free_busy_days == NULL || g_hash_table_size (free_busy_days) == 0)
+        return;
+
+    free_busy_slot_of (start, ORAGE_FREE_BUSY_RESOLUTION, FALSE,
+                       &range[0], &slot);
+    free_busy_slot_of (end, ORAGE_FREE_BUSY_RESOLUTION, FALSE,
+                       &range[1], &slot);
+
+    g_hash_table_foreach_remove (free_busy_days, free_busy_key_in_range,
+                                 range);
+}
+
+guint8 *orage_free_busy_get (GDateTime *start, GDateTime *end,
+                             const guint resolution, GDateTime **first_slot,
+                             guint *n_slots)
+{
+    const FreeBusyDay *day;
+    guint8 *bitmap;
+    guint32 start_key;
+    guint32 end_key;
+    guint32 key;
+    guint start_slot;
+    guint end_slot;
+    guint slot;
+    guint slots_per_day;
+    guint ratio;
+    guint from;
+    guint to;
+    guint i;
+    guint n;
+
+    if (resolution == 0 || resolution % ORAGE_FREE_BUSY_RESOLUTION != 0
+     || FREE_BUSY_MINUTES_PER_DAY % resolution != 0)
+    {
+        g_warning ("unsupported free/busy resolution %u minutes", resolution);
+        return NULL;
+    }
+
+    if (g_date_time_compare (start, end) >= 0)
+    {
+        g_warning ("free/busy period end is not after start");
+        return NULL;
+    }
+
+    free_busy_slot_of (start, resolution, FALSE, &start_key, &start_slot);
+    free_busy_slot_of (end, resolution, TRUE, &end_key, &end_slot);
+
+    if (end_key - start_key >= ORAGE_FREE_BUSY_MAX_DAYS)
+    {
+        g_warning ("free/busy period is longer than %d days",
+                   ORAGE_FREE_BUSY_MAX_DAYS);
+        return NULL;
+    }
+
+    if (!free_busy_load (start_key, end_key))
+        return NULL;
+
+    slots_per_day = FREE_BUSY_MINUTES_PER_DAY / resolution;
+    ratio = resolution / ORAGE_FREE_BUSY_RESOLUTION;
+    bitmap = g_malloc0 (((end_key - start_key + 1) * slots_per_day + 7) / 8);
+    n = 0;
+
+    for (key = start_key; key <= end_key; key++)
+    {
+        day = g_hash_table_lookup (free_busy_days, GUINT_TO_POINTER (key));
+        from = (key == start_key) ? start_slot : 0;
+        to = (key == end_key) ? end_slot : slots_per_day;
+
+        for (slot = from; slot < to; slot++, n++)
+        {
+            for (i = slot * ratio; i < (slot + 1) * ratio; i++)
+            {
+                if (free_busy_day_is_busy (day, i))
+                {
+                    bitmap[n / 8] |= 1 << (n % 8);
+                    break;
+                }
+            }
+        }
+    }
+
+    *first_slot = free_busy_slot_time (start_key, start_slot * ratio);
+    *n_slots = n;
+
+    return bitmap;
+}
+
+GDateTime *orage_free_busy_find_free_slot (GDateTime *from, GDateTime *until,
+                                           const guint duration)
+{
+    const FreeBusyDay *day;
+    guint32 start_key;
+    guint32 end_key;
+    guint32 key;
+    guint32 run_key = 0;
+    guint start_slot;
+    guint end_slot;
+    guint slot;
+    guint run_slot = 0;
+    guint run = 0;
+    guint needed;
+    guint to;
+
+    needed = (duration + ORAGE_FREE_BUSY_RESOLUTION - 1)
+           / ORAGE_FREE_BUSY_RESOLUTION;
+    if (needed == 0 || g_date_time_compare (from, until) >= 0)
+        return NULL;
+
+    free_busy_slot_of (from, ORAGE_FREE_BUSY_RESOLUTION, TRUE,
+                       &start_key, &start_slot);
+    if (start_slot == FREE_BUSY_SLOTS_PER_DAY)
+    {
+        start_key++;
+        start_slot = 0;
+    }
+    free_busy_slot_of (until, ORAGE_FREE_BUSY_RESOLUTION, FALSE,
+                       &end_key, &end_slot);
+
+    if (end_key < start_key)
+        return NULL;
+
+    if (end_key - start_key >= ORAGE_FREE_BUSY_MAX_DAYS)
+    {
+        g_warning ("free slot search period is longer than %d days",
+                   ORAGE_FREE_BUSY_MAX_DAYS);
+        return NULL;
+    }
+
+    if (!free_busy_load (start_key, end_key))
+        return NULL;
+
+    for (key = start_key; key <= end_key; key++)
+    {
+        day = g_hash_table_lookup (free_busy_days, GUINT_TO_POINTER (key));
+        to = (key == end_key) ? end_slot : FREE_BUSY_SLOTS_PER_DAY;
+
+        for (slot = (key == start_key) ? start_slot : 0; slot < to; slot++)
+        {
+            if (free_busy_day_is_busy (day, slot))
+            {
+                run = 0;
+                continue;
+            }
+
+            if (run == 0)
+            {
+                run_key = key;
+                run_slot = slot;
+            }
+
+            if (++run == needed)
+                return free_busy_slot_time (run_key, run_slot);
+        }
+    }
+
+    return NULL;
+}
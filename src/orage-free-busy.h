@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2026 Erkki Moorits
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ *     Free Software Foundation
+ *     51 Franklin Street, 5th Floor
+ *     Boston, MA 02110-1301 USA
+ */
+
+#ifndef ORAGE_FREE_BUSY_H
+#define ORAGE_FREE_BUSY_H 1
+
+/* Free/busy engine. Opaque events of the main and foreign calendars are
+ * collected into per-day bitmaps of local wall clock time. Days are built
+ * on first query and dropped again when an appointment touching them is
+ * added, modified or removed.
+ */
+
+#include <glib.h>
+
+/** Finest supported resolution in minutes. Query resolutions must be
+ *  multiples of this and divide one day evenly.
+ */
+#define ORAGE_FREE_BUSY_RESOLUTION 5
+
+/** Longest period in days which can be queried at once. */
+#define ORAGE_FREE_BUSY_MAX_DAYS 366
+
+G_BEGIN_DECLS
+
+/** Drop all bitmaps, for example after calendar files were reloaded. */
+void orage_free_busy_invalidate_all (void);
+
+/** Drop bitmaps of days between start and end, both days included.
+ *  @param start first day to drop
+ *  @param end last day to drop
+ */
+void orage_free_busy_invalidate_range (GDateTime *start, GDateTime *end);
+
+/** Add memory usage of built bitmaps.
+ *  @param usage array of OrageMemoryUsage
+ */
+void orage_free_busy_memory_usage (GArray *usage);
+
+/** Get busy bitmap of the period. Slot n covers resolution minutes starting
+ *  from first slot start + n * resolution and it is busy when bit (n % 8) of
+ *  byte (n / 8) is set.
+ *  @param start start of the period, rounded down to resolution
+ *  @param end end of the period, rounded up to resolution
+ *  @param resolution slot length in minutes
+ *  @param first_slot (out) start time of the first slot, unref after use
+ *  @param n_slots (out) number of slots in the bitmap
+ *  @return bitmap, free with g_free. NULL if arguments are not valid.
+ */
+guint8 *orage_free_busy_get (GDateTime *start, GDateTime *end,
+                             guint resolution, GDateTime **first_slot,
+                             guint *n_slots);
+
+/** Find first free period of given length.
+ *  @param from earliest start time, rounded up to finest resolution
+ *  @param until latest end time of the period
+ *  @param duration length of the needed period in minutes
+ *  @return start time of the free period or NULL if there is none
+ */
+GDateTime *orage_free_busy_find_free_slot (GDateTime *from, GDateTime *until,
+                                           guint duration);
+
+G_END_DECLS
+
+#endif
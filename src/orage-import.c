@@ -25,6 +25,7 @@
 #include "orage-appointment-window.h"
 #include "orage-i18n.h"
 #include "orage-time-utils.h"
+#include "parameters.h"
 #include <glib-object.h>
 #include <glib.h>
 #include <gtk/gtk.h>
@@ -32,6 +33,9 @@
 
 #define IMPORT_WINDOW_EVENTS "import-window-events"
 
+/* Number of components added to the summary table in one idle call. */
+#define IMPORT_FILL_BATCH 200
+
 static void orage_import_window_set_property (GObject *object,
                                               guint prop_id,
                                               const GValue *value,
@@ -41,6 +45,7 @@ static void orage_import_window_get_property (GObject *object,
                                               GValue *value,
                                               GParamSpec *pspec);
 static void orage_import_window_constructed (GObject *object);
+static void orage_import_window_dispose (GObject *object);
 static void orage_import_window_finalize (GObject *object);
 
 struct _OrageImportWindow
@@ -48,7 +53,19 @@ struct _OrageImportWindow
     XfceTitledDialog __parent__;
 
     GList *events;
-    GtkWidget *notebook;
+
+    /* Summary table of multiple events. Rows are added in idle callback and
+     * detailed preview is created only for the selected row.
+     */
+    GtkListStore *store;
+    GtkWidget *view;
+    GtkWidget *summary_label;
+    GtkWidget *details;
+    GList *fill_next;
+    guint fill_id;
+    guint counts[XFICAL_TYPE_JOURNAL + 1];
+    GDateTime *first_start;
+    GDateTime *last_start;
 };
 
 enum
@@ -56,6 +73,15 @@ enum
     PROP_EVENT_LIST = 1
 };
 
+enum
+{
+    COLUMN_COMPONENT,
+    COLUMN_START,
+    COLUMN_TYPE,
+    COLUMN_SUMMARY,
+    N_COLUMNS
+};
+
 static const gchar *event_type_to_string (const xfical_type type)
 {
     switch (type)
@@ -220,6 +246,213 @@ static GtkWidget *orage_import_window_create_event_preview_from_cal_comp (
     return GTK_WIDGET (grid);
 }
 
+static void orage_import_window_update_summary (OrageImportWindow *self)
+{
+    GString *text;
+    gchar *first;
+    gchar *last;
+    guint n_rows;
+
+    n_rows = gtk_tree_model_iter_n_children (GTK_TREE_MODEL (self->store),
+                                             NULL);
+    text = g_string_new (NULL);
+    g_string_append_printf (text,
+                            ngettext ("%u item: %u events, %u todos, "
+                                      "%u journals",
+                                      "%u items: %u events, %u todos, "
+                                      "%u journals", n_rows),
+                            n_rows,
+                            self->counts[XFICAL_TYPE_EVENT],
+                            self->counts[XFICAL_TYPE_TODO],
+                            self->counts[XFICAL_TYPE_JOURNAL]);
+
+    if (self->first_start)
+    {
+        first = orage_gdatetime_to_i18_time (self->first_start, TRUE);
+        last = orage_gdatetime_to_i18_time (self->last_start, TRUE);
+        g_string_append_c (text, '\n');
+        g_string_append_printf (text, _("Starting from %s to %s"),
+                                first, last);
+        g_free (first);
+        g_free (last);
+    }
+
+    g_string_append_c (text, '\n');
+    g_string_append_printf (text, _("Import into: %s"), g_par.orage_file);
+
+    if (self->fill_next)
+        g_string_append (text, _(" (reading...)"));
+
+    gtk_label_set_text (GTK_LABEL (self->summary_label), text->str);
+    g_string_free (text, TRUE);
+}
+
+static void orage_import_window_add_row (OrageImportWindow *self,
+                                         OrageCalendarComponent *cal_comp)
+{
+    GDateTime *gdt;
+    gchar *start;
+    xfical_type type;
+    const gchar *summary;
+
+    type = o_cal_component_get_type (cal_comp);
+    if (type <= XFICAL_TYPE_JOURNAL)
+        self->counts[type]++;
+
+    gdt = o_cal_component_get_dtstart (cal_comp);
+    if (gdt)
+    {
+        start = orage_gdatetime_to_i18_time (
+            gdt, o_cal_component_is_all_day_event (cal_comp));
+
+        if (self->first_start == NULL
+         || g_date_time_compare (gdt, self->first_start) < 0)
+        {
+            orage_gdatetime_unref (self->first_start);
+            self->first_start = g_date_time_ref (gdt);
+        }
+
+        if (self->last_start == NULL
+         || g_date_time_compare (gdt, self->last_start) > 0)
+        {
+            orage_gdatetime_unref (self->last_start);
+            self->last_start = g_date_time_ref (gdt);
+        }
+
+        g_date_time_unref (gdt);
+    }
+    else
+        start = NULL;
+
+    summary = o_cal_component_get_summary (cal_comp);
+    gtk_list_store_insert_with_values (self->store, NULL, -1,
+                                       COLUMN_COMPONENT, cal_comp,
+                                       COLUMN_START, start,
+                                       COLUMN_TYPE,
+                                       event_type_to_string (type),
+                                       COLUMN_SUMMARY, summary,
+                                       -1);
+    g_free (start);
+}
+
+static gboolean orage_import_window_fill (gpointer user_data)
+{
+    OrageImportWindow *self = ORAGE_IMPORT_WINDOW (user_data);
+    GtkTreeSelection *selection;
+    GtkTreeIter iter;
+    guint i;
+
+    for (i = 0; i < IMPORT_FILL_BATCH && self->fill_next; i++)
+    {
+        orage_import_window_add_row (
+            self, ORAGE_CALENDAR_COMPONENT (self->fill_next->data));
+        self->fill_next = g_list_next (self->fill_next);
+    }
+
+    orage_import_window_update_summary (self);
+
+    if (self->fill_next)
+        return G_SOURCE_CONTINUE;
+
+    self->fill_id = 0;
+
+    /* show details of the first item */
+    selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (self->view));
+    if (gtk_tree_model_get_iter_first (GTK_TREE_MODEL (self->store), &iter))
+        gtk_tree_selection_select_iter (selection, &iter);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void orage_import_window_selection_changed (GtkTreeSelection *selection,
+                                                   gpointer user_data)
+{
+    OrageImportWindow *self = ORAGE_IMPORT_WINDOW (user_data);
+    GtkTreeModel *model;
+    GtkTreeIter iter;
+    GtkWidget *page;
+    OrageCalendarComponent *cal_comp;
+
+    gtk_container_foreach (GTK_CONTAINER (self->details),
+                           (GtkCallback)gtk_widget_destroy, NULL);
+
+    if (!gtk_tree_selection_get_selected (selection, &model, &iter))
+        return;
+
+    gtk_tree_model_get (model, &iter, COLUMN_COMPONENT, &cal_comp, -1);
+    page = orage_import_window_create_event_preview_from_cal_comp (cal_comp);
+    gtk_box_pack_start (GTK_BOX (self->details), page, FALSE, FALSE, 0);
+    gtk_widget_show (page);
+}
+
+static void append_text_column (GtkTreeView *view, const gchar *title,
+                                const gint column, const gint width)
+{
+    GtkCellRenderer *renderer;
+    GtkTreeViewColumn *tree_column;
+
+    renderer = gtk_cell_renderer_text_new ();
+    g_object_set (renderer, "ellipsize", PANGO_ELLIPSIZE_END, NULL);
+    tree_column = gtk_tree_view_column_new_with_attributes (title, renderer,
+                                                            "text", column,
+                                                            NULL);
+    gtk_tree_view_column_set_sizing (tree_column,
+                                     GTK_TREE_VIEW_COLUMN_FIXED);
+    gtk_tree_view_column_set_fixed_width (tree_column, width);
+    gtk_tree_view_column_set_resizable (tree_column, TRUE);
+    gtk_tree_view_append_column (view, tree_column);
+}
+
+/* Summary of all items and a table of them. Fixed height rows let the
+ * table to create row widgets only for the visible part.
+ */
+static GtkWidget *orage_import_window_create_summary (OrageImportWindow *self)
+{
+    GtkWidget *box;
+    GtkWidget *scrolled;
+    GtkTreeSelection *selection;
+
+    box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 6);
+    gtk_container_set_border_width (GTK_CONTAINER (box), 6);
+
+    self->summary_label = gtk_label_new (NULL);
+    gtk_widget_set_halign (self->summary_label, GTK_ALIGN_START);
+    gtk_box_pack_start (GTK_BOX (box), self->summary_label, FALSE, FALSE, 0);
+
+    self->store = gtk_list_store_new (N_COLUMNS, G_TYPE_POINTER,
+                                      G_TYPE_STRING, G_TYPE_STRING,
+                                      G_TYPE_STRING);
+    self->view = gtk_tree_view_new_with_model (GTK_TREE_MODEL (self->store));
+    append_text_column (GTK_TREE_VIEW (self->view), _("Start"),
+                        COLUMN_START, 160);
+    append_text_column (GTK_TREE_VIEW (self->view), _("Type"),
+                        COLUMN_TYPE, 70);
+    append_text_column (GTK_TREE_VIEW (self->view), _("Summary"),
+                        COLUMN_SUMMARY, 250);
+    gtk_tree_view_set_fixed_height_mode (GTK_TREE_VIEW (self->view), TRUE);
+
+    selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (self->view));
+    gtk_tree_selection_set_mode (selection, GTK_SELECTION_BROWSE);
+    g_signal_connect (selection, "changed",
+                      G_CALLBACK (orage_import_window_selection_changed),
+                      self);
+
+    scrolled = gtk_scrolled_window_new (NULL, NULL);
+    gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (scrolled),
+                                    GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+    gtk_scrolled_window_set_min_content_height (
+        GTK_SCROLLED_WINDOW (scrolled), 200);
+    gtk_container_add (GTK_CONTAINER (scrolled), self->view);
+    gtk_box_pack_start (GTK_BOX (box), scrolled, TRUE, TRUE, 0);
+
+    self->details = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
+    gtk_box_pack_start (GTK_BOX (box), self->details, FALSE, FALSE, 0);
+
+    gtk_widget_show_all (box);
+
+    return box;
+}
+
 static void orage_import_window_class_init (OrageImportWindowClass *klass)
 {
     GParamSpec *param_specs;
@@ -227,6 +460,7 @@ static void orage_import_window_class_init (OrageImportWindowClass *klass)
 
     object_class = G_OBJECT_CLASS (klass);
     object_class->constructed = orage_import_window_constructed;
+    object_class->dispose = orage_import_window_dispose;
     object_class->finalize = orage_import_window_finalize;
     object_class->get_property = orage_import_window_get_property;
     object_class->set_property = orage_import_window_set_property;
@@ -247,7 +481,6 @@ static void orage_import_window_constructed (GObject *object)
     OrageImportWindow *self = (OrageImportWindow *)object;
     GtkWidget *button;
     GtkWidget *page;
-    GtkWidget *label;
     GList *tmp_list;
     OrageCalendarComponent *cal_comp;
     guint nr_items;
@@ -287,33 +520,39 @@ static void orage_import_window_constructed (GObject *object)
     }
     else if (nr_items > 1)
     {
-        self->notebook = gtk_notebook_new ();
-        gtk_notebook_set_scrollable (GTK_NOTEBOOK (self->notebook), TRUE);
-        gtk_container_set_border_width (GTK_CONTAINER (self->notebook), 6);
+        gtk_window_set_resizable (GTK_WINDOW (self), TRUE);
         gtk_box_pack_start (
             GTK_BOX (gtk_dialog_get_content_area (GTK_DIALOG (self))),
-                     self->notebook, TRUE, TRUE, 0);
+            orage_import_window_create_summary (self), TRUE, TRUE, 0);
 
-        for (tmp_list = g_list_first (self->events);
-             tmp_list != NULL;
-             tmp_list = g_list_next (tmp_list))
-        {
-            cal_comp = ORAGE_CALENDAR_COMPONENT (tmp_list->data);
-            page = orage_import_window_create_event_preview_from_cal_comp (cal_comp);
-            label = gtk_label_new (o_cal_component_get_summary (cal_comp));
-
-            gtk_notebook_append_page (GTK_NOTEBOOK (self->notebook), page, label);
-            gtk_widget_show (page);
-        }
-
-        gtk_widget_show (self->notebook);
+        self->fill_next = g_list_first (self->events);
+        self->fill_id = g_idle_add (orage_import_window_fill, self);
     }
     else
         g_assert_not_reached ();
 }
 
+static void orage_import_window_dispose (GObject *object)
+{
+    OrageImportWindow *self = ORAGE_IMPORT_WINDOW (object);
+
+    if (self->fill_id)
+    {
+        g_source_remove (self->fill_id);
+        self->fill_id = 0;
+    }
+
+    G_OBJECT_CLASS (orage_import_window_parent_class)->dispose (object);
+}
+
 static void orage_import_window_finalize (GObject *object)
 {
+    OrageImportWindow *self = ORAGE_IMPORT_WINDOW (object);
+
+    g_clear_object (&self->store);
+    orage_gdatetime_unref (self->first_start);
+    orage_gdatetime_unref (self->last_start);
+
     G_OBJECT_CLASS (orage_import_window_parent_class)->finalize (object);
 }
 
@@ -22,10 +22,9 @@
 
 #include <glib.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
-#define LOG_STREAM stdout
-
 #define ALERT_LEVELS (G_LOG_LEVEL_ERROR | G_LOG_LEVEL_CRITICAL | G_LOG_LEVEL_WARNING)
 #define DEFAULT_LEVELS (ALERT_LEVELS | G_LOG_LEVEL_MESSAGE)
 #define INFO_LEVELS (G_LOG_LEVEL_INFO | G_LOG_LEVEL_DEBUG)
@@ -68,6 +67,9 @@ static gboolean log_domain_is_enabled (const gchar *domain,
 static gboolean is_debug_enabled_for_domain (const gchar *domain,
                                              const gsize domain_length)
 {
+    if (orage_log_domains == NULL)
+        return FALSE;
+
     if (g_strcmp0 (orage_log_domains, "all") == 0)
         return TRUE;
 
@@ -123,50 +125,107 @@ static const gchar *color_reset (const gboolean use_color)
     return use_color ? "\033[0m" : "";
 }
 
-static void append_level_prefix (GString *gstring,
-                                 const GLogLevelFlags log_level,
-                                 const gboolean use_color)
+/* Fixed size output buffer. Room for LOG_TAIL is always kept free, so that
+ * truncated lines can still be terminated.
+ */
+typedef struct _LogBuffer
+{
+    gchar *str;
+    gsize size;
+    gsize len;
+    gboolean truncated;
+} LogBuffer;
+
+#define LOG_TAIL (sizeof ("...\n"))
+
+static void log_buffer_append_len (LogBuffer *buffer, const gchar *str,
+                                   const gsize len)
 {
-    g_string_append (gstring, log_level_to_color (log_level, use_color));
+    gsize n;
+
+    if (buffer->truncated)
+        return;
+
+    n = buffer->size - LOG_TAIL - buffer->len;
+    if (len > n)
+    {
+        /* do not cut UTF-8 character in half */
+        while (n > 0 && ((guchar)str[n] & 0xc0) == 0x80)
+            n--;
+
+        buffer->truncated = TRUE;
+    }
+    else
+        n = len;
+
+    memcpy (buffer->str + buffer->len, str, n);
+    buffer->len += n;
+}
+
+/* Append escape sequence completely or not at all. */
+static void log_buffer_append_escape (LogBuffer *buffer, const gchar *esc,
+                                      const gsize len)
+{
+    if (buffer->len + len > buffer->size - LOG_TAIL)
+        buffer->truncated = TRUE;
+    else
+        log_buffer_append_len (buffer, esc, len);
+}
+
+static inline void log_buffer_append (LogBuffer *buffer, const gchar *str)
+{
+    log_buffer_append_len (buffer, str, strlen (str));
+}
+
+static inline void log_buffer_append_c (LogBuffer *buffer, const gchar c)
+{
+    log_buffer_append_len (buffer, &c, 1);
+}
+
+static void log_buffer_append_level_prefix (LogBuffer *buffer,
+                                            const GLogLevelFlags log_level,
+                                            const gboolean use_color)
+{
+    log_buffer_append (buffer, log_level_to_color (log_level, use_color));
 
     switch (log_level & G_LOG_LEVEL_MASK)
     {
         case G_LOG_LEVEL_ERROR:
-            g_string_append (gstring, "ERROR");
+            log_buffer_append (buffer, "ERROR");
             break;
 
         case G_LOG_LEVEL_CRITICAL:
-            g_string_append (gstring, "CRITICAL");
+            log_buffer_append (buffer, "CRITICAL");
             break;
 
         case G_LOG_LEVEL_WARNING:
-            g_string_append (gstring, "WARNING");
+            log_buffer_append (buffer, "WARNING");
             break;
 
         case G_LOG_LEVEL_MESSAGE:
-            g_string_append (gstring, "Message");
+            log_buffer_append (buffer, "Message");
             break;
 
         case G_LOG_LEVEL_INFO:
-            g_string_append (gstring, "INFO");
+            log_buffer_append (buffer, "INFO");
             break;
 
         case G_LOG_LEVEL_DEBUG:
-            g_string_append (gstring, "DEBUG");
+            log_buffer_append (buffer, "DEBUG");
             break;
 
         default:
-            g_string_append (gstring, "LOG");
+            log_buffer_append (buffer, "LOG");
             break;
     }
 
-    g_string_append (gstring, color_reset (use_color));
+    log_buffer_append (buffer, color_reset (use_color));
 
     if (log_level & G_LOG_FLAG_RECURSION)
-        g_string_append (gstring, " (recursed)");
+        log_buffer_append (buffer, " (recursed)");
 
     if (log_level & ALERT_LEVELS)
-        g_string_append (gstring, " **");
+        log_buffer_append (buffer, " **");
 }
 
 static gboolean is_safe_char (const gchar *p, const gchar *end,
@@ -192,88 +251,126 @@ static gboolean is_safe_char (const gchar *p, const gchar *end,
     return TRUE;
 }
 
-static void escape_string (GString *string)
+/* Append message with invalid UTF-8 as \xNN and control characters as
+ * \uNNNN. Safe runs of text are copied at once.
+ */
+static void log_buffer_append_escaped (LogBuffer *buffer, const gchar *str,
+                                       const gsize len)
 {
-    const char *p = string->str;
+    static const gchar hex[] = "0123456789abcdef";
+    const gchar *p = str;
+    const gchar *end = str + len;
+    const gchar *run = str;
+    gchar esc[6];
     gunichar wc;
-    gboolean safe;
-    gchar *tmp;
-    guint pos;
 
-    while (p < string->str + string->len)
+    while (p < end && !buffer->truncated)
     {
-        wc = g_utf8_get_char_validated (p, -1);
+        /* g_utf8_get_char_validated treats NUL as invalid input, but it is
+         * a control char like the others and is escaped as \u0000.
+         */
+        wc = (*p == '\0') ? 0 : g_utf8_get_char_validated (p, end - p);
         if (wc == (gunichar)-1 || wc == (gunichar)-2)
         {
-            pos = p - string->str;
-
-            /* Emit invalid UTF-8 as hex escapes */
-            tmp = g_strdup_printf ("\\x%02x", (guint)(guchar)*p);
-            g_string_erase (string, pos, 1);
-            g_string_insert (string, pos, tmp);
-
-            p = string->str + (pos + 4); /* Skip over escape sequence */
-            g_free (tmp);
-            continue;
+            log_buffer_append_len (buffer, run, p - run);
+            esc[0] = '\\';
+            esc[1] = 'x';
+            esc[2] = hex[((guchar)*p) >> 4];
+            esc[3] = hex[((guchar)*p) & 0xf];
+            log_buffer_append_escape (buffer, esc, 4);
+            run = ++p;
         }
-
-        safe = is_safe_char (p, string->str + string->len, wc);
-
-        if (safe == FALSE)
+        else if (is_safe_char (p, end, wc) == FALSE)
         {
-            pos = p - string->str;
-
             /* Largest char we escape is 0x9f, so we don't have to worry
              * about 8-digit \Uxxxxyyyy.
              */
-            tmp = g_strdup_printf ("\\u%04x", wc);
-            g_string_erase (string, pos, g_utf8_next_char (p) - p);
-            g_string_insert (string, pos, tmp);
-            g_free (tmp);
-
-            p = string->str + (pos + 6); /* Skip over escape sequence */
+            log_buffer_append_len (buffer, run, p - run);
+            esc[0] = '\\';
+            esc[1] = 'u';
+            esc[2] = '0';
+            esc[3] = '0';
+            esc[4] = hex[(wc >> 4) & 0xf];
+            esc[5] = hex[wc & 0xf];
+            log_buffer_append_escape (buffer, esc, 6);
+            run = p = g_utf8_next_char (p);
         }
         else
             p = g_utf8_next_char (p);
     }
+
+    log_buffer_append_len (buffer, run, p - run);
 }
 
-static void append_time_string (GString *gstring, const gboolean use_color)
+/* Local time formatting is done only once per second. */
+G_LOCK_DEFINE_STATIC (log_time);
+static gint64 log_time_second = -1;
+static gchar log_time_hms[sizeof ("HH:MM:SS")];
+
+static void log_buffer_append_time (LogBuffer *buffer,
+                                    const gboolean use_color)
 {
     gint64 now;
+    gint64 second;
     gint millis;
     GDateTime *dt;
-    gchar *time_str;
+    gchar hms[sizeof (log_time_hms)];
+    gchar ms[sizeof (".000: ")];
 
     now = g_get_real_time ();
+    second = now / G_USEC_PER_SEC;
     millis = (now / 1000) % 1000;
 
-    dt = g_date_time_new_from_unix_local (now / G_USEC_PER_SEC);
-    if (dt != NULL)
-    {
-        time_str = g_date_time_format (dt, "%H:%M:%S");
+    G_LOCK (log_time);
+    if (second == log_time_second)
+        memcpy (hms, log_time_hms, sizeof (hms));
+    else
+        hms[0] = '\0';
+    G_UNLOCK (log_time);
 
-        g_string_append_printf (gstring, "%s%s.%03d%s: ",
-                                color_set_blue (use_color),
-                                time_str,
-                                millis,
-                                color_reset (use_color));
+    if (hms[0] == '\0')
+    {
+        /* not under lock, GDateTime may log itself */
+        dt = g_date_time_new_from_unix_local (second);
+        if (dt == NULL)
+        {
+            log_buffer_append (buffer, color_set_red (use_color));
+            log_buffer_append (buffer, "(error)");
+            log_buffer_append (buffer, color_reset (use_color));
+            log_buffer_append (buffer, ": ");
+            return;
+        }
 
-        g_free (time_str);
+        g_snprintf (hms, sizeof (hms), "%02d:%02d:%02d",
+                    g_date_time_get_hour (dt),
+                    g_date_time_get_minute (dt),
+                    g_date_time_get_second (dt));
         g_date_time_unref (dt);
+
+        G_LOCK (log_time);
+        memcpy (log_time_hms, hms, sizeof (hms));
+        log_time_second = second;
+        G_UNLOCK (log_time);
     }
-    else
-    {
-        g_string_append_printf (gstring, "%s(error)%s: ",
-                                color_set_red (use_color),
-                                color_reset (use_color));
-    }
+
+    ms[0] = '.';
+    ms[1] = '0' + millis / 100;
+    ms[2] = '0' + (millis / 10) % 10;
+    ms[3] = '0' + millis % 10;
+
+    log_buffer_append (buffer, color_set_blue (use_color));
+    log_buffer_append_len (buffer, hms, sizeof (hms) - 1);
+    log_buffer_append_len (buffer, ms, 4);
+    log_buffer_append (buffer, color_reset (use_color));
+    log_buffer_append (buffer, ": ");
 }
 
-static char *log_writer_format_fields_utf8 (GLogLevelFlags level,
-                                            const GLogField *fields,
-                                            const gsize n_fields,
-                                            const gboolean use_color)
+gsize orage_log_format (gchar *buf,
+                        const gsize size,
+                        const GLogLevelFlags level,
+                        const GLogField *fields,
+                        const gsize n_fields,
+                        const gboolean use_color)
 {
     static const char NULL_MSG[] = "(null) message";
     gsize i;
@@ -282,87 +379,205 @@ static char *log_writer_format_fields_utf8 (GLogLevelFlags level,
     const gchar *code_func = NULL;
     const gchar *code_line = NULL;
     gsize log_domain_length;
-    gssize message_length = -1;
-    gssize code_func_length = -1;
-    gssize code_line_length = -1;
-    GString *gstring;
-    GString *tmp_msg;
+    gsize message_length = 0;
+    gsize code_func_length = 0;
+    gsize code_line_length = 0;
+    LogBuffer buffer;
     const GLogField *field;
     gboolean add_code_ref;
 
+    g_return_val_if_fail (size >= ORAGE_LOG_LINE_MIN, 0);
+
     for (i = 0; i < n_fields; i++)
     {
         field = &fields[i];
 
         if (g_strcmp0 (field->key, "MESSAGE") == 0)
-        {
-            message = (const gchar *)field->value;
-            message_length = field->length;
-        }
+            get_message (field, &message, &message_length);
         else if (g_strcmp0 (field->key, "GLIB_DOMAIN") == 0)
             get_message (field, &log_domain, &log_domain_length);
         else if (g_strcmp0 (field->key, "CODE_FUNC") == 0)
-        {
-            code_func = (const gchar *)field->value;
-            code_func_length = field->length;
-        }
+            get_message (field, &code_func, &code_func_length);
         else if (g_strcmp0 (field->key, "CODE_LINE") == 0)
-        {
-            code_line = (const gchar *)field->value;
-            code_line_length = field->length;
-        }
+            get_message (field, &code_line, &code_line_length);
     }
 
-    gstring = g_string_new (NULL);
+    buffer.str = buf;
+    buffer.size = size;
+    buffer.len = 0;
+    buffer.truncated = FALSE;
 
-    append_time_string (gstring, use_color);
+    log_buffer_append_time (&buffer, use_color);
 
     if (log_domain)
     {
-        g_string_append_len (gstring, log_domain, log_domain_length);
-        g_string_append_c (gstring, '-');
+        log_buffer_append_len (&buffer, log_domain, log_domain_length);
+        log_buffer_append_c (&buffer, '-');
         add_code_ref = is_debug_enabled_for_domain (log_domain,
                                                     log_domain_length);
     }
     else
     {
-        g_string_append (gstring, "** ");
+        log_buffer_append (&buffer, "** ");
         add_code_ref = FALSE;
     }
 
-    append_level_prefix (gstring, level, use_color);
-    g_string_append (gstring, ": ");
+    log_buffer_append_level_prefix (&buffer, level, use_color);
+    log_buffer_append (&buffer, ": ");
 
     if (add_code_ref && code_func)
     {
-        g_string_append_len (gstring, code_func, code_func_length);
+        log_buffer_append_len (&buffer, code_func, code_func_length);
 
         if (code_line)
         {
-            g_string_append_c (gstring, '@');
-            g_string_append_len (gstring, code_line, code_line_length);
+            log_buffer_append_c (&buffer, '@');
+            log_buffer_append_len (&buffer, code_line, code_line_length);
         }
 
-        g_string_append (gstring, ": ");
+        log_buffer_append (&buffer, ": ");
     }
 
     if (message)
+        log_buffer_append_escaped (&buffer, message, message_length);
+    else
+        log_buffer_append_len (&buffer, NULL_MSG, sizeof (NULL_MSG) - 1);
+
+    /* LOG_TAIL is reserved for this */
+    if (buffer.truncated)
+    {
+        memcpy (buffer.str + buffer.len, "...", 3);
+        buffer.len += 3;
+    }
+
+    buffer.str[buffer.len++] = '\n';
+    buffer.str[buffer.len] = '\0';
+
+    return buffer.len;
+}
+
+/* Background writer. Lines are copied into a ring buffer and written by
+ * the writer thread. When the buffer is full, lines are dropped instead of
+ * blocking the caller, and the number of dropped lines is reported later.
+ */
+typedef struct _LogRing
+{
+    GMutex lock;
+    GCond cond;
+    GThread *thread;
+    gchar *data;
+    gsize head;
+    gsize len;
+    guint dropped;
+    gboolean writing;
+    gboolean quit;
+} LogRing;
+
+static LogRing log_ring;
+
+/* NULL means stdout */
+static FILE *log_stream = NULL;
+
+static inline FILE *log_get_stream (void)
+{
+    return log_stream ? log_stream : stdout;
+}
+
+static void log_stream_write (const gchar *str, const gsize len)
+{
+    FILE *stream = log_get_stream ();
+
+    (void)fwrite (str, 1, len, stream);
+    fflush (stream);
+}
+
+static gpointer log_ring_writer_thread (G_GNUC_UNUSED gpointer data)
+{
+    gchar chunk[ORAGE_LOG_LINE_MAX];
+    gchar note[64];
+    gsize n;
+    guint dropped;
+
+    g_mutex_lock (&log_ring.lock);
+    for (;;)
     {
-        tmp_msg = g_string_new_len (message, message_length);
-        escape_string (tmp_msg);
-        g_string_append_len (gstring, tmp_msg->str, tmp_msg->len);
-        g_string_free (tmp_msg, TRUE);
+        while (log_ring.len == 0 && !log_ring.quit)
+            g_cond_wait (&log_ring.cond, &log_ring.lock);
+
+        if (log_ring.len == 0)
+            break;
+
+        n = MIN (log_ring.len, ORAGE_LOG_RING_SIZE - log_ring.head);
+        n = MIN (n, sizeof (chunk));
+        memcpy (chunk, log_ring.data + log_ring.head, n);
+        log_ring.head = (log_ring.head + n) % ORAGE_LOG_RING_SIZE;
+        log_ring.len -= n;
+
+        /* Chunk may end in the middle of a line, the note is written only
+         * after a complete line. Lines always end with newline, so the
+         * note is written at latest with the last chunk of the buffer. */
+        dropped = 0;
+        if (chunk[n - 1] == '\n')
+        {
+            dropped = log_ring.dropped;
+            log_ring.dropped = 0;
+        }
+        log_ring.writing = TRUE;
+        g_mutex_unlock (&log_ring.lock);
+
+        log_stream_write (chunk, n);
+        if (dropped)
+        {
+            n = g_snprintf (note, sizeof (note),
+                            "** %u log messages dropped\n", dropped);
+            log_stream_write (note, MIN (n, sizeof (note) - 1));
+        }
+
+        g_mutex_lock (&log_ring.lock);
+        log_ring.writing = FALSE;
+        g_cond_broadcast (&log_ring.cond);
     }
+    g_mutex_unlock (&log_ring.lock);
+
+    return NULL;
+}
+
+/* Returns FALSE when background writer is not running. */
+static gboolean log_ring_push (const gchar *str, const gsize len)
+{
+    gsize tail;
+    gsize n;
+
+    g_mutex_lock (&log_ring.lock);
+    if (log_ring.data == NULL || log_ring.quit)
+    {
+        g_mutex_unlock (&log_ring.lock);
+        return FALSE;
+    }
+
+    if (len > ORAGE_LOG_RING_SIZE - log_ring.len)
+        log_ring.dropped++;
     else
     {
-        message = NULL_MSG;
-        message_length = sizeof (NULL_MSG) - 1;
-        g_string_append_len (gstring, message, message_length);
+        tail = (log_ring.head + log_ring.len) % ORAGE_LOG_RING_SIZE;
+        n = MIN (len, ORAGE_LOG_RING_SIZE - tail);
+        memcpy (log_ring.data + tail, str, n);
+        memcpy (log_ring.data, str + n, len - n);
+        log_ring.len += len;
+        g_cond_broadcast (&log_ring.cond);
     }
+    g_mutex_unlock (&log_ring.lock);
 
-    g_string_append_c (gstring, '\n');
+    return TRUE;
+}
 
-    return g_string_free (gstring, FALSE);
+/* Wait until everything queued so far is written. */
+static void log_ring_drain (void)
+{
+    g_mutex_lock (&log_ring.lock);
+    while (log_ring.thread && (log_ring.len || log_ring.writing))
+        g_cond_wait (&log_ring.cond, &log_ring.lock);
+    g_mutex_unlock (&log_ring.lock);
 }
 
 static GLogWriterOutput orage_log_writer (GLogLevelFlags level,
@@ -371,7 +586,8 @@ static GLogWriterOutput orage_log_writer (GLogLevelFlags level,
                                           G_GNUC_UNUSED gpointer user_data)
 {
     int fno;
-    char *out;
+    gchar out[ORAGE_LOG_LINE_MAX];
+    gsize len;
 
     g_return_val_if_fail (fields != NULL, G_LOG_WRITER_UNHANDLED);
     g_return_val_if_fail (n_fields > 0, G_LOG_WRITER_UNHANDLED);
@@ -379,19 +595,68 @@ static GLogWriterOutput orage_log_writer (GLogLevelFlags level,
     if (orage_log_is_message_enabled (level, fields, n_fields) == FALSE)
         return G_LOG_WRITER_HANDLED;
 
-    fno = fileno (LOG_STREAM);
+    fno = fileno (log_get_stream ());
     if (G_UNLIKELY (fno < 0))
         return G_LOG_WRITER_UNHANDLED;
 
-    out = log_writer_format_fields_utf8 (level, fields, n_fields,
-                                         g_log_writer_supports_color (fno));
-    fputs (out, LOG_STREAM);
-    fflush (LOG_STREAM);
-    g_free (out);
+    len = orage_log_format (out, sizeof (out), level, fields, n_fields,
+                            g_log_writer_supports_color (fno));
+
+    /* Fatal messages are written before the program aborts. */
+    if (level & (G_LOG_LEVEL_ERROR | G_LOG_FLAG_FATAL))
+        log_ring_drain ();
+    else if (log_ring_push (out, len))
+        return G_LOG_WRITER_HANDLED;
+
+    log_stream_write (out, len);
 
     return G_LOG_WRITER_HANDLED;
 }
 
+void orage_log_set_async (const gboolean async)
+{
+    GThread *thread;
+
+    g_mutex_lock (&log_ring.lock);
+    if (async && log_ring.thread == NULL)
+    {
+        log_ring.data = g_malloc (ORAGE_LOG_RING_SIZE);
+        log_ring.head = 0;
+        log_ring.len = 0;
+        log_ring.dropped = 0;
+        log_ring.quit = FALSE;
+        log_ring.thread = g_thread_new ("orage-log", log_ring_writer_thread,
+                                        NULL);
+        g_mutex_unlock (&log_ring.lock);
+        return;
+    }
+
+    if (async || log_ring.thread == NULL)
+    {
+        g_mutex_unlock (&log_ring.lock);
+        return;
+    }
+
+    /* writer thread writes everything queued before it quits */
+    log_ring.quit = TRUE;
+    g_cond_broadcast (&log_ring.cond);
+    thread = log_ring.thread;
+    g_mutex_unlock (&log_ring.lock);
+
+    g_thread_join (thread);
+
+    g_mutex_lock (&log_ring.lock);
+    g_clear_pointer (&log_ring.data, g_free);
+    log_ring.thread = NULL;
+    g_mutex_unlock (&log_ring.lock);
+}
+
+void orage_log_set_stream (FILE *stream)
+{
+    log_ring_drain ();
+    log_stream = stream;
+}
+
 void orage_log_init (void)
 {
     static gsize initialized = FALSE;
@@ -402,6 +667,9 @@ void orage_log_init (void)
 
         g_log_set_writer_func (orage_log_writer, NULL, NULL);
 
+        if (g_strcmp0 (g_getenv ("ORAGE_LOG_ASYNC"), "1") == 0)
+            orage_log_set_async (TRUE);
+
         g_once_init_leave (&initialized, TRUE);
     }
 }
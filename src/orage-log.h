@@ -24,6 +24,16 @@
 /* Handles Orage debug logging. Inspired by GNOME Calendar and GLib logging. */
 
 #include <glib.h>
+#include <stdio.h>
+
+/** Longest log line in bytes, longer messages are truncated. */
+#define ORAGE_LOG_LINE_MAX 4096
+
+/** Smallest buffer accepted by orage_log_format(). */
+#define ORAGE_LOG_LINE_MIN 64
+
+/** Size of the background writer queue in bytes. */
+#define ORAGE_LOG_RING_SIZE (64 * 1024)
 
 G_BEGIN_DECLS
 
@@ -85,6 +95,52 @@ gboolean orage_log_is_message_enabled (GLogLevelFlags level,
                                        const GLogField *fields,
                                        gsize n_fields);
 
+/**
+ * orage_log_format:
+ * @buf: output buffer
+ * @size: size of @buf, at least %ORAGE_LOG_LINE_MIN
+ * @level: log message severity level
+ * @fields: structured log fields array
+ * @n_fields: number of elements in @fields
+ * @use_color: add terminal color codes
+ *
+ * Formats one log line into @buf without allocating memory. Invalid UTF-8
+ * and control characters of the message are escaped. Line which does not
+ * fit is truncated and ends with "...".
+ *
+ * Returns: length of the line including the newline, @buf is NUL
+ *          terminated.
+ */
+gsize orage_log_format (gchar *buf,
+                        gsize size,
+                        GLogLevelFlags level,
+                        const GLogField *fields,
+                        gsize n_fields,
+                        gboolean use_color);
+
+/**
+ * orage_log_set_async:
+ * @async: %TRUE to write log from background thread
+ *
+ * Starts or stops the background log writer. While it runs, log lines are
+ * queued into a ring buffer of %ORAGE_LOG_RING_SIZE bytes and the caller
+ * does not wait for the output. When the queue is full, lines are dropped
+ * and their number is reported. Fatal messages are always written directly.
+ * Stopping writes out everything queued.
+ *
+ * Background writer is started by orage_log_init() when environment
+ * variable %ORAGE_LOG_ASYNC is set to "1".
+ */
+void orage_log_set_async (gboolean async);
+
+/**
+ * orage_log_set_stream:
+ * @stream: output stream or %NULL for stdout
+ *
+ * Changes log output stream. Used mainly by tests.
+ */
+void orage_log_set_stream (FILE *stream);
+
 G_END_DECLS
 
 #endif
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2026 Erkki Moorits
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ *     Free Software Foundation
+ *     51 Franklin Street, 5th Floor
+ *     Boston, MA 02110-1301 USA
+ */
+
+#include "orage-memory.h"
+
+#include "event-list.h"
+#include "functions.h"
+#include "ical-code.h"
+#include "orage-category.h"
+#include "orage-free-busy.h"
+#include "reminder.h"
+
+#include <glib.h>
+#include <gtk/gtk.h>
+
+static void orage_memory_usage_clear (gpointer data)
+{
+    g_free (((OrageMemoryUsage *)data)->name);
+}
+
+void orage_memory_usage_add (GArray *usage, const gchar *name,
+                             const guint64 items, const guint64 properties,
+                             const guint64 bytes)
+{
+    OrageMemoryUsage entry;
+
+    entry.name = g_strdup (name);
+    entry.items = items;
+    entry.properties = properties;
+    entry.bytes = bytes;
+    g_array_append_val (usage, entry);
+}
+
+GArray *orage_memory_get_usage (void)
+{
+    GArray *usage;
+
+    usage = g_array_new (FALSE, FALSE, sizeof (OrageMemoryUsage));
+    g_array_set_clear_func (usage, orage_memory_usage_clear);
+
+    xfical_memory_usage (usage);
+    alarm_list_memory_usage (usage);
+    orage_free_busy_memory_usage (usage);
+    orage_process_text_commands_memory_usage (usage);
+    orage_category_memory_usage (usage);
+    el_win_memory_usage (usage);
+
+    return usage;
+}
+
+guint64 orage_memory_usage_total (GArray *usage)
+{
+    guint64 total = 0;
+    guint i;
+
+    for (i = 0; i < usage->len; i++)
+        total += g_array_index (usage, OrageMemoryUsage, i).bytes;
+
+    return total;
+}
+
+gchar *orage_memory_format (GArray *usage)
+{
+    GString *text;
+    OrageMemoryUsage *entry;
+    gchar *size;
+    guint i;
+
+    text = g_string_new (NULL);
+    g_string_append_printf (text, "%-32s %10s %10s %10s\n",
+                            "", "items", "properties", "size");
+
+    for (i = 0; i < usage->len; i++)
+    {
+        entry = &g_array_index (usage, OrageMemoryUsage, i);
+        size = g_format_size (entry->bytes);
+        g_string_append_printf (text,
+                                "%-32s %10" G_GUINT64_FORMAT
+                                " %10" G_GUINT64_FORMAT " %10s\n",
+                                entry->name, entry->items, entry->properties,
+                                size);
+        g_free (size);
+    }
+
+    size = g_format_size (orage_memory_usage_total (usage));
+    g_string_append_printf (text, "%-32s %10s %10s %10s\n",
+                            "total (approximate)", "", "", size);
+    g_free (size);
+
+    return g_string_free (text, FALSE);
+}
+
+guint64 orage_memory_trim (void)
+{
+    GArray *usage;
+    guint64 before;
+    guint64 after;
+
+    usage = orage_memory_get_usage ();
+    before = orage_memory_usage_total (usage);
+    g_array_unref (usage);
+
+    xfical_memory_trim ();
+    orage_process_text_commands_cache_clear ();
+
+    usage = orage_memory_get_usage ();
+    after = orage_memory_usage_total (usage);
+    g_array_unref (usage);
+
+    g_message ("trimmed about %" G_GUINT64_FORMAT " bytes",
+               before > after ? before - after : 0);
+
+    return before > after ? before - after : 0;
+}
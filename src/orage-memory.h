@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2026 Erkki Moorits
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ *     Free Software Foundation
+ *     51 Franklin Street, 5th Floor
+ *     Boston, MA 02110-1301 USA
+ */
+
+#ifndef ORAGE_MEMORY_H
+#define ORAGE_MEMORY_H 1
+
+/* Approximate memory accounting of calendar trees, alarms, caches and open
+ * views. Sizes are estimates of heap use, not exact allocator numbers.
+ */
+
+#include <glib.h>
+#include <string.h>
+
+/** Estimated heap bytes of one entry in a GHashTable. */
+#define ORAGE_MEMORY_HASH_ENTRY (2 * sizeof (gpointer) + sizeof (guint))
+
+/** Estimated heap bytes of one GList node. */
+#define ORAGE_MEMORY_LIST_NODE (3 * sizeof (gpointer))
+
+/** Estimated heap bytes of one GDateTime. */
+#define ORAGE_MEMORY_DATE_TIME 40
+
+G_BEGIN_DECLS
+
+typedef struct _OrageMemoryUsage
+{
+    gchar *name;
+    guint64 items;      /* components, alarms, rows or cache entries */
+    guint64 properties; /* iCalendar properties, 0 for other data */
+    guint64 bytes;
+} OrageMemoryUsage;
+
+static inline gsize orage_memory_string_size (const gchar *str)
+{
+    return str ? strlen (str) + 1 : 0;
+}
+
+/** Add one line to usage report.
+ *  @param usage array of OrageMemoryUsage
+ *  @param name name of the accounted data, copied
+ */
+void orage_memory_usage_add (GArray *usage, const gchar *name, guint64 items,
+                             guint64 properties, guint64 bytes);
+
+/** Collect memory usage of all subsystems.
+ *  @return array of OrageMemoryUsage, free with g_array_unref
+ */
+GArray *orage_memory_get_usage (void);
+
+/** Sum of bytes in usage report. */
+guint64 orage_memory_usage_total (GArray *usage);
+
+/** Format usage report as text table for command line output.
+ *  @return report text, free with g_free
+ */
+gchar *orage_memory_format (GArray *usage);
+
+/** Release calendar trees which are kept open only to save time and drop
+ *  caches. Everything released is loaded again when needed.
+ *  @return estimated number of bytes released
+ */
+guint64 orage_memory_trim (void);
+
+G_END_DECLS
+
+#endif
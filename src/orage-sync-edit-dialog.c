@@ -32,6 +32,7 @@ struct _OrageSyncEditDialog
 
     GtkEntry *description_entry;
     GtkEntry *command_entry;
+    GtkEntry *reload_file_entry;
     GtkSpinButton *period_entry;
 
     gboolean changed;
@@ -111,6 +112,7 @@ static void orage_sync_edit_dialog_constructed (GObject *object)
     GtkGrid *grid;
     GtkWidget *description_label;
     GtkWidget *command_label;
+    GtkWidget *reload_file_label;
     GtkWidget *period_label;
     GtkBox *minute_box;
     GtkWidget *minute_label;
@@ -133,6 +135,8 @@ static void orage_sync_edit_dialog_constructed (GObject *object)
     dialog->description_entry = create_entry (dialog);
     command_label = create_label (_("Command:"));
     dialog->command_entry = create_entry (dialog);
+    reload_file_label = create_label (_("Reload calendar:"));
+    dialog->reload_file_entry = create_entry (dialog);
     period_label = create_label (_("Period:"));
     dialog->period_entry = create_spinner (dialog);
     minute_label = create_label (_("minutes"));
@@ -143,6 +147,11 @@ static void orage_sync_edit_dialog_constructed (GObject *object)
     gtk_widget_set_tooltip_text (GTK_WIDGET (dialog->command_entry),
         _("Command for synchronization."));
 
+    gtk_widget_set_tooltip_text (GTK_WIDGET (dialog->reload_file_entry),
+        _("Calendar file written by the command. It is reloaded as soon as "
+          "synchronization succeeds. Leave empty to rely on periodic file "
+          "checking."));
+
     gtk_widget_set_tooltip_text (GTK_WIDGET (dialog->period_entry),
         _("Synchronization period in minutes."));
 
@@ -155,8 +164,10 @@ static void orage_sync_edit_dialog_constructed (GObject *object)
     gtk_grid_attach (grid, GTK_WIDGET (dialog->description_entry), 1, 0, 1, 1);
     gtk_grid_attach (grid, command_label,                          0, 1, 1, 1);
     gtk_grid_attach (grid, GTK_WIDGET (dialog->command_entry),     1, 1, 1, 1);
-    gtk_grid_attach (grid, period_label,                           0, 2, 1, 1);
-    gtk_grid_attach (grid, GTK_WIDGET (minute_box),                1, 2, 1, 1);
+    gtk_grid_attach (grid, reload_file_label,                      0, 2, 1, 1);
+    gtk_grid_attach (grid, GTK_WIDGET (dialog->reload_file_entry), 1, 2, 1, 1);
+    gtk_grid_attach (grid, period_label,                           0, 3, 1, 1);
+    gtk_grid_attach (grid, GTK_WIDGET (minute_box),                1, 3, 1, 1);
 
     content_area = gtk_dialog_get_content_area (GTK_DIALOG (dialog));
     gtk_box_pack_start (GTK_BOX (content_area), GTK_WIDGET (grid),
@@ -191,6 +202,7 @@ GtkWidget *orage_sync_edit_dialog_new (void)
 
 GtkWidget *orage_sync_edit_dialog_new_with_defaults (const gchar *description,
                                                      const gchar *command,
+                                                     const gchar *reload_file,
                                                      guint period)
 {
     OrageSyncEditDialog *dialog;
@@ -204,6 +216,9 @@ GtkWidget *orage_sync_edit_dialog_new_with_defaults (const gchar *description,
     if (command)
         gtk_entry_set_text (dialog->command_entry, command);
 
+    if (reload_file)
+        gtk_entry_set_text (dialog->reload_file_entry, reload_file);
+
     gtk_spin_button_set_value (dialog->period_entry, period);
 
     dialog->changed = FALSE;
@@ -225,6 +240,13 @@ const gchar *orage_sync_edit_dialog_get_command (OrageSyncEditDialog *dialog)
     return gtk_entry_get_text (dialog->command_entry);
 }
 
+const gchar *orage_sync_edit_dialog_get_reload_file (OrageSyncEditDialog *dialog)
+{
+    g_return_val_if_fail (ORAGE_IS_SYNC_EDIT_DIALOG (dialog), NULL);
+
+    return gtk_entry_get_text (dialog->reload_file_entry);
+}
+
 guint orage_sync_edit_dialog_get_period (OrageSyncEditDialog *dialog)
 {
     g_return_val_if_fail (ORAGE_IS_SYNC_EDIT_DIALOG (dialog), 10);
@@ -31,6 +31,7 @@ GtkWidget *orage_sync_edit_dialog_new (void);
 
 GtkWidget *orage_sync_edit_dialog_new_with_defaults (const gchar *description,
                                                      const gchar *command,
+                                                     const gchar *reload_file,
                                                      guint period);
 
 /** Gets the current text of the syncronization description.
@@ -45,6 +46,12 @@ const gchar *orage_sync_edit_dialog_get_description (OrageSyncEditDialog *dialog
  */
 const gchar *orage_sync_edit_dialog_get_command (OrageSyncEditDialog *dialog);
 
+/** Gets the calendar file which is reloaded after successful sync.
+ *  @param dialog OrageSyncEditDialog instance
+ *  @return file name, empty if not set, owned by dialog
+ */
+const gchar *orage_sync_edit_dialog_get_reload_file (OrageSyncEditDialog *dialog);
+
 /** Gets the current period value.
  *  @param dialog OrageSyncEditDialog instance
  *  @return integer between 1 to 60
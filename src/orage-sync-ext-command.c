@@ -20,41 +20,59 @@
 
 #include "orage-sync-ext-command.h"
 #include "orage-task-runner.h"
-#include "functions.h"
+#include "orage-trace.h"
 #include <gio/gio.h>
 #include <glib.h>
 
-void orage_sync_ext_command (G_GNUC_UNUSED GTask *task,
+void orage_sync_ext_command (GTask *task,
                              G_GNUC_UNUSED gpointer source_object,
                              gpointer task_data,
-                             G_GNUC_UNUSED GCancellable *cancellable)
+                             GCancellable *cancellable)
 {
-    gboolean succeed;
+    GSubprocess *process;
+    gchar **argv;
     GError *error = NULL;
     orage_task_runner_conf *sync_conf = (orage_task_runner_conf *)task_data;
+    ORAGE_TRACE_SCOPE ("sync");
 
-    g_return_if_fail (sync_conf->command != NULL);
+    if (sync_conf->command == NULL || sync_conf->command[0] == '\0')
+    {
+        g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                                 "sync '%s' has no command",
+                                 sync_conf->description);
+        return;
+    }
 
     g_message ("starting sync '%s' with command '%s'",
                sync_conf->description, sync_conf->command);
 
-    if (sync_conf->sync_active)
+    if (G_UNLIKELY (!g_shell_parse_argv (sync_conf->command, NULL, &argv,
+                                         &error)))
     {
-        g_debug ("sync '%s' already active", sync_conf->description);
+        g_task_return_error (task, error);
         return;
     }
 
-    succeed = orage_exec (sync_conf->command, &sync_conf->sync_active, &error);
+    process = g_subprocess_newv ((const gchar * const *)argv,
+                                 G_SUBPROCESS_FLAGS_NONE, &error);
+    g_strfreev (argv);
 
-    if (G_UNLIKELY (succeed == FALSE))
+    if (G_UNLIKELY (process == NULL))
     {
-        if (error != NULL)
-        {
-            g_warning ("sync command '%s' failed: %s",
-                       sync_conf->command, error->message);
-            g_clear_error (&error);
-        }
-        else
-            g_warning ("sync command '%s' failed", sync_conf->command);
+        g_task_return_error (task, error);
+        return;
     }
+
+    /* Exit status is checked, so that failed sync is retried later. */
+    if (g_subprocess_wait_check (process, cancellable, &error))
+        g_task_return_boolean (task, TRUE);
+    else
+    {
+        if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+            g_subprocess_force_exit (process);
+
+        g_task_return_error (task, error);
+    }
+
+    g_object_unref (process);
 }
@@ -24,10 +24,30 @@
 #include <glib-object.h>
 #include <glib.h>
 
+#include <string.h>
+
+/* First retry delay in seconds after failed task. Delay is doubled for
+ * each following failure up to ORAGE_TASK_RUNNER_MAX_BACKOFF.
+ */
+#define TASK_RETRY_DELAY 60
+
+/* Periods are spread by this percentage so that tasks with same period do
+ * not start at the same time.
+ */
+#define TASK_JITTER_PERCENT 10
+
 struct _orage_task_runner_data
 {
+    OrageTaskRunner *runner;
     GTask *task;
     guint timer_id;
+    guint failures;
+    gboolean queued;
+
+    /* Task was removed while it was running, data is freed when task is
+     * ready.
+     */
+    gboolean removed;
     GTaskThreadFunc task_func;
     orage_task_runner_conf *conf;
 };
@@ -39,6 +59,10 @@ struct _OrageTaskRunner
     GObject __parent__;
 
     GSList* task_runner_callbacks;
+
+    /* Tasks waiting for free slot. */
+    GQueue pending;
+    guint running;
 };
 
 struct _OrageTaskRunnerClass
@@ -46,16 +70,26 @@ struct _OrageTaskRunnerClass
     GObjectClass __parent__;
 };
 
+enum
+{
+    SIGNAL_FINISHED,
+    N_SIGNALS
+};
+
+static guint signals[N_SIGNALS] = { 0 };
+
 G_DEFINE_TYPE (OrageTaskRunner, orage_task_runner, G_TYPE_OBJECT)
 
 static void remove_timer (gpointer data);
 static void orage_task_runner_free (orage_task_runner_data *data);
+static void request_task_run (orage_task_runner_data *task_data);
 
 static void orage_task_runner_finalize (GObject *object)
 {
     OrageTaskRunner *task_runner = ORAGE_TASK_RUNNER (object);
 
     orage_task_runne_interrupt (task_runner);
+    g_queue_clear (&task_runner->pending);
     g_slist_free_full (task_runner->task_runner_callbacks,
                        (GDestroyNotify)orage_task_runner_free);
 
@@ -68,50 +102,201 @@ static void orage_task_runner_class_init (OrageTaskRunnerClass *klass)
 
     gobject_class = G_OBJECT_CLASS (klass);
     gobject_class->finalize = orage_task_runner_finalize;
+
+    /**
+     * OrageTaskRunner::finished:
+     * @runner: the task runner
+     * @conf: configuration of the finished task, owned by task runner
+     * @success: TRUE if task succeeded
+     *
+     * Emitted in main context when task has finished. Not emitted for
+     * cancelled tasks.
+     */
+    signals[SIGNAL_FINISHED] =
+            g_signal_new ("finished",
+                          G_TYPE_FROM_CLASS (klass),
+                          G_SIGNAL_RUN_LAST,
+                          0, NULL, NULL, NULL,
+                          G_TYPE_NONE, 2,
+                          G_TYPE_POINTER, G_TYPE_BOOLEAN);
 }
 
-static void orage_task_runner_init (G_GNUC_UNUSED OrageTaskRunner *task_runner)
+static void orage_task_runner_init (OrageTaskRunner *task_runner)
 {
+    g_queue_init (&task_runner->pending);
+    task_runner->running = 0;
 }
 
-static void task_ready_callback (G_GNUC_UNUSED GObject *source_object,
-                                 G_GNUC_UNUSED GAsyncResult *res,
-                                 gpointer user_data)
+static orage_task_runner_conf *orage_task_runner_conf_clone (
+    const orage_task_runner_conf *conf)
 {
-    orage_task_runner_data *task_data = (orage_task_runner_data *)user_data;
+    orage_task_runner_conf *cloned_conf;
 
-    task_data->task = NULL;
+    cloned_conf = g_new (orage_task_runner_conf, 1);
+    cloned_conf->description = g_strdup (conf->description);
+    cloned_conf->command = g_strdup (conf->command);
+    cloned_conf->reload_file = g_strdup (conf->reload_file);
+    cloned_conf->period = conf->period;
+
+    return cloned_conf;
 }
 
-static gboolean start_task_runner_thread (gpointer data)
+static void orage_task_runner_conf_free (orage_task_runner_conf *conf)
+{
+    g_return_if_fail (conf != NULL);
+
+    g_free (conf->command);
+    g_free (conf->description);
+    g_free (conf->reload_file);
+    g_free (conf);
+}
+
+/* Delay in seconds until the next run of the task. */
+static guint task_delay (const orage_task_runner_data *task_data)
+{
+    guint delay;
+    guint jitter;
+
+    if (task_data->failures)
+    {
+        delay = TASK_RETRY_DELAY << MIN (task_data->failures - 1, 16);
+        delay = MIN (delay, ORAGE_TASK_RUNNER_MAX_BACKOFF);
+    }
+    else
+        delay = MAX (task_data->conf->period, 1);
+
+    jitter = delay * TASK_JITTER_PERCENT / 100;
+    if (jitter)
+        delay += g_random_int_range (-(gint)jitter, (gint)jitter + 1);
+
+    return MAX (delay, 1);
+}
+
+static gboolean task_timer_cb (gpointer data)
 {
-    GCancellable *cancel;
     orage_task_runner_data *task_data = (orage_task_runner_data *)data;
 
-    if (task_data->task != NULL)
+    task_data->timer_id = 0;
+    request_task_run (task_data);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void schedule_task (orage_task_runner_data *task_data)
+{
+    guint delay;
+
+    remove_timer (task_data);
+    delay = task_delay (task_data);
+    g_debug ("task '%s' scheduled after %u seconds",
+             task_data->conf->description, delay);
+    task_data->timer_id = g_timeout_add_seconds (delay, task_timer_cb,
+                                                 task_data);
+}
+
+static void start_next_pending_task (OrageTaskRunner *runner)
+{
+    orage_task_runner_data *task_data;
+
+    while (runner->running < ORAGE_TASK_RUNNER_MAX_CONCURRENT
+        && (task_data = g_queue_pop_head (&runner->pending)) != NULL)
     {
-        g_info ("task @ %p already started", data);
-        return TRUE;
+        task_data->queued = FALSE;
+        request_task_run (task_data);
     }
+}
 
-    cancel = g_cancellable_new ();
-    task_data->task = g_task_new (NULL, cancel, task_ready_callback, data);
+static void task_ready_callback (GObject *source_object,
+                                 GAsyncResult *res,
+                                 gpointer user_data)
+{
+    OrageTaskRunner *runner = ORAGE_TASK_RUNNER (source_object);
+    orage_task_runner_data *task_data = (orage_task_runner_data *)user_data;
+    GError *error = NULL;
+    gboolean success;
+
+    success = g_task_propagate_boolean (G_TASK (res), &error);
+    task_data->task = NULL;
+    runner->running--;
+
+    if (task_data->removed)
+        orage_task_runner_free (task_data);
+    else if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_debug ("task '%s' cancelled", task_data->conf->description);
+    else
+    {
+        if (success)
+        {
+            g_debug ("task '%s' finished", task_data->conf->description);
+            task_data->failures = 0;
+        }
+        else
+        {
+            task_data->failures++;
+            g_warning ("task '%s' failed (%u in row): %s",
+                       task_data->conf->description, task_data->failures,
+                       error ? error->message : "unknown error");
+        }
+
+        g_signal_emit (runner, signals[SIGNAL_FINISHED], 0,
+                       task_data->conf, success);
+        schedule_task (task_data);
+    }
+
+    g_clear_error (&error);
+    start_next_pending_task (runner);
+}
+
+static void start_task_runner_thread (orage_task_runner_data *task_data)
+{
+    GCancellable *cancel;
 
-    g_task_set_task_data (task_data->task, task_data->conf, NULL);
+    cancel = g_cancellable_new ();
+    task_data->task = g_task_new (task_data->runner, cancel,
+                                  task_ready_callback, task_data);
+    task_data->runner->running++;
+
+    /* Thread gets own copy, configuration may change while it runs. */
+    g_task_set_task_data (task_data->task,
+                          orage_task_runner_conf_clone (task_data->conf),
+                          (GDestroyNotify)orage_task_runner_conf_free);
     g_task_run_in_thread (task_data->task, task_data->task_func);
 
     g_object_unref (cancel);
     g_object_unref (task_data->task);
+}
+
+static void request_task_run (orage_task_runner_data *task_data)
+{
+    OrageTaskRunner *runner = task_data->runner;
+
+    if (task_data->task != NULL || task_data->queued)
+    {
+        g_info ("task '%s' already started", task_data->conf->description);
+        return;
+    }
+
+    if (runner->running >= ORAGE_TASK_RUNNER_MAX_CONCURRENT)
+    {
+        g_debug ("task '%s' waiting for free slot",
+                 task_data->conf->description);
+        task_data->queued = TRUE;
+        g_queue_push_tail (&runner->pending, task_data);
+        return;
+    }
 
-    return TRUE;
+    start_task_runner_thread (task_data);
 }
 
 static void remove_timer (gpointer data)
 {
-    const orage_task_runner_data *task_data =
-        (const orage_task_runner_data *)data;
+    orage_task_runner_data *task_data = (orage_task_runner_data *)data;
 
-    (void)g_source_remove (task_data->timer_id);
+    if (task_data->timer_id)
+    {
+        (void)g_source_remove (task_data->timer_id);
+        task_data->timer_id = 0;
+    }
 }
 
 static gint task_callback_conf_compare (gconstpointer pa, gconstpointer pb)
@@ -139,11 +324,9 @@ static void task_runner_and_restart_timer (gpointer data,
 {
     orage_task_runner_data *task_data = (orage_task_runner_data *)data;
 
-    remove_timer (data);
-    start_task_runner_thread (data);
-    task_data->timer_id = g_timeout_add_seconds (task_data->conf->period,
-                                                 start_task_runner_thread,
-                                                 data);
+    /* next run is scheduled when this one is ready */
+    remove_timer (task_data);
+    request_task_run (task_data);
 }
 
 static void cancel_task_runner (gpointer data, G_GNUC_UNUSED gpointer user_data)
@@ -154,33 +337,24 @@ static void cancel_task_runner (gpointer data, G_GNUC_UNUSED gpointer user_data)
         g_cancellable_cancel (g_task_get_cancellable (task_data->task));
 }
 
-static orage_task_runner_conf *orage_task_runner_conf_clone (
-    const orage_task_runner_conf *conf)
+static void orage_task_runner_free (orage_task_runner_data *data)
 {
-    orage_task_runner_conf *cloned_conf;
-
-    cloned_conf = g_new (orage_task_runner_conf, 1);
-    cloned_conf->description = g_strdup (conf->description);
-    cloned_conf->command = g_strdup (conf->command);
-    cloned_conf->period = conf->period;
-    cloned_conf->sync_active = conf->sync_active;
-
-    return cloned_conf;
-}
+    remove_timer (data);
 
-static void orage_task_runner_conf_free (orage_task_runner_conf *conf)
-{
-    g_return_if_fail (conf != NULL);
+    if (data->queued)
+    {
+        g_queue_remove (&data->runner->pending, data);
+        data->queued = FALSE;
+    }
 
-    g_free (conf->command);
-    g_free (conf->description);
-    g_free (conf);
-}
+    if (data->task)
+    {
+        /* task_ready_callback frees data */
+        cancel_task_runner (data, NULL);
+        data->removed = TRUE;
+        return;
+    }
 
-static void orage_task_runner_free (orage_task_runner_data *data)
-{
-    remove_timer (data);
-    cancel_task_runner (data, NULL);
     orage_task_runner_conf_free (data->conf);
     g_free (data);
 }
@@ -191,11 +365,10 @@ void orage_task_runner_add (OrageTaskRunner *task_runner,
 {
     orage_task_runner_data *task_data = g_new0 (orage_task_runner_data, 1);
 
+    task_data->runner = task_runner;
     task_data->task_func = task_func;
     task_data->conf = orage_task_runner_conf_clone (task_runner_conf);
-    task_data->timer_id = g_timeout_add_seconds (task_runner_conf->period,
-                                                 start_task_runner_thread,
-                                                 task_data);
+    schedule_task (task_data);
     task_runner->task_runner_callbacks =
             g_slist_append (task_runner->task_runner_callbacks, task_data);
 }
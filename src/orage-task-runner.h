@@ -34,17 +34,32 @@ typedef struct _OrageTaskRunner      OrageTaskRunner;
 
 GType orage_task_runner_get_type (void);
 
+/** Maximum number of tasks running at the same time. Other due tasks wait
+ *  until one of the running tasks has finished.
+ */
+#define ORAGE_TASK_RUNNER_MAX_CONCURRENT 2
+
+/** Longest retry delay in seconds after repeated failures. */
+#define ORAGE_TASK_RUNNER_MAX_BACKOFF (60 * 60)
+
 struct _orage_task_runner_conf
 {
     gchar *description;
     gchar *command;
+
+    /** Calendar file which is reloaded when task has succeeded, or NULL. */
+    gchar *reload_file;
+
+    /** Period in seconds. */
     guint period;
-    gboolean sync_active;
 };
 
 typedef struct _orage_task_runner_conf orage_task_runner_conf;
 
-/** Add new task function.
+/** Add new task function. Task function must return result with
+ *  g_task_return_boolean() or g_task_return_error(). Failed tasks are
+ *  retried with exponential backoff and successful tasks are run again after
+ *  their period. Result is reported with "finished" signal.
  *  @param task_runner instance of task runner
  *  @param task_func task function
  *  @param conf periodic task configuration, data is owned by caller
@@ -60,7 +75,7 @@ void orage_task_runner_add (OrageTaskRunner *task_runner,
 void orage_task_runner_remove (OrageTaskRunner *task_runner,
                                const orage_task_runner_conf *conf);
 
-/** Run all tasks.
+/** Run all tasks now, or as soon as there are free slots for them.
  *  @param task_runner instance of task runner
  */
 void orage_task_runner_trigger (OrageTaskRunner *task_runner);
@@ -204,16 +204,23 @@ gchar *orage_gdatetime_to_icaltime (GDateTime *gdt, const gboolean date_only)
 struct icaltimetype orage_gdatetime_to_icaltimetype (GDateTime *gdt,
                                                      const gboolean date_only)
 {
-    gchar *str;
+    gint year;
+    gint month;
+    gint day;
     struct icaltimetype icalt;
 
-    /* TODO: icaltimetype should be created directly from GDateTime, not using
-     * intermediate string.
-     */
+    icalt = date_only ? icaltime_null_date () : icaltime_null_time ();
+    g_date_time_get_ymd (gdt, &year, &month, &day);
+    icalt.year = year;
+    icalt.month = month;
+    icalt.day = day;
 
-    str = orage_gdatetime_to_icaltime (gdt, date_only);
-    icalt = icaltime_from_string (str);
-    g_free (str);
+    if (date_only == FALSE)
+    {
+        icalt.hour = g_date_time_get_hour (gdt);
+        icalt.minute = g_date_time_get_minute (gdt);
+        icalt.second = g_date_time_get_second (gdt);
+    }
 
     return icalt;
 }
@@ -366,9 +373,20 @@ GDateTime *orage_icaltimetype_to_gdatetime (struct icaltimetype *icaltime)
 
 GDateTime *orage_icaltimetype_to_gdatetime2 (struct icaltimetype t)
 {
-    const gchar *i18_date = icaltime_as_ical_string (t);
+    if (t.is_date)
+        return g_date_time_new_local (t.year, t.month, t.day, 0, 0, 0);
+
+    return g_date_time_new_local (t.year, t.month, t.day,
+                                  t.hour, t.minute, t.second);
+}
+
+GDateTime *orage_icaltimetype_to_gdatetime_in_zone (struct icaltimetype t,
+                                                    icaltimezone *zone)
+{
+    if (zone != NULL)
+        t = icaltime_convert_to_zone (t, zone);
 
-    return orage_icaltime_to_gdatetime (i18_date);
+    return orage_icaltimetype_to_gdatetime2 (t);
 }
 
 GDateTime *orage_time_t_to_gdatetime (const time_t t, const gchar *tz_id)
@@ -392,3 +410,22 @@ GDateTime *orage_time_t_to_gdatetime (const time_t t, const gchar *tz_id)
 
     return gdt;
 }
+
+struct icaltimetype orage_time_t_to_icaltimetype (const time_t t)
+{
+    struct icaltimetype icalt;
+    struct tm tm;
+
+    icalt = icaltime_null_time ();
+    if (gmtime_r (&t, &tm) == NULL)
+        return icalt;
+
+    icalt.year = tm.tm_year + 1900;
+    icalt.month = tm.tm_mon + 1;
+    icalt.day = tm.tm_mday;
+    icalt.hour = tm.tm_hour;
+    icalt.minute = tm.tm_min;
+    icalt.second = tm.tm_sec;
+
+    return icalt;
+}
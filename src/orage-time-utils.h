@@ -186,8 +186,9 @@ gchar *orage_gdatetime_to_icaltime (GDateTime *gdt, gboolean date_only);
  * @gdt: a #GDateTime instance to convert
  * @date_only: %TRUE if the result should contain only date (no time)
  *
- * Converts a #GDateTime instance to an #icaltimetype. This implementation uses
- * an intermediate string representation before conversion.
+ * Converts a #GDateTime instance to a floating #icaltimetype. Wall clock fields
+ * of @gdt are copied as they are, timezone of @gdt is not used. The conversion
+ * does not allocate memory.
  *
  * Returns: the resulting #icaltimetype structure
  */
@@ -282,18 +283,37 @@ gchar *orage_icaltime_to_i18_time (const gchar *icaltime);
 GDateTime *orage_icaltimetype_to_gdatetime (struct icaltimetype *icaltime);
 
 /**
- * icaltimetype_to_gdatetime:
+ * orage_icaltimetype_to_gdatetime2:
  * @t: an #icaltimetype value
  *
  * Converts a #icaltimetype structure into a #GDateTime object. The resulting
- * #GDateTime reflects the same date and time components as the input.
- *
- * Returns: (transfer full): a newly-allocated #GDateTime corresponding
- * to @t. The caller must free it with g_date_time_unref() when no longer
- * needed.
+ * #GDateTime reflects the same date and time components as the input and is
+ * created in the local time zone. For DATE values the time is 00:00:00. The
+ * timezone of @t is not used, this matches parsing the string returned by
+ * `icaltime_as_ical_string()` with orage_icaltime_to_gdatetime() without the
+ * intermediate string.
+ *
+ * Returns: (transfer full) (nullable): a newly-allocated #GDateTime
+ * corresponding to @t, or %NULL if @t is not a valid time. The caller must
+ * free it with g_date_time_unref() when no longer needed.
  */
 GDateTime *orage_icaltimetype_to_gdatetime2 (struct icaltimetype t);
 
+/**
+ * orage_icaltimetype_to_gdatetime_in_zone:
+ * @t: an #icaltimetype value
+ * @zone: (nullable): timezone to convert @t into before the conversion
+ *
+ * Converts @t into @zone with `icaltime_convert_to_zone()` and then returns
+ * wall clock of the result as #GDateTime in the local time zone, like
+ * orage_icaltimetype_to_gdatetime2(). If @zone is %NULL, @t is used as it is.
+ *
+ * Returns: (transfer full) (nullable): a newly-allocated #GDateTime, or %NULL
+ * if @t is not a valid time. Free it with g_date_time_unref().
+ */
+GDateTime *orage_icaltimetype_to_gdatetime_in_zone (struct icaltimetype t,
+                                                    icaltimezone *zone);
+
 /**
  * orage_time_t_to_gdatetime:
  * @t: UNIX timestamp (seconds since the Epoch)
@@ -309,4 +329,17 @@ GDateTime *orage_icaltimetype_to_gdatetime2 (struct icaltimetype t);
  */
 GDateTime *orage_time_t_to_gdatetime (const time_t t, const gchar *tz_id);
 
+/**
+ * orage_time_t_to_icaltimetype:
+ * @t: UNIX timestamp (seconds since the Epoch)
+ *
+ * Converts a UNIX timestamp to a floating #icaltimetype holding UTC wall clock
+ * of @t. This gives same fields as g_date_time_new_from_unix_utc() followed
+ * by orage_gdatetime_to_icaltimetype(), but without any allocation.
+ *
+ * Returns: the resulting #icaltimetype structure, null time if @t can not be
+ * converted
+ */
+struct icaltimetype orage_time_t_to_icaltimetype (const time_t t);
+
 #endif
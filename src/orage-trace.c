@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2026 Erkki Moorits
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ *     Free Software Foundation
+ *     51 Franklin Street, 5th Floor
+ *     Boston, MA 02110-1301 USA
+ */
+
+#include "orage-trace.h"
+
+#include <glib.h>
+
+typedef struct _TraceEvent
+{
+    const gchar *name;
+    gint64 start;
+    gint64 duration;
+    guint thread_id;
+} TraceEvent;
+
+gboolean orage_trace_enabled = FALSE;
+
+static GMutex trace_lock;
+static GArray *trace_events = NULL;
+static gchar *trace_file = NULL;
+static gint64 trace_start_time = 0;
+
+/* Small sequential thread numbers, the main thread is 1. */
+static GPrivate trace_thread_id;
+static gint trace_thread_count = 0;
+
+static guint trace_get_thread_id (void)
+{
+    guint id;
+
+    id = GPOINTER_TO_UINT (g_private_get (&trace_thread_id));
+    if (id == 0)
+    {
+        id = (guint)g_atomic_int_add (&trace_thread_count, 1) + 1;
+        g_private_set (&trace_thread_id, GUINT_TO_POINTER (id));
+    }
+
+    return id;
+}
+
+static void trace_append_name (GString *json, const gchar *name)
+{
+    for (; *name != '\0'; name++)
+    {
+        if (*name == '"' || *name == '\\')
+            g_string_append_c (json, '\\');
+        g_string_append_c (json, *name);
+    }
+}
+
+void orage_trace_start (const gchar *file_name)
+{
+    if (orage_trace_enabled)
+        return;
+
+    g_mutex_lock (&trace_lock);
+    trace_events = g_array_new (FALSE, FALSE, sizeof (TraceEvent));
+    trace_file = g_strdup (file_name);
+    trace_start_time = g_get_monotonic_time ();
+    g_mutex_unlock (&trace_lock);
+
+    (void)trace_get_thread_id ();
+    orage_trace_enabled = TRUE;
+}
+
+void orage_trace_record (const gchar *name, const gint64 start,
+                         const gint64 end)
+{
+    TraceEvent event;
+
+    event.name = name;
+    event.start = start;
+    event.duration = end - start;
+    event.thread_id = trace_get_thread_id ();
+
+    g_mutex_lock (&trace_lock);
+    if (trace_events)
+        g_array_append_val (trace_events, event);
+    g_mutex_unlock (&trace_lock);
+}
+
+void orage_trace_stop (void)
+{
+    GString *json;
+    TraceEvent *event;
+    GError *error = NULL;
+    guint i;
+
+    if (!orage_trace_enabled)
+        return;
+
+    orage_trace_enabled = FALSE;
+
+    g_mutex_lock (&trace_lock);
+    json = g_string_new ("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    g_string_append (json,
+                     "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+                     "\"tid\":1,\"args\":{\"name\":\"orage\"}},\n"
+                     "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                     "\"tid\":1,\"args\":{\"name\":\"main\"}}");
+
+    for (i = 0; i < trace_events->len; i++)
+    {
+        event = &g_array_index (trace_events, TraceEvent, i);
+        g_string_append (json, ",\n{\"name\":\"");
+        trace_append_name (json, event->name);
+        g_string_append_printf (json,
+                                "\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                                "\"ts\":%" G_GINT64_FORMAT ","
+                                "\"dur\":%" G_GINT64_FORMAT "}",
+                                event->thread_id,
+                                event->start - trace_start_time,
+                                event->duration);
+    }
+
+    g_string_append (json, "\n]}\n");
+
+    if (g_file_set_contents (trace_file, json->str, json->len, &error))
+    {
+        g_message ("wrote %u trace events to '%s'", trace_events->len,
+                   trace_file);
+    }
+    else
+    {
+        g_warning ("could not write trace file '%s': %s", trace_file,
+                   error->message);
+        g_error_free (error);
+    }
+
+    g_string_free (json, TRUE);
+    g_array_free (trace_events, TRUE);
+    trace_events = NULL;
+    g_clear_pointer (&trace_file, g_free);
+    g_mutex_unlock (&trace_lock);
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2026 Erkki Moorits
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ *     Free Software Foundation
+ *     51 Franklin Street, 5th Floor
+ *     Boston, MA 02110-1301 USA
+ */
+
+#ifndef ORAGE_TRACE_H
+#define ORAGE_TRACE_H 1
+
+/* Records time spent in named spans and writes them as Chrome trace event
+ * JSON, which chrome://tracing and ui.perfetto.dev can show. Tracing is off
+ * unless orage_trace_start() was called, and then a span costs only one
+ * flag test.
+ */
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _OrageTraceSpan
+{
+    const gchar *name;
+    gint64 start;
+} OrageTraceSpan;
+
+/** TRUE while spans are recorded. Use the functions below to change. */
+extern gboolean orage_trace_enabled;
+
+/** Start recording spans.
+ *  @param file_name file where the trace is written when stopped
+ */
+void orage_trace_start (const gchar *file_name);
+
+/** Stop recording and write recorded spans. Does nothing if tracing was not
+ *  started.
+ */
+void orage_trace_stop (void);
+
+/** Add finished span to the trace. Thread safe.
+ *  @param name span name, must stay valid until the trace is written
+ *  @param start start time from g_get_monotonic_time()
+ *  @param end end time from g_get_monotonic_time()
+ */
+void orage_trace_record (const gchar *name, gint64 start, gint64 end);
+
+static inline OrageTraceSpan orage_trace_span_begin (const gchar *name)
+{
+    OrageTraceSpan span = { name, 0 };
+
+    if (G_UNLIKELY (orage_trace_enabled))
+        span.start = g_get_monotonic_time ();
+
+    return span;
+}
+
+static inline void orage_trace_span_end (OrageTraceSpan *span)
+{
+    if (G_UNLIKELY (span->start != 0))
+    {
+        orage_trace_record (span->name, span->start, g_get_monotonic_time ());
+        span->start = 0;
+    }
+}
+
+G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC (OrageTraceSpan, orage_trace_span_end)
+
+/** Record span from this point to the end of the enclosing block. Must be
+ *  placed among declarations.
+ *  @param name string literal naming the span
+ */
+#define ORAGE_TRACE_SCOPE(name) \
+    g_auto (OrageTraceSpan) G_PASTE (orage_trace_span_, __LINE__) = \
+        orage_trace_span_begin (name)
+
+G_END_DECLS
+
+#endif
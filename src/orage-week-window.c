@@ -32,10 +32,10 @@
 #include "functions.h"
 #include "ical-code.h"
 #include "orage-appointment-window.h"
-#include "orage-category.h"
 #include "orage-css.h"
 #include "orage-i18n.h"
 #include "orage-time-utils.h"
+#include "orage-trace.h"
 #include "orage-week-window.h"
 #include "parameters.h"
 
@@ -638,11 +638,12 @@ static gchar *get_row_css_name (const gint row)
         return ORAGE_WEEK_WINDOW_ODD_HOURS;
 }
 
-static void add_row (OrageWeekWindow *dw, const xfical_appt *appt)
+static void add_row (OrageWeekWindow *dw, const xfical_occurrence *occurrence)
 {
     gint row, start_row, end_row, days;
     gint col, start_col, end_col, first_col, last_col;
-    gchar *tip, *start_date, *end_date, *tmp_title, *tip_title;
+    const gchar *tmp_title;
+    gchar *tip, *start_date, *end_date, *tip_title;
     gchar *tmp_note, *tip_note;
     GtkWidget *ev, *lab, *hb;
     GDateTime *gdt_start;
@@ -651,10 +652,11 @@ static void add_row (OrageWeekWindow *dw, const xfical_appt *appt)
     gint start_hour;
     gint end_hour;
     AppointmentClickCtx *click_ctx;
+    const xfical_appt *appt = occurrence->appt;
 
     /* First clarify timings */
-    gdt_start = g_date_time_ref (appt->starttimecur);
-    gdt_end   = g_date_time_ref (appt->endtimecur);
+    gdt_start = g_date_time_ref (occurrence->start);
+    gdt_end   = g_date_time_ref (occurrence->end);
     gdt_first = g_date_time_ref (dw->a_day);
 
     start_col = orage_gdatetime_days_between (gdt_first, gdt_start) + 1;
@@ -691,11 +693,12 @@ static void add_row (OrageWeekWindow *dw, const xfical_appt *appt)
     }
 
     /* then add the appointment */
-    tmp_title = orage_process_text_commands(
-            appt->title ? appt->title : _("Unknown"));
+    tmp_title = appt->title
+              ? orage_process_text_commands_cached (appt->uid, appt->title)
+              : _("Unknown");
     tip_title = g_markup_printf_escaped("<b> %s </b>", tmp_title);
-    tmp_note = orage_process_text_commands(
-            appt->note ? appt->note : "");
+    tmp_note = g_strdup (appt->note
+            ? orage_process_text_commands_cached (appt->uid, appt->note) : "");
     tmp_note = orage_limit_text(tmp_note, 50, 10);
     tip_note = g_markup_escape_text(tmp_note, strlen(tmp_note));
     g_free(tmp_note);
@@ -772,7 +775,6 @@ static void add_row (OrageWeekWindow *dw, const xfical_appt *appt)
     g_signal_connect_data (ev, "button-press-event",
                            G_CALLBACK (on_day_cell_double_click),
                            click_ctx, free_data, 0);
-    g_free(tmp_title);
     g_free(tip);
     g_free(tip_title);
     g_free(tip_note);
@@ -805,21 +807,20 @@ static void app_rows (OrageWeekWindow *dw,
                       const xfical_type ical_type,
                       const gchar *file_type)
 {
-    GList *appt_list=NULL, *tmp;
-    xfical_appt *appt;
+    GList *occurrence_list=NULL, *tmp;
+    xfical_occurrence *occurrence;
 
     xfical_get_each_app_within_time (dw->a_day, dw->days, ical_type, file_type,
-                                     &appt_list);
-    for (tmp = g_list_first(appt_list);
+                                     &occurrence_list);
+    for (tmp = g_list_first(occurrence_list);
          tmp != NULL;
          tmp = g_list_next(tmp)) {
-        appt = (xfical_appt *)tmp->data;
-        if (appt->priority < g_par.priority_list_limit) { 
-            add_row(dw, appt);
+        occurrence = (xfical_occurrence *)tmp->data;
+        if (occurrence->appt->priority < g_par.priority_list_limit) {
+            add_row(dw, occurrence);
         }
-        xfical_appt_free(appt);
     }
-    g_list_free(appt_list);
+    xfical_occurrence_list_free (occurrence_list);
 }
 
 static void app_data (OrageWeekWindow *dw)
@@ -861,6 +862,7 @@ static void fill_days (OrageWeekWindow *dw, const gint days, GDateTime *gdt0)
     GDateTime *gdt;
     gint d, m, y;
     AppointmentClickCtx *click_ctx;
+    ORAGE_TRACE_SCOPE ("week view fill");
 
     g_date_time_get_ymd (gdt0, &y, &m, &d);
     start_date = g_date_time_new_local (y, m, d, 0, 0, 0);
@@ -1095,7 +1097,6 @@ static void build_day_view_table (OrageWeekWindow *dw)
     GDateTime *gdt_start_date;
     GDateTime *gdt_today;
 
-    (void)orage_category_get_list (); /* Uses side effects. */
     days = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(dw->day_spin));
     days_n1 = days + 1;
     gdt0 = g_date_time_ref (
@@ -47,6 +47,7 @@
 #include "orage-css.h"
 #include "orage-i18n.h"
 #include "orage-time-utils.h"
+#include "orage-trace.h"
 #include "orage-week-window.h"
 #include "orage-window-classic.h"
 #include "orage-window.h"
@@ -107,6 +108,8 @@ static guint month_change_timer = 0;
 
 void orage_window_classic_update_appointments (OrageWindow *window)
 {
+    ORAGE_TRACE_SCOPE ("month view update");
+
     g_return_if_fail (window != NULL);
 
     if (!xfical_file_open (TRUE))
@@ -252,8 +255,14 @@ static void mCalendar_month_changed_cb (GtkCalendar *calendar,
     if (month_change_timer)
     {
         g_source_remove (month_change_timer);
+        month_change_timer = 0;
     }
 
+    /* Months which have been shown already, or marked in background, can
+     * be marked right away. */
+    if (xfical_mark_calendar_from_cache (calendar))
+        return;
+
     gtk_calendar_clear_marks (calendar);
     month_change_timer = g_timeout_add (400, upd_calendar, user_data);
 }
@@ -370,11 +379,13 @@ static void todo_clicked (GtkWidget *widget, GdkEventButton *event,
     }
 }
 
-static void add_info_row (xfical_appt *appt, GtkGrid *parentBox,
-                          const gboolean todo)
+static void add_info_row (const xfical_appt *appt,
+                          GDateTime *start, GDateTime *end,
+                          GtkGrid *parentBox, const gboolean todo)
 {
     GtkWidget *ev, *label;
-    gchar *tip, *tmp, *tmp_title, *tmp_note;
+    const gchar *tmp_title;
+    gchar *tip, *tmp, *tmp_note;
     gchar *tip_title, *tip_location, *tip_note;
     char *s_time, *s_timeonly, *e_time, *c_time, *na;
     GDateTime *today;
@@ -382,22 +393,23 @@ static void add_info_row (xfical_appt *appt, GtkGrid *parentBox,
 
     /***** add data into the vbox *****/
     ev = gtk_event_box_new ();
-    tmp_title = appt->title ? orage_process_text_commands (appt->title)
-                            : g_strdup (_("No title defined"));
-    s_time = orage_gdatetime_to_i18_time (appt->starttimecur, appt->allDay);
+    tmp_title = appt->title
+              ? orage_process_text_commands_cached (appt->uid, appt->title)
+              : _("No title defined");
+    s_time = orage_gdatetime_to_i18_time (start, appt->allDay);
     today = g_date_time_new_now_local ();
     if (todo)
     {
         e_time = appt->use_due_time ?
-                 orage_gdatetime_to_i18_time (appt->endtimecur, appt->allDay) :
+                 orage_gdatetime_to_i18_time (end, appt->allDay) :
                  g_strdup (s_time);
         tmp = g_strdup_printf (" %s  %s", e_time, tmp_title);
         g_free (e_time);
     }
     else
     {
-        s_timeonly = g_date_time_format (appt->starttimecur, "%R");
-        if (orage_gdatetime_compare_date (today, appt->starttimecur) == 0)
+        s_timeonly = g_date_time_format (start, "%R");
+        if (orage_gdatetime_compare_date (today, start) == 0)
             tmp = g_strdup_printf (" %s* %s", s_timeonly, tmp_title);
         else
         {
@@ -430,13 +442,13 @@ static void add_info_row (xfical_appt *appt, GtkGrid *parentBox,
     if (todo)
     {
         if (appt->use_due_time)
-            gdt_end_time = g_date_time_ref (appt->endtimecur);
+            gdt_end_time = g_date_time_ref (end);
         else
             gdt_end_time = g_date_time_new_local (9999, 12, 31, 23, 59, 59);
 
         if (g_date_time_compare (gdt_end_time, today) < 0) /* gone */
             gtk_widget_set_name (label, ORAGE_TODO_COMPLETED);
-        else if ((g_date_time_compare (appt->starttimecur, today) <= 0)
+        else if ((g_date_time_compare (start, today) <= 0)
                  && (g_date_time_compare (gdt_end_time, today) >= 0))
         {
             gtk_widget_set_name (label, ORAGE_TODO_ACTUAL_NOW);
@@ -460,9 +472,11 @@ static void add_info_row (xfical_appt *appt, GtkGrid *parentBox,
 
     if (appt->note)
     {
-        tmp_note = orage_process_text_commands (appt->note);
+        tmp_note = g_strdup (orage_process_text_commands_cached (appt->uid,
+                                                                 appt->note));
         tmp_note = orage_limit_text (tmp_note, 50, 10);
         tmp = g_markup_escape_text (tmp_note, strlen (tmp_note));
+        g_free (tmp_note);
         tip_note = g_strdup_printf ("\n %s:\n%s", _("Note"), tmp);
         g_free (tmp);
     }
@@ -474,7 +488,7 @@ static void add_info_row (xfical_appt *appt, GtkGrid *parentBox,
     if (todo)
     {
         na = _("Never");
-        e_time = appt->use_due_time ? orage_gdatetime_to_i18_time (appt->endtimecur, appt->allDay)
+        e_time = appt->use_due_time ? orage_gdatetime_to_i18_time (end, appt->allDay)
                                     : g_strdup (na);
         c_time = appt->completed && appt->completedtime ? orage_gdatetime_to_i18_time (appt->completedtime, appt->allDay)
                                                         : g_strdup (na);
@@ -495,7 +509,7 @@ static void add_info_row (xfical_appt *appt, GtkGrid *parentBox,
     else
     {
         /* it is event */
-        e_time = orage_gdatetime_to_i18_time (appt->endtimecur, appt->allDay);
+        e_time = orage_gdatetime_to_i18_time (end, appt->allDay);
         tip = g_strdup_printf ("%s: %s\n"
                                "%s"
                                " %s:\t%s\n"
@@ -514,7 +528,6 @@ static void add_info_row (xfical_appt *appt, GtkGrid *parentBox,
     g_free (tip_title);
     g_free (tip_location);
     g_free (tip_note);
-    g_free (tmp_title);
     g_free (s_time);
     g_free (e_time);
     g_free (tip);
@@ -534,12 +547,12 @@ static void insert_rows (GList **list, GDateTime *gdt, xfical_type ical_type, gc
 
 static gint event_order (gconstpointer a, gconstpointer b)
 {
-    xfical_appt *appt1, *appt2;
+    const xfical_occurrence *occurrence1, *occurrence2;
 
-    appt1 = (xfical_appt *)a;
-    appt2 = (xfical_appt *)b;
+    occurrence1 = (const xfical_occurrence *)a;
+    occurrence2 = (const xfical_occurrence *)b;
 
-    return g_date_time_compare (appt1->starttimecur, appt2->starttimecur);
+    return g_date_time_compare (occurrence1->start, occurrence2->start);
 }
 
 static gint todo_order (gconstpointer a, gconstpointer b)
@@ -557,21 +570,29 @@ static gint todo_order (gconstpointer a, gconstpointer b)
     return g_date_time_compare (appt1->endtimecur, appt2->endtimecur);
 }
 
-static void info_process (gpointer a, gpointer pbox)
+static void todo_info_process (gpointer a, gpointer pbox)
 {
     xfical_appt *appt = (xfical_appt *)a;
-    GtkGrid *box = GTK_GRID (pbox);
-    OrageApplication *app = ORAGE_APPLICATION (g_application_get_default ());
-    OrageWindowClassic *window = ORAGE_WINDOW_CLASSIC (
-        orage_application_get_window (app));
-    gboolean todo;
 
-    todo = (pbox == window->mTodo_rows_vbox) ? TRUE : FALSE;
     if (appt->priority < g_par.priority_list_limit)
-        add_info_row (appt, box, todo);
+    {
+        add_info_row (appt, appt->starttimecur, appt->endtimecur,
+                      GTK_GRID (pbox), TRUE);
+    }
     xfical_appt_free (appt);
 }
 
+static void event_info_process (gpointer a, gpointer pbox)
+{
+    const xfical_occurrence *occurrence = (const xfical_occurrence *)a;
+
+    if (occurrence->appt->priority < g_par.priority_list_limit)
+    {
+        add_info_row (occurrence->appt, occurrence->start, occurrence->end,
+                      GTK_GRID (pbox), FALSE);
+    }
+}
+
 static void create_mainbox_todo_info (OrageWindowClassic *window)
 {
     GtkScrolledWindow *sw;
@@ -686,7 +707,7 @@ static void build_mainbox_todo_info (OrageWindowClassic *window)
         gtk_widget_destroy (window->mTodo_vbox);
         create_mainbox_todo_info (window);
         todo_list = g_list_sort (todo_list, todo_order);
-        g_list_foreach (todo_list, info_process, window->mTodo_rows_vbox);
+        g_list_foreach (todo_list, todo_info_process, window->mTodo_rows_vbox);
         g_list_free (todo_list);
         todo_list = NULL;
         gtk_widget_show_all (window->mTodo_vbox);
@@ -728,8 +749,9 @@ static void build_mainbox_event_info (OrageWindowClassic *window)
         gtk_widget_destroy (window->mEvent_vbox);
         create_mainbox_event_info_box (window);
         event_list = g_list_sort (event_list, event_order);
-        g_list_foreach (event_list, info_process, window->mEvent_rows_vbox);
-        g_list_free (event_list);
+        g_list_foreach (event_list, event_info_process,
+                        window->mEvent_rows_vbox);
+        xfical_occurrence_list_free (event_list);
         event_list = NULL;
         gtk_widget_show_all (window->mEvent_vbox);
     }
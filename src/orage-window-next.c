@@ -32,6 +32,7 @@
 #include "orage-month-cell.h"
 #include "orage-month-view.h"
 #include "orage-time-utils.h"
+#include "orage-trace.h"
 #include "orage-week-window.h"
 #include "parameters.h"
 #include <glib.h>
@@ -727,12 +728,12 @@ static void insert_rows (GList **list, GDateTime *gdt, xfical_type ical_type,
 
 static gint event_order (gconstpointer a, gconstpointer b)
 {
-    xfical_appt *appt1, *appt2;
+    const xfical_occurrence *occurrence1, *occurrence2;
 
-    appt1 = (xfical_appt *)a;
-    appt2 = (xfical_appt *)b;
+    occurrence1 = (const xfical_occurrence *)a;
+    occurrence2 = (const xfical_occurrence *)b;
 
-    return g_date_time_compare (appt1->starttimecur, appt2->starttimecur);
+    return g_date_time_compare (occurrence1->start, occurrence2->start);
 }
 
 static gint todo_order (gconstpointer a, gconstpointer b)
@@ -764,14 +765,15 @@ static void todo_clicked (GtkWidget *widget, GdkEventButton *event,
     }
 }
 
-static void add_info_row (xfical_appt *appt, GtkBox *parent_box,
-                          const gboolean todo)
+static void add_info_row (const xfical_appt *appt,
+                          GDateTime *start, GDateTime *end,
+                          GtkBox *parent_box, const gboolean todo)
 {
     GtkWidget *ev;
     GtkWidget *label;
     gchar *tip;
     gchar *tmp;
-    gchar *tmp_title;
+    const gchar *tmp_title;
     gchar *tmp_note;
     gchar *tip_title;
     gchar *tip_location;
@@ -786,22 +788,23 @@ static void add_info_row (xfical_appt *appt, GtkBox *parent_box,
 
     /* Add data into the vbox. */
     ev = gtk_event_box_new ();
-    tmp_title = appt->title ? orage_process_text_commands (appt->title)
-                            : g_strdup (_("No title defined"));
-    s_time = orage_gdatetime_to_i18_time (appt->starttimecur, appt->allDay);
+    tmp_title = appt->title
+              ? orage_process_text_commands_cached (appt->uid, appt->title)
+              : _("No title defined");
+    s_time = orage_gdatetime_to_i18_time (start, appt->allDay);
     today = g_date_time_new_now_local ();
     if (todo)
     {
         e_time = appt->use_due_time
-               ? orage_gdatetime_to_i18_time (appt->endtimecur, appt->allDay)
+               ? orage_gdatetime_to_i18_time (end, appt->allDay)
                : g_strdup (s_time);
         tmp = g_strdup_printf (" %s  %s", e_time, tmp_title);
         g_free (e_time);
     }
     else
     {
-        s_timeonly = g_date_time_format (appt->starttimecur, "%R");
-        if (orage_gdatetime_compare_date (today, appt->starttimecur) == 0)
+        s_timeonly = g_date_time_format (start, "%R");
+        if (orage_gdatetime_compare_date (today, start) == 0)
             tmp = g_strdup_printf (" %s* %s", s_timeonly, tmp_title);
         else
         {
@@ -835,7 +838,7 @@ static void add_info_row (xfical_appt *appt, GtkBox *parent_box,
     if (todo)
     {
         if (appt->use_due_time)
-            gdt_end_time = g_date_time_ref (appt->endtimecur);
+            gdt_end_time = g_date_time_ref (end);
         else
             gdt_end_time = g_date_time_new_local (9999, 12, 31, 23, 59, 59);
 
@@ -844,7 +847,7 @@ static void add_info_row (xfical_appt *appt, GtkBox *parent_box,
             /* gone */
             gtk_widget_set_name (label, ORAGE_TODO_COMPLETED);
         }
-        else if ((g_date_time_compare (appt->starttimecur, today) <= 0) &&
+        else if ((g_date_time_compare (start, today) <= 0) &&
                  (g_date_time_compare (gdt_end_time, today) >= 0))
         {
             gtk_widget_set_name (label, ORAGE_TODO_ACTUAL_NOW);
@@ -865,9 +868,11 @@ static void add_info_row (xfical_appt *appt, GtkBox *parent_box,
 
     if (appt->note)
     {
-        tmp_note = orage_process_text_commands (appt->note);
+        tmp_note = g_strdup (orage_process_text_commands_cached (appt->uid,
+                                                                 appt->note));
         tmp_note = orage_limit_text (tmp_note, 50, 10);
         tmp = g_markup_escape_text (tmp_note, strlen (tmp_note));
+        g_free (tmp_note);
         tip_note = g_strdup_printf ("\n %s:\n%s", _("Note"), tmp);
         g_free (tmp);
     }
@@ -878,7 +883,7 @@ static void add_info_row (xfical_appt *appt, GtkBox *parent_box,
     {
         na = _("Never");
         e_time = appt->use_due_time
-               ? orage_gdatetime_to_i18_time (appt->endtimecur, appt->allDay)
+               ? orage_gdatetime_to_i18_time (end, appt->allDay)
                : g_strdup (na);
         c_time = (appt->completed && appt->completedtime)
                ? orage_gdatetime_to_i18_time (appt->completedtime, appt->allDay)
@@ -902,7 +907,7 @@ static void add_info_row (xfical_appt *appt, GtkBox *parent_box,
     else
     {
         /* It is event. */
-        e_time = orage_gdatetime_to_i18_time (appt->endtimecur, appt->allDay);
+        e_time = orage_gdatetime_to_i18_time (end, appt->allDay);
         tip = g_strdup_printf ("%s: %s\n"
                                "%s"
                                " %s:\t%s\n"
@@ -921,30 +926,33 @@ static void add_info_row (xfical_appt *appt, GtkBox *parent_box,
     g_free (tip_title);
     g_free (tip_location);
     g_free (tip_note);
-    g_free (tmp_title);
     g_free (s_time);
     g_free (e_time);
     g_free (tip);
 }
 
-static void info_process (gpointer a, gpointer pbox, gboolean todo)
-{
-    xfical_appt *appt = (xfical_appt *)a;
-
-    if (appt->priority < g_par.priority_list_limit)
-        add_info_row (appt, GTK_BOX (pbox), todo);
-
-    xfical_appt_free (appt);
-}
-
 static void info_process_event (gpointer a, gpointer pbox)
 {
-    info_process (a, pbox, FALSE);
+    const xfical_occurrence *occurrence = (const xfical_occurrence *)a;
+
+    if (occurrence->appt->priority < g_par.priority_list_limit)
+    {
+        add_info_row (occurrence->appt, occurrence->start, occurrence->end,
+                      GTK_BOX (pbox), FALSE);
+    }
 }
 
 static void info_process_todo (gpointer a, gpointer pbox)
 {
-    info_process (a, pbox, TRUE);
+    xfical_appt *appt = (xfical_appt *)a;
+
+    if (appt->priority < g_par.priority_list_limit)
+    {
+        add_info_row (appt, appt->starttimecur, appt->endtimecur,
+                      GTK_BOX (pbox), TRUE);
+    }
+
+    xfical_appt_free (appt);
 }
 
 static void orage_window_next_build_mainbox_todo_info (OrageWindowNext *self)
@@ -1025,7 +1033,7 @@ static void orage_window_next_build_mainbox_event_info (OrageWindowNext *self)
 
         event_list = g_list_sort (event_list, event_order);
         g_list_foreach (event_list, info_process_event, self->event_rows_box);
-        g_list_free (event_list);
+        xfical_occurrence_list_free (event_list);
         gtk_widget_show_all (self->event_box);
     }
     else
@@ -1253,6 +1261,7 @@ void orage_window_next_update_appointments (OrageWindow *window)
     OrageWindowNext *self;
     const gchar *visible_name;
     enum {E_MONTH_PAGE, E_UNDEFINED_PAGE} displayed_page;
+    ORAGE_TRACE_SCOPE ("month view update");
 
     g_return_if_fail (window != NULL);
 
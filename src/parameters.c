@@ -65,16 +65,19 @@
 #define SYNC_DESCRIPTION "Sync %02d description"
 #define SYNC_COMMAND "Sync %02d command"
 #define SYNC_PERIOD "Sync %02d period"
+#define SYNC_RELOAD_FILE "Sync %02d reload file"
 
 static void fill_sync_entries (gpointer data, gpointer user_data);
 static void orage_sync_task_remove (const orage_task_runner_conf *conf);
 static gint orage_sync_task_add (const gchar *description,
                                  const gchar *command,
+                                 const gchar *reload_file,
                                  const uint period);
 
 static void orage_sync_task_change (const orage_task_runner_conf *conf,
                                     const gchar *description,
                                     const gchar *command,
+                                    const gchar *reload_file,
                                     const guint period);
 
 static Itf *global_itf = NULL;
@@ -324,6 +327,7 @@ static void set_systray(void)
     {
         status_icon = orage_create_trayicon ();
         g_par.trayIcon = status_icon;
+        orage_tooltip_refresh ();
     }
 
     orage_status_icon_set_visible (status_icon, g_par.show_systray);
@@ -477,10 +481,9 @@ static gboolean check_wakeup(gpointer user_data)
            which means that this is init call */
         if (!user_data) { /* normal timer call */
             g_message ("wakeup timer refreshing");
-            alarm_read();
             /* It is quite possible that day did not change,
                but we need to reset timers */
-            orage_day_change(&tt_prev);
+            orage_alarm_resume();
         }
         else {
             g_debug ("wakeup timer init %" PRIiMAX, (intmax_t)tt_prev);
@@ -564,6 +567,7 @@ static void on_sync_add_clicked_cb (G_GNUC_UNUSED GtkButton *b,
 {
     const gchar *description;
     const gchar *command;
+    const gchar *reload_file;
     guint period;
     gint idx;
     gint result;
@@ -577,9 +581,10 @@ static void on_sync_add_clicked_cb (G_GNUC_UNUSED GtkButton *b,
     {
         description = orage_sync_edit_dialog_get_description (dialog);
         command = orage_sync_edit_dialog_get_command (dialog);
+        reload_file = orage_sync_edit_dialog_get_reload_file (dialog);
         period = orage_sync_edit_dialog_get_period (dialog) * 60;
 
-        idx = orage_sync_task_add (description, command, period);
+        idx = orage_sync_task_add (description, command, reload_file, period);
         if (idx >= 0)
         {
             app = ORAGE_APPLICATION (g_application_get_default ());
@@ -599,6 +604,7 @@ static void on_sync_edit_clicked_cb (G_GNUC_UNUSED GtkButton *b,
     gint result;
     const gchar *description;
     const gchar *command;
+    const gchar *reload_file;
     guint period;
     OrageSyncEditDialog *dialog;
     orage_task_runner_conf *conf = (orage_task_runner_conf *)user_data;
@@ -610,6 +616,7 @@ static void on_sync_edit_clicked_cb (G_GNUC_UNUSED GtkButton *b,
     dialog = ORAGE_SYNC_EDIT_DIALOG (
             orage_sync_edit_dialog_new_with_defaults (conf->description,
                                                       conf->command,
+                                                      conf->reload_file,
                                                       conf->period / 60));
 
     result = gtk_dialog_run (GTK_DIALOG (dialog));
@@ -617,6 +624,7 @@ static void on_sync_edit_clicked_cb (G_GNUC_UNUSED GtkButton *b,
     {
         description = orage_sync_edit_dialog_get_description (dialog);
         command = orage_sync_edit_dialog_get_command (dialog);
+        reload_file = orage_sync_edit_dialog_get_reload_file (dialog);
         period = orage_sync_edit_dialog_get_period (dialog) * 60;
 
         g_debug ("updated sync task '%s' (period: %u seconds)",
@@ -625,7 +633,8 @@ static void on_sync_edit_clicked_cb (G_GNUC_UNUSED GtkButton *b,
         app = ORAGE_APPLICATION (g_application_get_default ());
         runner = orage_application_get_sync (app);
         orage_task_runner_remove (runner, conf);
-        orage_sync_task_change (conf, description, command, period);
+        orage_sync_task_change (conf, description, command, reload_file,
+                                period);
         orage_task_runner_add (runner, orage_sync_ext_command, conf);
     }
 
@@ -1462,17 +1471,20 @@ static void orage_sync_task_remove (const orage_task_runner_conf *conf)
 
     g_free (g_par.sync_conf[i].description);
     g_free (g_par.sync_conf[i].command);
+    g_free (g_par.sync_conf[i].reload_file);
     g_par.sync_source_count--;
 
     for (; i < g_par.sync_source_count; i++)
     {
         g_par.sync_conf[i].description = g_par.sync_conf[i + 1].description;
         g_par.sync_conf[i].command = g_par.sync_conf[i + 1].command;
+        g_par.sync_conf[i].reload_file = g_par.sync_conf[i + 1].reload_file;
         g_par.sync_conf[i].period = g_par.sync_conf[i + 1].period;
     }
 
     g_par.sync_conf[i].description = NULL;
     g_par.sync_conf[i].command = NULL;
+    g_par.sync_conf[i].reload_file = NULL;
     g_par.sync_conf[i].period = 0;
 
     write_parameters ();
@@ -1480,6 +1492,7 @@ static void orage_sync_task_remove (const orage_task_runner_conf *conf)
 
 static gint orage_sync_task_add (const gchar *description,
                                  const gchar *command,
+                                 const gchar *reload_file,
                                  const guint period)
 {
     guint idx;
@@ -1493,6 +1506,7 @@ static gint orage_sync_task_add (const gchar *description,
     idx = g_par.sync_source_count;
     g_par.sync_conf[idx].description = g_strdup (description);
     g_par.sync_conf[idx].command = g_strdup (command);
+    g_par.sync_conf[idx].reload_file = g_strdup (reload_file);
     g_par.sync_conf[idx].period = period;
     g_par.sync_source_count++;
 
@@ -1506,6 +1520,7 @@ static gint orage_sync_task_add (const gchar *description,
 static void orage_sync_task_change (const orage_task_runner_conf *conf,
                                     const gchar *description,
                                     const gchar *command,
+                                    const gchar *reload_file,
                                     const guint period)
 {
     gint i;
@@ -1520,8 +1535,11 @@ static void orage_sync_task_change (const orage_task_runner_conf *conf,
             if (g_par.sync_conf[i].command)
                 g_free (g_par.sync_conf[i].command);
 
+            g_free (g_par.sync_conf[i].reload_file);
+
             g_par.sync_conf[i].description = g_strdup (description);
             g_par.sync_conf[i].command = g_strdup (command);
+            g_par.sync_conf[i].reload_file = g_strdup (reload_file);
             g_par.sync_conf[i].period = period;
 
             write_parameters ();
@@ -1715,6 +1733,8 @@ void read_parameters (void)
     g_par.use_wakeup_timer = orage_rc_get_bool(orc, "Use wakeup timer", TRUE);
     g_par.close_means_quit = orage_rc_get_bool(orc, "Always quit", FALSE);
     g_par.file_close_delay = orage_rc_get_int(orc, "File close delay", 600);
+    g_par.main_shards = orage_rc_get_bool(orc, "Yearly calendar shards"
+            , FALSE);
 
     g_par.sync_source_count = orage_rc_get_int (orc, SYNC_SOURCE_COUNT, 0);
     for (i = 0; i < g_par.sync_source_count; i++)
@@ -1727,6 +1747,9 @@ void read_parameters (void)
 
         g_snprintf (f_par, sizeof (f_par), SYNC_PERIOD, i);
         g_par.sync_conf[i].period = orage_rc_get_int (orc, f_par, 0);
+
+        g_snprintf (f_par, sizeof (f_par), SYNC_RELOAD_FILE, i);
+        g_par.sync_conf[i].reload_file = orage_rc_get_str (orc, f_par, "");
     }
 
     orage_rc_file_close(orc);
@@ -1830,6 +1853,7 @@ void write_parameters(void)
     orage_rc_put_bool(orc, "Use wakeup timer", g_par.use_wakeup_timer);
     orage_rc_put_bool(orc, "Always quit", g_par.close_means_quit);
     orage_rc_put_int(orc, "File close delay", g_par.file_close_delay);
+    orage_rc_put_bool(orc, "Yearly calendar shards", g_par.main_shards);
 
     orage_rc_put_int (orc, SYNC_SOURCE_COUNT, g_par.sync_source_count);
 
@@ -1843,6 +1867,9 @@ void write_parameters(void)
 
         g_snprintf (f_par, sizeof (f_par), SYNC_PERIOD, i);
         orage_rc_put_int (orc, f_par, g_par.sync_conf[i].period);
+
+        g_snprintf (f_par, sizeof (f_par), SYNC_RELOAD_FILE, i);
+        orage_rc_put_str (orc, f_par, g_par.sync_conf[i].reload_file);
     }
 
     for (i = g_par.sync_source_count; i < 10; i++)
@@ -1858,6 +1885,9 @@ void write_parameters(void)
 
         g_snprintf (f_par, sizeof (f_par), SYNC_PERIOD, i);
         orage_rc_del_item (orc, f_par);
+
+        g_snprintf (f_par, sizeof (f_par), SYNC_RELOAD_FILE, i);
+        orage_rc_del_item (orc, f_par);
     }
 
     orage_rc_file_close(orc);
@@ -128,6 +128,9 @@ typedef struct _parameters
     /* delayed close length in seconds. 0 = close immediately */
     gint file_close_delay;
 
+    /* keep events which ended before this year in yearly shard files */
+    gboolean main_shards;
+
     /** Number of sync sources. */
     gint sync_source_count;
 
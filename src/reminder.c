@@ -45,10 +45,11 @@
 #include "event-list.h"
 #include "functions.h"
 #include "ical-code.h"
+#include "orage-alarm-store.h"
 #include "orage-alarm-structure.h"
 #include "orage-appointment-window.h"
 #include "orage-i18n.h"
-#include "orage-rc-file.h"
+#include "orage-memory.h"
 #include "orage-time-utils.h"
 #include "orage-window.h"
 #include "parameters.h"
@@ -59,21 +60,6 @@
 #include "tray_icon.h"
 #endif
 
-#define RC_ALARM_TIME "ALARM_TIME"
-#define RC_ACTION_TIME "ACTION_TIME"
-#define RC_TITLE "TITLE"
-#define RC_DESCRIPTION "DESCRIPTION"
-#define RC_DISPLAY_ORAGE "DISPLAY_ORAGE"
-#define RC_TEMPORARY "TEMPORARY"
-#define RC_DISPLAY_NOTIFY "DISPLAY_NOTIFY"
-#define RC_NOTIFY_TIMEOUT "NOTIFY_TIMEOUT"
-#define RC_AUDIO "AUDIO"
-#define RC_SOUND "SOUND"
-#define RC_REPEAT_CNT "REPEAT_CNT"
-#define RC_REPEAT_DELAY "REPEAT_DELAY"
-#define RC_PROCEDURE "PROCEDURE"
-#define RC_CMD "CMD"
-
 #ifdef HAVE_NOTIFY
 static gboolean orage_notify_initted = FALSE;
 #endif
@@ -81,6 +67,51 @@ static gboolean orage_notify_initted = FALSE;
 static void create_notify_reminder(alarm_struct *l_alarm);
 static void reset_orage_alarm_clock (void);
 
+#ifdef HAVE_X11_TRAY_ICON
+#define TOOLTIP_ALARM_LIMIT 5
+
+/* Alarms shown in the trayicon tooltip. Titles are escaped when the shown
+ * alarms change, the remaining times are counted every minute. */
+typedef struct _tooltip_entry
+{
+    alarm_struct *alarm;
+    gchar *title;
+} tooltip_entry;
+
+static tooltip_entry tooltip_entries[TOOLTIP_ALARM_LIMIT];
+static gint tooltip_entry_cnt = 0;
+static GString *tooltip_markup = NULL;
+#endif
+
+/* date of the last day change */
+static gint previous_year = 0, previous_month = 0, previous_day = 0;
+
+void alarm_list_memory_usage (GArray *usage)
+{
+    GList *alarm_l;
+    alarm_struct *l_alarm;
+    guint64 bytes = 0;
+    guint n = 0;
+
+    for (alarm_l = g_par.alarm_list; alarm_l != NULL;
+         alarm_l = g_list_next (alarm_l))
+    {
+        l_alarm = alarm_l->data;
+        n++;
+        bytes += ORAGE_MEMORY_LIST_NODE + sizeof (alarm_struct)
+               + ORAGE_MEMORY_DATE_TIME
+               + orage_memory_string_size (l_alarm->action_time)
+               + orage_memory_string_size (l_alarm->recurrence_id)
+               + orage_memory_string_size (l_alarm->title)
+               + orage_memory_string_size (l_alarm->description)
+               + orage_memory_string_size (l_alarm->sound)
+               + orage_memory_string_size (l_alarm->sound_cmd)
+               + orage_memory_string_size (l_alarm->cmd);
+    }
+
+    orage_memory_usage_add (usage, "alarms", n, 0, bytes);
+}
+
 void alarm_list_free(void)
 {
     GDateTime *time_now;
@@ -130,142 +161,32 @@ void alarm_add(alarm_struct *l_alarm)
 /* persistent alarms start                                  */
 /************************************************************/
 
-static OrageRc *orage_persistent_file_open (void)
-{
-    gchar *fpath;
-    OrageRc *orc;
-
-    fpath = orage_data_file_location(ORAGE_PERSISTENT_ALARMS_DIR_FILE);
-
-    if ((orc = orage_rc_file_open (fpath, TRUE)) == NULL) {
-        g_warning ("could not open persistent alarms file '%s'", fpath);
-    }
-    g_free(fpath);
-
-    return(orc);
-}
-
-static OrageRc *orage_persistent_file_new (void)
-{
-    gchar *fpath;
-    OrageRc *orc;
-
-    fpath = orage_data_file_location (ORAGE_PERSISTENT_ALARMS_DIR_FILE);
-
-    if ((orc = orage_rc_file_new (fpath)) == NULL)
-        g_warning ("could not create persistent alarms file '%s'", fpath);
-
-    g_free (fpath);
-
-    return orc;
-}
-
-static alarm_struct *alarm_read_next_alarm(OrageRc *orc, GDateTime *gdt)
-{
-    gint cmp_result;
-    alarm_struct *new_alarm;
-
-    new_alarm = orage_alarm_new ();
-
-    new_alarm->uid = orage_rc_get_group(orc);
-    new_alarm->alarm_time = orage_rc_get_gdatetime (orc, RC_ALARM_TIME, NULL);
-    new_alarm->action_time = orage_rc_get_str(orc, RC_ACTION_TIME, "0000");
-    new_alarm->title = orage_rc_get_str(orc, RC_TITLE, NULL);
-    new_alarm->description = orage_rc_get_str(orc, RC_DESCRIPTION, NULL);
-    new_alarm->persistent = TRUE; /* this must be */
-    new_alarm->temporary = orage_rc_get_bool(orc, RC_TEMPORARY, FALSE);
-    new_alarm->display_orage = orage_rc_get_bool(orc, RC_DISPLAY_ORAGE, FALSE);
-
-#ifdef HAVE_NOTIFY
-    new_alarm->display_notify = orage_rc_get_bool(orc, RC_DISPLAY_NOTIFY, FALSE);
-    new_alarm->notify_timeout = orage_rc_get_int(orc, RC_NOTIFY_TIMEOUT, FALSE);
-#endif
-
-    new_alarm->audio = orage_rc_get_bool(orc, RC_AUDIO, FALSE);
-    new_alarm->sound = orage_rc_get_str(orc, RC_SOUND, NULL);
-    new_alarm->repeat_cnt = orage_rc_get_int(orc, RC_REPEAT_CNT, 0);
-    new_alarm->repeat_delay = orage_rc_get_int(orc, RC_REPEAT_DELAY, 2);
-    new_alarm->procedure = orage_rc_get_bool(orc, RC_PROCEDURE, FALSE);
-    new_alarm->cmd = orage_rc_get_str(orc, RC_CMD, NULL);
-
-    /* let's first check if the time has gone so that we need to
-     * send that delayed l_alarm or can we just ignore it since it is
-     * still in the future */
-    cmp_result = g_date_time_compare (gdt, new_alarm->alarm_time);
-
-    if (cmp_result < 0) {
-        /* real l_alarm has not happened yet */
-        if (new_alarm->temporary)
-            /* we need to store this or it will get lost */
-            alarm_add(new_alarm);
-        else  /* we can ignore this as it will be created again soon */
-            orage_alarm_unref (new_alarm);
-        return(NULL);
-    }
-
-    return(new_alarm);
-}
-
 void alarm_read(void)
 {
-    alarm_struct *new_alarm;
-    OrageRc *orc;
+    alarm_struct *l_alarm;
+    GList *alarms;
+    GList *alarm_l;
     GDateTime *time_now;
-    gchar **alarm_groups;
-    gint i;
 
     time_now = g_date_time_new_now_local ();
-    orc = orage_persistent_file_open ();
-    alarm_groups = orage_rc_get_groups(orc);
-    for (i = 0; alarm_groups[i] != NULL; i++) {
-        orage_rc_set_group(orc, alarm_groups[i]);
-        if ((new_alarm = alarm_read_next_alarm(orc, time_now)) != NULL) {
-            create_reminders(new_alarm);
-            orage_alarm_unref (new_alarm);
+    alarms = orage_alarm_store_read ();
+    for (alarm_l = alarms; alarm_l != NULL; alarm_l = g_list_next (alarm_l)) {
+        l_alarm = (alarm_struct *)alarm_l->data;
+        /* let's first check if the time has gone so that we need to
+         * send that delayed l_alarm or can we just ignore it since it is
+         * still in the future */
+        if (g_date_time_compare (time_now, l_alarm->alarm_time) < 0) {
+            /* real l_alarm has not happened yet */
+            if (l_alarm->temporary)
+                /* we need to store this or it will get lost */
+                alarm_add (orage_alarm_ref (l_alarm));
+            /* else we can ignore this as it will be created again soon */
         }
+        else
+            create_reminders (l_alarm);
     }
     g_date_time_unref (time_now);
-    g_strfreev(alarm_groups);
-    orage_rc_file_close(orc);
-}
-
-static void alarm_store(gpointer galarm, gpointer par)
-{
-    const alarm_struct *l_alarm = (const alarm_struct *)galarm;
-    OrageRc *orc = (OrageRc *)par;
-
-    if (!l_alarm->persistent)
-        return; /* only store persistent alarms */
-
-    orage_rc_set_group(orc, l_alarm->uid);
-
-    orage_rc_put_gdatetime (orc, RC_ALARM_TIME, l_alarm->alarm_time);
-    orage_rc_put_str(orc, RC_ACTION_TIME, l_alarm->action_time);
-    orage_rc_put_str(orc, RC_TITLE, l_alarm->title);
-    orage_rc_put_str(orc, RC_DESCRIPTION, l_alarm->description);
-    orage_rc_put_bool(orc, RC_DISPLAY_ORAGE, l_alarm->display_orage);
-    orage_rc_put_bool(orc, RC_TEMPORARY, l_alarm->temporary);
-
-#ifdef HAVE_NOTIFY
-    orage_rc_put_bool(orc, RC_DISPLAY_NOTIFY, l_alarm->display_notify);
-    orage_rc_put_int(orc, RC_NOTIFY_TIMEOUT, l_alarm->notify_timeout);
-#endif
-
-    orage_rc_put_bool(orc, RC_AUDIO, l_alarm->audio);
-    orage_rc_put_str(orc, RC_SOUND, l_alarm->sound);
-    orage_rc_put_int(orc, RC_REPEAT_CNT, l_alarm->repeat_cnt);
-    orage_rc_put_int(orc, RC_REPEAT_DELAY, l_alarm->repeat_delay);
-    orage_rc_put_bool(orc, RC_PROCEDURE, l_alarm->procedure);
-    orage_rc_put_str(orc, RC_CMD, l_alarm->cmd);
-}
-
-static void store_persistent_alarms(void)
-{
-    OrageRc *orc;
-
-    orc = orage_persistent_file_new ();
-    g_list_foreach(g_par.alarm_list, alarm_store, orc);
-    orage_rc_file_close(orc);
+    g_list_free_full (alarms, (GDestroyNotify)orage_alarm_unref);
 }
 
 /************************************************************/
@@ -840,9 +761,9 @@ gboolean orage_day_change(gpointer user_data)
     gint year;
     gint month;
     gint day;
-    static gint previous_year=0, previous_month=0, previous_day=0;
     gint selected_year, selected_month, selected_day;
     gint current_year=0, current_month=0, current_day=0;
+    gboolean year_changed;
 
     gdt = g_date_time_new_now_local ();
     g_date_time_get_ymd (gdt, &year, &month, &day);
@@ -878,14 +799,27 @@ gboolean orage_day_change(gpointer user_data)
                keep it current automatically */
             orage_window_select_date (window, gdt);
         }
+        year_changed = (user_data || previous_year != current_year);
         previous_year  = current_year;
         previous_month = current_month;
         previous_day   = current_day;
+        /* text commands depend on current date */
+        orage_process_text_commands_cache_clear ();
 #ifdef HAVE_X11_TRAY_ICON
         if (GDK_IS_X11_DISPLAY (gdk_display_get_default ()))
+        {
             orage_refresh_trayicon ();
+            orage_tooltip_refresh ();
+        }
 #endif
-        xfical_alarm_build_list(TRUE);  /* new l_alarm list when date changed */
+        /* Text commands like <&Ynnnn> change their value only when year
+         * changes, otherwise moving the alarm horizon is enough. */
+        if (year_changed)
+            xfical_alarm_build_list(TRUE); /* new alarm list */
+        else {
+            xfical_alarm_horizon_slide();
+            orage_window_build_info (window);
+        }
         reset_orage_day_change(TRUE);   /* setup for next time */
     }
     else { 
@@ -901,40 +835,189 @@ gboolean orage_day_change(gpointer user_data)
     return(FALSE); /* we started new timer, so we end here */
 }
 
-/* check and raise alarms if there are any */
-static gboolean orage_alarm_clock (G_GNUC_UNUSED gpointer user_data)
+/* Take overdue alarms out of the list. Remember that it is sorted list, so
+ * the scan can be stopped at the first alarm in the future. */
+static GList *alarm_take_overdue (void)
 {
     GList *alarm_l;
+    GList *fired = NULL;
     alarm_struct *cur_alarm;
-    gboolean alarm_raised=FALSE;
-    gboolean more_alarms=TRUE;
     GDateTime *time_now;
 
     time_now = g_date_time_new_now_local ();
-    /* Check if there are any alarms to show */
-    for (alarm_l = g_list_first(g_par.alarm_list);
-         alarm_l != NULL && more_alarms;
-         alarm_l = g_list_next(alarm_l)) {
-        /* remember that it is sorted list */
-        cur_alarm = orage_alarm_ref ((alarm_struct *)alarm_l->data);
-        if (g_date_time_compare (time_now, cur_alarm->alarm_time) > 0) {
-            create_reminders(cur_alarm);
-            alarm_raised = TRUE;
+    while ((alarm_l = g_list_first (g_par.alarm_list)) != NULL) {
+        cur_alarm = (alarm_struct *)alarm_l->data;
+        if (g_date_time_compare (time_now, cur_alarm->alarm_time) <= 0)
+            break;
+        g_par.alarm_list = g_list_remove_link (g_par.alarm_list, alarm_l);
+        fired = g_list_concat (fired, alarm_l);
+    }
+    g_date_time_unref (time_now);
+
+    return(fired);
+}
+
+/* Several alarms of the same appointment may be overdue, for example after
+ * suspend. Only the latest of them is shown. Returned list does not hold
+ * references, free it with g_list_free. */
+static GList *alarm_to_raise (GList *fired)
+{
+    GList *alarm_l;
+    GList *raise = NULL;
+    GHashTable *latest;
+    alarm_struct *cur_alarm;
+
+    latest = g_hash_table_new (g_str_hash, g_str_equal);
+    for (alarm_l = fired; alarm_l != NULL; alarm_l = g_list_next (alarm_l)) {
+        cur_alarm = (alarm_struct *)alarm_l->data;
+        if (!cur_alarm->temporary && cur_alarm->uid)
+            g_hash_table_replace (latest, (gpointer)cur_alarm->uid
+                    , cur_alarm);
+    }
+    for (alarm_l = fired; alarm_l != NULL; alarm_l = g_list_next (alarm_l)) {
+        cur_alarm = (alarm_struct *)alarm_l->data;
+        if (cur_alarm->temporary || cur_alarm->uid == NULL
+        || g_hash_table_lookup (latest, cur_alarm->uid) == cur_alarm)
+            raise = g_list_prepend (raise, cur_alarm);
+    }
+    g_hash_table_destroy (latest);
+
+    return(g_list_reverse (raise));
+}
+
+/* check and raise alarms if there are any */
+static gboolean orage_alarm_clock (G_GNUC_UNUSED gpointer user_data)
+{
+    GList *fired;
+    GList *raise;
+
+    fired = alarm_take_overdue ();
+    if (fired == NULL) {
+        reset_orage_alarm_clock(); /* need to setup next timer */
+        return(FALSE);
+    }
+
+    raise = alarm_to_raise (fired);
+    g_list_foreach (raise, (GFunc)create_reminders, NULL);
+    g_list_free (raise);
+
+    /* only appointments which ran out of alarms are read again */
+    xfical_alarm_fired (fired); /* this calls reset_orage_alarm_clock */
+    g_list_free_full (fired, (GDestroyNotify)orage_alarm_unref);
+
+    return(FALSE); /* only once */
+}
+
+/* Raise alarms missed during sleep. Notifications of them are collected
+ * into one and sound is played only once, other reminders are shown
+ * normally. */
+static void create_missed_reminders (GList *missed)
+{
+    GList *alarm_l;
+    alarm_struct *l_alarm;
+    gboolean sound_started = FALSE;
+    gboolean keep = FALSE;
+    GString *body;
+    gint cnt = 0;
+#ifdef HAVE_NOTIFY
+    NotifyNotification *n;
+    gchar *heading;
+#endif
+
+    body = g_string_new ("");
+    for (alarm_l = missed; alarm_l != NULL; alarm_l = g_list_next (alarm_l)) {
+        l_alarm = (alarm_struct *)alarm_l->data;
+        if (l_alarm->audio && l_alarm->sound && !sound_started) {
+            create_sound_reminder (l_alarm);
+            sound_started = TRUE;
         }
-        else /* sorted so scan can be stopped */
-            more_alarms = FALSE;
 
-        orage_alarm_unref (cur_alarm);
+        if (l_alarm->display_orage)
+            create_orage_reminder (l_alarm);
+
+        if (l_alarm->display_notify) {
+            if (cnt)
+                g_string_append_c (body, '\n');
+            if (l_alarm->action_time)
+                g_string_append_printf (body, "%s  ", l_alarm->action_time);
+            g_string_append (body, l_alarm->title ? l_alarm->title
+                                                  : _("No title defined"));
+            keep |= (l_alarm->notify_timeout == -1);
+            cnt++;
         }
 
-    g_date_time_unref (time_now);
+        if (l_alarm->procedure && l_alarm->cmd)
+            create_procedure_reminder (l_alarm);
+    }
+
+#ifdef HAVE_NOTIFY
+    if (cnt && orage_notify_init ()) {
+        heading = g_strdup_printf (ngettext ("%d missed reminder",
+                                             "%d missed reminders", cnt), cnt);
+        n = notify_notification_new (heading, body->str, NULL);
+        notify_notification_set_timeout (n, keep ? NOTIFY_EXPIRES_NEVER
+                                                 : NOTIFY_EXPIRES_DEFAULT);
+        (void)g_signal_connect (G_OBJECT (n), "closed"
+                , G_CALLBACK (g_object_unref), NULL);
+        if (!notify_notification_show (n, NULL)) {
+            g_warning ("failed to send notification");
+            g_object_unref (n);
+        }
+        g_free (heading);
+    }
+#else
+    if (cnt)
+        g_warning ("libnotify not linked in. Can't use notifications");
+#endif
+
+    g_string_free (body, TRUE);
+}
+
+void orage_alarm_resume (void)
+{
+    GList *fired;
+    GList *raise;
+    GDateTime *gdt;
+    gint year;
+    gint month;
+    gint day;
+
+    if (g_par.alarm_timer) {
+        g_source_remove (g_par.alarm_timer);
+        g_par.alarm_timer = 0;
+    }
 
-    if (alarm_raised)  /* at least one l_alarm processed, need new list */
-        xfical_alarm_build_list(FALSE); /* this calls reset_orage_alarm_clock */
+    /* alarms list still holds everything, which was due during sleep */
+    fired = alarm_take_overdue ();
+    if (fired) {
+        raise = alarm_to_raise (fired);
+        g_message ("raising %u alarms missed during sleep",
+                   g_list_length (raise));
+        if (g_list_next (raise))
+            create_missed_reminders (raise);
+        else
+            create_reminders ((alarm_struct *)raise->data);
+        g_list_free (raise);
+
+        xfical_alarm_fired (fired); /* this calls reset_orage_alarm_clock */
+        g_list_free_full (fired, (GDestroyNotify)orage_alarm_unref);
+    }
     else
-        reset_orage_alarm_clock(); /* need to setup next timer */
+        reset_orage_alarm_clock ();
 
-    return(FALSE); /* only once */
+    /* day timer was counted before sleep and is wrong now */
+    if (g_par.day_timer) {
+        g_source_remove (g_par.day_timer);
+        g_par.day_timer = 0;
+    }
+    gdt = g_date_time_new_now_local ();
+    g_date_time_get_ymd (gdt, &year, &month, &day);
+    g_date_time_unref (gdt);
+    if (previous_day != day || previous_month != month
+    || previous_year != year)
+        orage_day_change (NULL);
+    else
+        reset_orage_day_change (TRUE);
 }
 
 static void reset_orage_alarm_clock(void)
@@ -971,137 +1054,189 @@ static void reset_orage_alarm_clock(void)
     }
 }
 
-/* Refresh trayicon tooltip once per minute. */
-static gboolean orage_tooltip_update (G_GNUC_UNUSED gpointer user_data)
+#ifdef HAVE_X11_TRAY_ICON
+/* Escaped title of alarm, shown in brackets for temporary alarms. */
+static gchar *tooltip_title (const alarm_struct *l_alarm)
+{
+    gchar *title;
+    gchar *tmp;
+
+    title = l_alarm->title ? g_markup_escape_text (l_alarm->title, -1)
+                           : g_strdup (_("No title defined"));
+    if (l_alarm->temporary) {
+        tmp = title;
+        title = g_strconcat ("[", tmp, "]", NULL);
+        g_free (tmp);
+    }
+
+    return(title);
+}
+
+static gboolean tooltip_has_uid (alarm_struct **alarms, const gint cnt
+        , const gchar *uid)
+{
+    gint i;
+
+    for (i = 0; i < cnt; i++) {
+        if (!alarms[i]->temporary && g_strcmp0 (alarms[i]->uid, uid) == 0)
+            return(TRUE);
+    }
+
+    return(FALSE);
+}
+#endif
+
+/* Take next alarms from the alarm list into tooltip model. List may contain
+ * several alarms of one appointment, only the next one of each is shown.
+ * Returns TRUE if shown alarms changed. */
+static gboolean tooltip_model_update (void)
 {
 #ifdef HAVE_X11_TRAY_ICON
-    GDateTime *gdt;
     GList *alarm_l;
+    alarm_struct *next[TOOLTIP_ALARM_LIMIT];
     alarm_struct *cur_alarm;
-    gboolean more_alarms=TRUE;
-    GString *tooltip;
-    GString *formatted_title;
-    gint alarm_cnt=0;
-    gint tooltip_alarm_limit=5;
-    gint hour, minute;
-    gint dd, hh, min;
-    gchar *title;
+    gboolean changed;
+    gint cnt = 0;
+    gint i;
 
-    if (!(g_par.trayIcon 
-    && orage_status_icon_is_embedded ((GtkStatusIcon *)g_par.trayIcon))) {
-           /* no trayicon => no need to update the tooltip */
-        return(FALSE);
-    }
-    gdt = g_date_time_new_now_local ();
-    tooltip = g_string_new ("");
-    g_string_append (tooltip, "<span foreground=\"blue\" weight=\"bold\" underline=\"single\">");
-    g_string_append (tooltip, _("Next active alarms:"));
-    g_string_append (tooltip, " </span>");
-    /* Check if there are any alarms to show */
     for (alarm_l = g_list_first(g_par.alarm_list);
-         alarm_l != NULL && more_alarms;
+         alarm_l != NULL && cnt < TOOLTIP_ALARM_LIMIT;
          alarm_l = g_list_next(alarm_l)) {
-        /* remember that it is sorted list */
-        cur_alarm = orage_alarm_ref ((alarm_struct *)alarm_l->data);
-        if (alarm_cnt < tooltip_alarm_limit) {
-            hour = g_date_time_get_hour (cur_alarm->alarm_time);
-            minute = g_date_time_get_minute (cur_alarm->alarm_time);
-            dd = orage_gdatetime_days_between (gdt, cur_alarm->alarm_time);
-            hh = hour - g_date_time_get_hour (gdt);
-            min = minute - g_date_time_get_minute (gdt);
-            if (min < 0) {
-                min += 60;
-                hh -= 1;
-            }
-            if (hh < 0) {
-                hh += 24;
-                dd -= 1;
-            }
+        cur_alarm = (alarm_struct *)alarm_l->data;
+        if (!cur_alarm->temporary && cur_alarm->uid
+        && tooltip_has_uid (next, cnt, cur_alarm->uid))
+            continue;
+        next[cnt++] = cur_alarm;
+    }
 
-            formatted_title = g_string_new ("");
+    changed = (cnt != tooltip_entry_cnt);
+    for (i = 0; i < cnt && !changed; i++)
+        changed = (next[i] != tooltip_entries[i].alarm);
 
-            if (cur_alarm->temporary)
-                g_string_append_c(formatted_title, '[');
+    if (!changed)
+        return(FALSE);
 
-            title = cur_alarm->title ? g_markup_escape_text (cur_alarm->title,
-                                                             strlen (cur_alarm->title))
-                                     : g_strdup (_("No title defined"));
-            g_string_append (formatted_title, title);
-            g_free(title);
-            if (cur_alarm->temporary)
-                g_string_append_c(formatted_title, ']');
+    for (i = 0; i < tooltip_entry_cnt; i++) {
+        orage_alarm_unref (tooltip_entries[i].alarm);
+        g_free (tooltip_entries[i].title);
+    }
+    for (i = 0; i < cnt; i++) {
+        tooltip_entries[i].alarm = orage_alarm_ref (next[i]);
+        tooltip_entries[i].title = tooltip_title (next[i]);
+    }
+    tooltip_entry_cnt = cnt;
 
-            g_string_append (tooltip, "\n ");
-            /* TRANSLATORS: Tooltip showing remaining time until next alarm.
-             * %1$d = days, %2$d = hours, %3$d = minutes, %4$s = alarm title.
-             * Example: "01 d 05 h 30 min to: Meeting
-             */
-            g_string_append_printf (tooltip,
-                _("<span weight=\"bold\">%1$02d d %2$02d h %3$02d min to:</span> %4$s"),
-                dd, hh, min, formatted_title->str);
+    return(TRUE);
+#else
+    return(FALSE);
+#endif
+}
 
-            g_string_free(formatted_title, TRUE);
-            alarm_cnt++;
-        }
-        else /* sorted so scan can be stopped */
-            more_alarms = FALSE;
+/* Set trayicon tooltip from the model. Only remaining times are counted.
+ * Returns FALSE if there is no trayicon. */
+static gboolean tooltip_render (void)
+{
+#ifdef HAVE_X11_TRAY_ICON
+    GDateTime *gdt;
+    alarm_struct *cur_alarm;
+    gint hour, minute;
+    gint dd, hh, min;
+    gint i;
 
-        orage_alarm_unref (cur_alarm);
+    if (g_par.trayIcon == NULL)
+        return(FALSE);
+
+    if (!orage_status_icon_is_embedded ((GtkStatusIcon *)g_par.trayIcon)) {
+        /* not shown yet, try again later */
+        return(TRUE);
     }
 
+    if (tooltip_markup == NULL)
+        tooltip_markup = g_string_sized_new (512);
+    else
+        g_string_truncate (tooltip_markup, 0);
+
+    gdt = g_date_time_new_now_local ();
+    g_string_append (tooltip_markup, "<span foreground=\"blue\" weight=\"bold\" underline=\"single\">");
+    g_string_append (tooltip_markup, _("Next active alarms:"));
+    g_string_append (tooltip_markup, " </span>");
+    for (i = 0; i < tooltip_entry_cnt; i++) {
+        cur_alarm = tooltip_entries[i].alarm;
+        hour = g_date_time_get_hour (cur_alarm->alarm_time);
+        minute = g_date_time_get_minute (cur_alarm->alarm_time);
+        dd = orage_gdatetime_days_between (gdt, cur_alarm->alarm_time);
+        hh = hour - g_date_time_get_hour (gdt);
+        min = minute - g_date_time_get_minute (gdt);
+        if (min < 0) {
+            min += 60;
+            hh -= 1;
+        }
+        if (hh < 0) {
+            hh += 24;
+            dd -= 1;
+        }
+
+        g_string_append (tooltip_markup, "\n ");
+        /* TRANSLATORS: Tooltip showing remaining time until next alarm.
+         * %1$d = days, %2$d = hours, %3$d = minutes, %4$s = alarm title.
+         * Example: "01 d 05 h 30 min to: Meeting
+         */
+        g_string_append_printf (tooltip_markup,
+            _("<span weight=\"bold\">%1$02d d %2$02d h %3$02d min to:</span> %4$s"),
+            dd, hh, min, tooltip_entries[i].title);
+    }
     g_date_time_unref (gdt);
 
-    if (alarm_cnt == 0)
+    if (tooltip_entry_cnt == 0)
     {
-        g_string_append_c (tooltip, '\n');
-        g_string_append (tooltip, _("No active alarms found"));
+        g_string_append_c (tooltip_markup, '\n');
+        g_string_append (tooltip_markup, _("No active alarms found"));
     }
 
-    orage_status_icon_set_tooltip_markup ((GtkStatusIcon *)g_par.trayIcon, tooltip->str);
-
-    g_string_free(tooltip, TRUE);
+    orage_status_icon_set_tooltip_markup ((GtkStatusIcon *)g_par.trayIcon,
+                                          tooltip_markup->str);
 
     return(TRUE);
 #else
-    return FALSE;
+    return(FALSE);
 #endif
 }
 
-/* start timer to fire every minute to keep tooltip accurate */
-static gboolean start_orage_tooltip_update (G_GNUC_UNUSED gpointer user_data)
+static void tooltip_schedule (guint secs);
+
+/* Refresh trayicon tooltip once per minute. */
+static gboolean orage_tooltip_update (G_GNUC_UNUSED gpointer user_data)
 {
-    if (g_par.tooltip_timer) { /* need to stop it if running */
-        g_source_remove(g_par.tooltip_timer);
-    }
+    GDateTime *gdt;
+    gint secs_left;
 
-    orage_tooltip_update(NULL);
-    g_par.tooltip_timer = g_timeout_add_seconds(60
-            , (GSourceFunc) orage_tooltip_update, NULL);
+    g_par.tooltip_timer = 0;
+    if (tooltip_render ()) {
+        /* next run right after the minute changes */
+        gdt = g_date_time_new_now_local ();
+        secs_left = 61 - g_date_time_get_second (gdt);
+        g_date_time_unref (gdt);
+        tooltip_schedule (secs_left);
+    }
 
-    return(FALSE);
+    return(FALSE); /* tooltip_schedule started new timer */
 }
 
-/* adjust the call to happen when minute changes */
-static gboolean reset_orage_tooltip_update (G_GNUC_UNUSED gpointer user_data)
+/* There is only one tooltip timer, new schedule replaces the old one. */
+static void tooltip_schedule (const guint secs)
 {
-    GDateTime *gdt;
-    gint secs_left;
+    if (g_par.tooltip_timer)
+        g_source_remove (g_par.tooltip_timer);
 
-    gdt = g_date_time_new_now_local ();
-    secs_left = 60 - g_date_time_get_second (gdt);
-    g_date_time_unref (gdt);
-
-    if (secs_left > 2) 
-        orage_tooltip_update(NULL);
-    /* FIXME: do not start this, if it is already in progress.
-     * Minor thing and does not cause any real trouble and happens
-     * only when appoinments are updated in less than 1 minute apart. 
-     * Perhaps not worth fixing. 
-     * Should add another timer or static time to keep track of this */
-    g_timeout_add_seconds(secs_left
-            , (GSourceFunc) start_orage_tooltip_update, NULL);
+    g_par.tooltip_timer = g_timeout_add_seconds (secs
+            , (GSourceFunc) orage_tooltip_update, NULL);
+}
 
-    return(FALSE);
+void orage_tooltip_refresh (void)
+{
+    /* We need to use timer since for some reason it does not work if we
+     * do it here directly. Ugly, I know, but it works. */
+    tooltip_schedule (1);
 }
 
 void setup_orage_alarm_clock(void)
@@ -1109,10 +1244,11 @@ void setup_orage_alarm_clock(void)
     /* order the list */
     g_par.alarm_list = g_list_sort(g_par.alarm_list, orage_alarm_order);
     reset_orage_alarm_clock();
-    store_persistent_alarms(); /* keep track of alarms when orage is down */
-    /* We need to use timer since for some reason it does not work if we
-     * do it here directly. Ugly, I know, but it works. */
-    g_timeout_add_seconds (1, reset_orage_tooltip_update, NULL);
+    /* keep track of alarms when orage is down */
+    orage_alarm_store_update (g_par.alarm_list);
+    /* tooltip changes only when the shown alarms change */
+    if (tooltip_model_update ())
+        orage_tooltip_refresh ();
 }
 
 void orage_notify_uninit (void)
@@ -27,9 +27,26 @@
 
 gboolean orage_day_change(gpointer user_data);
 void setup_orage_alarm_clock(void);
+
+/** Show the tooltip of the trayicon again, for example after the icon was
+ *  created. Tooltip is otherwise updated when the next alarms change and
+ *  once per minute.
+ */
+void orage_tooltip_refresh (void);
 void alarm_add(alarm_struct *alarm);
 void alarm_read (void);
+
+/** Catch up after suspend or hibernate. Alarms which were due during the
+ *  sleep are raised together and timers are set again without reading the
+ *  calendar files, unless the date changed.
+ */
+void orage_alarm_resume (void);
 void alarm_list_free (void);
+
+/** Add memory usage of the alarm list.
+ *  @param usage array of OrageMemoryUsage
+ */
+void alarm_list_memory_usage (GArray *usage);
 void create_reminders(alarm_struct *alarm);
 void orage_notify_uninit (void);
 
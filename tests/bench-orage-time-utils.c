@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2026 Erkki Moorits
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ *     Free Software Foundation
+ *     51 Franklin Street, 5th Floor
+ *     Boston, MA 02110-1301 USA
+ */
+
+#include "orage-time-utils.h"
+
+#include <glib.h>
+#include <libical/ical.h>
+
+/* Number of simulated occurrences, each has start and end time. */
+#define BENCH_OCCURRENCES 200000
+
+/* One day between occurrences, like daily repeating event. */
+#define BENCH_STEP (24 * 60 * 60)
+
+#define BENCH_FIRST ((time_t)1767225600) /* 2026-01-01T00:00:00Z */
+
+/** Occurrence time conversion as it was done before: unix time to UTC
+ *  GDateTime, then to icaltimetype and back to GDateTime through strings.
+ */
+static GDateTime *occurrence_time_with_strings (const time_t t)
+{
+    GDateTime *gdt;
+    gchar *str;
+    struct icaltimetype icalt;
+
+    gdt = g_date_time_new_from_unix_utc (t);
+    str = orage_gdatetime_to_icaltime (gdt, FALSE);
+    icalt = icaltime_from_string (str);
+    g_free (str);
+    g_date_time_unref (gdt);
+
+    return orage_icaltime_to_gdatetime (icaltime_as_ical_string (icalt));
+}
+
+/** Occurrence time conversion with struct level helpers. */
+static GDateTime *occurrence_time_direct (const time_t t)
+{
+    struct icaltimetype icalt;
+
+    icalt = orage_time_t_to_icaltimetype (t);
+
+    return orage_icaltimetype_to_gdatetime2 (icalt);
+}
+
+static gdouble run_occurrences (GDateTime *(*convert) (time_t))
+{
+    GDateTime *gdt_start;
+    GDateTime *gdt_end;
+    time_t t;
+    gint i;
+
+    g_test_timer_start ();
+
+    for (i = 0, t = BENCH_FIRST; i < BENCH_OCCURRENCES; i++, t += BENCH_STEP)
+    {
+        gdt_start = convert (t);
+        gdt_end = convert (t + 60 * 60);
+        g_date_time_unref (gdt_start);
+        g_date_time_unref (gdt_end);
+    }
+
+    return g_test_timer_elapsed ();
+}
+
+static void bench_same_result (void)
+{
+    GDateTime *gdt1;
+    GDateTime *gdt2;
+    time_t t;
+    gint i;
+
+    for (i = 0, t = BENCH_FIRST; i < 1000; i++, t += BENCH_STEP + 3671)
+    {
+        gdt1 = occurrence_time_with_strings (t);
+        gdt2 = occurrence_time_direct (t);
+        g_assert_true (g_date_time_equal (gdt1, gdt2));
+        g_date_time_unref (gdt1);
+        g_date_time_unref (gdt2);
+    }
+}
+
+static void bench_occurrence_conversion (void)
+{
+    gdouble with_strings;
+    gdouble direct;
+
+    if (!g_test_perf ())
+    {
+        g_test_skip ("run with -m perf");
+        return;
+    }
+
+    with_strings = run_occurrences (occurrence_time_with_strings);
+    direct = run_occurrences (occurrence_time_direct);
+
+    g_test_minimized_result (with_strings * 1e9 / BENCH_OCCURRENCES,
+                             "string round-trip: %.0f ns per occurrence",
+                             with_strings * 1e9 / BENCH_OCCURRENCES);
+    g_test_minimized_result (direct * 1e9 / BENCH_OCCURRENCES,
+                             "direct conversion: %.0f ns per occurrence",
+                             direct * 1e9 / BENCH_OCCURRENCES);
+}
+
+int main (int argc, char **argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/bench/time-utils/same_result", bench_same_result);
+    g_test_add_func ("/bench/time-utils/occurrence_conversion",
+                     bench_occurrence_conversion);
+
+    return g_test_run ();
+}
@@ -21,6 +21,8 @@
 #include "orage-log.h"
 
 #include <glib.h>
+#include <stdio.h>
+#include <string.h>
 
 /** Helper to simulate environment */
 static gboolean test_log (const GLogLevelFlags level,
@@ -73,6 +75,121 @@ static void test_domain_filter (void)
     g_assert_true (test_log (G_LOG_LEVEL_DEBUG, "all", "orage"));
 }
 
+/** Helper to format message with a domain */
+static gsize format_message (gchar *buf, const gsize size,
+                             const gchar *message, const gssize length)
+{
+    GLogField fields[2];
+
+    fields[0].key = "GLIB_DOMAIN";
+    fields[0].value = "orage";
+    fields[0].length = -1;
+    fields[1].key = "MESSAGE";
+    fields[1].value = message;
+    fields[1].length = length;
+
+    return orage_log_format (buf, size, G_LOG_LEVEL_MESSAGE, fields, 2,
+                             FALSE);
+}
+
+static void test_format (void)
+{
+    gchar buf[ORAGE_LOG_LINE_MAX];
+    gsize len;
+
+    len = format_message (buf, sizeof (buf), "hello", -1);
+
+    g_assert_cmpuint (len, ==, strlen (buf));
+    g_assert_true (g_str_has_suffix (buf, "orage-Message: hello\n"));
+
+    /* time stamp HH:MM:SS.mmm */
+    g_assert_cmpint (buf[2], ==, ':');
+    g_assert_cmpint (buf[5], ==, ':');
+    g_assert_cmpint (buf[8], ==, '.');
+}
+
+static void test_format_escape (void)
+{
+    gchar buf[ORAGE_LOG_LINE_MAX];
+
+    format_message (buf, sizeof (buf), "a\001b\tc\xff" "d\r\ne\r", -1);
+    g_assert_true (g_str_has_suffix (buf,
+                                     ": a\\u0001b\tc\\xffd\r\ne\\u000d\n"));
+
+    /* embedded NUL with explicit length */
+    format_message (buf, sizeof (buf), "x\0y", 3);
+    g_assert_true (g_str_has_suffix (buf, ": x\\u0000y\n"));
+
+    /* valid UTF-8 is kept */
+    format_message (buf, sizeof (buf), "k\xc3\xa4" "ev", -1);
+    g_assert_true (g_str_has_suffix (buf, ": k\xc3\xa4" "ev\n"));
+}
+
+static void test_format_truncate (void)
+{
+    gchar buf[ORAGE_LOG_LINE_MIN];
+    gchar *message;
+    gsize len;
+    gint i;
+
+    /* binary payload, every byte needs escaping */
+    message = g_strnfill (10 * ORAGE_LOG_LINE_MAX, '\xff');
+    len = format_message (buf, sizeof (buf), message, -1);
+    g_free (message);
+
+    g_assert_cmpuint (len, <, sizeof (buf));
+    g_assert_cmpuint (len, ==, strlen (buf));
+    g_assert_true (g_str_has_suffix (buf, "...\n"));
+    g_assert_true (g_utf8_validate (buf, -1, NULL));
+
+    /* multibyte character is not cut, whichever position it has */
+    for (i = 0; i < ORAGE_LOG_LINE_MIN; i++)
+    {
+        message = g_strnfill (2 * ORAGE_LOG_LINE_MIN, 'a');
+        message[i] = '\xc3';
+        message[i + 1] = '\xa4';
+        format_message (buf, sizeof (buf), message, -1);
+        g_free (message);
+
+        g_assert_true (g_str_has_suffix (buf, "...\n"));
+        g_assert_true (g_utf8_validate (buf, -1, NULL));
+    }
+}
+
+static void test_async_writer (void)
+{
+    FILE *stream;
+    gchar line[ORAGE_LOG_LINE_MAX];
+    gchar *expected;
+    gint i;
+
+    stream = tmpfile ();
+    g_assert_nonnull (stream);
+
+    orage_log_init ();
+    orage_log_set_stream (stream);
+    orage_log_set_async (TRUE);
+
+    for (i = 0; i < 100; i++)
+        g_message ("async line %d", i);
+
+    /* stopping writes out everything queued */
+    orage_log_set_async (FALSE);
+    orage_log_set_stream (NULL);
+
+    rewind (stream);
+    for (i = 0; i < 100; i++)
+    {
+        g_assert_nonnull (fgets (line, sizeof (line), stream));
+        expected = g_strdup_printf (": async line %d\n", i);
+        g_assert_true (g_str_has_suffix (line, expected));
+        g_free (expected);
+    }
+
+    g_assert_null (fgets (line, sizeof (line), stream));
+    fclose (stream);
+}
+
 int main (int argc, char **argv)
 {
     g_test_init (&argc, &argv, NULL);
@@ -80,6 +197,10 @@ int main (int argc, char **argv)
     g_test_add_func ("/log/default", test_default_levels);
     g_test_add_func ("/log/debug_all", test_debug_all);
     g_test_add_func ("/log/domain", test_domain_filter);
+    g_test_add_func ("/log/format", test_format);
+    g_test_add_func ("/log/format_escape", test_format_escape);
+    g_test_add_func ("/log/format_truncate", test_format_truncate);
+    g_test_add_func ("/log/async_writer", test_async_writer);
 
     return g_test_run ();
 }
@@ -34,11 +34,75 @@ static void test_compare_dates (void)
     g_date_time_unref (d2);
 }
 
+static void test_gdatetime_to_icaltimetype (void)
+{
+    GDateTime *gdt = g_date_time_new_local (2026, 3, 29, 2, 30, 15);
+    struct icaltimetype direct;
+    struct icaltimetype parsed;
+    gchar *str;
+
+    direct = orage_gdatetime_to_icaltimetype (gdt, FALSE);
+    str = orage_gdatetime_to_icaltime (gdt, FALSE);
+    parsed = icaltime_from_string (str);
+    g_assert_cmpint (icaltime_compare (direct, parsed), ==, 0);
+    g_assert_false (icaltime_is_date (direct));
+    g_free (str);
+
+    direct = orage_gdatetime_to_icaltimetype (gdt, TRUE);
+    str = orage_gdatetime_to_icaltime (gdt, TRUE);
+    parsed = icaltime_from_string (str);
+    g_assert_cmpint (icaltime_compare_date_only (direct, parsed), ==, 0);
+    g_assert_true (icaltime_is_date (direct));
+    g_free (str);
+
+    g_date_time_unref (gdt);
+}
+
+static void test_icaltimetype_to_gdatetime (void)
+{
+    struct icaltimetype t = icaltime_from_string ("20261231T235959");
+    struct icaltimetype d = icaltime_from_string ("20260101");
+    GDateTime *direct;
+    GDateTime *parsed;
+
+    direct = orage_icaltimetype_to_gdatetime2 (t);
+    parsed = orage_icaltime_to_gdatetime (icaltime_as_ical_string (t));
+    g_assert_true (g_date_time_equal (direct, parsed));
+    g_date_time_unref (direct);
+    g_date_time_unref (parsed);
+
+    direct = orage_icaltimetype_to_gdatetime2 (d);
+    parsed = orage_icaltime_to_gdatetime (icaltime_as_ical_string (d));
+    g_assert_true (g_date_time_equal (direct, parsed));
+    g_date_time_unref (direct);
+    g_date_time_unref (parsed);
+}
+
+static void test_time_t_to_icaltimetype (void)
+{
+    const time_t t = 1790000000;
+    GDateTime *gdt = g_date_time_new_from_unix_utc (t);
+    struct icaltimetype direct;
+    struct icaltimetype expected;
+
+    direct = orage_time_t_to_icaltimetype (t);
+    expected = orage_gdatetime_to_icaltimetype (gdt, FALSE);
+    g_assert_cmpint (icaltime_compare (direct, expected), ==, 0);
+
+    g_date_time_unref (gdt);
+}
+
 int main (int argc, char **argv)
 {
     g_test_init (&argc, &argv, NULL);
 
     g_test_add_func ("/utility/compare_dates", test_compare_dates);
+    g_test_add_func ("/utility/gdatetime_to_icaltimetype",
+                     test_gdatetime_to_icaltimetype);
+    g_test_add_func ("/utility/icaltimetype_to_gdatetime",
+                     test_icaltimetype_to_gdatetime);
+    g_test_add_func ("/utility/time_t_to_icaltimetype",
+                     test_time_t_to_icaltimetype);
 
     return g_test_run ();
 }